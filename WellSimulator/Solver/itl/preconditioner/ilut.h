@@ -171,7 +171,8 @@ namespace itl {
           (*w)[inrow].value = *A_ij;
           (*w)[inrow].index = A_ij.index();
           inrow++;
-          norm_row += std::norm(T(*A_ij));
+          // norm_row += std::norm(T(*A_ij)); gcc4
+          norm_row += T(*A_ij)*T(*A_ij);
           if ( i > A_ij.index() ) nL++;
           
           ++A_ij;
@@ -357,7 +358,8 @@ namespace itl {
           (*w)[inrow].value = *A_ij;
           (*w)[inrow].index = A_ij.index();
           inrow++;
-          norm_row += std::norm(T(*A_ij));
+          // norm_row += std::norm(T(*A_ij)); gcc4
+          norm_row += T(*A_ij)*T(*A_ij);
           if ( i > A_ij.index() ) nL++;
           
           ++A_ij;
@@ -3010,7 +3010,8 @@ ele_mult(const VecX& x, const VecY& y, MTL_OUT(VecZ) z_) MTL_THROW_ASSERTION
   MTL_ASSERT(x.size() <= y.size(), "mtl::ele_mult()");
   MTL_ASSERT(x.size() <= z.size(), "mtl::ele_mult()");
 
-  ele_mult(x, y, z, dim_n<VecX>::RET());
+  // ele_mult(x, y, z, dim_n<VecX>::RET()); gcc4
+  ele_mult(x, y, z, typename dim_n<VecX>::RET());
 }
 
 
@@ -3160,7 +3161,8 @@ template <class VecX, class VecY, class T>
 inline T
 dot(const VecX& x, const VecY& y, T s, dense_tag, dense_tag)
 {
-  return dot(x, y, s, dim_n<VecX>::RET());
+  // return dot(x, y, s, dim_n<VecX>::RET()); gcc4
+  return dot(x, y, s, typename dim_n<VecX>::RET());
 }
 
 template <class InputIterator1, class InputIterator2, class T>
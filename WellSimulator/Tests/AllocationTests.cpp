@@ -0,0 +1,98 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+#include <new>
+#include <cstdlib>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// Every heap allocation of the test binary, by any thread
+static unsigned long s_allocations = 0;
+
+void* operator new( std::size_t p_size )
+{
+    #pragma omp atomic
+    ++s_allocations;
+    void* p = std::malloc( p_size ? p_size : 1 );
+    if( !p ) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[]( std::size_t p_size )
+{
+    return operator new( p_size );
+}
+
+void operator delete( void* p ) throw()
+{
+    std::free( p );
+}
+
+void operator delete[]( void* p ) throw()
+{
+    std::free( p );
+}
+
+// Heap allocations of p_steps timesteps of p_well, after a first one that sizes its workspace
+static unsigned long allocations_after_first_timestep( TestWell& p_well, int p_steps )
+{
+    unsigned long allocations = s_allocations;
+    CHECK( p_well.timestep() > 0 );
+    CHECK( s_allocations > allocations ); // the counter sees the workspace being sized
+
+    allocations = s_allocations;
+    for( int step = 0; step < p_steps; ++step ) CHECK( p_well.timestep() > 0 );
+    return s_allocations - allocations;
+}
+
+// Once the first timestep has sized the Newton and Krylov workspaces, the assembly, the linear
+// solves and the updates of the timesteps after it don't allocate, whichever the solvers
+WELLSIM_TEST( timesteps_do_not_allocate_after_the_first )
+{
+    const krylov_method_type methods[] = { KRYLOV_GMRES, KRYLOV_BICGSTAB, KRYLOV_GCRODR };
+    const preconditioner_type preconditioners[] = { BLOCK_ILU, SCHWARZ };
+    for( int m = 0; m < 3; ++m ){
+        for( int p = 0; p < 2; ++p ){
+            TestWell well( 40 );
+            well.set_krylov_solver( methods[ m ], preconditioners[ p ] );
+            well.set_number_of_threads( 2 );
+            CHECK( allocations_after_first_timestep( well, 3 ) == 0 );
+        }
+    }
+
+    const jacobian_method_type jacobians[] = { FINITE_DIFFERENCE, COLORED_FINITE_DIFFERENCE, JACOBIAN_FREE };
+    for( int j = 0; j < 3; ++j ){
+        TestWell well( 40 );
+        well.set_jacobian_method( jacobians[ j ] );
+        CHECK( allocations_after_first_timestep( well, 3 ) == 0 );
+    }
+
+    TestWell banded( 40 ), mixed( 40 ), inexact( 40 );
+    banded.set_linear_solver( BLOCK_BANDED_LU );
+    mixed.set_mixed_precision( true );
+    inexact.set_preconditioner_reuse( true );
+    inexact.set_inexact_newton( true );
+    inexact.set_newton_globalization( true );
+    CHECK( allocations_after_first_timestep( banded, 3 ) == 0 );
+    CHECK( allocations_after_first_timestep( mixed, 3 ) == 0 );
+    CHECK( allocations_after_first_timestep( inexact, 3 ) == 0 );
+}
+
+// Heap allocations of a solve() of p_steps timesteps
+static unsigned long solve_allocations( TestWell& p_well, uint_type p_steps )
+{
+    p_well.set_final_timestep( p_steps );
+    unsigned long allocations = s_allocations;
+    p_well.solve();
+    return s_allocations - allocations;
+}
+
+// The timestep loop of solve() itself, its residual norm histories and timers included, allocates
+// nothing per timestep: twice the timesteps, the same allocations
+WELLSIM_TEST( solve_does_not_allocate_per_timestep )
+{
+    TestWell well( 40 );
+    well.set_output_files( false );
+    solve_allocations( well, 2 );
+    CHECK( solve_allocations( well, 6 ) == solve_allocations( well, 3 ) );
+}
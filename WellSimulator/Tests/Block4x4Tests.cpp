@@ -0,0 +1,87 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+#include <Block4x4.h>
+#include <cstdlib>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+using namespace WellSimulator::block4x4;
+
+// p_blocks random blocks, diagonally dominant with p_dominant so their LU is well conditioned
+template <class Real>
+static std::vector<Real> random_blocks( unsigned p_blocks, bool p_dominant = false )
+{
+    std::vector<Real> a( SIZE*p_blocks );
+    for( unsigned k = 0; k < a.size(); ++k ) a[ k ] = Real( std::rand()/double( RAND_MAX ) - 0.5 );
+    for( unsigned b = 0; p_dominant && b < p_blocks; ++b ){
+        for( int r = 0; r < N; ++r ) a[ SIZE*b + N*r + r ] += Real( 4 );
+    }
+    return a;
+}
+
+// The kernels of block4x4 with an AVX2 version, those of the block LU factorization, on the same
+// operands
+template <class Real>
+struct KernelRun
+{
+    std::vector<Real> blocks, solved_blocks;
+
+    KernelRun( const std::vector<Real>& a, const std::vector<Real>& lu, const std::vector<int>& piv, unsigned p_blocks )
+        : blocks( a ), solved_blocks( a )
+    {
+        for( unsigned i = 0; i < p_blocks; ++i ){
+            if( i > 0 ) gemm_sub( &a[ SIZE*i ], &a[ SIZE*( i - 1 ) ], &blocks[ SIZE*i ] );
+            lu_solve_block( &lu[ SIZE*i ], &piv[ N*i ], &solved_blocks[ SIZE*i ] );
+        }
+    }
+};
+
+template <class Real>
+static void check_simd_kernels( double p_tolerance )
+{
+    const unsigned n = 9;
+    std::vector<Real> a = random_blocks<Real>( n ), lu = random_blocks<Real>( n, true );
+    std::vector<int> piv( N*n );
+    for( unsigned i = 0; i < n; ++i ) CHECK( scalar::lu_factor( &lu[ SIZE*i ], &piv[ N*i ] ) );
+
+    bool simd = use_simd();
+    use_simd() = false;
+    KernelRun<Real> scalar_run( a, lu, piv, n );
+    use_simd() = true;
+    KernelRun<Real> simd_run( a, lu, piv, n );
+    use_simd() = simd;
+
+    CHECK( relative_difference( scalar_run.blocks, simd_run.blocks, SIZE*n ) < p_tolerance );
+    CHECK( relative_difference( scalar_run.solved_blocks, simd_run.solved_blocks, SIZE*n ) < p_tolerance );
+}
+
+// The AVX2 kernels against the scalar ones, where the CPU has AVX2 and FMA
+WELLSIM_TEST( simd_kernels_match_scalar_kernels )
+{
+    if( !avx2_supported() ){
+        std::cout << " (no AVX2, scalar kernels only)";
+        return;
+    }
+    check_simd_kernels<double>( 1E-13 );
+    check_simd_kernels<float>( 1E-5 );
+}
+
+// ... and the block banded solve, factored with them, against the one on the scalar kernels
+WELLSIM_TEST( simd_block_banded_solve_matches_scalar )
+{
+    if( !avx2_supported() ) return;
+    TestWell well( 40 );
+    CHECK( well.timestep() > 0 );
+    well.start_timestep( 10.0 );
+    well.compute_Jacobian();
+    svector_type b( well.size() ), x_scalar( well.size() ), x_simd( well.size() );
+    itl::copy( well.rhs(), b );
+
+    bool simd = use_simd();
+    use_simd() = false;
+    well.BlockBanded_Solve( well.jacobian(), x_scalar, b );
+    use_simd() = true;
+    well.BlockBanded_Solve( well.jacobian(), x_simd, b );
+    use_simd() = simd;
+    CHECK( relative_difference( x_scalar, x_simd, well.size() ) < 1E-10 );
+}
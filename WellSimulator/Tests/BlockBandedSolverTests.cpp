@@ -0,0 +1,141 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// The Jacobian of the first Newton iteration of a long timestep, after a short one: far from
+// converged, so the right-hand side isn't down at the round-off of the solvers
+static void newton_system( TestWell& p_well, svector_type& b )
+{
+    CHECK( p_well.timestep() > 0 );
+    p_well.start_timestep( 10.0 );
+    p_well.compute_Jacobian();
+    itl::copy( p_well.rhs(), b );
+}
+
+// BLOCK_BANDED_LU against dense Gaussian elimination of the same Jacobian
+WELLSIM_TEST( block_banded_solve_matches_dense_lu )
+{
+    TestWell well( 40 );
+    svector_type b( well.size() ), x_banded( well.size() ), x_dense( well.size() );
+    newton_system( well, b );
+
+    well.BlockBanded_Solve( well.jacobian(), x_banded, b );
+    CHECK( !well.solve_failed() );
+    CHECK( dense_solve( well.jacobian(), b, x_dense ) );
+    CHECK( relative_residual( well.jacobian(), x_banded, b ) < 1E-12 );
+    CHECK( relative_difference( x_dense, x_banded, well.size() ) < 1E-10 );
+}
+
+// ... and against the GMRES_ILU path, GMRES(10) on block ILU(0)
+WELLSIM_TEST( block_banded_solve_matches_gmres_ilu )
+{
+    TestWell well( 40 );
+    svector_type b( well.size() ), x_banded( well.size() ), x_krylov( well.size() );
+    newton_system( well, b );
+
+    well.BlockBanded_Solve( well.jacobian(), x_banded, b );
+    well.set_krylov_solver( KRYLOV_GMRES, BLOCK_ILU );
+    well.Krylov_Solve( well.jacobian(), x_krylov, b );
+    CHECK( !well.solve_failed() );
+    CHECK( relative_residual( well.jacobian(), x_krylov, b ) < 1E-6 );
+    CHECK( relative_difference( x_banded, x_krylov, well.size() ) < 1E-6 );
+}
+
+// Both linear solvers take the well through the same timesteps
+WELLSIM_TEST( block_banded_timesteps_match_gmres_ilu )
+{
+    TestWell direct( 20 ), krylov( 20 );
+    direct.set_linear_solver( BLOCK_BANDED_LU );
+    krylov.set_linear_solver( GMRES_ILU );
+    for( int step = 0; step < 3; ++step ){
+        CHECK( direct.timestep() > 0 );
+        CHECK( krylov.timestep() > 0 );
+    }
+    for( uint_type i = 0; i < 20; ++i ){
+        CHECK_CLOSE( krylov.pressure_at( i ), direct.pressure_at( i ), 1E-8 );
+        CHECK_CLOSE( krylov.gas_vol_frac_at( i ), direct.gas_vol_frac_at( i ), 1E-8 );
+        CHECK_CLOSE( krylov.velocity_at( i ), direct.velocity_at( i ), 1E-8 );
+    }
+}
+
+// The partitioned elimination on p_threads threads, partitions down to 8 cells, against the serial
+// one, on one Newton system
+static void check_partitioned_solve( TestWell& p_well, const svector_type& b, unsigned p_threads, unsigned p_partitions )
+{
+    const unsigned n = p_well.size();
+    svector_type x_serial( n ), x_partitioned( n );
+    BlockBandedSolver serial;
+    serial.load( p_well.jacobian() );
+    CHECK( serial.factorize() );
+    serial.solve( b, x_serial );
+
+    PartitionedBlockBandedSolver partitioned;
+    partitioned.set_partition_thresholds( 2, 8 );
+    partitioned.set_number_of_threads( p_threads );
+    CHECK( partitioned.load( p_well.jacobian() ) );
+    CHECK( partitioned.factorize() );
+    partitioned.solve( b, x_partitioned );
+    CHECK( partitioned.number_of_partitions() == p_partitions );
+    CHECK( relative_residual( p_well.jacobian(), x_partitioned, b ) < 1E-12 );
+    CHECK( relative_difference( x_serial, x_partitioned, n ) < 1E-10 );
+}
+
+// PARALLEL_BLOCK_BANDED_LU, the SPIKE-like partitioning, solves like BLOCK_BANDED_LU on one
+// partition per thread
+WELLSIM_TEST( partitioned_solve_matches_block_banded )
+{
+    TestWell well( 100 );
+    svector_type b( well.size() );
+    newton_system( well, b );
+    const unsigned threads[] = { 1, 2, 3, 4, 7, 10, 16 };
+    const unsigned partitions[] = { 1, 2, 3, 4, 7, 10, 10 };
+    for( int t = 0; t < 7; ++t ) check_partitioned_solve( well, b, threads[ t ], partitions[ t ] );
+}
+
+// By default, and with thresholds set, fewer threads or shorter partitions than them, the solve
+// is the serial one
+WELLSIM_TEST( partition_thresholds_fall_back_to_one_partition )
+{
+    TestWell well( 100 );
+    svector_type b( well.size() ), x_serial( well.size() ), x_partitioned( well.size() );
+    newton_system( well, b );
+    well.BlockBanded_Solve( well.jacobian(), x_serial, b );
+
+    // 100 cells make at most 4 partitions of 20 cells, or 3 of 30
+    PartitionedBlockBandedSolver partitioned;
+    partitioned.set_number_of_threads( 16 );
+    CHECK( partitioned.load( well.jacobian() ) );
+    CHECK( partitioned.number_of_partitions() == 1 );
+
+    const unsigned min_partitions[] = { 4, 4, 4, 4, 2 };
+    const unsigned min_cells[] = { 20, 20, 20, 30, 30 };
+    const unsigned threads[] = { 3, 4, 8, 8, 8 };
+    const unsigned partitions[] = { 1, 4, 4, 1, 3 };
+    for( int t = 0; t < 5; ++t ){
+        partitioned.set_partition_thresholds( min_partitions[ t ], min_cells[ t ] );
+        partitioned.set_number_of_threads( threads[ t ] );
+        CHECK( partitioned.load( well.jacobian() ) );
+        CHECK( partitioned.number_of_partitions() == partitions[ t ] );
+        CHECK( partitioned.factorize() );
+        partitioned.solve( b, x_partitioned );
+        CHECK( relative_difference( x_serial, x_partitioned, well.size() ) < 1E-10 );
+    }
+}
+
+// ... and the well goes through the same timesteps with either
+WELLSIM_TEST( partitioned_timesteps_match_block_banded )
+{
+    TestWell serial( 60 ), partitioned( 60 );
+    serial.set_linear_solver( BLOCK_BANDED_LU );
+    partitioned.set_linear_solver( PARALLEL_BLOCK_BANDED_LU );
+    partitioned.set_number_of_threads( 4 );
+    partitioned.set_partition_thresholds( 2, 8 );
+    for( int step = 0; step < 3; ++step ){
+        uint_type serial_iterations = serial.timestep();
+        CHECK( serial_iterations > 0 );
+        CHECK( partitioned.timestep() == serial_iterations );
+    }
+    check_same_state( serial, partitioned, 60, 1E-8 );
+}
@@ -0,0 +1,125 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// Largest difference of two Jacobians of the same size, each row relative to the largest entry of
+// that row of A: the rows are the residuals of different equations, with their own scales
+static double jacobian_difference( const bmatrix_type& A, const bmatrix_type& B )
+{
+    double difference = 0.0;
+    for( unsigned i = 0; i < A.number_of_blocks(); ++i ){
+        for( int r = 0; r < block4x4::N; ++r ){
+            double row_difference = 0.0, row_scale = 0.0;
+            for( int offset = BlockSparseMatrix::W; offset <= BlockSparseMatrix::EE; ++offset ){
+                const double* A_block = A.block( i, offset );
+                const double* B_block = B.block( i, offset );
+                if( !A_block ) continue;
+                for( int c = 0; c < block4x4::N; ++c ){
+                    row_difference = std::max( row_difference, std::fabs( A_block[ block4x4::N*r + c ] - B_block[ block4x4::N*r + c ] ) );
+                    row_scale = std::max( row_scale, std::fabs( A_block[ block4x4::N*r + c ] ) );
+                }
+            }
+            if( row_scale > 0.0 ) difference = std::max( difference, row_difference/row_scale );
+        }
+    }
+    return difference;
+}
+
+// The Jacobian of p_method at the first Newton iteration of the second timestep of a fresh well,
+// assembled by p_threads threads
+static void jacobian_of( jacobian_method_type p_method, uint_type p_nnodes, bmatrix_type& A, svector_type& b, uint_type p_threads = 1 )
+{
+    TestWell well( p_nnodes );
+    well.set_jacobian_method( p_method );
+    well.set_number_of_threads( p_threads );
+    CHECK( well.timestep() > 0 );
+    well.start_timestep( 1.0 );
+    well.compute_Jacobian();
+    A = well.jacobian();
+    b = svector_type( well.size() );
+    itl::copy( well.rhs(), b );
+}
+
+// AUTOMATIC_DIFFERENTIATION against the one-sided differences of FINITE_DIFFERENCE: they agree to
+// the truncation error of the differences, and the residuals are the same
+WELLSIM_TEST( ad_jacobian_matches_finite_differences )
+{
+    bmatrix_type A_ad, A_fd;
+    svector_type b_ad, b_fd;
+    jacobian_of( AUTOMATIC_DIFFERENTIATION, 20, A_ad, b_ad );
+    jacobian_of( FINITE_DIFFERENCE, 20, A_fd, b_fd );
+
+    CHECK( relative_difference( b_fd, b_ad, b_fd.size() ) < 1E-10 );
+    CHECK( jacobian_difference( A_ad, A_fd ) < 1E-4 );
+}
+
+// Each thread assembles whole block rows, so the threads change nothing, not even the round-off
+WELLSIM_TEST( threaded_assembly_matches_serial )
+{
+    const jacobian_method_type methods[] = { FINITE_DIFFERENCE, AUTOMATIC_DIFFERENTIATION };
+    for( int m = 0; m < 2; ++m ){
+        bmatrix_type A_serial, A_threaded;
+        svector_type b_serial, b_threaded;
+        jacobian_of( methods[ m ], 40, A_serial, b_serial );
+        jacobian_of( methods[ m ], 40, A_threaded, b_threaded, 4 );
+        CHECK( relative_difference( b_serial, b_threaded, b_serial.size() ) == 0.0 );
+        CHECK( jacobian_difference( A_serial, A_threaded ) == 0.0 );
+    }
+}
+
+// COLORED_FINITE_DIFFERENCE perturbs every fourth node at once with the increments of
+// FINITE_DIFFERENCE, and no residual depends on two nodes of a color: the same differences
+WELLSIM_TEST( colored_jacobian_matches_finite_differences )
+{
+    bmatrix_type A_colored, A_fd, A_ad;
+    svector_type b_colored, b_fd, b_ad;
+    jacobian_of( COLORED_FINITE_DIFFERENCE, 20, A_colored, b_colored );
+    jacobian_of( FINITE_DIFFERENCE, 20, A_fd, b_fd );
+    jacobian_of( AUTOMATIC_DIFFERENTIATION, 20, A_ad, b_ad );
+
+    CHECK( relative_difference( b_fd, b_colored, b_fd.size() ) < 1E-10 );
+    CHECK( jacobian_difference( A_fd, A_colored ) < 1E-12 );
+    CHECK( jacobian_difference( A_ad, A_colored ) < 1E-4 );
+}
+
+// The J*x of JACOBIAN_FREE against the AD Jacobian times x, for x the Newton step: the same to the
+// truncation error of the differences, the identity rows of the boundary conditions included
+WELLSIM_TEST( jacobian_free_product_matches_ad_jacobian )
+{
+    TestWell well( 12 );
+    well.set_jacobian_method( AUTOMATIC_DIFFERENTIATION );
+    CHECK( well.timestep() > 0 );
+    well.start_timestep( 1.0 );
+    well.compute_Jacobian();
+    const unsigned n = well.size();
+    bmatrix_type A = well.jacobian();
+    svector_type b( n ), x( n ), Ax( n ), Jx( n );
+    itl::copy( well.rhs(), b );
+    well.BlockBanded_Solve( A, x, b );
+    A.mult( x, Ax );
+
+    well.set_jacobian_method( JACOBIAN_FREE );
+    well.compute_Jacobian();
+    CHECK( relative_difference( b, well.rhs(), n ) < 1E-10 );
+    well.jacobian_free_mult( x, Jx );
+    CHECK( relative_difference( Ax, Jx, n ) < 1E-6 );
+}
+
+// ... and Newton-Krylov on it takes the well through the same timesteps, to the Newton tolerance
+WELLSIM_TEST( jacobian_free_timesteps_match_ad )
+{
+    TestWell ad( 20 ), jacobian_free( 20 );
+    ad.set_jacobian_method( AUTOMATIC_DIFFERENTIATION );
+    jacobian_free.set_jacobian_method( JACOBIAN_FREE );
+    for( int step = 0; step < 3; ++step ){
+        CHECK( ad.timestep() > 0 );
+        CHECK( jacobian_free.timestep() > 0 );
+    }
+    for( uint_type i = 0; i < 20; ++i ){
+        CHECK_CLOSE( ad.pressure_at( i ), jacobian_free.pressure_at( i ), 1E-6 );
+        CHECK_CLOSE( ad.gas_vol_frac_at( i ), jacobian_free.gas_vol_frac_at( i ), 1E-6 );
+        CHECK_CLOSE( ad.velocity_at( i ), jacobian_free.velocity_at( i ), 1E-6 );
+    }
+}
@@ -0,0 +1,202 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// GMRES on the block ILU(0) of an earlier Newton iteration converges to the same timesteps as
+// GMRES refactoring every Newton step, and reuses the factors on most of them
+WELLSIM_TEST( preconditioner_reuse_converges_like_refactoring )
+{
+    TestWell fresh( 20 ), reused( 20 );
+    fresh.set_linear_solver( GMRES_ILU );
+    reused.set_linear_solver( GMRES_ILU );
+    reused.set_preconditioner_reuse( true );
+    for( int step = 0; step < 5; ++step ){
+        CHECK( fresh.timestep() > 0 );
+        CHECK( reused.timestep() > 0 );
+    }
+    check_same_state( fresh, reused, 20, 1E-6 );
+    CHECK( fresh.preconditioner_statistics().reuses == 0 );
+    CHECK( reused.preconditioner_statistics().reuses > reused.preconditioner_statistics().factorizations );
+}
+
+// The step size set before the first factorization doesn't count as a timestep change; later
+// changes of it do
+WELLSIM_TEST( first_factorization_keeps_its_refactor_reason )
+{
+    TestWell well( 20 );
+    well.set_linear_solver( GMRES_ILU );
+    well.set_preconditioner_reuse( true );
+    CHECK( well.timestep() > 0 );
+    const PreconditionerStatistics& statistics = well.preconditioner_statistics();
+    CHECK( statistics.refactor_reasons[ FIRST_FACTORIZATION ] == 1 );
+    CHECK( statistics.refactor_reasons[ TIMESTEP_CHANGE ] == 0 );
+    CHECK( well.timestep() > 0 );
+    CHECK( statistics.refactor_reasons[ TIMESTEP_CHANGE ] == 0 );
+    well.set_dt( 1.0 );
+    CHECK( well.timestep() > 0 );
+    CHECK( statistics.refactor_reasons[ TIMESTEP_CHANGE ] == 1 );
+}
+
+// The Jacobian of the first Newton iteration of a long timestep, after a short one
+static void newton_system( TestWell& p_well, svector_type& b )
+{
+    CHECK( p_well.timestep() > 0 );
+    p_well.start_timestep( 10.0 );
+    p_well.compute_Jacobian();
+    itl::copy( p_well.rhs(), b );
+}
+
+// ( A^T x, y ) = ( x, A y ), for the transposed products of QMR
+WELLSIM_TEST( trans_mult_is_the_transposed_product )
+{
+    TestWell well( 12 );
+    const unsigned n = well.size();
+    svector_type b( n ), x( n ), y( n ), Ay( n ), ATx( n );
+    newton_system( well, b );
+    for( unsigned k = 0; k < n; ++k ){
+        x[ k ] = std::sin( 1.0 + k );
+        y[ k ] = std::cos( 2.0*k );
+    }
+    well.jacobian().mult( y, Ay );
+    well.jacobian().trans_mult( x, ATx );
+    CHECK_CLOSE( itl::dot( x, Ay ), itl::dot( ATx, y ), 1E-12*std::fabs( itl::dot( x, Ay ) ) );
+}
+
+// The scalar ITL preconditioners and QMR solve the Newton system like BLOCK_BANDED_LU. Not every
+// method converges on every one: GMRES(10) stagnates on ILUT and point Jacobi, BiCGSTAB breaks
+// down on them or not with the rounding of the Jacobian, and nothing converges on SSOR, but the
+// tuning still runs them.
+WELLSIM_TEST( scalar_preconditioners_solve_like_block_banded )
+{
+    const krylov_method_type methods[] = { KRYLOV_GMRES, KRYLOV_QMR, KRYLOV_BICGSTAB, KRYLOV_QMR, KRYLOV_TFQMR, KRYLOV_QMR };
+    const preconditioner_type preconditioners[] = { SCALAR_ILU, SCALAR_ILU, SCALAR_ILU, ILUT, DIAGONAL, DIAGONAL };
+    for( int k = 0; k < 6; ++k ){
+        TestWell well( 20 );
+        svector_type b( well.size() ), x_banded( well.size() ), x_krylov( well.size() );
+        newton_system( well, b );
+        well.BlockBanded_Solve( well.jacobian(), x_banded, b );
+        CHECK( well.set_krylov_solver( krylov_method_name( methods[ k ] ), preconditioner_name( preconditioners[ k ] ) ) );
+        well.Krylov_Solve( well.jacobian(), x_krylov, b );
+        CHECK( !well.solve_failed() );
+        CHECK( relative_residual( well.jacobian(), x_krylov, b ) < 1E-6 );
+        CHECK( relative_difference( x_banded, x_krylov, well.size() ) < 1E-6 );
+    }
+}
+
+// QMR needs M^-T, which the block preconditioners don't have
+WELLSIM_TEST( qmr_takes_only_the_scalar_preconditioners )
+{
+    TestWell well( 4 );
+    CHECK( !well.set_krylov_solver( "qmr", "ilu" ) );
+    CHECK( !well.set_krylov_solver( "qmr", "schwarz" ) );
+    CHECK( well.krylov_method() == KRYLOV_GMRES && well.preconditioner() == BLOCK_ILU );
+    CHECK( well.set_krylov_solver( "qmr", "ssor" ) );
+    CHECK( well.set_krylov_solver( "qmr", "none" ) );
+}
+
+// Auto-tuning factors every preconditioner, the scalar ones included, on each Jacobian of a round,
+// and the pair it keeps takes the well through the same timesteps as the default
+WELLSIM_TEST( auto_tuning_with_the_scalar_preconditioners_matches_gmres_ilu )
+{
+    TestWell fixed( 20 ), tuned( 20 );
+    CHECK( tuned.set_krylov_solver( "auto", "" ) );
+    for( int step = 0; step < 3; ++step ){
+        CHECK( fixed.timestep() > 0 );
+        CHECK( tuned.timestep() > 0 );
+    }
+    check_same_state( fixed, tuned, 20, 1E-6 );
+    const PreconditionerStatistics& statistics = tuned.preconditioner_statistics();
+    CHECK( statistics.krylov_tunings > 0 );
+    CHECK( statistics.tuning_factorizations > 0 && statistics.tuning_factorizations % ( total_preconditioners - 1 ) == 0 );
+}
+
+// With factors of the Jacobian it is applied with, the second stage of CPR is the exact LU of
+// block ILU(0), so CPR is the exact solve of BLOCK_BANDED_LU whatever its pressure stage did
+WELLSIM_TEST( fresh_cpr_solves_like_block_banded )
+{
+    TestWell well( 40 );
+    svector_type b( well.size() ), x_banded( well.size() ), x_cpr( well.size() );
+    newton_system( well, b );
+
+    well.BlockBanded_Solve( well.jacobian(), x_banded, b );
+    CPRPreconditioner cpr;
+    CHECK( cpr.factorize( well.jacobian() ) );
+    CHECK( cpr.number_of_blocks() == 40 );
+    cpr.solve( b, x_cpr );
+    CHECK( relative_difference( x_banded, x_cpr, well.size() ) < 1E-10 );
+}
+
+// With factors kept from earlier Newton iterations, GMRES on CPR takes the well through the same
+// timesteps as GMRES refactoring block ILU(0) every Newton step
+WELLSIM_TEST( reused_cpr_converges_like_refactored_ilu )
+{
+    TestWell fresh( 20 ), reused( 20 );
+    fresh.set_linear_solver( GMRES_ILU );
+    reused.set_linear_solver( GMRES_ILU );
+    CHECK( reused.set_krylov_solver( "gmres", "cpr" ) );
+    reused.set_preconditioner_reuse( true );
+    for( int step = 0; step < 5; ++step ){
+        CHECK( fresh.timestep() > 0 );
+        CHECK( reused.timestep() > 0 );
+    }
+    check_same_state( fresh, reused, 20, 1E-6 );
+    CHECK( reused.preconditioner_statistics().reuses > 0 );
+    CHECK( !reused.set_krylov_solver( "qmr", "cpr" ) );
+}
+
+// GCRO-DR against GMRES(10) and the block banded solve on one Newton system, with an empty recycled
+// space and then with the one the first solve left, on a short timestep with block Jacobi and on a
+// long one with Schwarz
+WELLSIM_TEST( gcrodr_solves_like_gmres )
+{
+    const real_type dts[] = { 0.1, 10.0 };
+    const preconditioner_type preconditioners[] = { BLOCK_JACOBI, SCHWARZ };
+    for( int k = 0; k < 2; ++k ){
+        TestWell well( 40 );
+        well.set_number_of_threads( 4 );
+        const unsigned n = well.size();
+        svector_type b( n ), x_banded( n ), x_gmres( n ), x_first( n ), x_recycled( n );
+        CHECK( well.timestep() > 0 );
+        well.start_timestep( dts[ k ] );
+        well.compute_Jacobian();
+        itl::copy( well.rhs(), b );
+        well.BlockBanded_Solve( well.jacobian(), x_banded, b );
+
+        well.set_krylov_solver( KRYLOV_GMRES, preconditioners[ k ] );
+        well.Krylov_Solve( well.jacobian(), x_gmres, b );
+        CHECK( !well.solve_failed() );
+        well.set_krylov_solver( KRYLOV_GCRODR, preconditioners[ k ] );
+        well.Krylov_Solve( well.jacobian(), x_first, b );
+        CHECK( !well.solve_failed() );
+        well.Krylov_Solve( well.jacobian(), x_recycled, b );
+        CHECK( !well.solve_failed() );
+
+        CHECK( relative_difference( x_banded, x_gmres, n ) < 1E-6 );
+        CHECK( relative_difference( x_gmres, x_first, n ) < 1E-6 );
+        CHECK( relative_difference( x_gmres, x_recycled, n ) < 1E-6 );
+        CHECK( relative_residual( well.jacobian(), x_recycled, b ) < 1E-6 );
+    }
+}
+
+// ... and, recycling across Newton iterations and timesteps, takes the well through the timesteps
+// of GMRES
+WELLSIM_TEST( gcrodr_timesteps_match_gmres )
+{
+    const preconditioner_type preconditioners[] = { BLOCK_JACOBI, SCHWARZ };
+    for( int k = 0; k < 2; ++k ){
+        TestWell gmres( 40 ), gcrodr( 40 );
+        gmres.set_number_of_threads( 4 );
+        gcrodr.set_number_of_threads( 4 );
+        gmres.set_krylov_solver( KRYLOV_GMRES, preconditioners[ k ] );
+        gcrodr.set_krylov_solver( KRYLOV_GCRODR, preconditioners[ k ] );
+        for( int step = 0; step < 3; ++step ){
+            CHECK( gmres.timestep() > 0 );
+            CHECK( gcrodr.timestep() > 0 );
+        }
+        check_same_state( gmres, gcrodr, 40, 1E-6 );
+        CHECK( gcrodr.preconditioner_statistics().recycle_applies > 0 );
+        CHECK( gcrodr.preconditioner_statistics().recycled_iterations_saved > 0.0 );
+    }
+}
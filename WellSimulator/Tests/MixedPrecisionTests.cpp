@@ -0,0 +1,71 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// The Jacobian of the first Newton iteration of a long timestep, after a short one
+static void newton_system( TestWell& p_well, svector_type& b )
+{
+    CHECK( p_well.timestep() > 0 );
+    p_well.start_timestep( 10.0 );
+    p_well.compute_Jacobian();
+    itl::copy( p_well.rhs(), b );
+}
+
+// The refinement with the float factors reaches the double precision solution of
+// BLOCK_BANDED_LU, in a few passes
+WELLSIM_TEST( mixed_precision_refinement_solves_like_double )
+{
+    TestWell well( 40 );
+    svector_type b( well.size() ), x_double( well.size() ), x_mixed( well.size() );
+    newton_system( well, b );
+
+    well.BlockBanded_Solve( well.jacobian(), x_double, b );
+    well.set_mixed_precision( true );
+    well.BlockBanded_Solve( well.jacobian(), x_mixed, b );
+    CHECK( !well.solve_failed() );
+    CHECK( well.preconditioner_statistics().refinement_steps > 0 && well.preconditioner_statistics().refinement_steps < 5 );
+    CHECK( relative_residual( well.jacobian(), x_mixed, b ) < 1E-8 );
+    CHECK( relative_difference( x_double, x_mixed, well.size() ) < 1E-8 );
+}
+
+// GMRES on the float block ILU(0) converges to the solution of GMRES on the double one, in
+// about as many iterations
+WELLSIM_TEST( mixed_precision_gmres_solves_like_double )
+{
+    TestWell well( 40 );
+    svector_type b( well.size() ), x_double( well.size() ), x_mixed( well.size() );
+    newton_system( well, b );
+
+    well.set_krylov_solver( KRYLOV_GMRES, BLOCK_ILU );
+    well.Krylov_Solve( well.jacobian(), x_double, b );
+    CHECK( !well.solve_failed() );
+    unsigned double_iterations = well.preconditioner_statistics().krylov_iterations;
+    well.set_mixed_precision( true );
+    well.Krylov_Solve( well.jacobian(), x_mixed, b );
+    CHECK( !well.solve_failed() );
+    unsigned mixed_iterations = well.preconditioner_statistics().krylov_iterations - double_iterations;
+    CHECK( mixed_iterations <= 2*double_iterations );
+    CHECK( relative_residual( well.jacobian(), x_mixed, b ) < 1E-8 );
+    CHECK( relative_difference( x_double, x_mixed, well.size() ) < 1E-8 );
+}
+
+// Both mixed precision solvers take the well through the timesteps of the double precision ones,
+// in as many Newton iterations
+WELLSIM_TEST( mixed_precision_timesteps_match_double )
+{
+    const linear_solver_type solvers[] = { BLOCK_BANDED_LU, GMRES_ILU };
+    for( int s = 0; s < 2; ++s ){
+        TestWell exact( 20 ), mixed( 20 );
+        exact.set_linear_solver( solvers[ s ] );
+        mixed.set_linear_solver( solvers[ s ] );
+        mixed.set_mixed_precision( true );
+        for( int step = 0; step < 3; ++step ){
+            uint_type exact_iterations = exact.timestep();
+            CHECK( exact_iterations > 0 );
+            CHECK( mixed.timestep() == exact_iterations );
+        }
+        check_same_state( exact, mixed, 20, 1E-6 );
+    }
+}
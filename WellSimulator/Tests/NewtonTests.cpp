@@ -0,0 +1,90 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// Eisenstat-Walker forcing terms loosen the Krylov tolerance of the early Newton steps only: the
+// timesteps end where the exact Newton steps take them, the last steps just above NEWTON_CRIT
+// included
+WELLSIM_TEST( inexact_newton_converges_like_exact_newton )
+{
+    TestWell exact( 20 ), inexact( 20 );
+    exact.set_linear_solver( GMRES_ILU );
+    inexact.set_linear_solver( GMRES_ILU );
+    inexact.set_inexact_newton( true );
+    for( int step = 0; step < 5; ++step ){
+        CHECK( exact.timestep() > 0 );
+        CHECK( inexact.timestep() > 0 );
+    }
+    check_same_state( exact, inexact, 20, 1E-6 );
+}
+
+// Chopping and the line search only shorten steps Newton would have taken: where plain Newton
+// converges, the globalized one ends the timesteps in the same state. The second timestep is ten
+// times longer, and its first update gets chopped.
+WELLSIM_TEST( globalized_newton_converges_like_newton )
+{
+    TestWell plain( 20 ), globalized( 20 );
+    globalized.set_newton_globalization( true );
+    for( int step = 0; step < 4; ++step ){
+        if( step == 1 ){
+            plain.set_dt( 1.0 );
+            globalized.set_dt( 1.0 );
+        }
+        CHECK( plain.timestep() > 0 );
+        CHECK( globalized.timestep() > 0 );
+    }
+    check_same_state( plain, globalized, 20, 1E-6 );
+    CHECK( globalized.newton_statistics().chopped_updates > 0 );
+}
+
+// ... and where plain Newton diverges, a timestep of 1000 s right after the first one, the
+// globalized one still converges, to volume fractions within [0,1]
+WELLSIM_TEST( globalized_newton_converges_where_newton_fails )
+{
+    TestWell plain( 20 ), globalized( 20 );
+    globalized.set_newton_globalization( true );
+    CHECK( plain.timestep() > 0 );
+    CHECK( globalized.timestep() > 0 );
+    plain.set_dt( 1000.0 );
+    globalized.set_dt( 1000.0 );
+    CHECK( plain.timestep() == 0 );
+    CHECK( globalized.timestep() > 0 );
+    for( uint_type i = 0; i < 20; ++i ) CHECK( globalized.gas_vol_frac_at( i ) >= 0.0 && globalized.gas_vol_frac_at( i ) <= 1.0 );
+}
+
+// Pseudo-transient continuation with switched evolution relaxation, from the default pseudo steps,
+// takes a liquid well with inflow from its initial state to steady state. The three-phase well of
+// the other tests segregates for longer than the pseudo steps can follow, so gas is left out. The
+// residual is converged at the physical timestep too, which solve_steady_state() leaves as it was:
+// a physical timestep from there takes one Newton iteration and doesn't move the well.
+WELLSIM_TEST( steady_state_is_steady_at_the_physical_timestep )
+{
+    TestWell well( 20, 0.0 );
+    inflow_vector_type liquid( 20, MakeShared<ConstantInflow>( 1.0E-4 ) ), none( 20, MakeShared<ConstantInflow>( 0.0 ) );
+    well.initialize_flow( liquid, liquid, none );
+    well.set_constant_vol_frac( 0.4, 0.0, 0.6 );
+    well.set_with_gas( false );
+    // From the 1 MPa of the other tests at the heel, the liquid column would take the toe below zero
+    well.set_constant_pressure( 1.0E7 );
+    well.set_heel_pressure( 1.0E7 );
+
+    CHECK( well.solve_steady_state() );
+    CHECK( well.dt() == 0.1 );
+    well.start_timestep( well.dt() );
+    well.compute_Jacobian();
+    CHECK( itl::two_norm( well.rhs() ) <= 1.0E-6 );
+
+    std::vector<real_type> pressure( 20 ), velocity( 20 );
+    for( uint_type i = 0; i < 20; ++i ){
+        pressure[ i ] = well.pressure_at( i );
+        velocity[ i ] = well.velocity_at( i );
+        CHECK( pressure[ i ] > 0.0 );
+    }
+    CHECK( well.timestep() == 1 );
+    for( uint_type i = 0; i < 20; ++i ){
+        CHECK_CLOSE( pressure[ i ], well.pressure_at( i ), 1E-6*pressure[ i ] );
+        CHECK_CLOSE( velocity[ i ], well.velocity_at( i ), 1E-8 );
+    }
+}
@@ -0,0 +1,225 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// Pressures from 1E4 to 1E7 Pa, the range the tables are built over
+static std::vector<double> pressures( unsigned p_size )
+{
+    std::vector<double> p( p_size );
+    for( unsigned k = 0; k < p_size; ++k ) p[ k ] = 1E4*std::pow( 1E3, k/double( p_size - 1 ) );
+    return p;
+}
+
+// The batch functions give exactly the scalar ones, element by element
+WELLSIM_TEST( batch_evaluation_matches_pointwise )
+{
+    const unsigned n = 37;
+    std::vector<double> p = pressures( n ), batch( n ), batch_derivative( n );
+
+    SharedPointer<IDensityModel> densities[] = {
+        MakeShared<WellCompressibleDensityModel>( 0.0, 0.0, 463.25 ),
+        MakeShared<ConstantDensityModel>( 800.0 ),
+        MakeShared<CompressibleDensityModel>( 800.0 )
+    };
+    for( int m = 0; m < 3; ++m ){
+        densities[ m ]->compute_densities( &p[ 0 ], &batch[ 0 ], n );
+        densities[ m ]->compute_density_derivatives( &p[ 0 ], &batch_derivative[ 0 ], n );
+        for( unsigned k = 0; k < n; ++k ){
+            CHECK( batch[ k ] == densities[ m ]->compute_density( p[ k ] ) );
+            CHECK( batch_derivative[ k ] == densities[ m ]->compute_density_derivative( p[ k ] ) );
+        }
+    }
+
+    SharedPointer<IViscosityModel> viscosity = MakeShared<PowerViscosityModel>( 1.5e-3, 0.2 );
+    viscosity->compute_viscosities( &p[ 0 ], &batch[ 0 ], n );
+    viscosity->compute_viscosity_derivatives( &p[ 0 ], &batch_derivative[ 0 ], n );
+    for( unsigned k = 0; k < n; ++k ){
+        CHECK( batch[ k ] == viscosity->compute_viscosity( p[ k ] ) );
+        CHECK( batch_derivative[ k ] == viscosity->compute_viscosity_derivative( p[ k ] ) );
+    }
+
+    SharedPointer<IInterfacialTensionModel> tensions[] = {
+        MakeShared<BeggsGasOilInterfacialTensionModel>( 323.0, 800.0/1000.0 ),
+        MakeShared<BeggsGasWaterInterfacialTensionModel>( 323.0 ),
+        MakeShared<ConstantInterfacialTensionModel>( 0.02 )
+    };
+    for( int m = 0; m < 3; ++m ){
+        tensions[ m ]->compute_interfacial_tensions( &p[ 0 ], &batch[ 0 ], n );
+        tensions[ m ]->compute_interfacial_tension_derivatives( &p[ 0 ], &batch_derivative[ 0 ], n );
+        for( unsigned k = 0; k < n; ++k ){
+            CHECK( batch[ k ] == tensions[ m ]->compute_interfacial_tension( p[ k ] ) );
+            CHECK( batch_derivative[ k ] == tensions[ m ]->compute_interfacial_tension_derivative( p[ k ] ) );
+        }
+    }
+}
+
+// Drift-flux closure inputs over the range of the well, volume fractions away from the kinks of the
+// Shi correlations
+static std::vector<IDriftVelocityModel::Inputs> drift_velocity_inputs( unsigned p_size )
+{
+    std::vector<IDriftVelocityModel::Inputs> inputs( p_size );
+    for( unsigned k = 0; k < p_size; ++k ){
+        inputs[ k ].volume_fraction         = 0.01 + 0.97*( k + 0.5 )/p_size;
+        inputs[ k ].profile_parameter       = 1.0 + 0.2*( k % 3 )/2.0;
+        inputs[ k ].characteristic_velocity = 0.1 + 0.01*( k % 7 );
+        inputs[ k ].dispersed_density       = 5.0 + 10.0*( k % 5 );
+        inputs[ k ].not_dispersed_density   = 800.0 + 50.0*( k % 4 );
+        inputs[ k ].Ku_critical             = 2.0 + 0.5*( k % 2 );
+    }
+    return inputs;
+}
+
+static double& drift_velocity_input( IDriftVelocityModel::Inputs& p_inputs, int p_input )
+{
+    double* inputs[] = { &p_inputs.volume_fraction, &p_inputs.profile_parameter, &p_inputs.characteristic_velocity,
+        &p_inputs.dispersed_density, &p_inputs.not_dispersed_density, &p_inputs.Ku_critical };
+    return *inputs[ p_input ];
+}
+
+// One instance of each closure model evaluated by several threads at once gives what it gives
+// evaluated cell by cell, and its derivatives are those of its values; a negative density ratio
+// is out of the range of the Shi correlation and comes back as NaN
+WELLSIM_TEST( closures_are_pure_functions_of_their_inputs )
+{
+    const int n = 200;
+    std::vector<IDriftVelocityModel::Inputs> inputs = drift_velocity_inputs( n );
+    std::vector<double> serial( n ), parallel( n );
+
+    SharedPointer<IDriftVelocityModel> drift_velocities[] = {
+        MakeShared<ShiGasLiquidDriftVelocityModel>( 0.2, 0.4 ),
+        MakeShared<ShiOilWaterDriftVelocityModel>(),
+        MakeShared<GasVolumeFractionDriftVelocityModel>( 0.5, 2.0 ),
+        MakeShared<ConstantDriftVelocityModel>( 0.3 )
+    };
+    for( int m = 0; m < 4; ++m ){
+        const IDriftVelocityModel& model = *drift_velocities[ m ];
+        for( int k = 0; k < n; ++k ) serial[ k ] = model.compute_drift_velocity( inputs[ k ] );
+        #pragma omp parallel for num_threads( 4 )
+        for( int k = 0; k < n; ++k ) parallel[ k ] = model.compute_drift_velocity( inputs[ k ] );
+        CHECK( serial == parallel );
+
+        for( int k = 0; k < n; ++k ){
+            double derivatives[ IDriftVelocityModel::total_inputs ];
+            model.compute_drift_velocity_derivatives( inputs[ k ], derivatives );
+            for( int i = 0; i < IDriftVelocityModel::total_inputs; ++i ){
+                IDriftVelocityModel::Inputs plus = inputs[ k ], minus = inputs[ k ];
+                double h = 1E-6*drift_velocity_input( plus, i );
+                drift_velocity_input( plus, i ) += h;
+                drift_velocity_input( minus, i ) -= h;
+                double difference = ( model.compute_drift_velocity( plus ) - model.compute_drift_velocity( minus ) )/( 2.0*h );
+                CHECK_CLOSE( difference, derivatives[ i ], 1E-6 );
+            }
+        }
+    }
+
+    IDriftVelocityModel::Inputs out_of_range = inputs[ n/2 ];
+    out_of_range.dispersed_density = -out_of_range.dispersed_density;
+    CHECK( drift_velocities[ 0 ]->compute_drift_velocity( out_of_range ) != drift_velocities[ 0 ]->compute_drift_velocity( out_of_range ) );
+
+    SharedPointer<IProfileParameterModel> profile_parameters[] = {
+        MakeShared<ShiGasLiquidProfileParameterModel>( 1.2, 0.3, 1.0 ),
+        MakeShared<ShiOilWaterProfileParameterModel>( 1.2, 0.4, 0.7 ),
+        MakeShared<ConstantProfileParameterModel>( 1.2 )
+    };
+    std::vector<IProfileParameterModel::Inputs> profile_inputs( n );
+    for( int k = 0; k < n; ++k ){
+        profile_inputs[ k ].volume_fraction   = inputs[ k ].volume_fraction;
+        profile_inputs[ k ].mixture_velocity  = -1.0 + 2.0*( k % 11 )/10.0;
+        profile_inputs[ k ].flooding_velocity = 0.5 + 0.1*( k % 3 );
+    }
+    for( int m = 0; m < 3; ++m ){
+        const IProfileParameterModel& model = *profile_parameters[ m ];
+        for( int k = 0; k < n; ++k ) serial[ k ] = model.compute_profile_parameter( profile_inputs[ k ] );
+        #pragma omp parallel for num_threads( 4 )
+        for( int k = 0; k < n; ++k ) parallel[ k ] = model.compute_profile_parameter( profile_inputs[ k ] );
+        CHECK( serial == parallel );
+
+        for( int k = 0; k < n; ++k ){
+            double derivatives[ IProfileParameterModel::total_inputs ];
+            model.compute_profile_parameter_derivatives( profile_inputs[ k ], derivatives );
+            IProfileParameterModel::Inputs plus = profile_inputs[ k ], minus = profile_inputs[ k ];
+            double h = 1E-6;
+            plus.volume_fraction += h;
+            minus.volume_fraction -= h;
+            double difference = ( model.compute_profile_parameter( plus ) - model.compute_profile_parameter( minus ) )/( 2.0*h );
+            CHECK_CLOSE( difference, derivatives[ IProfileParameterModel::VOLUME_FRACTION ], 1E-6 );
+        }
+    }
+}
+
+// Over the pressures of the table the interpolation stays within a small multiple of its error
+// bound, which is measured at the midpoints only, and the table's derivative is that of its values
+WELLSIM_TEST( tables_stay_within_their_error_bound )
+{
+    const unsigned n = 1001;
+    std::vector<double> p = pressures( n );
+    double error, derivative_error;
+
+    SharedPointer<IViscosityModel> viscosity = MakeShared<PowerViscosityModel>( 1.5e-3, 0.2 );
+    TabulatedViscosityModel viscosity_table( viscosity, 1E4, 1E7, 200 );
+    error = derivative_error = 0.0;
+    for( unsigned k = 0; k < n; ++k ){
+        error = std::max( error, std::fabs( viscosity_table.compute_viscosity( p[ k ] ) - viscosity->compute_viscosity( p[ k ] ) ) );
+        if( k == 0 || k == n - 1 ) continue; // the differences would leave the table
+        double h = 1E-6*p[ k ];
+        double difference = ( viscosity_table.compute_viscosity( p[ k ] + h ) - viscosity_table.compute_viscosity( p[ k ] - h ) )/( 2.0*h );
+        derivative_error = std::max( derivative_error, std::fabs( viscosity_table.compute_viscosity_derivative( p[ k ] ) - difference )/std::fabs( difference ) );
+    }
+    CHECK( error <= 2.0*viscosity_table.get_error_bound() );
+    CHECK( derivative_error < 1E-6 );
+
+    SharedPointer<IInterfacialTensionModel> tension = MakeShared<BeggsGasWaterInterfacialTensionModel>( 323.0 );
+    TabulatedInterfacialTensionModel tension_table( tension, 1E4, 1E7, 200 );
+    error = derivative_error = 0.0;
+    for( unsigned k = 0; k < n; ++k ){
+        error = std::max( error, std::fabs( tension_table.compute_interfacial_tension( p[ k ] ) - tension->compute_interfacial_tension( p[ k ] ) ) );
+        if( k == 0 || k == n - 1 ) continue; // the differences would leave the table
+        double h = 1E-6*p[ k ];
+        double difference = ( tension_table.compute_interfacial_tension( p[ k ] + h ) - tension_table.compute_interfacial_tension( p[ k ] - h ) )/( 2.0*h );
+        derivative_error = std::max( derivative_error, std::fabs( tension_table.compute_interfacial_tension_derivative( p[ k ] ) - difference )/std::fabs( difference ) );
+    }
+    CHECK( error <= 2.0*tension_table.get_error_bound() );
+    CHECK( derivative_error < 1E-6 );
+
+    // Linear in the pressure: the table is exact
+    SharedPointer<IDensityModel> density = MakeShared<WellCompressibleDensityModel>( 0.0, 0.0, 463.25 );
+    TabulatedDensityModel density_table( density, 1E4, 1E7, 200 );
+    error = 0.0;
+    for( unsigned k = 0; k < n; ++k ){
+        error = std::max( error, std::fabs( density_table.compute_density( p[ k ] ) - density->compute_density( p[ k ] ) )/density->compute_density( p[ k ] ) );
+    }
+    CHECK( error < 1E-14 );
+}
+
+// Without intervals or over an empty range nothing is tabulated; otherwise the error returned is
+// the largest of the tables relative to the property at each of their midpoints
+WELLSIM_TEST( tabulation_checks_its_range )
+{
+    MonotoneCubicTable unbuilt;
+    CHECK( !unbuilt.contains( 0.0 ) );
+
+    TestWell well( 20 ), reference( 20 );
+    CHECK( well.tabulate_property_models( 1E7, 1E4, 200 ) == 0.0 );
+    CHECK( well.tabulate_property_models( 1E4, 1E4, 200 ) == 0.0 );
+    CHECK( well.tabulate_property_models( 1E4, 1E7, 0 ) == 0.0 );
+    CHECK( well.timestep() > 0 && reference.timestep() > 0 );
+    check_same_state( reference, well, 20, 0.0 );
+
+    SharedPointer<IViscosityModel> viscosity = MakeShared<PowerViscosityModel>( 1.5e-3, 0.2 );
+    TabulatedViscosityModel viscosity_table( viscosity, 1E4, 1E7, 200 );
+    std::vector<double> p = pressures( 1001 );
+    double error = 0.0;
+    for( unsigned k = 0; k < p.size(); ++k ){
+        double exact = viscosity->compute_viscosity( p[ k ] );
+        error = std::max( error, std::fabs( viscosity_table.compute_viscosity( p[ k ] ) - exact )/exact );
+    }
+    CHECK( error <= 2.0*viscosity_table.get_relative_error_bound() );
+
+    // Tabulated, the well takes the same timesteps to the error of its tables
+    double well_error = well.tabulate_property_models( 1E4, 1E7, 200 );
+    CHECK( well_error > 0.0 && well_error < 1E-2 );
+    CHECK( well.timestep() > 0 && reference.timestep() > 0 );
+    check_same_state( reference, well, 20, 1E-4 );
+}
@@ -0,0 +1,84 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// A well in the middle of a Newton iteration: the second timestep, ten times longer than the first
+static void unconverged_well( TestWell& p_well )
+{
+    CHECK( p_well.timestep() > 0 );
+    p_well.start_timestep( 1.0 );
+}
+
+// compute_residual() takes the face fluxes of the mass balances from the face loop, each face
+// evaluated once; the block rows of the stencil evaluate both faces of every node themselves
+WELLSIM_TEST( face_loop_residual_matches_stencil_residual )
+{
+    TestWell well( 20 );
+    unconverged_well( well );
+    vector_type R_faces;
+    well.compute_residual( R_faces );
+
+    std::vector<double> R_stencil( well.size(), 0.0 );
+    for( uint_type i = 0; i < 20; ++i ){
+        bool equations[ total_var ];
+        for( int eq = 0; eq < total_var; ++eq ) equations[ eq ] = well.has_residual( i, eq );
+        well.compute_block_row_residual( i, equations, &R_stencil[ total_var*i ] );
+    }
+    CHECK( relative_difference( R_stencil, R_faces, well.size() ) < 1E-12 );
+}
+
+// Any other type than the exact Shi models takes the closure through the virtual interfaces
+class DerivedShiGasLiquidDriftVelocityModel : public ShiGasLiquidDriftVelocityModel
+{
+public:
+    DerivedShiGasLiquidDriftVelocityModel() : ShiGasLiquidDriftVelocityModel( 0.2, 0.4 ) {}
+};
+
+// The closure compiled for the Shi models against the same models called through IDriftVelocityModel
+// and IProfileParameterModel: the residual and the AD Jacobian are the same
+WELLSIM_TEST( compiled_closure_matches_virtual_closure )
+{
+    TestWell compiled( 20 ), virtual_calls( 20 );
+    virtual_calls.set_gas_liquid_drift_velocity_model( MakeShared<DerivedShiGasLiquidDriftVelocityModel>() );
+    CHECK( compiled.compiled_closure() && !virtual_calls.compiled_closure() );
+    unconverged_well( compiled );
+    unconverged_well( virtual_calls );
+
+    vector_type R_compiled, R_virtual;
+    compiled.compute_residual( R_compiled );
+    virtual_calls.compute_residual( R_virtual );
+    CHECK( relative_difference( R_compiled, R_virtual, compiled.size() ) < 1E-12 );
+
+    compiled.compute_Jacobian();
+    virtual_calls.compute_Jacobian();
+    svector_type x( compiled.size() ), y_compiled( compiled.size() ), y_virtual( compiled.size() );
+    for( unsigned k = 0; k < x.size(); ++k ) x[ k ] = 1.0 + k%7;
+    compiled.jacobian().mult( x, y_compiled );
+    virtual_calls.jacobian().mult( x, y_virtual );
+    CHECK( relative_difference( y_compiled, y_virtual, compiled.size() ) < 1E-12 );
+}
+
+// The residual from the property cache, warm from the timestep before and from the perturbed
+// states of an FD Jacobian, against the one of a well in the same state whose cache was emptied
+WELLSIM_TEST( cached_properties_match_evaluated_ones )
+{
+    TestWell cached( 20 ), evaluated( 20 );
+    cached.set_jacobian_method( FINITE_DIFFERENCE );
+    evaluated.set_jacobian_method( FINITE_DIFFERENCE );
+    unconverged_well( cached );
+    unconverged_well( evaluated );
+    cached.compute_Jacobian();
+    // Setting a closure model empties the cache
+    evaluated.set_gas_liquid_drift_velocity_model( MakeShared<ShiGasLiquidDriftVelocityModel>( 0.2, 0.4 ) );
+
+    vector_type R_cached, R_evaluated;
+    cached.reset_property_cache_statistics();
+    evaluated.reset_property_cache_statistics();
+    cached.compute_residual( R_cached );
+    evaluated.compute_residual( R_evaluated );
+    CHECK( relative_difference( R_evaluated, R_cached, cached.size() ) == 0.0 );
+    CHECK( cached.property_cache_statistics().property_evaluations < evaluated.property_cache_statistics().property_evaluations );
+    CHECK( cached.property_cache_statistics().closure_evaluations < evaluated.property_cache_statistics().closure_evaluations );
+}
@@ -0,0 +1,130 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+#include <ScalarPreconditioner.h>
+#include <itl/krylov/gmres.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+typedef ScalarPreconditioner::matrix_type scalar_matrix_type;
+
+// Every entry of the stencil of A is in the copy, with its value
+static void check_copy( const bmatrix_type& A, const scalar_matrix_type& A_copy )
+{
+    CHECK( A_copy.nrows() == A.nrows() );
+    CHECK( A_copy.nnz() == A.nnz() );
+    for( unsigned i = 0; i < A.number_of_blocks(); ++i ){
+        for( int offset = BlockSparseMatrix::W; offset <= BlockSparseMatrix::EE; ++offset ){
+            const double* block = A.block( i, offset );
+            if( !block ) continue;
+            for( int r = 0; r < block4x4::N; ++r )
+                for( int c = 0; c < block4x4::N; ++c )
+                    CHECK( A_copy( block4x4::N*i + r, block4x4::N*( i + offset ) + c ) == block[ block4x4::N*r + c ] );
+        }
+    }
+}
+
+WELLSIM_TEST( copy_to_copies_the_stencil_and_overwrites_it )
+{
+    TestWell well( 12 );
+    well.start_timestep( 0.1 );
+    well.compute_Jacobian();
+
+    scalar_matrix_type A_copy;
+    well.jacobian().copy_to( A_copy );
+    check_copy( well.jacobian(), A_copy );
+
+    // The second copy only overwrites the values of the first
+    well.linear_solve( well.jacobian(), well.newton_update(), well.rhs() );
+    well.apply_newton_update();
+    well.compute_Jacobian();
+    scalar_matrix_type A_shared = A_copy;
+    well.jacobian().copy_to( A_copy );
+    check_copy( well.jacobian(), A_copy );
+    CHECK( A_shared.nnz() == A_copy.nnz() && A_shared( 0, 0 ) == A_copy( 0, 0 ) );
+}
+
+// ILU(0) of the scalar copy has the whole band in its pattern, so it is the exact LU as well
+WELLSIM_TEST( scalar_ilu_solves_like_block_banded )
+{
+    TestWell well( 20 );
+    well.start_timestep( 0.1 );
+    well.compute_Jacobian();
+    svector_type b( well.size() ), x_ilu( well.size() ), x_banded( well.size() );
+    itl::copy( well.rhs(), b );
+
+    ScalarPreconditioner ilu;
+    CHECK( ilu.factorize( well.jacobian(), ScalarPreconditioner::ILU0 ) );
+    CHECK( ilu.number_of_blocks() == 20 );
+    ilu.solve( b, x_ilu );
+    well.BlockBanded_Solve( well.jacobian(), x_banded, b );
+    CHECK( relative_difference( x_banded, x_ilu, well.size() ) < 1E-10 );
+}
+
+WELLSIM_TEST( scalar_diagonal_divides_by_the_diagonal )
+{
+    TestWell well( 10 );
+    well.start_timestep( 0.1 );
+    well.compute_Jacobian();
+    svector_type b( well.size() ), x( well.size() );
+    itl::copy( well.rhs(), b );
+
+    ScalarPreconditioner diagonal;
+    CHECK( diagonal.factorize( well.jacobian(), ScalarPreconditioner::DIAGONAL ) );
+    diagonal.solve( b, x );
+    for( unsigned k = 0; k < well.size(); ++k ) CHECK_CLOSE( b[ k ]/well.jacobian()( k, k ), x[ k ], 1E-14 );
+}
+
+// M = ( D + L ) D^-1 ( D + U ), L and U the strict triangles of the Jacobian
+WELLSIM_TEST( scalar_ssor_applies_symmetric_gauss_seidel )
+{
+    TestWell well( 10 );
+    well.start_timestep( 0.1 );
+    well.compute_Jacobian();
+    const bmatrix_type& A = well.jacobian();
+    const unsigned n = well.size();
+    svector_type b( n ), z( n );
+    itl::copy( well.rhs(), b );
+
+    ScalarPreconditioner ssor;
+    CHECK( ssor.factorize( A, ScalarPreconditioner::SSOR ) );
+    ssor.solve( b, z );
+
+    // The stencil spans columns 4(i-1) to 4(i+3)-1 of the rows of block row i
+    std::vector<double> y( n, 0.0 ), Mz( n, 0.0 );
+    for( unsigned r = 0; r < n; ++r ){
+        unsigned i = r/block4x4::N;
+        for( unsigned c = r; c < std::min( n, block4x4::N*( i + 3 ) ); ++c ) y[ r ] += A( r, c )*z[ c ];
+        y[ r ] /= A( r, r );
+    }
+    for( unsigned r = 0; r < n; ++r ){
+        unsigned i = r/block4x4::N;
+        for( unsigned c = i > 0 ? block4x4::N*( i - 1 ) : 0; c <= r; ++c ) Mz[ r ] += A( r, c )*y[ c ];
+    }
+    CHECK( relative_difference( b, Mz, n ) < 1E-6 ); // z is huge where the diagonal is tiny
+}
+
+// Unrestarted GMRES on ILU(0), ILUT and scalar Jacobi reaches the dense solution. SSOR is left
+// out: on this Jacobian it is nonsingular but so badly conditioned that GMRES stagnates.
+WELLSIM_TEST( gmres_converges_on_the_scalar_preconditioners )
+{
+    TestWell well( 10 );
+    well.start_timestep( 0.1 );
+    well.compute_Jacobian();
+    const unsigned n = well.size();
+    svector_type b( n ), x_dense( n );
+    itl::copy( well.rhs(), b );
+    CHECK( dense_solve( well.jacobian(), b, x_dense ) );
+
+    const ScalarPreconditioner::kind_type kinds[] = { ScalarPreconditioner::ILU0, ScalarPreconditioner::ILUT, ScalarPreconditioner::DIAGONAL };
+    for( int k = 0; k < 3; ++k ){
+        ScalarPreconditioner M;
+        CHECK( M.factorize( well.jacobian(), kinds[ k ] ) );
+        svector_type x( n ), Mb( n );
+        M.solve( b, Mb );
+        itl::basic_iteration<double> iter( Mb, 4*n, 1E-14 );
+        itl::modified_gram_schmidt<svector_type> orthogonalization( n, n );
+        itl::gmres( well.jacobian(), x, b, M, n, iter, orthogonalization );
+        CHECK( relative_difference( x_dense, x, n ) < 1E-8 );
+    }
+}
@@ -0,0 +1,70 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// The Jacobian of the first Newton iteration of a long timestep, after a short one
+static void newton_system( TestWell& p_well, svector_type& b )
+{
+    CHECK( p_well.timestep() > 0 );
+    p_well.start_timestep( 10.0 );
+    p_well.compute_Jacobian();
+    itl::copy( p_well.rhs(), b );
+}
+
+// A single segment is the whole well, factored exactly: the solve of BLOCK_BANDED_LU
+WELLSIM_TEST( one_segment_schwarz_solves_like_block_banded )
+{
+    TestWell well( 40 );
+    svector_type b( well.size() ), x_banded( well.size() ), x_schwarz( well.size() );
+    newton_system( well, b );
+    well.BlockBanded_Solve( well.jacobian(), x_banded, b );
+
+    SchwarzPreconditioner schwarz;
+    CHECK( schwarz.factorize( well.jacobian() ) );
+    CHECK( schwarz.number_of_segments() == 1 );
+    schwarz.solve( b, x_schwarz );
+    CHECK( relative_difference( x_banded, x_schwarz, well.size() ) < 1E-12 );
+}
+
+// GMRES(10) on RAS and on AS, over 2 and 4 segments and overlaps of 1 and 4 cells, and BiCGSTAB
+// over 8 segments, converge to the solution of BLOCK_BANDED_LU. GMRES(10) stagnates from about 6
+// segments on: one-level Schwarz takes a Krylov iteration per segment to cross the well.
+WELLSIM_TEST( schwarz_krylov_solves_like_block_banded )
+{
+    const unsigned threads[] = { 2, 4, 8 };
+    const krylov_method_type methods[] = { KRYLOV_GMRES, KRYLOV_GMRES, KRYLOV_BICGSTAB };
+    const unsigned overlaps[] = { 1, 4 };
+    for( int t = 0; t < 3; ++t ){
+        for( int o = 0; o < 2; ++o ){
+            for( int restricted = 0; restricted < 2; ++restricted ){
+                TestWell well( 80 );
+                svector_type b( well.size() ), x_banded( well.size() ), x_krylov( well.size() );
+                newton_system( well, b );
+                well.BlockBanded_Solve( well.jacobian(), x_banded, b );
+
+                well.set_number_of_threads( threads[ t ] );
+                well.set_schwarz_overlap( overlaps[ o ], restricted != 0 );
+                well.set_krylov_solver( methods[ t ], SCHWARZ );
+                well.Krylov_Solve( well.jacobian(), x_krylov, b );
+                CHECK( !well.solve_failed() );
+                CHECK( relative_residual( well.jacobian(), x_krylov, b ) < 1E-6 );
+                CHECK( relative_difference( x_banded, x_krylov, well.size() ) < 1E-6 );
+            }
+        }
+    }
+}
+
+// ... and takes the well through the same timesteps as GMRES on block ILU(0)
+WELLSIM_TEST( schwarz_timesteps_match_block_ilu )
+{
+    TestWell ilu( 40 ), schwarz( 40 );
+    schwarz.set_number_of_threads( 4 );
+    schwarz.set_krylov_solver( KRYLOV_GMRES, SCHWARZ );
+    for( int step = 0; step < 3; ++step ){
+        CHECK( ilu.timestep() > 0 );
+        CHECK( schwarz.timestep() > 0 );
+    }
+    check_same_state( ilu, schwarz, 40, 1E-6 );
+}
@@ -0,0 +1,67 @@
+#ifndef H_WellSimulator_TESTHARNESS
+#define H_WellSimulator_TESTHARNESS
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cmath>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+namespace test {
+
+// Test harness ====================================================================================
+//
+//  WELLSIM_TEST( name ){ ... } defines a test and registers it with main(). CHECK and CHECK_CLOSE
+//  report a failure with its file and line and let the test go on; the test binary returns
+//  nonzero when any of them failed.
+//
+typedef void (*test_function)();
+
+struct TestCase{
+    const char*     name;
+    test_function   function;
+};
+
+std::vector<TestCase>& registered_tests();
+void report_failure( const char* p_file, int p_line, const std::string& p_message );
+
+struct TestRegistrar{
+    TestRegistrar( const char* p_name, test_function p_function ){
+        TestCase test = { p_name, p_function };
+        registered_tests().push_back( test );
+    }
+};
+
+// |p_expected - p_actual| <= p_tolerance*max( 1, |p_expected| )
+inline bool close( double p_expected, double p_actual, double p_tolerance ){
+    double scale = std::fabs( p_expected ) > 1.0 ? std::fabs( p_expected ) : 1.0;
+    return std::fabs( p_expected - p_actual ) <= p_tolerance*scale;
+}
+
+// Namespace =======================================================================================
+} // namespace test
+} // namespace WellSimulator
+
+#define WELLSIM_TEST( p_name ) \
+    static void p_name(); \
+    static WellSimulator::test::TestRegistrar p_name##_registrar( #p_name, p_name ); \
+    static void p_name()
+
+#define CHECK( p_condition ) \
+    do{ \
+        if( !( p_condition ) ) WellSimulator::test::report_failure( __FILE__, __LINE__, #p_condition ); \
+    }while( false )
+
+// Relative to the size of p_expected once it is above 1
+#define CHECK_CLOSE( p_expected, p_actual, p_tolerance ) \
+    do{ \
+        double expected_ = ( p_expected ), actual_ = ( p_actual ); \
+        if( !WellSimulator::test::close( expected_, actual_, ( p_tolerance ) ) ){ \
+            std::ostringstream message_; \
+            message_ << #p_actual << " = " << actual_ << ", expected " << expected_; \
+            WellSimulator::test::report_failure( __FILE__, __LINE__, message_.str() ); \
+        } \
+    }while( false )
+
+#endif // H_WellSimulator_TESTHARNESS
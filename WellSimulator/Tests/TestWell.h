@@ -0,0 +1,206 @@
+#ifndef H_WellSimulator_TESTWELL
+#define H_WellSimulator_TESTWELL
+
+#include <TestHarness.h>
+#include <DriftFluxWell.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+namespace test {
+
+// TestWell ========================================================================================
+//
+//  The three-phase well of WellData/Setup.txt as simulate() builds it, on p_nnodes nodes over
+//  1000 m with the same inflow into every node, opened up for the tests: the Jacobian, the
+//  right-hand side and the Newton update of the last compute_Jacobian() and linear_solve(), and
+//  the internal functions the tests compare against each other. timestep() is one timestep of
+//  solve(p_pressure) without its output files.
+//
+class TestWell : public DriftFluxWell
+{
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    explicit TestWell( uint_type p_nnodes, real_type p_inflow = 1.0E-4 )
+        : DriftFluxWell( p_nnodes, 0.5*0.3 )
+    {
+        std::vector<coord_type> coordinates( p_nnodes );
+        real_type dx = 1000.0/real_type( p_nnodes - 1 );
+        for( uint_type i = 0; i < p_nnodes; ++i ){
+            coordinates[ i ][ 0 ] = i*dx;
+            coordinates[ i ][ 1 ] = 0.0;
+            coordinates[ i ][ 2 ] = 0.0;
+        }
+
+        this->set_inclination( 85.0 );
+        this->set_constant_vol_frac( 0.6, 0.1, 0.3 );
+        this->set_dt( 0.1 );
+        this->set_max_delta_t( 1000.0 );
+        this->set_final_time( 10000.0 );
+        this->set_final_timestep( 100000 );
+        this->set_C_0( 1.2 );
+
+        this->set_gas_liquid_drift_velocity_model   ( MakeShared<ShiGasLiquidDriftVelocityModel>( 0.2, 0.4 ) );
+        this->set_oil_water_drift_velocity_model    ( MakeShared<ShiOilWaterDriftVelocityModel>() );
+        this->set_gas_liquid_profile_parameter_model( MakeShared<ShiGasLiquidProfileParameterModel>( 1.2, 0.3, 1.0 ) );
+        this->set_oil_water_profile_parameter_model ( MakeShared<ShiOilWaterProfileParameterModel>( 1.2, 0.4, 0.7 ) );
+        this->set_gas_oil_interfacial_tension_model  ( MakeShared<BeggsGasOilInterfacialTensionModel>( 323.0, 800.0/1000.0 ) );
+        this->set_gas_water_interfacial_tension_model( MakeShared<BeggsGasWaterInterfacialTensionModel>( 323.0 ) );
+        this->set_gas_density_model  ( MakeShared<WellCompressibleDensityModel>( 0.0, 0.0, 463.25 ) );
+        this->set_oil_density_model  ( MakeShared<ConstantDensityModel>( 800.0 ) );
+        this->set_water_density_model( MakeShared<ConstantDensityModel>( 1000.0 ) );
+        this->set_gas_viscosity_model  ( MakeShared<PowerViscosityModel>( 12.09e-6, 0.0 ) );
+        this->set_oil_viscosity_model  ( MakeShared<PowerViscosityModel>( 1.5e-3, 0.0 ) );
+        this->set_water_viscosity_model( MakeShared<PowerViscosityModel>( 0.5471e-3, 0.0 ) );
+
+        this->set_delta( 1.220703125e-4, 1.220703125e-4, 1.220703125e-4, 1.220703125e-4 );
+        this->set_constant_pressure( 1.0E6 );
+        this->set_heel_pressure( 1.0E6 );
+        this->set_constant_velocity( 0.0 );
+        this->set_boundary_velocity( 0.0 );
+        this->set_with_gas( true );
+        this->set_mass_flux( false );
+        this->set_newton_criteria( 1.0E-6 );
+
+        inflow_vector_type inflow( p_nnodes, MakeShared<ConstantInflow>( p_inflow ) );
+        this->initialize_flow( inflow, inflow, inflow );
+        this->set_coordinates( coordinates );
+        this->set_gravity( 0.0, 0.0, 9.8 );
+
+        m_current_time = 0.0;
+        this->set_bottom_pressure( m_HEEL_PRESSURE );
+    }
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    // The current state becomes the old one, and the next compute_Jacobian() is the first Newton
+    // iteration of a timestep of p_dt
+    void start_timestep( real_type p_dt ){
+        this->set_dt( p_dt );
+        this->update_variables_for_new_timestep();
+        this->reset_forcing_term();
+    }
+
+    // Newton iterations of a timestep of dt(), 0 if it didn't converge in p_max_iterations or a
+    // Newton step was rejected. The well is left where the last iteration took it.
+    uint_type timestep( uint_type p_max_iterations = 50 ){
+        this->start_timestep( this->dt() );
+        for( uint_type r = 1; r <= p_max_iterations; ++r ){
+            this->compute_Jacobian();
+            this->linear_solve( *m_matrix, *m_variables, *m_source );
+            if( !this->apply_newton_update() ) return 0;
+            if( itl::two_norm( *m_source ) <= this->NEWTON_CRIT ){
+                m_current_time += this->dt();
+                return r;
+            }
+        }
+        return 0;
+    }
+
+    bmatrix_type& jacobian(){ return *m_matrix; }
+    svector_type& rhs(){ return *m_source; }
+    svector_type& newton_update(){ return *m_variables; }
+    uint_type size() const { return total_var*m_nnodes; }
+    // Of the last linear solve
+    bool solve_failed() const { return m_convergence_status; }
+
+    // The closure models have one of the compiled combinations, not the virtual fallback
+    bool compiled_closure() const { return m_shi_closure || m_constant_closure; }
+
+    real_type pressure_at( uint_type p_node ){ return m_pressure[ p_node ]; }
+    real_type gas_vol_frac_at( uint_type p_node ){ return m_gas_vol_frac[ p_node ]; }
+    real_type velocity_at( uint_type p_node ){ return m_mean_velocity[ p_node ]; }
+
+    // y = J*x by the differences of JACOBIAN_FREE, around the state of its last compute_Jacobian()
+    void jacobian_free_mult( const svector_type& x, svector_type& y ){
+        NewtonFunction F = { this };
+        jacobian_free_type J( F, m_newton_unknowns, m_newton_function );
+        J.mult( x, y );
+    }
+
+    using DriftFluxWell::newton_function;
+    using DriftFluxWell::compute_residual;
+    using DriftFluxWell::compute_block_row_residual;
+    using DriftFluxWell::has_residual;
+
+}; // class TestWell
+
+// Largest |x_k - y_k| over the largest |x_k|
+template <class VectorX, class VectorY>
+double relative_difference( const VectorX& x, const VectorY& y, unsigned p_size ){
+    double difference = 0.0, scale = 0.0;
+    for( unsigned k = 0; k < p_size; ++k ){
+        difference = std::max( difference, std::fabs( double( x[ k ] ) - double( y[ k ] ) ) );
+        scale = std::max( scale, std::fabs( double( x[ k ] ) ) );
+    }
+    return scale > 0.0 ? difference/scale : difference;
+}
+
+// Both wells are in the same state, to p_tolerance
+inline void check_same_state( TestWell& p_expected, TestWell& p_actual, uint_type p_nnodes, double p_tolerance ){
+    for( uint_type i = 0; i < p_nnodes; ++i ){
+        CHECK_CLOSE( p_expected.pressure_at( i ), p_actual.pressure_at( i ), p_tolerance );
+        CHECK_CLOSE( p_expected.gas_vol_frac_at( i ), p_actual.gas_vol_frac_at( i ), p_tolerance );
+        CHECK_CLOSE( p_expected.velocity_at( i ), p_actual.velocity_at( i ), p_tolerance );
+    }
+}
+
+// x = A^-1 b by Gaussian elimination with partial pivoting on a dense copy of A, the reference
+// the sparse solvers are checked against. Returns false on a zero pivot.
+inline bool dense_solve( const bmatrix_type& A, const svector_type& b, svector_type& x ){
+    const unsigned n = b.size();
+    std::vector<double> LU( n*n, 0.0 ), y( n );
+    for( unsigned i = 0; i < A.number_of_blocks(); ++i ){
+        for( int offset = BlockSparseMatrix::W; offset <= BlockSparseMatrix::EE; ++offset ){
+            const double* block = A.block( i, offset );
+            if( !block ) continue;
+            for( int r = 0; r < block4x4::N; ++r )
+                for( int c = 0; c < block4x4::N; ++c )
+                    LU[ n*( block4x4::N*i + r ) + block4x4::N*( i + offset ) + c ] = block[ block4x4::N*r + c ];
+        }
+    }
+    for( unsigned r = 0; r < n; ++r ) y[ r ] = b[ r ];
+    for( unsigned k = 0; k < n; ++k ){
+        unsigned pivot = k;
+        for( unsigned r = k + 1; r < n; ++r ){
+            if( std::fabs( LU[ n*r + k ] ) > std::fabs( LU[ n*pivot + k ] ) ) pivot = r;
+        }
+        if( LU[ n*pivot + k ] == 0.0 ) return false;
+        if( pivot != k ){
+            for( unsigned c = 0; c < n; ++c ) std::swap( LU[ n*k + c ], LU[ n*pivot + c ] );
+            std::swap( y[ k ], y[ pivot ] );
+        }
+        for( unsigned r = k + 1; r < n; ++r ){
+            double l = LU[ n*r + k ]/LU[ n*k + k ];
+            if( l == 0.0 ) continue;
+            for( unsigned c = k; c < n; ++c ) LU[ n*r + c ] -= l*LU[ n*k + c ];
+            y[ r ] -= l*y[ k ];
+        }
+    }
+    for( unsigned k = n; k-- > 0; ){
+        double sum = y[ k ];
+        for( unsigned c = k + 1; c < n; ++c ) sum -= LU[ n*k + c ]*x[ c ];
+        x[ k ] = sum/LU[ n*k + k ];
+    }
+    return true;
+}
+
+// ||A x - b|| / ||b||
+inline double relative_residual( const bmatrix_type& A, const svector_type& x, const svector_type& b ){
+    svector_type r( b.size() );
+    A.mult( x, r );
+    double norm = 0.0, b_norm = 0.0;
+    for( unsigned k = 0; k < b.size(); ++k ){
+        norm += ( r[ k ] - b[ k ] )*( r[ k ] - b[ k ] );
+        b_norm += b[ k ]*b[ k ];
+    }
+    return b_norm > 0.0 ? std::sqrt( norm/b_norm ) : std::sqrt( norm );
+}
+
+// Namespace =======================================================================================
+} // namespace test
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_TESTWELL
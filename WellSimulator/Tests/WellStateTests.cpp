@@ -0,0 +1,108 @@
+#include <TestHarness.h>
+#include <TestWell.h>
+#include <WellState.h>
+#include <cstddef>
+#include <vector>
+
+using namespace WellSimulator;
+using namespace WellSimulator::test;
+
+// A value no other (node, quantity) pair of the tests below has
+static double tagged( unsigned p_node, unsigned p_quantity, double p_offset = 0.0 )
+{
+    return 10.0*p_node + p_quantity + p_offset;
+}
+
+static void fill( WellState& p_state, double p_offset )
+{
+    for( unsigned i = 0; i < p_state.number_of_nodes(); ++i ){
+        for( unsigned k = 0; k < WellState::unknowns_per_node; ++k ) p_state.unknown( k )[ i ] = tagged( i, k, p_offset );
+        p_state.water_vol_frac()[ i ] = tagged( i, WellState::unknowns_per_node, p_offset );
+    }
+}
+
+// The unknowns of a node are contiguous, in the order of the Newton vector, with the water volume
+// fractions after them; the fields and the Newton vector read and write the same doubles
+WELLSIM_TEST( well_state_interleaves_the_unknowns_of_a_node )
+{
+    WellState state;
+    state.resize( 7 );
+    CHECK( state.number_of_unknowns() == 28 );
+    CHECK( reinterpret_cast<std::size_t>( state.unknowns() ) % WellState::alignment == 0 );
+    fill( state, 0.0 );
+
+    const double* x = state.unknowns();
+    for( unsigned i = 0; i < 7; ++i ){
+        for( unsigned k = 0; k < WellState::unknowns_per_node; ++k ) CHECK( x[ 4*i + k ] == tagged( i, k ) );
+        CHECK( x[ 28 + i ] == tagged( i, 4 ) );
+    }
+
+    std::vector<double> unknowns( 28 );
+    state.get_unknowns( unknowns );
+    for( unsigned k = 0; k < 28; ++k ) CHECK( unknowns[ k ] == x[ k ] );
+    for( unsigned k = 0; k < 28; ++k ) unknowns[ k ] = -unknowns[ k ];
+    state.set_unknowns( unknowns );
+    for( unsigned i = 0; i < 7; ++i ){
+        for( unsigned k = 0; k < WellState::unknowns_per_node; ++k ) CHECK( state.unknown( k )[ i ] == -tagged( i, k ) );
+        CHECK( state.water_vol_frac()[ i ] == tagged( i, 4 ) );
+    }
+}
+
+// snapshot() copies the whole current record to the old one and restore() back, bit for bit; the
+// phase velocities are in neither
+WELLSIM_TEST( well_state_snapshot_and_restore_round_trip )
+{
+    WellState state;
+    state.resize( 7 );
+    fill( state, 0.0 );
+    for( unsigned p = 0; p < 3; ++p ){
+        for( unsigned i = 0; i < 7; ++i ) state.phase_velocity( p )[ i ] = tagged( i, p, 0.5 );
+    }
+
+    state.snapshot();
+    fill( state, 0.25 );
+    for( unsigned i = 0; i < 7; ++i ){
+        for( unsigned k = 0; k < WellState::unknowns_per_node; ++k ) CHECK( state.old_unknown( k )[ i ] == tagged( i, k ) );
+        CHECK( state.old_water_vol_frac()[ i ] == tagged( i, 4 ) );
+    }
+
+    state.restore();
+    for( unsigned i = 0; i < 7; ++i ){
+        for( unsigned k = 0; k < WellState::unknowns_per_node; ++k ){
+            CHECK( state.unknown( k )[ i ] == tagged( i, k ) );
+            CHECK( state.old_unknown( k )[ i ] == tagged( i, k ) );
+        }
+        CHECK( state.water_vol_frac()[ i ] == tagged( i, 4 ) );
+        for( unsigned p = 0; p < 3; ++p ) CHECK( state.phase_velocity( p )[ i ] == tagged( i, p, 0.5 ) );
+    }
+}
+
+// A timestep of 1000 s right after the first one, where plain Newton fails: restore_initial_guess()
+// puts back the state the timestep started from exactly, and the shorter timestep taken from there
+// ends where it does on a well that never tried the long one
+WELLSIM_TEST( restore_initial_guess_undoes_a_failed_timestep_exactly )
+{
+    TestWell failed( 20 ), direct( 20 );
+    CHECK( failed.timestep() > 0 );
+    CHECK( direct.timestep() > 0 );
+    std::vector<double> start( failed.size() ), unknowns( failed.size() );
+    failed.get_unknowns( start );
+
+    failed.set_dt( 1000.0 );
+    CHECK( failed.timestep() == 0 );
+    failed.get_unknowns( unknowns );
+    bool moved = false;
+    for( unsigned k = 0; k < failed.size(); ++k ) moved = moved || !( unknowns[ k ] == start[ k ] );
+    CHECK( moved );
+    failed.restore_initial_guess();
+    failed.get_unknowns( unknowns );
+    for( unsigned k = 0; k < failed.size(); ++k ) CHECK( unknowns[ k ] == start[ k ] );
+    for( unsigned k = 0; k < failed.size(); ++k ) CHECK( failed.newton_update()[ k ] == 0.0 );
+    CHECK( failed.newton_statistics().timestep_cuts == 1 );
+
+    failed.set_dt( 1.0 );
+    direct.set_dt( 1.0 );
+    CHECK( failed.timestep() > 0 );
+    CHECK( direct.timestep() > 0 );
+    check_same_state( direct, failed, 20, 1E-10 );
+}
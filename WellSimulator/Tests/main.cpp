@@ -0,0 +1,47 @@
+#include <TestHarness.h>
+#include <iostream>
+#include <cstring>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+namespace test {
+
+static unsigned s_failures = 0;
+
+std::vector<TestCase>& registered_tests(){
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+void report_failure( const char* p_file, int p_line, const std::string& p_message ){
+    std::cout << "\n    " << p_file << "(" << p_line << "): " << p_message;
+    ++s_failures;
+}
+
+// Namespace =======================================================================================
+} // namespace test
+} // namespace WellSimulator
+
+// Runs every registered test, or only those whose name contains the first argument
+int main( int argc, char* argv[] )
+{
+    using namespace WellSimulator::test;
+    const char* filter = argc > 1 ? argv[ 1 ] : "";
+
+    unsigned failed_tests = 0, run = 0;
+    std::vector<TestCase>& tests = registered_tests();
+    for( unsigned t = 0; t < tests.size(); ++t ){
+        if( !std::strstr( tests[ t ].name, filter ) ) continue;
+        std::cout << tests[ t ].name << " ..." << std::flush;
+        unsigned failures = s_failures;
+        tests[ t ].function();
+        ++run;
+        if( s_failures == failures ) std::cout << " ok\n";
+        else{
+            std::cout << "\n    FAILED\n";
+            ++failed_tests;
+        }
+    }
+    std::cout << run - failed_tests << " of " << run << " tests passed\n";
+    return failed_tests ? 1 : 0;
+}
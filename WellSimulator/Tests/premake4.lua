@@ -0,0 +1,28 @@
+project "WellSimulatorTests"
+
+kind "ConsoleApp"
+targetdir "../Bin"
+
+configuration {}
+
+includedirs {
+	"./",
+	"../Solver",
+	"../WellSim/include",
+}
+
+files {
+	"**.cpp",
+	"**.h",
+	"../WellSim/**.cpp",
+	"../WellSim/**.h",
+	"../WellSim/**.hpp"
+}
+
+-- Same OpenMP build as WellSimulator: the tests run the threaded assembly and solvers
+configuration "vs*"
+	buildoptions { "/openmp" }
+configuration "gmake"
+	buildoptions { "-fopenmp" }
+	linkoptions { "-fopenmp" }
+configuration {}
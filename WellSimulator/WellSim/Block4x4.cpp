@@ -0,0 +1,10 @@
+#include <Block4x4.h>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+namespace block4x4 {
+
+    bool s_use_simd = avx2_supported();
+
+} // namespace block4x4
+} // namespace WellSimulator
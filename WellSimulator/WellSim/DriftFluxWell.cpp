@@ -8,8 +8,13 @@
 #include <fstream>
 #include <sstream>
 #include <string>
-#include <queue>
+#include <limits>
 #include <ctime>
+#include <typeinfo>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #define PI 3.1415926535897932384626433832795
 
@@ -43,7 +48,7 @@ namespace WellSimulator {
 			return this->now - this->old;
 		}
 
-        inline void print(std::string p_msg){
+        inline void print(const char* p_msg){
             if(m_print_time){
                 std::cout << p_msg << this->elapsed();
             }            
@@ -69,47 +74,326 @@ namespace WellSimulator {
                   * pow(1.0 + sin(p_inclination),2.0) 
                  );
     }
+
+    // Whether entry p_index of a property cache was evaluated at p_pressure
+    inline bool is_cached( const vector_type& p_pressures, uint_type p_index, real_type p_pressure ){
+        return p_index < p_pressures.size() && p_pressures[ p_index ] == p_pressure;
+    }
+
+    // Evaluates p_compute, a batch method of p_model, at the arguments of the entries that changed
+    // (packed by update_property_cache()), and scatters the results into p_values
+    template <class Model>
+    void evaluate_changed(
+        Model& p_model, void (Model::*p_compute)( const float64*, float64*, unsigned ),
+        const std::vector<uint_type>& p_changed, const vector_type& p_arguments, vector_type& p_scratch, vector_type& p_values
+        )
+    {
+        (p_model.*p_compute)( &p_arguments[ 0 ], &p_scratch[ 0 ], p_changed.size() );
+        for( uint_type k = 0; k < p_changed.size(); ++k ) p_values[ p_changed[ k ] ] = p_scratch[ k ];
+    }
+
+    // p_x with the derivatives w.r.t. the unknowns of each stencil node moved to the node west of it
+    ad_type seeded_one_node_west( const ad_type& p_x ){
+        enum{ stencil_directions = 4*total_var };
+        ad_type x( p_x.value() );
+        for( int d = total_var; d < stencil_directions; ++d ) x.derivative( d - total_var ) = p_x.derivative( d );
+        return x;
+    }
+
+    // The drift-flux closures flag anything else as an invalid state
+    template <class T>
+    bool is_valid_closure_state( const T& p_gas_vol_frac, const T& p_oil_vol_frac, const T& p_pressure ){
+        return !( p_pressure < 0.0 || p_gas_vol_frac < 0.0 || p_oil_vol_frac < 0.0 || p_gas_vol_frac > 1.0 || p_oil_vol_frac > 1.0 );
+    }
+
+    // p_model, if it is exactly a Model
+    template <class Model, class Interface>
+    const Model* exact_model( const SharedPointer<Interface>& p_model ){
+        return ( p_model && typeid( *p_model ) == typeid( Model ) ) ? static_cast<const Model*>( p_model.get() ) : 0;
+    }
+
+    // Closure models behind virtual interfaces can't be templated on the scalar type. The dual number
+    // overloads evaluate them at the values and apply the chain rule with their partial derivatives.
+    // Model is either the interface or, from the compiled closures, the concrete model, whose
+    // correlations are then called directly (qualified) rather than through the vtable.
+    real_type interfacial_tension_of( const IInterfacialTensionModel& p_model, real_type p_pressure ){
+        return p_model.compute_interfacial_tension( p_pressure );
+    }
+    template <int N>
+    ad::DualNumber<N> interfacial_tension_of( const IInterfacialTensionModel& p_model, const ad::DualNumber<N>& p_pressure ){
+        return ad::DualNumber<N>::compose(
+            p_model.compute_interfacial_tension( p_pressure.value() ),
+            p_model.compute_interfacial_tension_derivative( p_pressure.value() ),
+            p_pressure
+            );
+    }
+
+    template <class Model>
+    float64 compute_profile_parameter( const Model& p_model, const IProfileParameterModel::Inputs& p_inputs ){
+        return p_model.Model::compute_profile_parameter( p_inputs );
+    }
+    float64 compute_profile_parameter( const IProfileParameterModel& p_model, const IProfileParameterModel::Inputs& p_inputs ){
+        return p_model.compute_profile_parameter( p_inputs );
+    }
+    template <class Model>
+    void compute_profile_parameter_derivatives( const Model& p_model, const IProfileParameterModel::Inputs& p_inputs, float64 p_derivatives[] ){
+        p_model.Model::compute_profile_parameter_derivatives( p_inputs, p_derivatives );
+    }
+    void compute_profile_parameter_derivatives( const IProfileParameterModel& p_model, const IProfileParameterModel::Inputs& p_inputs, float64 p_derivatives[] ){
+        p_model.compute_profile_parameter_derivatives( p_inputs, p_derivatives );
+    }
+
+    template <class Model>
+    float64 compute_drift_velocity( const Model& p_model, const IDriftVelocityModel::Inputs& p_inputs ){
+        return p_model.Model::compute_drift_velocity( p_inputs );
+    }
+    float64 compute_drift_velocity( const IDriftVelocityModel& p_model, const IDriftVelocityModel::Inputs& p_inputs ){
+        return p_model.compute_drift_velocity( p_inputs );
+    }
+    template <class Model>
+    void compute_drift_velocity_derivatives( const Model& p_model, const IDriftVelocityModel::Inputs& p_inputs, float64 p_derivatives[] ){
+        p_model.Model::compute_drift_velocity_derivatives( p_inputs, p_derivatives );
+    }
+    void compute_drift_velocity_derivatives( const IDriftVelocityModel& p_model, const IDriftVelocityModel::Inputs& p_inputs, float64 p_derivatives[] ){
+        p_model.compute_drift_velocity_derivatives( p_inputs, p_derivatives );
+    }
+
+    template <class T>
+    IProfileParameterModel::Inputs profile_parameter_inputs( const T& p_vol_frac, const T& p_mixture_velocity, const T& p_flooding_velocity ){
+        IProfileParameterModel::Inputs inputs;
+        inputs.volume_fraction   = ad::value_of( p_vol_frac );
+        inputs.mixture_velocity  = ad::value_of( p_mixture_velocity );
+        inputs.flooding_velocity = ad::value_of( p_flooding_velocity );
+        return inputs;
+    }
+
+    template <class Model>
+    real_type profile_parameter_of(
+        const Model& p_model, real_type p_vol_frac, real_type p_mixture_velocity, real_type p_flooding_velocity )
+    {
+        return compute_profile_parameter( p_model, profile_parameter_inputs( p_vol_frac, p_mixture_velocity, p_flooding_velocity ) );
+    }
+    template <class Model, int N>
+    ad::DualNumber<N> profile_parameter_of(
+        const Model& p_model, const ad::DualNumber<N>& p_vol_frac, const ad::DualNumber<N>& p_mixture_velocity, const ad::DualNumber<N>& p_flooding_velocity )
+    {
+        IProfileParameterModel::Inputs inputs = profile_parameter_inputs( p_vol_frac, p_mixture_velocity, p_flooding_velocity );
+        float64 partial[ IProfileParameterModel::total_inputs ];
+        compute_profile_parameter_derivatives( p_model, inputs, partial );
+        ad::DualNumber<N> C_0( compute_profile_parameter( p_model, inputs ) );
+        C_0.chain( partial[ IProfileParameterModel::VOLUME_FRACTION   ], p_vol_frac );
+        C_0.chain( partial[ IProfileParameterModel::MIXTURE_VELOCITY  ], p_mixture_velocity );
+        C_0.chain( partial[ IProfileParameterModel::FLOODING_VELOCITY ], p_flooding_velocity );
+        return C_0;
+    }
+
+    template <class T>
+    IDriftVelocityModel::Inputs drift_velocity_inputs(
+        const T& p_vol_frac, const T& p_profile_parameter, const T& p_characteristic_velocity,
+        const T& p_dispersed_density, const T& p_not_dispersed_density, const T& p_Ku_critical )
+    {
+        IDriftVelocityModel::Inputs inputs;
+        inputs.volume_fraction         = ad::value_of( p_vol_frac );
+        inputs.profile_parameter       = ad::value_of( p_profile_parameter );
+        inputs.characteristic_velocity = ad::value_of( p_characteristic_velocity );
+        inputs.dispersed_density       = ad::value_of( p_dispersed_density );
+        inputs.not_dispersed_density   = ad::value_of( p_not_dispersed_density );
+        inputs.Ku_critical             = ad::value_of( p_Ku_critical );
+        return inputs;
+    }
+
+    template <class Model>
+    real_type drift_velocity_of(
+        const Model& p_model, real_type p_vol_frac, real_type p_profile_parameter, real_type p_characteristic_velocity,
+        real_type p_dispersed_density, real_type p_not_dispersed_density, real_type p_Ku_critical )
+    {
+        return compute_drift_velocity( p_model, drift_velocity_inputs(
+            p_vol_frac, p_profile_parameter, p_characteristic_velocity, p_dispersed_density, p_not_dispersed_density, p_Ku_critical ) );
+    }
+    template <class Model, int N>
+    ad::DualNumber<N> drift_velocity_of(
+        const Model& p_model, const ad::DualNumber<N>& p_vol_frac, const ad::DualNumber<N>& p_profile_parameter, const ad::DualNumber<N>& p_characteristic_velocity,
+        const ad::DualNumber<N>& p_dispersed_density, const ad::DualNumber<N>& p_not_dispersed_density, const ad::DualNumber<N>& p_Ku_critical )
+    {
+        IDriftVelocityModel::Inputs inputs = drift_velocity_inputs(
+            p_vol_frac, p_profile_parameter, p_characteristic_velocity, p_dispersed_density, p_not_dispersed_density, p_Ku_critical );
+        float64 partial[ IDriftVelocityModel::total_inputs ];
+        compute_drift_velocity_derivatives( p_model, inputs, partial );
+        ad::DualNumber<N> v_d( compute_drift_velocity( p_model, inputs ) );
+        v_d.chain( partial[ IDriftVelocityModel::VOLUME_FRACTION         ], p_vol_frac );
+        v_d.chain( partial[ IDriftVelocityModel::PROFILE_PARAMETER       ], p_profile_parameter );
+        v_d.chain( partial[ IDriftVelocityModel::CHARACTERISTIC_VELOCITY ], p_characteristic_velocity );
+        v_d.chain( partial[ IDriftVelocityModel::DISPERSED_DENSITY       ], p_dispersed_density );
+        v_d.chain( partial[ IDriftVelocityModel::NOT_DISPERSED_DENSITY   ], p_not_dispersed_density );
+        v_d.chain( partial[ IDriftVelocityModel::KU_CRITICAL             ], p_Ku_critical );
+        return v_d;
+    }
+
+    // Whether residual p_equation of a row reads p_variable of the node at stencil offset p_offset
+    // (-1 = W ... 2 = EE). The mass balances stop at E and only use the W and P velocities.
+    bool residual_depends_on( int p_equation, int p_variable, int p_offset ){
+        int last_offset = ( p_equation == v ) ? 2 : 1;
+        if( p_variable == v ) --last_offset;
+        return p_offset >= -1 && p_offset <= last_offset;
+    }
+
+    // Increment of p_variable at p_value in compute_Jacobian_FD
+    inline real_type fd_increment( int p_variable, real_type p_value, real_type p_delta ){
+        if( p_variable == P ) return p_delta*p_value;
+        real_type size = ( p_variable == v ) ? abs( p_value ) : p_value;
+        return size > 1e-12 ? p_delta*p_value : p_delta;
+    }
+
+    // ... and in its first row and EE columns, which fall back to 1e-4*p_delta below 1e-8
+    inline real_type fd_outer_increment( int p_variable, real_type p_value, real_type p_delta ){
+        if( p_variable == P ) return p_delta*p_value;
+        real_type size = ( p_variable == v ) ? abs( p_value ) : p_value;
+        return size > 1e-8 ? p_delta*p_value : 1e-4*p_delta;
+    }
+
+    // Absolute residual the Krylov solvers stop at when each Newton step is solved exactly
+    const real_type KRYLOV_TOLERANCE = 1E-6;
+    // Iterations a Krylov solve may take with fresh factors, or none
+    const int MAX_KRYLOV_ITERATIONS = 1000;
+    // GMRES restart of JACOBIAN_FREE: block Jacobi is weak, short restarts stagnate
+    const int JFNK_RESTART = 50;
+    // Share of the time of GMRES + block ILU a pair must save to be kept by the auto-tuning
+    const real_type TUNING_MARGIN = 0.2;
+
+    // Setup file names, in the order of krylov_method_type and preconditioner_type
+    const char* const KRYLOV_METHOD_NAMES[ total_krylov_methods ] = { "gmres", "bicgstab", "tfqmr", "cgs", "gcr", "gcrodr", "qmr" };
+    const char* const PRECONDITIONER_NAMES[ total_preconditioners ] = { "ilu", "jacobi", "cpr", "schwarz", "scalar_ilu", "ilut", "ssor", "diagonal", "none" };
+
+    const char* krylov_method_name( krylov_method_type p_method ){
+        return KRYLOV_METHOD_NAMES[ p_method ];
+    }
+
+    const char* preconditioner_name( preconditioner_type p_preconditioner ){
+        return PRECONDITIONER_NAMES[ p_preconditioner ];
+    }
+
+    bool krylov_pair_supported( krylov_method_type p_method, preconditioner_type p_preconditioner ){
+        return p_method != KRYLOV_QMR || p_preconditioner >= SCALAR_ILU;
+    }
+
+    // The ScalarPreconditioner kind of the scalar preconditioner types
+    ScalarPreconditioner::kind_type scalar_preconditioner_kind( preconditioner_type p_preconditioner ){
+        switch( p_preconditioner ){
+        case ILUT:      return ScalarPreconditioner::ILUT;
+        case SSOR:      return ScalarPreconditioner::SSOR;
+        case DIAGONAL:  return ScalarPreconditioner::DIAGONAL;
+        default:        return ScalarPreconditioner::ILU0;
+        }
+    }
+
+    // ITL's QMR, preconditioned by M on the left only. The block preconditioners have no
+    // trans_solve() and never get here, krylov_pair_supported() turns them down.
+    template <class Preconditioner, class Iteration>
+    int run_qmr( const bmatrix_type&, svector_type&, const svector_type&, const Preconditioner&, Iteration& p_iter ){
+        p_iter.fail( 1, "qmr: no transposed solve with this preconditioner" );
+        return p_iter.error_code();
+    }
+
+    template <class Iteration>
+    int run_qmr( const bmatrix_type& A, svector_type& x, const svector_type& b, const ScalarPreconditioner& M, Iteration& p_iter ){
+        return itl::qmr( A, x, b, M, itl::identity_preconditioner(), p_iter );
+    }
+
+    template <class Iteration>
+    int run_qmr( const bmatrix_type& A, svector_type& x, const svector_type& b, const itl::identity_preconditioner& M, Iteration& p_iter ){
+        return itl::qmr( A, x, b, M, M, p_iter );
+    }
 	
 	DriftFluxWell::DriftFluxWell()
+		: m_dt( 0.0 ),
+		  m_linear_solver( GMRES_ILU ),
+		  m_jacobian_method( AUTOMATIC_DIFFERENTIATION ),
+		  m_number_of_threads( 1 ),
+		  m_preconditioner_lag( 5 ),
+		  m_preconditioner_age( 0 ),
+		  m_preconditioner_reuse( false ),
+		  m_refactor_iteration_growth( 2.0 ),
+		  m_refactor_min_iterations( 10 ),
+		  m_refactor_reason( FIRST_FACTORIZATION ),
+		  m_iterations_after_refactor( 0 ),
+		  m_krylov_method( KRYLOV_GMRES ),
+		  m_preconditioner( BLOCK_ILU ),
+		  m_krylov_auto_tune( false ),
+		  m_tuning_jacobians( 3 ),
+		  m_tuned_jacobians( 0 ),
+		  m_tuned_iterations( 0 ),
+		  m_krylov_recycle_dimension( 4 ),
+		  m_mixed_precision( false ),
+		  m_inexact_newton( false ),
+		  m_forcing_term( 0.0 ),
+		  m_previous_residual_norm( -1.0 ),
+		  m_newton_globalization( false ),
+		  m_max_vol_frac_change( 0.2 ),
+		  m_max_relative_pressure_change( 0.5 ),
+		  m_max_backtracks( 5 ),
+		  m_output_files( true ),
+		  m_steady_state( false ),
+		  m_initial_pseudo_dt( 1.0 ),
+		  m_max_pseudo_dt( 1E8 ),
+		  m_max_pseudo_steps( 200 ),
+		  m_pseudo_dt( 0.0 )
 	{
+		this->reset_preconditioner_statistics();
+		this->reset_newton_statistics();
+		this->reset_property_cache_statistics();
 	}
 	DriftFluxWell::DriftFluxWell(
 								 const uint_type& p_nnodes,
 								 const real_type& p_radius
 								)
-								: m_oil_velocity	( p_nnodes, 0 ),
-								  m_water_velocity	( p_nnodes, 0 ),
-								  m_gas_velocity	( p_nnodes, 0 ),
-								  m_mean_velocity	( p_nnodes, 0 ),
-								  m_oil_vol_frac	( p_nnodes, 0 ),
-								  m_water_vol_frac	( p_nnodes, 0 ),
-								  m_gas_vol_frac	( p_nnodes, 0 ),
-								  m_gas_vol_frac_old	( p_nnodes, 0 ),
-								  m_oil_vol_frac_old	( p_nnodes, 0 ),
-								  m_water_vol_frac_old	( p_nnodes, 0 ),
-								  m_pressure_old		( p_nnodes, 0 ),
-								  m_mean_velocity_old	( p_nnodes, 0 ),								  
-								  m_id				( p_nnodes ),
-								  m_gravity			( 3, 0 ),
+								: m_gravity			( 3, 0 ),
 								  m_delta			( total_var, 0 ),
-                                  m_matrix   (new smatrix_type(total_var*p_nnodes,total_var*p_nnodes)),
+								  m_dt				( 0.0 ),
+                                  m_matrix   (new bmatrix_type),
                                   m_variables(new svector_type(total_var*p_nnodes)),
                                   m_source   (new svector_type(total_var*p_nnodes)),
-                                  m_has_inclination_correction(true)
+                                  m_has_inclination_correction(true),
+                                  m_linear_solver(GMRES_ILU),
+                                  m_jacobian_method(AUTOMATIC_DIFFERENTIATION),
+                                  m_number_of_threads(1),
+                                  m_preconditioner_lag(5),
+                                  m_preconditioner_age(0),
+                                  m_preconditioner_reuse(false),
+                                  m_refactor_iteration_growth(2.0),
+                                  m_refactor_min_iterations(10),
+                                  m_refactor_reason(FIRST_FACTORIZATION),
+                                  m_iterations_after_refactor(0),
+                                  m_krylov_method(KRYLOV_GMRES),
+                                  m_preconditioner(BLOCK_ILU),
+                                  m_krylov_auto_tune(false),
+                                  m_tuning_jacobians(3),
+                                  m_tuned_jacobians(0),
+                                  m_tuned_iterations(0),
+                                  m_krylov_recycle_dimension(4),
+                                  m_mixed_precision(false),
+                                  m_inexact_newton(false),
+                                  m_forcing_term(0.0),
+                                  m_previous_residual_norm(-1.0),
+                                  m_newton_globalization(false),
+                                  m_max_vol_frac_change(0.2),
+                                  m_max_relative_pressure_change(0.5),
+                                  m_max_backtracks(5),
+                                  m_output_files(true),
+                                  m_steady_state(false),
+                                  m_initial_pseudo_dt(1.0),
+                                  m_max_pseudo_dt(1E8),
+                                  m_max_pseudo_steps(200),
+                                  m_pseudo_dt(0.0)
 	{					 
+		this->reset_preconditioner_statistics();
+		this->reset_newton_statistics();
+		this->reset_property_cache_statistics();
 	    
 
-		for( uint_type i = 0; i < m_id.size(); ++i )
-		{
-			this->m_id[ i ].resize( total_var );
-			m_id[ i ][ P ]	     = total_var*i;
-			m_id[ i ][ alpha_g ] = total_var*i + 1;
-			m_id[ i ][ alpha_o ] = total_var*i + 2;
-			m_id[ i ][ v ]       = total_var*i + 3;
-		}
+		this->resize_state( p_nnodes );
+		for( uint_type i = 0; i < p_nnodes; ++i ) this->m_pressure[ i ] = 100000.0;
 		this->m_coordinates.resize( p_nnodes );
 		
-		this->m_pressure.resize(p_nnodes, 100000.0);
 		this->m_nnodes = p_nnodes;
 		this->m_radius = p_radius;		
 	}
@@ -134,19 +418,7 @@ namespace WellSimulator {
                    |     |     |     |     |     |      |  Lateral Mass Inflow
 */
         uint_type well_size = p_number_of_completions+1;
-        m_oil_velocity.resize       ( well_size, 0.0 );	
-        m_water_velocity.resize	    ( well_size, 0.0 );
-        m_gas_velocity.resize	    ( well_size, 0.0 );
-        m_mean_velocity.resize	    ( well_size, 0.0 );
-        m_oil_vol_frac.resize	    ( well_size, 0.0 );
-        m_water_vol_frac.resize	    ( well_size, 0.0 );
-        m_gas_vol_frac.resize	    ( well_size, 0.0 );
-        m_gas_vol_frac_old.resize	( well_size, 0.0 );
-        m_oil_vol_frac_old.resize	( well_size, 0.0 );
-        m_water_vol_frac_old.resize	( well_size, 0.0 );
-        m_pressure_old.resize		( well_size, 0.0 );
-        m_mean_velocity_old.resize  ( well_size, 0.0 );								  
-        m_id.resize				    ( well_size );
+        this->resize_state          ( well_size );
         m_gravity.resize			( 3, 0.0 );
         m_delta.resize			    ( total_var, 0 );
         m_total_production.resize   ( NumberOfPhases, 0);
@@ -155,25 +427,18 @@ namespace WellSimulator {
         m_gas_flow.resize(well_size, MakeShared<ConstantInflow>(0.0));
         m_water_flow.resize(well_size, MakeShared<ConstantInflow>(0.0));
 
-        m_matrix	= SharedPointer<smatrix_type>( new smatrix_type(total_var*well_size,total_var*well_size) );
+        m_matrix	= SharedPointer<bmatrix_type>( new bmatrix_type ); // sized by compute_Jacobian()
         m_variables = SharedPointer<svector_type>( new svector_type(total_var*well_size) );
         m_source	= SharedPointer<svector_type>( new svector_type(total_var*well_size) );
 
-        for( uint_type i = 0; i < m_id.size(); ++i )
-        {
-            this->m_id[ i ].resize( total_var );
-            m_id[ i ][ P ]	     = total_var*i;
-            m_id[ i ][ alpha_g ] = total_var*i + 1;
-            m_id[ i ][ alpha_o ] = total_var*i + 2;
-            m_id[ i ][ v ]       = total_var*i + 3;
-        }
         this->m_coordinates.resize( well_size );
 
-        this->m_pressure.resize(well_size , p_BHPressure);
+        for( uint_type i = 0; i < well_size; ++i ) this->m_pressure[ i ] = p_BHPressure;
         
         this->set_bottom_pressure(p_BHPressure);
         this->m_nnodes = well_size;
         this->m_radius = p_well_radius;
+        m_property_cache.clear();
 
         this->set_with_gas (true);
         this->set_mass_flux(false);
@@ -261,6 +526,7 @@ namespace WellSimulator {
 	}
 	void DriftFluxWell::set_dt( real_type p_dt )
 	{
+		if( p_dt != this->m_dt ) this->request_refactor( TIMESTEP_CHANGE );
 		this->m_dt = p_dt;
 	}
 
@@ -288,6 +554,11 @@ namespace WellSimulator {
 		return p_velocity >= 0 ? 0.5 : -0.5;
         //return 0.0;
 	}
+
+	template <int N>
+	real_type DriftFluxWell::ksi( const ad::DualNumber<N>& p_velocity ){
+		return this->ksi( p_velocity.value() );
+	}
 	
 	real_type DriftFluxWell::Volume( real_type dS ){
 		return this->area()*dS;
@@ -306,15 +577,44 @@ namespace WellSimulator {
 		//return 1.1245;
 	}									   // where R = 518.3 J/(Kg.K)and T = 323 K	
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::gas_density( const ad::DualNumber<N>& p_pressure ){
+		return ad::DualNumber<N>::compose(
+			m_gas_density_model->compute_density( p_pressure.value() ),
+			m_gas_density_model->compute_density_derivative( p_pressure.value() ),
+			p_pressure
+			);
+	}
+
 	real_type DriftFluxWell::liquid_density(
 											real_type p_oil_vol_frac,
 											real_type p_water_vol_frac,
 											real_type p_pressure
 											)
+	{
+		return this->do_liquid_density<real_type>( p_oil_vol_frac, p_water_vol_frac, p_pressure );
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::liquid_density(
+										  const ad::DualNumber<N>& p_oil_vol_frac,
+										  const ad::DualNumber<N>& p_water_vol_frac,
+										  const ad::DualNumber<N>& p_pressure
+										  )
+	{
+		return this->do_liquid_density< ad::DualNumber<N> >( p_oil_vol_frac, p_water_vol_frac, p_pressure );
+	}
+
+	template <class T>
+	T DriftFluxWell::do_liquid_density(
+									   T p_oil_vol_frac,
+									   T p_water_vol_frac,
+									   T p_pressure
+									   )
 	{    
         if(p_water_vol_frac < 0.0) p_water_vol_frac = 0.0;
         if(p_oil_vol_frac   < 0.0) p_oil_vol_frac   = 0.0;
-        real_type den = p_oil_vol_frac + p_water_vol_frac; // denominator
+        T den = p_oil_vol_frac + p_water_vol_frac; // denominator
         if( abs(den) < 1.0e-12){
             return 0.5*this->oil_density  ( p_pressure ) + 0.5*this->water_density( p_pressure );
         }
@@ -341,6 +641,57 @@ namespace WellSimulator {
         return m_water_density_model->compute_density(p_pressure);
 	}
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::oil_density( const ad::DualNumber<N>& p_pressure ){
+		return ad::DualNumber<N>::compose(
+			m_oil_density_model->compute_density( p_pressure.value() ),
+			m_oil_density_model->compute_density_derivative( p_pressure.value() ),
+			p_pressure
+			);
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::water_density( const ad::DualNumber<N>& p_pressure ){
+		return ad::DualNumber<N>::compose(
+			m_water_density_model->compute_density( p_pressure.value() ),
+			m_water_density_model->compute_density_derivative( p_pressure.value() ),
+			p_pressure
+			);
+	}
+
+	real_type DriftFluxWell::gas_density( real_type p_pressure, uint_type p_node ){
+		if( this->count_property_lookup( is_cached( m_property_cache.pressure, p_node, p_pressure ) ) ) return m_property_cache.gas_density[ p_node ];
+		return this->gas_density( p_pressure );
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::gas_density( const ad::DualNumber<N>& p_pressure, uint_type p_node ){
+		if( !this->count_property_lookup( is_cached( m_property_cache.pressure, p_node, p_pressure.value() ) ) ) return this->gas_density( p_pressure );
+		return ad::DualNumber<N>::compose( m_property_cache.gas_density[ p_node ], m_property_cache.gas_density_derivative[ p_node ], p_pressure );
+	}
+
+	real_type DriftFluxWell::oil_density( real_type p_pressure, uint_type p_node ){
+		if( this->count_property_lookup( is_cached( m_property_cache.pressure, p_node, p_pressure ) ) ) return m_property_cache.oil_density[ p_node ];
+		return this->oil_density( p_pressure );
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::oil_density( const ad::DualNumber<N>& p_pressure, uint_type p_node ){
+		if( !this->count_property_lookup( is_cached( m_property_cache.pressure, p_node, p_pressure.value() ) ) ) return this->oil_density( p_pressure );
+		return ad::DualNumber<N>::compose( m_property_cache.oil_density[ p_node ], m_property_cache.oil_density_derivative[ p_node ], p_pressure );
+	}
+
+	real_type DriftFluxWell::water_density( real_type p_pressure, uint_type p_node ){
+		if( this->count_property_lookup( is_cached( m_property_cache.pressure, p_node, p_pressure ) ) ) return m_property_cache.water_density[ p_node ];
+		return this->water_density( p_pressure );
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::water_density( const ad::DualNumber<N>& p_pressure, uint_type p_node ){
+		if( !this->count_property_lookup( is_cached( m_property_cache.pressure, p_node, p_pressure.value() ) ) ) return this->water_density( p_pressure );
+		return ad::DualNumber<N>::compose( m_property_cache.water_density[ p_node ], m_property_cache.water_density_derivative[ p_node ], p_pressure );
+	}
+
 
 	real_type DriftFluxWell::mean_density( 
 										  const real_type& p_oil_vol_frac,
@@ -358,6 +709,21 @@ namespace WellSimulator {
 		
 	}
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::mean_density( 
+										const ad::DualNumber<N>& p_oil_vol_frac,
+										const ad::DualNumber<N>& p_water_vol_frac,
+										const ad::DualNumber<N>& p_gas_vol_frac,
+										const ad::DualNumber<N>& p_pressure
+										)
+	{
+		return (
+			    p_oil_vol_frac   * this->oil_density  (p_pressure) +  
+				p_water_vol_frac * this->water_density(p_pressure) +  
+				p_gas_vol_frac   * this->gas_density  (p_pressure) 
+			   );
+	}
+
 	real_type DriftFluxWell::friction_factor( real_type p_reynolds ){
 		//if( p_reynolds == 0.0 )
 		//	return 0.0;
@@ -373,6 +739,11 @@ namespace WellSimulator {
         return p_reynolds == 0.0 ? 0.0 : abs(64/p_reynolds); // Laminar AtTheMoment...			
 	}
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::friction_factor( const ad::DualNumber<N>& p_reynolds ){
+        return p_reynolds == 0.0 ? ad::DualNumber<N>( 0.0 ) : abs(64.0/p_reynolds);
+	}
+
 	real_type DriftFluxWell::mean_velocity( uint_type p_index ){
 		return this->m_mean_velocity[ p_index ];		
 	}
@@ -408,23 +779,79 @@ namespace WellSimulator {
 											  real_type p_water_vol_frac,
 											  real_type p_pressure  
 											  )
+	{
+		if( m_shi_closure ) return this->do_mod_v_drift_flux( *m_shi_closure, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		if( m_constant_closure ) return this->do_mod_v_drift_flux( *m_constant_closure, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		return this->do_mod_v_drift_flux( this->virtual_closure(), p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::mod_v_drift_flux(
+											const ad::DualNumber<N>& p_mean_velocity,
+											const ad::DualNumber<N>& p_gas_vol_frac,
+											const ad::DualNumber<N>& p_oil_vol_frac,
+											const ad::DualNumber<N>& p_water_vol_frac,
+											const ad::DualNumber<N>& p_pressure
+											)
+	{
+		if( m_shi_closure ) return this->do_mod_v_drift_flux( *m_shi_closure, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		if( m_constant_closure ) return this->do_mod_v_drift_flux( *m_constant_closure, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		return this->do_mod_v_drift_flux( this->virtual_closure(), p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+	}
+
+	real_type DriftFluxWell::mod_v_drift_flux( real_type p_mean_velocity, real_type p_gas_vol_frac, real_type p_oil_vol_frac, real_type p_water_vol_frac, real_type p_pressure, uint_type p_face ){
+		if( this->count_closure_lookup( this->is_cached_closure( p_face, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure ) ) ){
+			return m_property_cache.gas_liquid_drift_flux[ p_face ];
+		}
+		return this->mod_v_drift_flux( p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::mod_v_drift_flux(
+			const ad::DualNumber<N>& p_mean_velocity, const ad::DualNumber<N>& p_gas_vol_frac, const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac, const ad::DualNumber<N>& p_pressure, uint_type p_face
+			)
+	{
+		if( !this->count_closure_lookup( this->is_cached_closure( p_face,
+				p_mean_velocity.value(), p_gas_vol_frac.value(), p_oil_vol_frac.value(), p_water_vol_frac.value(), p_pressure.value() ) ) ){
+			return this->mod_v_drift_flux( p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		}
+		const PropertyCache& cache = m_property_cache;
+		ad::DualNumber<N> V_gj( cache.gas_liquid_drift_flux[ p_face ] );
+		V_gj.chain( cache.gas_liquid_drift_flux_derivative[ PropertyCache::MEAN_VELOCITY  ][ p_face ], p_mean_velocity );
+		V_gj.chain( cache.gas_liquid_drift_flux_derivative[ PropertyCache::GAS_VOL_FRAC   ][ p_face ], p_gas_vol_frac );
+		V_gj.chain( cache.gas_liquid_drift_flux_derivative[ PropertyCache::OIL_VOL_FRAC   ][ p_face ], p_oil_vol_frac );
+		V_gj.chain( cache.gas_liquid_drift_flux_derivative[ PropertyCache::WATER_VOL_FRAC ][ p_face ], p_water_vol_frac );
+		V_gj.chain( cache.gas_liquid_drift_flux_derivative[ PropertyCache::PRESSURE       ][ p_face ], p_pressure );
+		return V_gj;
+	}
+
+	template <class Closure, class T>
+	T DriftFluxWell::do_mod_v_drift_flux(
+										 const Closure& p_closure,
+										 T p_mean_velocity, 
+										 T p_gas_vol_frac, 
+										 T p_oil_vol_frac,
+										 T p_water_vol_frac,
+										 T p_pressure  
+										 )
 	{	
-        if(p_pressure < 0.0 || p_gas_vol_frac < 0.0 || p_oil_vol_frac < 0.0 || p_gas_vol_frac > 1.0 || p_oil_vol_frac > 1.0){
-            m_convergence_status = true;
+        if( !is_valid_closure_state( p_gas_vol_frac, p_oil_vol_frac, p_pressure ) ){
+            this->flag_invalid_state();
             return 0.0;
         }
-		real_type rho_m = this->mean_density( p_oil_vol_frac, p_water_vol_frac, p_gas_vol_frac, p_pressure );
-		real_type rho_l = this->liquid_density( p_oil_vol_frac, p_water_vol_frac, p_pressure);
-		real_type rho_g = this->gas_density( p_pressure );
+		T rho_m = this->mean_density( p_oil_vol_frac, p_water_vol_frac, p_gas_vol_frac, p_pressure );
+		T rho_l = this->liquid_density( p_oil_vol_frac, p_water_vol_frac, p_pressure);
+		T rho_g = this->gas_density( p_pressure );
 
-        float64 sigma_go = 0.0;
-        float64 sigma_gw = 0.0;
-        float64 interfacial_tension = 0.0;         
+        T sigma_go = 0.0;
+        T sigma_gw = 0.0;
+        T interfacial_tension = 0.0;         
 
-        sigma_go = m_gas_oil_interfacial_tension_model->compute_interfacial_tension  ( ( p_pressure < 0.0) ? 0.0 : p_pressure );
-        sigma_gw = m_gas_water_interfacial_tension_model->compute_interfacial_tension( ( p_pressure < 0.0) ? 0.0 : p_pressure );
+        sigma_go = interfacial_tension_of( *m_gas_oil_interfacial_tension_model  , ( p_pressure < 0.0) ? T( 0.0 ) : p_pressure );
+        sigma_gw = interfacial_tension_of( *m_gas_water_interfacial_tension_model, ( p_pressure < 0.0) ? T( 0.0 ) : p_pressure );
          
-        real_type den = p_oil_vol_frac + p_water_vol_frac;        
+        T den = p_oil_vol_frac + p_water_vol_frac;        
         if( abs(den) < 1.0e-12 ){
             interfacial_tension   = 0.5*(sigma_go + sigma_gw);
         }
@@ -438,8 +865,8 @@ namespace WellSimulator {
         }
 
         
-        real_type D_hat = sqrt( gravity()*(rho_l - rho_g)/interfacial_tension )*2.0*m_radius;
-        real_type Ku;
+        T D_hat = sqrt( gravity()*(rho_l - rho_g)/interfacial_tension )*2.0*m_radius;
+        T Ku;
         if(D_hat <= 2.0){
             Ku = 0.0;
         }else if(D_hat >= 50){
@@ -447,18 +874,10 @@ namespace WellSimulator {
         }else{
             Ku = 2.684*exp(0.003669*D_hat) - 3.847*exp(-0.1853*D_hat);
         }
-        real_type Vc = pow( interfacial_tension*gravity()*(rho_l - rho_g)/(rho_l*rho_l) , 0.25 );
-        m_gas_liquid_profile_parameter_model->set_flooding_velocity( Ku*sqrt(rho_l/rho_g)*Vc );
-        m_gas_liquid_profile_parameter_model->set_mixture_velocity(p_mean_velocity);
-        m_gas_liquid_profile_parameter_model->set_volume_fraction(p_gas_vol_frac);
-        real_type C_0_gl = m_gas_liquid_profile_parameter_model->compute_profile_parameter();
-        m_gas_liquid_drift_velocity_model->set_volume_fraction(p_gas_vol_frac);
-        m_gas_liquid_drift_velocity_model->set_dispersed_density(rho_g);
-        m_gas_liquid_drift_velocity_model->set_not_dispersed_density(rho_l);
-        m_gas_liquid_drift_velocity_model->set_Ku_critical(Ku);
-        m_gas_liquid_drift_velocity_model->set_characteristic_velocity(Vc);
-        m_gas_liquid_drift_velocity_model->set_profile_parameter(C_0_gl);
-		real_type v_d   = m_gas_liquid_drift_velocity_model->compute_drift_velocity();
+        T Vc = pow( interfacial_tension*gravity()*(rho_l - rho_g)/(rho_l*rho_l) , 0.25 );
+        T flooding_velocity = Ku*sqrt(rho_l/rho_g)*Vc;
+        T C_0_gl = profile_parameter_of( p_closure.gas_liquid_profile_parameter, p_gas_vol_frac, p_mean_velocity, flooding_velocity );
+		T v_d   = drift_velocity_of( p_closure.gas_liquid_drift_velocity, p_gas_vol_frac, C_0_gl, Vc, rho_g, rho_l, Ku );
 
         if(m_has_inclination_correction){
             v_d *= calculate_inclination_correction(m_well_inclination);
@@ -474,25 +893,79 @@ namespace WellSimulator {
 			real_type p_water_vol_frac,
 			real_type p_pressure  
 			)
+	{
+		if( m_shi_closure ) return this->do_mod_v_drift_flux_ow( *m_shi_closure, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		if( m_constant_closure ) return this->do_mod_v_drift_flux_ow( *m_constant_closure, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		return this->do_mod_v_drift_flux_ow( this->virtual_closure(), p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::mod_v_drift_flux_ow(
+			const ad::DualNumber<N>& p_mean_velocity,
+			const ad::DualNumber<N>& p_gas_vol_frac,
+			const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac,
+			const ad::DualNumber<N>& p_pressure
+			)
+	{
+		if( m_shi_closure ) return this->do_mod_v_drift_flux_ow( *m_shi_closure, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		if( m_constant_closure ) return this->do_mod_v_drift_flux_ow( *m_constant_closure, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		return this->do_mod_v_drift_flux_ow( this->virtual_closure(), p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+	}
+
+	real_type DriftFluxWell::mod_v_drift_flux_ow( real_type p_mean_velocity, real_type p_gas_vol_frac, real_type p_oil_vol_frac, real_type p_water_vol_frac, real_type p_pressure, uint_type p_face ){
+		if( this->count_closure_lookup( this->is_cached_closure( p_face, p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure ) ) ){
+			return m_property_cache.oil_water_drift_flux[ p_face ];
+		}
+		return this->mod_v_drift_flux_ow( p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+	}
+
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::mod_v_drift_flux_ow(
+			const ad::DualNumber<N>& p_mean_velocity, const ad::DualNumber<N>& p_gas_vol_frac, const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac, const ad::DualNumber<N>& p_pressure, uint_type p_face
+			)
+	{
+		if( !this->count_closure_lookup( this->is_cached_closure( p_face,
+				p_mean_velocity.value(), p_gas_vol_frac.value(), p_oil_vol_frac.value(), p_water_vol_frac.value(), p_pressure.value() ) ) ){
+			return this->mod_v_drift_flux_ow( p_mean_velocity, p_gas_vol_frac, p_oil_vol_frac, p_water_vol_frac, p_pressure );
+		}
+		const PropertyCache& cache = m_property_cache;
+		ad::DualNumber<N> V_ow( cache.oil_water_drift_flux[ p_face ] );
+		V_ow.chain( cache.oil_water_drift_flux_derivative[ PropertyCache::MEAN_VELOCITY  ][ p_face ], p_mean_velocity );
+		V_ow.chain( cache.oil_water_drift_flux_derivative[ PropertyCache::GAS_VOL_FRAC   ][ p_face ], p_gas_vol_frac );
+		V_ow.chain( cache.oil_water_drift_flux_derivative[ PropertyCache::OIL_VOL_FRAC   ][ p_face ], p_oil_vol_frac );
+		V_ow.chain( cache.oil_water_drift_flux_derivative[ PropertyCache::WATER_VOL_FRAC ][ p_face ], p_water_vol_frac );
+		V_ow.chain( cache.oil_water_drift_flux_derivative[ PropertyCache::PRESSURE       ][ p_face ], p_pressure );
+		return V_ow;
+	}
+
+	template <class Closure, class T>
+	T DriftFluxWell::do_mod_v_drift_flux_ow(
+			const Closure& p_closure,
+			T p_mean_velocity, 
+			T p_gas_vol_frac, 
+			T p_oil_vol_frac,
+			T p_water_vol_frac,
+			T p_pressure  
+			)
 	{	
-        if(p_pressure < 0.0 || p_gas_vol_frac < 0.0 || p_oil_vol_frac < 0.0 || p_gas_vol_frac > 1.0 || p_oil_vol_frac > 1.0){
-            m_convergence_status = true;
+        if( !is_valid_closure_state( p_gas_vol_frac, p_oil_vol_frac, p_pressure ) ){
+            this->flag_invalid_state();
             return 0.0;
         }
-		real_type rho_o = this->oil_density( p_pressure );
-		real_type rho_w = this->water_density( p_pressure );
-        real_type rho_l = this->liquid_density( p_oil_vol_frac, p_water_vol_frac, p_pressure );
-        real_type alpha_ol = p_oil_vol_frac/(p_oil_vol_frac + p_water_vol_frac + 1.0e-20);
-        m_oil_water_profile_parameter_model->set_volume_fraction(alpha_ol);       
-        real_type C_0_ow = m_oil_water_profile_parameter_model->compute_profile_parameter();
-        m_oil_water_drift_velocity_model->set_volume_fraction(alpha_ol);
-
-        float64 sigma_go = 0.0;
-        float64 sigma_gw = 0.0;
-        float64 interfacial_tension = 0.0;         
-
-        sigma_go = m_gas_oil_interfacial_tension_model->compute_interfacial_tension  ( ( p_pressure < 0.0) ? 0.0 : p_pressure );
-        sigma_gw = m_gas_water_interfacial_tension_model->compute_interfacial_tension( ( p_pressure < 0.0) ? 0.0 : p_pressure );
+		T rho_o = this->oil_density( p_pressure );
+		T rho_w = this->water_density( p_pressure );
+        T rho_l = this->liquid_density( p_oil_vol_frac, p_water_vol_frac, p_pressure );
+        T alpha_ol = p_oil_vol_frac/(p_oil_vol_frac + p_water_vol_frac + 1.0e-20);
+        T C_0_ow = profile_parameter_of( p_closure.oil_water_profile_parameter, alpha_ol, T( 0.0 ), T( 0.0 ) ); // the oil-water correlations only use the volume fraction
+
+        T sigma_go = 0.0;
+        T sigma_gw = 0.0;
+        T interfacial_tension = 0.0;         
+
+        sigma_go = interfacial_tension_of( *m_gas_oil_interfacial_tension_model  , ( p_pressure < 0.0) ? T( 0.0 ) : p_pressure );
+        sigma_gw = interfacial_tension_of( *m_gas_water_interfacial_tension_model, ( p_pressure < 0.0) ? T( 0.0 ) : p_pressure );
         
         float64 min_interfacial_tension = WellConstants::convert_Dynes_per_cm_to_Pa_m();
         interfacial_tension = sigma_gw - sigma_go;
@@ -500,9 +973,8 @@ namespace WellSimulator {
             interfacial_tension = min_interfacial_tension;
         }
 
-        real_type Vc = pow( interfacial_tension*gravity()*(rho_w - rho_o)/(rho_w*rho_w) , 0.25 );
-        m_oil_water_drift_velocity_model->set_characteristic_velocity(Vc);
-		real_type v_d   = m_oil_water_drift_velocity_model->compute_drift_velocity();
+        T Vc = pow( interfacial_tension*gravity()*(rho_w - rho_o)/(rho_w*rho_w) , 0.25 );
+		T v_d   = drift_velocity_of( p_closure.oil_water_drift_velocity, alpha_ol, T( 0.0 ), Vc, T( 0.0 ), T( 0.0 ), T( 0.0 ) ); // only the volume fraction and Vc are used
 
         if(m_has_inclination_correction){
             v_d *= calculate_inclination_correction(m_well_inclination);
@@ -526,6 +998,7 @@ namespace WellSimulator {
 		this->m_gravity[ 0 ] = p_valueX;
 		this->m_gravity[ 1 ] = p_valueY;
 		this->m_gravity[ 2 ] = p_valueZ;
+		m_property_cache.clear();
 	}
 	real_type DriftFluxWell::gravity(){
 		return sqrt( m_gravity[ 0 ]*m_gravity[ 0 ] + m_gravity[ 1 ]*m_gravity[ 1 ] + m_gravity[ 2 ]*m_gravity[ 2 ] );
@@ -588,8 +1061,27 @@ namespace WellSimulator {
 		}
 	}
 	
-	uint_type DriftFluxWell::id( uint_type p_node , uint_type p_variable ){
-		return this->m_id[ p_node ][ p_variable ];
+	void DriftFluxWell::resize_state( uint_type p_nnodes )
+	{
+		m_state.resize( p_nnodes );
+		m_pressure			= m_state.unknown( P );
+		m_gas_vol_frac		= m_state.unknown( alpha_g );
+		m_oil_vol_frac		= m_state.unknown( alpha_o );
+		m_mean_velocity		= m_state.unknown( v );
+		m_water_vol_frac	= m_state.water_vol_frac();
+		m_pressure_old		= m_state.old_unknown( P );
+		m_gas_vol_frac_old	= m_state.old_unknown( alpha_g );
+		m_oil_vol_frac_old	= m_state.old_unknown( alpha_o );
+		m_mean_velocity_old	= m_state.old_unknown( v );
+		m_water_vol_frac_old = m_state.old_water_vol_frac();
+		m_oil_velocity		= m_state.phase_velocity( 0 );
+		m_water_velocity	= m_state.phase_velocity( 1 );
+		m_gas_velocity		= m_state.phase_velocity( 2 );
+	}
+
+	real_type* DriftFluxWell::pressure( uint_type p_index )
+	{
+		return &m_pressure[ p_index ];
 	}
 	
 	real_type DriftFluxWell::segment_length( coord_type p_coord_i, coord_type p_coord_j )
@@ -623,272 +1115,474 @@ namespace WellSimulator {
         return m_gas_viscosity_model->compute_viscosity(p_pressure);
 	}
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::gas_viscosity( const ad::DualNumber<N>& p_pressure ){
+		return ad::DualNumber<N>::compose(
+			m_gas_viscosity_model->compute_viscosity( p_pressure.value() ),
+			m_gas_viscosity_model->compute_viscosity_derivative( p_pressure.value() ),
+			p_pressure
+			);
+	}
+
 	real_type DriftFluxWell::oil_viscosity( real_type p_pressure ){
 		//return 0.05;
         return m_oil_viscosity_model->compute_viscosity(p_pressure);
 	}
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::oil_viscosity( const ad::DualNumber<N>& p_pressure ){
+		return ad::DualNumber<N>::compose(
+			m_oil_viscosity_model->compute_viscosity( p_pressure.value() ),
+			m_oil_viscosity_model->compute_viscosity_derivative( p_pressure.value() ),
+			p_pressure
+			);
+	}
+
 	real_type DriftFluxWell::water_viscosity( real_type p_pressure ){
 		//return 0.05;
         return m_water_viscosity_model->compute_viscosity(p_pressure);
 	}
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::water_viscosity( const ad::DualNumber<N>& p_pressure ){
+		return ad::DualNumber<N>::compose(
+			m_water_viscosity_model->compute_viscosity( p_pressure.value() ),
+			m_water_viscosity_model->compute_viscosity_derivative( p_pressure.value() ),
+			p_pressure
+			);
+	}
 
-	real_type DriftFluxWell::R_m(
-								 real_type p_pressureW,
-								 real_type p_pressureP,
-								 real_type p_pressureE,
-								 real_type p_gas_vol_fracW,
-								 real_type p_gas_vol_fracP,
-								 real_type p_gas_vol_fracE,
-								 real_type p_oil_vol_fracW,
-								 real_type p_oil_vol_fracP,
-								 real_type p_oil_vol_fracE,
-								 real_type p_velocityW,
-								 real_type p_velocityP,
-								 uint_type p_node,
-								 string_type	   position = 'C'
-								 )
-	{
-		
-		switch ( position )
-		{
-		
-		case 'L':
-			{
-				real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
-				real_type dSe = 0.;
-				real_type dS  = dSw + dSe;
-				real_type dV = this->Volume( dS );
-
-				real_type water_vol_fracOld = 1.0 - (m_oil_vol_frac_old[ p_node ] + m_gas_vol_frac_old[ p_node ]);
-				real_type water_vol_fracW	= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-				real_type water_vol_fracP	= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
-
-				real_type rho_P_old = this->mean_density(m_oil_vol_frac_old[ p_node ], water_vol_fracOld, m_gas_vol_frac_old[ p_node ], m_pressure_old[ p_node ]);
-                
-                real_type rho_P = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);			
-				real_type rho_W = this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW, p_pressureW);
-
-                real_type rhoG_P		= this->gas_density( p_pressureP );			
-                real_type rhoG_W		= this->gas_density( p_pressureW );
-
-                real_type rhoW_P		= this->water_density( p_pressureP );			
-                real_type rhoW_W		= this->water_density( p_pressureW );
-
-                real_type rhoO_P_old	= this->oil_density( m_pressure_old[ p_node ] );	
-                real_type rhoO_P		= this->oil_density( p_pressureP );			
-                real_type rhoO_W		= this->oil_density( p_pressureW );
-
-                real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );			
-                real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-                
-                real_type mixture_inlet;
-
-                real_type Qoil = m_oil_flow[ p_node ]->get_current_value();
-                real_type Qwater = m_water_flow[ p_node ]->get_current_value();
-                real_type Qgas = m_gas_flow[ p_node ]->get_current_value();
-
-                if(m_mass_flux){   
-                    mixture_inlet = Qoil + Qwater + Qgas;
-                }                      
-                else
-                {
-				    real_type rhoGas_P	     = this->gas_density	( p_pressureP );
-				    real_type rhoWater_P	 = this->water_density	( p_pressureP );
-				    real_type rhoOil_P	     = this->oil_density	( p_pressureP );
-				    mixture_inlet  = rhoOil_P*Qoil + rhoWater_P*Qwater + rhoGas_P*Qgas;
-                }  				
-
-				
+	real_type DriftFluxWell::gas_viscosity( real_type p_pressure, uint_type p_face ){
+		if( this->count_property_lookup( is_cached( m_property_cache.face_pressure, p_face, p_pressure ) ) ) return m_property_cache.gas_viscosity[ p_face ];
+		return this->gas_viscosity( p_pressure );
+	}
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::gas_viscosity( const ad::DualNumber<N>& p_pressure, uint_type p_face ){
+		if( !this->count_property_lookup( is_cached( m_property_cache.face_pressure, p_face, p_pressure.value() ) ) ) return this->gas_viscosity( p_pressure );
+		return ad::DualNumber<N>::compose( m_property_cache.gas_viscosity[ p_face ], m_property_cache.gas_viscosity_derivative[ p_face ], p_pressure );
+	}
 
-                real_type mod_Vow_w	= this->mod_v_drift_flux_ow( 
-                    p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                    0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-                    );
+	real_type DriftFluxWell::oil_viscosity( real_type p_pressure, uint_type p_face ){
+		if( this->count_property_lookup( is_cached( m_property_cache.face_pressure, p_face, p_pressure ) ) ) return m_property_cache.oil_viscosity[ p_face ];
+		return this->oil_viscosity( p_pressure );
+	}
 
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::oil_viscosity( const ad::DualNumber<N>& p_pressure, uint_type p_face ){
+		if( !this->count_property_lookup( is_cached( m_property_cache.face_pressure, p_face, p_pressure.value() ) ) ) return this->oil_viscosity( p_pressure );
+		return ad::DualNumber<N>::compose( m_property_cache.oil_viscosity[ p_face ], m_property_cache.oil_viscosity_derivative[ p_face ], p_pressure );
+	}
 
-                real_type mod_Vgj_w	= this->mod_v_drift_flux( 
-                    p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                    0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-                    );
+	real_type DriftFluxWell::water_viscosity( real_type p_pressure, uint_type p_face ){
+		if( this->count_property_lookup( is_cached( m_property_cache.face_pressure, p_face, p_pressure ) ) ) return m_property_cache.water_viscosity[ p_face ];
+		return this->water_viscosity( p_pressure );
+	}
 
-                real_type gas_vol_frac_w   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
-                real_type oil_vol_frac_w   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracW);
-                real_type water_vol_frac_w = 0.5*(water_vol_fracP + water_vol_fracW);
-                real_type rho_g_w = 0.5*(rhoG_W + rhoG_P);
-                real_type rho_o_w = 0.5*(rhoO_W + rhoO_P);
-                real_type rho_w_w = 0.5*(rhoW_W + rhoW_P);
-                real_type rho_l_w = 0.5*(rhoL_W + rhoL_P);
-                real_type rho_w = 0.5*(rho_W + rho_P);
+	template <int N>
+	ad::DualNumber<N> DriftFluxWell::water_viscosity( const ad::DualNumber<N>& p_pressure, uint_type p_face ){
+		if( !this->count_property_lookup( is_cached( m_property_cache.face_pressure, p_face, p_pressure.value() ) ) ) return this->water_viscosity( p_pressure );
+		return ad::DualNumber<N>::compose( m_property_cache.water_viscosity[ p_face ], m_property_cache.water_viscosity_derivative[ p_face ], p_pressure );
+	}
 
-                real_type gas_velocity_w   = p_velocityW + rho_l_w/rho_w*mod_Vgj_w;
-                real_type liquid_velocity_w = p_velocityW - gas_vol_frac_w/(1 - gas_vol_frac_w + 1.0e-20)*rho_g_w/rho_w*mod_Vgj_w;
-                real_type oil_velocity_w   = liquid_velocity_w + rho_w_w/rho_l_w*mod_Vow_w;               
-                real_type water_velocity_w = liquid_velocity_w - (oil_vol_frac_w/(water_vol_frac_w + 1.0e-20))*(rho_o_w/rho_l_w)*mod_Vow_w;               
-                
-              
+	// Once per residual or Jacobian evaluation, outside the parallel assembly. The residuals call
+	// the properties of a node a dozen times or more; they read them back from here instead.
+	void DriftFluxWell::update_property_cache()
+	{
+		const real_type none = std::numeric_limits<real_type>::quiet_NaN(); // new entries never match
+		PropertyCache& cache = m_property_cache;
+		uint_type n = this->number_of_nodes();
+		uint_type faces = n - 1;
+		cache.pressure.resize( n, none );
+		cache.gas_density.resize( n );		cache.gas_density_derivative.resize( n );
+		cache.oil_density.resize( n );		cache.oil_density_derivative.resize( n );
+		cache.water_density.resize( n );	cache.water_density_derivative.resize( n );
+		cache.face_pressure.resize( faces, none );
+		cache.gas_viscosity.resize( faces );	cache.gas_viscosity_derivative.resize( faces );
+		cache.oil_viscosity.resize( faces );	cache.oil_viscosity_derivative.resize( faces );
+		cache.water_viscosity.resize( faces );	cache.water_viscosity_derivative.resize( faces );
+		cache.changed_arguments.resize( n );
+		cache.changed_values.resize( n );
+
+		// Only the nodes whose pressure changed since the last update are evaluated again
+		cache.changed.clear();
+		for( uint_type i = 0; i < n; ++i ){
+			if( is_cached( cache.pressure, i, m_pressure[ i ] ) ) continue;
+			cache.pressure[ i ] = m_pressure[ i ];
+			cache.changed_arguments[ cache.changed.size() ] = m_pressure[ i ];
+			cache.changed.push_back( i );
+		}
+		if( !cache.changed.empty() ){
+			evaluate_changed( *m_gas_density_model,	&IDensityModel::compute_densities,			cache.changed, cache.changed_arguments, cache.changed_values, cache.gas_density );
+			evaluate_changed( *m_gas_density_model,	&IDensityModel::compute_density_derivatives,	cache.changed, cache.changed_arguments, cache.changed_values, cache.gas_density_derivative );
+			evaluate_changed( *m_oil_density_model,	&IDensityModel::compute_densities,			cache.changed, cache.changed_arguments, cache.changed_values, cache.oil_density );
+			evaluate_changed( *m_oil_density_model,	&IDensityModel::compute_density_derivatives,	cache.changed, cache.changed_arguments, cache.changed_values, cache.oil_density_derivative );
+			evaluate_changed( *m_water_density_model, &IDensityModel::compute_densities,			cache.changed, cache.changed_arguments, cache.changed_values, cache.water_density );
+			evaluate_changed( *m_water_density_model, &IDensityModel::compute_density_derivatives,	cache.changed, cache.changed_arguments, cache.changed_values, cache.water_density_derivative );
+			m_cache_statistics.property_evaluations += 6*cache.changed.size();
+		}
+		if( faces == 0 ) return;
+
+		// Same expression as the mean pressure of the momentum residuals, so the lookups match bit for bit
+		cache.changed.clear();
+		for( uint_type k = 0; k < faces; ++k ){
+			real_type face_pressure = 0.5*( m_pressure[ k ] + m_pressure[ k+1 ] );
+			if( is_cached( cache.face_pressure, k, face_pressure ) ) continue;
+			cache.face_pressure[ k ] = face_pressure;
+			cache.changed_arguments[ cache.changed.size() ] = face_pressure;
+			cache.changed.push_back( k );
+		}
+		if( !cache.changed.empty() ){
+			evaluate_changed( *m_gas_viscosity_model,	&IViscosityModel::compute_viscosities,			cache.changed, cache.changed_arguments, cache.changed_values, cache.gas_viscosity );
+			evaluate_changed( *m_gas_viscosity_model,	&IViscosityModel::compute_viscosity_derivatives,	cache.changed, cache.changed_arguments, cache.changed_values, cache.gas_viscosity_derivative );
+			evaluate_changed( *m_oil_viscosity_model,	&IViscosityModel::compute_viscosities,			cache.changed, cache.changed_arguments, cache.changed_values, cache.oil_viscosity );
+			evaluate_changed( *m_oil_viscosity_model,	&IViscosityModel::compute_viscosity_derivatives,	cache.changed, cache.changed_arguments, cache.changed_values, cache.oil_viscosity_derivative );
+			evaluate_changed( *m_water_viscosity_model, &IViscosityModel::compute_viscosities,			cache.changed, cache.changed_arguments, cache.changed_values, cache.water_viscosity );
+			evaluate_changed( *m_water_viscosity_model, &IViscosityModel::compute_viscosity_derivatives,	cache.changed, cache.changed_arguments, cache.changed_values, cache.water_viscosity_derivative );
+			m_cache_statistics.property_evaluations += 6*cache.changed.size();
+		}
 
-                real_type ksi_w_oil     = this->ksi( oil_velocity_w   );
-                real_type ksi_w_gas     = this->ksi( gas_velocity_w   );
-                real_type ksi_w_water   = this->ksi( water_velocity_w );
+		cache.closure_mean_velocity.resize( faces );
+		cache.closure_gas_vol_frac.resize( faces );
+		cache.closure_oil_vol_frac.resize( faces );
+		cache.closure_water_vol_frac.resize( faces );
+		cache.closure_pressure.resize( faces, none );
+		cache.gas_liquid_drift_flux.resize( faces );
+		cache.oil_water_drift_flux.resize( faces );
+		for( int k = 0; k < PropertyCache::total_closure_arguments; ++k ){
+			cache.gas_liquid_drift_flux_derivative[ k ].resize( faces );
+			cache.oil_water_drift_flux_derivative[ k ].resize( faces );
+		}
+		for( uint_type k = 0; k < faces; ++k ){
+			// Same expressions as the arguments the residuals pass to the closures
+			real_type water_vol_fracW	= 1.0 - ( m_gas_vol_frac[ k ] + m_oil_vol_frac[ k ] );
+			real_type water_vol_fracE	= 1.0 - ( m_gas_vol_frac[ k+1 ] + m_oil_vol_frac[ k+1 ] );
+			real_type mean_velocity		= m_mean_velocity[ k ];
+			real_type gas_vol_frac		= 0.5*( m_gas_vol_frac[ k ] + m_gas_vol_frac[ k+1 ] );
+			real_type oil_vol_frac		= 0.5*( m_oil_vol_frac[ k ] + m_oil_vol_frac[ k+1 ] );
+			real_type water_vol_frac	= 0.5*( water_vol_fracW + water_vol_fracE );
+			real_type pressure			= cache.face_pressure[ k ];
+			if( this->is_cached_closure( k, mean_velocity, gas_vol_frac, oil_vol_frac, water_vol_frac, pressure ) ) continue;
+
+			// Invalid states aren't cached: the residuals evaluate them, and flag them, themselves
+			cache.closure_pressure[ k ] = std::numeric_limits<real_type>::quiet_NaN();
+			if( !is_valid_closure_state( gas_vol_frac, oil_vol_frac, pressure ) ) continue;
+
+			ad_type arguments[ PropertyCache::total_closure_arguments ] = {
+				ad_type( mean_velocity, PropertyCache::MEAN_VELOCITY ), ad_type( gas_vol_frac, PropertyCache::GAS_VOL_FRAC ),
+				ad_type( oil_vol_frac, PropertyCache::OIL_VOL_FRAC ), ad_type( water_vol_frac, PropertyCache::WATER_VOL_FRAC ),
+				ad_type( pressure, PropertyCache::PRESSURE )
+			};
+			ad_type V_gj = this->mod_v_drift_flux	( arguments[ 0 ], arguments[ 1 ], arguments[ 2 ], arguments[ 3 ], arguments[ 4 ] );
+			ad_type V_ow = this->mod_v_drift_flux_ow( arguments[ 0 ], arguments[ 1 ], arguments[ 2 ], arguments[ 3 ], arguments[ 4 ] );
+			// The values from the real_type closures, so cached residuals match evaluated ones bit for bit
+			cache.gas_liquid_drift_flux[ k ] = this->mod_v_drift_flux	( mean_velocity, gas_vol_frac, oil_vol_frac, water_vol_frac, pressure );
+			cache.oil_water_drift_flux[ k ]	 = this->mod_v_drift_flux_ow( mean_velocity, gas_vol_frac, oil_vol_frac, water_vol_frac, pressure );
+			for( int a = 0; a < PropertyCache::total_closure_arguments; ++a ){
+				cache.gas_liquid_drift_flux_derivative[ a ][ k ] = V_gj.derivative( a );
+				cache.oil_water_drift_flux_derivative[ a ][ k ]	 = V_ow.derivative( a );
+			}
+			m_cache_statistics.closure_evaluations += 2;
 
-                real_type m_w_oil   = oil_velocity_w  *( (0.5+ksi_w_oil  )*rhoO_W*p_oil_vol_fracW + (0.5-ksi_w_oil  )*rhoO_P*p_oil_vol_fracP );
-                real_type m_w_water = water_velocity_w*( (0.5+ksi_w_water)*rhoW_W*water_vol_fracW + (0.5-ksi_w_water)*rhoW_P*water_vol_fracP );
-                real_type m_w_gas   = gas_velocity_w  *( (0.5+ksi_w_gas  )*rhoG_W*p_gas_vol_fracW + (0.5-ksi_w_gas  )*rhoG_P*p_gas_vol_fracP );
+			cache.closure_mean_velocity[ k ]	= mean_velocity;
+			cache.closure_gas_vol_frac[ k ]		= gas_vol_frac;
+			cache.closure_oil_vol_frac[ k ]		= oil_vol_frac;
+			cache.closure_water_vol_frac[ k ]	= water_vol_frac;
+			cache.closure_pressure[ k ]			= pressure;
+		}
+	}
 
-                return (rho_P-rho_P_old)*dV/dt() - mixture_inlet 
-                    +	area()*( p_velocityP*rho_P - (m_w_oil + m_w_water + m_w_gas) );
+	bool DriftFluxWell::is_cached_closure(
+		uint_type p_face, real_type p_mean_velocity, real_type p_gas_vol_frac, real_type p_oil_vol_frac, real_type p_water_vol_frac, real_type p_pressure
+		) const
+	{
+		const PropertyCache& cache = m_property_cache;
+		return is_cached( cache.closure_pressure, p_face, p_pressure )
+			&& cache.closure_mean_velocity[ p_face ] == p_mean_velocity
+			&& cache.closure_gas_vol_frac[ p_face ] == p_gas_vol_frac
+			&& cache.closure_oil_vol_frac[ p_face ] == p_oil_vol_frac
+			&& cache.closure_water_vol_frac[ p_face ] == p_water_vol_frac;
+	}
 
-                //real_type ksi_w = this->ksi( p_velocityW );	
-			/*return (rho_P-rho_P_old)*dV/dt() - mixture_inlet 
-				  +	area()*( p_velocityP*rho_P 
-						   - p_velocityW*( (0.5+ksi_w)*rho_W + (0.5-ksi_w)*rho_P ) );*/	
-			
-			}			
-		
-		case 'C':
-			{
-				
-				real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
-				real_type dSe = 0.5*this->segment_length( m_coordinates[ p_node ], m_coordinates[ p_node+1 ] );
-				real_type dS  = dSw + dSe;
-				real_type dV = this->Volume( dS );
+	void DriftFluxWell::select_closure(){
+		m_shi_closure		= this->make_closure<ShiClosureModels>();
+		m_constant_closure	= this->make_closure<ConstantClosureModels>();
+		m_property_cache.clear();
+	}
 
-				real_type water_vol_fracOld = 1.0 - (m_oil_vol_frac_old[ p_node ] + m_gas_vol_frac_old[ p_node ]);
-				real_type water_vol_fracW	= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-				real_type water_vol_fracP	= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
-				real_type water_vol_fracE	= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);
+	// The models must have exactly the types of Closure: a model derived from one of them could
+	// override its correlation.
+	template <class Closure>
+	SharedPointer<Closure> DriftFluxWell::make_closure() const {
+		const typename Closure::gas_liquid_drift_velocity_type*		gas_liquid_drift	= exact_model< typename Closure::gas_liquid_drift_velocity_type >( m_gas_liquid_drift_velocity_model );
+		const typename Closure::oil_water_drift_velocity_type*		oil_water_drift		= exact_model< typename Closure::oil_water_drift_velocity_type >( m_oil_water_drift_velocity_model );
+		const typename Closure::gas_liquid_profile_parameter_type*	gas_liquid_profile	= exact_model< typename Closure::gas_liquid_profile_parameter_type >( m_gas_liquid_profile_parameter_model );
+		const typename Closure::oil_water_profile_parameter_type*	oil_water_profile	= exact_model< typename Closure::oil_water_profile_parameter_type >( m_oil_water_profile_parameter_model );
+		if( !gas_liquid_drift || !oil_water_drift || !gas_liquid_profile || !oil_water_profile ) return SharedPointer<Closure>();
+		return SharedPointer<Closure>( new Closure( *gas_liquid_drift, *oil_water_drift, *gas_liquid_profile, *oil_water_profile ) );
+	}
 
-				real_type rho_P_old = this->mean_density(m_oil_vol_frac_old[ p_node ], water_vol_fracOld, m_gas_vol_frac_old[ p_node ], m_pressure_old[ p_node ]);
-                
+	DriftFluxWell::VirtualClosureModels DriftFluxWell::virtual_closure() const {
+		return VirtualClosureModels(
+			*m_gas_liquid_drift_velocity_model, *m_oil_water_drift_velocity_model,
+			*m_gas_liquid_profile_parameter_model, *m_oil_water_profile_parameter_model
+			);
+	}
 
+	real_type DriftFluxWell::tabulate_property_models( real_type p_min_pressure, real_type p_max_pressure, uint_type p_intervals )
+	{
+		real_type max_error = 0.0;
+		if( p_intervals == 0 || !( p_min_pressure < p_max_pressure ) ) return max_error;
+
+		SharedPointer<IDensityModel>* density_models[] = { &m_gas_density_model, &m_oil_density_model, &m_water_density_model };
+		for( int k = 0; k < 3; ++k ){
+			SharedPointer<IDensityModel>& model = *density_models[ k ];
+			SharedPointer<TabulatedDensityModel> table( new TabulatedDensityModel( model, p_min_pressure, p_max_pressure, p_intervals ) );
+			max_error = std::max( max_error, table->get_relative_error_bound() );
+			model = table;
+		}
 
-				real_type rho_P = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);
-				real_type rho_E = this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
-				real_type rho_W = this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW, p_pressureW);
+		SharedPointer<IViscosityModel>* viscosity_models[] = { &m_gas_viscosity_model, &m_oil_viscosity_model, &m_water_viscosity_model };
+		for( int k = 0; k < 3; ++k ){
+			SharedPointer<IViscosityModel>& model = *viscosity_models[ k ];
+			SharedPointer<TabulatedViscosityModel> table( new TabulatedViscosityModel( model, p_min_pressure, p_max_pressure, p_intervals ) );
+			max_error = std::max( max_error, table->get_relative_error_bound() );
+			model = table;
+		}
 
-                real_type rhoG_P		= this->gas_density( p_pressureP );
-                real_type rhoG_E		= this->gas_density( p_pressureE );
-                real_type rhoG_W		= this->gas_density( p_pressureW );
+		SharedPointer<IInterfacialTensionModel>* tension_models[] = { &m_gas_oil_interfacial_tension_model, &m_gas_water_interfacial_tension_model };
+		for( int k = 0; k < 2; ++k ){
+			SharedPointer<IInterfacialTensionModel>& model = *tension_models[ k ];
+			SharedPointer<TabulatedInterfacialTensionModel> table( new TabulatedInterfacialTensionModel( model, p_min_pressure, p_max_pressure, p_intervals ) );
+			max_error = std::max( max_error, table->get_relative_error_bound() );
+			model = table;
+		}
 
-                real_type rhoW_P		= this->water_density( p_pressureP );
-                real_type rhoW_E		= this->water_density( p_pressureE );
-                real_type rhoW_W		= this->water_density( p_pressureW );
+		m_property_cache.clear();
+		return max_error;
+	}
 
-                real_type rhoO_P_old	= this->oil_density( m_pressure_old[ p_node ] );	
-                real_type rhoO_P		= this->oil_density( p_pressureP );
-                real_type rhoO_E		= this->oil_density( p_pressureE );
-                real_type rhoO_W		= this->oil_density( p_pressureW );
+	uint_type DriftFluxWell::assembly_thread(){
+#ifdef _OPENMP
+		return omp_get_thread_num();
+#else
+		return 0;
+#endif
+	}
 
-                real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
-                real_type rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
-                real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-                
-                real_type mixture_inlet;
+	void DriftFluxWell::prepare_thread_status(){
+		PropertyCacheStatistics none = { 0, 0, 0, 0 };
+		m_thread_invalid_state.assign( m_number_of_threads - 1, 0 );
+		m_thread_cache_statistics.assign( m_number_of_threads - 1, none );
+	}
 
-                real_type Qoil = m_oil_flow[ p_node ]->get_current_value();
-                real_type Qwater = m_water_flow[ p_node ]->get_current_value();
-                real_type Qgas = m_gas_flow[ p_node ]->get_current_value();
+	void DriftFluxWell::gather_thread_status(){
+		for( uint_type k = 0; k < m_thread_invalid_state.size(); ++k ){
+			if( m_thread_invalid_state[ k ] ) m_convergence_status = true;
+		}
+		for( uint_type k = 0; k < m_thread_cache_statistics.size(); ++k ){
+			const PropertyCacheStatistics& thread = m_thread_cache_statistics[ k ];
+			m_cache_statistics.property_hits		+= thread.property_hits;
+			m_cache_statistics.property_evaluations	+= thread.property_evaluations;
+			m_cache_statistics.closure_hits			+= thread.closure_hits;
+			m_cache_statistics.closure_evaluations	+= thread.closure_evaluations;
+		}
+		m_thread_cache_statistics.clear();
+	}
 
-                if(m_mass_flux){   
-                    mixture_inlet = Qoil + Qwater + Qgas;
-                }                      
-                else
-                {
-                    real_type rhoGas_P	     = this->gas_density	( p_pressureP );
-                    real_type rhoWater_P	 = this->water_density	( p_pressureP );
-                    real_type rhoOil_P	     = this->oil_density	( p_pressureP );
-                    mixture_inlet  = rhoOil_P*Qoil + rhoWater_P*Qwater + rhoGas_P*Qgas;
-                }  
-
-
-                real_type mod_Vow_e	= this->mod_v_drift_flux_ow( 
-                    p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-                    0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
-                    );
-
-                real_type mod_Vow_w	= this->mod_v_drift_flux_ow( 
-                    p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                    0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-                    );
-
-                real_type mod_Vgj_e		= this->mod_v_drift_flux( 
-                    p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-                    0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
-                    );
-
-                real_type mod_Vgj_w		= this->mod_v_drift_flux( 
-                    p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                    0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-                    );
-
-                real_type gas_vol_frac_w   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
-                real_type oil_vol_frac_w   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracW);
-                real_type water_vol_frac_w = 0.5*(water_vol_fracP + water_vol_fracW);
-                real_type rho_g_w = 0.5*(rhoG_W + rhoG_P);
-                real_type rho_o_w = 0.5*(rhoO_W + rhoO_P);
-                real_type rho_w_w = 0.5*(rhoW_W + rhoW_P);
-                real_type rho_l_w = 0.5*(rhoL_W + rhoL_P);
-                real_type rho_w = 0.5*(rho_W + rho_P);
-
-                real_type gas_velocity_w   = p_velocityW + rho_l_w/rho_w*mod_Vgj_w;
-                real_type liquid_velocity_w = p_velocityW - gas_vol_frac_w/(1 - gas_vol_frac_w + 1.0e-20)*rho_g_w/rho_w*mod_Vgj_w;	 
-                real_type water_velocity_w = liquid_velocity_w - (oil_vol_frac_w/(water_vol_frac_w + 1.0e-20))*(rho_o_w/rho_l_w)*mod_Vow_w;               
-                real_type oil_velocity_w = liquid_velocity_w + rho_w_w/rho_l_w*mod_Vow_w;  
+	void DriftFluxWell::flag_invalid_state(){
+		uint_type thread = this->assembly_thread();
+		if( thread == 0 ) m_convergence_status = true;
+		else m_thread_invalid_state[ thread - 1 ] = 1;
+	}
 
-                
-                
-                real_type gas_vol_frac_e   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE);
-                real_type oil_vol_frac_e   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracE);
-                real_type water_vol_frac_e = 0.5*(water_vol_fracP + water_vol_fracE);
-                real_type rho_g_e = 0.5*(rhoG_E + rhoG_P);
-                real_type rho_o_e = 0.5*(rhoO_E + rhoO_P);
-                real_type rho_w_e = 0.5*(rhoW_E + rhoW_P);
-                real_type rho_l_e = 0.5*(rhoL_E + rhoL_P);
-                real_type rho_e = 0.5*(rho_E + rho_P);
+	// Both return p_hit, counted for the calling thread
+	bool DriftFluxWell::count_property_lookup( bool p_hit ){
+		uint_type thread = this->assembly_thread();
+		PropertyCacheStatistics& statistics = ( thread == 0 ) ? m_cache_statistics : m_thread_cache_statistics[ thread - 1 ];
+		if( p_hit ) ++statistics.property_hits;
+		else ++statistics.property_evaluations;
+		return p_hit;
+	}
 
-                real_type gas_velocity_e = p_velocityP + rho_l_e/rho_e*mod_Vgj_e;
-                real_type liquid_velocity_e = p_velocityP - gas_vol_frac_e/(1 - gas_vol_frac_e + 1.0e-20)*rho_g_e/rho_e*mod_Vgj_e;	 
-                real_type water_velocity_e = liquid_velocity_e - (oil_vol_frac_e/(water_vol_frac_e + 1.0e-20))*(rho_o_e/rho_l_e)*mod_Vow_e;               
-                real_type oil_velocity_e = liquid_velocity_e + rho_w_e/rho_l_e*mod_Vow_e;
+	bool DriftFluxWell::count_closure_lookup( bool p_hit ){
+		uint_type thread = this->assembly_thread();
+		PropertyCacheStatistics& statistics = ( thread == 0 ) ? m_cache_statistics : m_thread_cache_statistics[ thread - 1 ];
+		if( p_hit ) ++statistics.closure_hits;
+		else ++statistics.closure_evaluations;
+		return p_hit;
+	}
 
-              
 
-                real_type ksi_e_oil     = this->ksi( oil_velocity_e   );
-                real_type ksi_e_gas     = this->ksi( gas_velocity_e   );
-                real_type ksi_e_water   = this->ksi( water_velocity_e );
+	real_type DriftFluxWell::R_m(
+								 real_type p_pressureW,
+								 real_type p_pressureP,
+								 real_type p_pressureE,
+								 real_type p_gas_vol_fracW,
+								 real_type p_gas_vol_fracP,
+								 real_type p_gas_vol_fracE,
+								 real_type p_oil_vol_fracW,
+								 real_type p_oil_vol_fracP,
+								 real_type p_oil_vol_fracE,
+								 real_type p_velocityW,
+								 real_type p_velocityP,
+								 uint_type p_node,
+								 string_type	   position = 'C'
+								 )
+	{
+		FaceFluxes<real_type> faces[ 2 ];
+		this->do_node_face_fluxes<real_type>(
+			p_pressureW, p_pressureP, p_pressureE,
+			p_gas_vol_fracW, p_gas_vol_fracP, p_gas_vol_fracE,
+			p_oil_vol_fracW, p_oil_vol_fracP, p_oil_vol_fracE,
+			p_velocityW, p_velocityP,
+			p_node, position, faces
+			);
+		return this->do_R_m<real_type>( p_pressureP, p_gas_vol_fracP, p_oil_vol_fracP, p_velocityP, faces, p_node, position );
+	}
 
-                real_type ksi_w_oil     = this->ksi( oil_velocity_w   );
-                real_type ksi_w_gas     = this->ksi( gas_velocity_w   );
-                real_type ksi_w_water   = this->ksi( water_velocity_w );	
+	// Phase velocities and upwinded phase mass fluxes, per unit area, through face p_face from its
+	// west node p_face to its east node p_face+1. The face loops evaluate every face once and hand
+	// it to the mass balances of both its nodes, so what leaves one node enters the next exactly.
+	template <class T>
+	void DriftFluxWell::do_face_fluxes(
+								 T p_pressureW,
+								 T p_pressureE,
+								 T p_gas_vol_fracW,
+								 T p_gas_vol_fracE,
+								 T p_oil_vol_fracW,
+								 T p_oil_vol_fracE,
+								 T p_velocity,
+								 uint_type p_face,
+								 FaceFluxes<T>& p_fluxes
+								 )
+	{
+		T water_vol_fracW	= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
+		T water_vol_fracE	= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);
+
+		T rho_W = this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW, p_pressureW);
+		T rho_E = this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
+
+		T rhoG_W		= this->gas_density( p_pressureW, p_face );
+		T rhoG_E		= this->gas_density( p_pressureE, p_face+1 );
+
+		T rhoW_W		= this->water_density( p_pressureW, p_face );
+		T rhoW_E		= this->water_density( p_pressureE, p_face+1 );
+
+		T rhoO_W		= this->oil_density( p_pressureW, p_face );
+		T rhoO_E		= this->oil_density( p_pressureE, p_face+1 );
+
+		T rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
+		T rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
+
+		T mod_Vow	= this->mod_v_drift_flux_ow( 
+			p_velocity, 0.5*(p_gas_vol_fracE + p_gas_vol_fracW), 0.5*(p_oil_vol_fracE + p_oil_vol_fracW),
+			0.5*(water_vol_fracE + water_vol_fracW), 0.5*(p_pressureE + p_pressureW), p_face
+			);
+
+		T mod_Vgj	= this->mod_v_drift_flux( 
+			p_velocity, 0.5*(p_gas_vol_fracE + p_gas_vol_fracW), 0.5*(p_oil_vol_fracE + p_oil_vol_fracW),
+			0.5*(water_vol_fracE + water_vol_fracW), 0.5*(p_pressureE + p_pressureW), p_face
+			);
+
+		T gas_vol_frac   = 0.5*(p_gas_vol_fracE + p_gas_vol_fracW);
+		T oil_vol_frac   = 0.5*(p_oil_vol_fracE + p_oil_vol_fracW);
+		T water_vol_frac = 0.5*(water_vol_fracE + water_vol_fracW);
+		T rho_g = 0.5*(rhoG_W + rhoG_E);
+		T rho_o = 0.5*(rhoO_W + rhoO_E);
+		T rho_w = 0.5*(rhoW_W + rhoW_E);
+		T rho_l = 0.5*(rhoL_W + rhoL_E);
+		T rho   = 0.5*(rho_W + rho_E);
+
+		T gas_velocity    = p_velocity + rho_l/rho*mod_Vgj;
+		T liquid_velocity = p_velocity - gas_vol_frac/(1 - gas_vol_frac + 1.0e-20)*rho_g/rho*mod_Vgj;	 
+		T water_velocity  = liquid_velocity - (oil_vol_frac/(water_vol_frac + 1.0e-20))*(rho_o/rho_l)*mod_Vow;               
+		T oil_velocity    = liquid_velocity + rho_w/rho_l*mod_Vow;  
+
+		real_type ksi_oil     = this->ksi( oil_velocity   );
+		real_type ksi_gas     = this->ksi( gas_velocity   );
+		real_type ksi_water   = this->ksi( water_velocity );
+
+		p_fluxes.oil   = oil_velocity  *( (0.5+ksi_oil  )*rhoO_W*p_oil_vol_fracW + (0.5-ksi_oil  )*rhoO_E*p_oil_vol_fracE );
+		p_fluxes.water = water_velocity*( (0.5+ksi_water)*rhoW_W*water_vol_fracW + (0.5-ksi_water)*rhoW_E*water_vol_fracE );
+		p_fluxes.gas   = gas_velocity  *( (0.5+ksi_gas  )*rhoG_W*p_gas_vol_fracW + (0.5-ksi_gas  )*rhoG_E*p_gas_vol_fracE );
+	}
 
-                real_type m_w_oil   = oil_velocity_w  *( (0.5+ksi_w_oil  )*rhoO_W*p_oil_vol_fracW + (0.5-ksi_w_oil  )*rhoO_P*p_oil_vol_fracP );
-                real_type m_w_water = water_velocity_w*( (0.5+ksi_w_water)*rhoW_W*water_vol_fracW + (0.5-ksi_w_water)*rhoW_P*water_vol_fracP );
-                real_type m_w_gas   = gas_velocity_w  *( (0.5+ksi_w_gas  )*rhoG_W*p_gas_vol_fracW + (0.5-ksi_w_gas  )*rhoG_P*p_gas_vol_fracP );
+	// West and east faces of node p_node from its own stencil, for the callers without a face loop
+	// (the row-wise finite differences). The last node has no east face.
+	template <class T>
+	void DriftFluxWell::do_node_face_fluxes(
+								 T p_pressureW,
+								 T p_pressureP,
+								 T p_pressureE,
+								 T p_gas_vol_fracW,
+								 T p_gas_vol_fracP,
+								 T p_gas_vol_fracE,
+								 T p_oil_vol_fracW,
+								 T p_oil_vol_fracP,
+								 T p_oil_vol_fracE,
+								 T p_velocityW,
+								 T p_velocityP,
+								 uint_type p_node,
+								 string_type	   position,
+								 FaceFluxes<T> p_faces[]
+								 )
+	{
+		this->do_face_fluxes<T>( p_pressureW, p_pressureP, p_gas_vol_fracW, p_gas_vol_fracP, p_oil_vol_fracW, p_oil_vol_fracP,
+								 p_velocityW, p_node-1, p_faces[ 0 ] );
+		if( position == 'L' ) return;
+		this->do_face_fluxes<T>( p_pressureP, p_pressureE, p_gas_vol_fracP, p_gas_vol_fracE, p_oil_vol_fracP, p_oil_vol_fracE,
+								 p_velocityP, p_node, p_faces[ 1 ] );
+	}
 
-                real_type m_e_oil   = oil_velocity_e  *( (0.5+ksi_e_oil  )*rhoO_P*p_oil_vol_fracP + (0.5-ksi_e_oil  )*rhoO_E*p_oil_vol_fracE );
-                real_type m_e_water = water_velocity_e*( (0.5+ksi_e_water)*rhoW_P*water_vol_fracP + (0.5-ksi_e_water)*rhoW_E*water_vol_fracE );
-                real_type m_e_gas   = gas_velocity_e  *( (0.5+ksi_e_gas  )*rhoG_P*p_gas_vol_fracP + (0.5-ksi_e_gas  )*rhoG_E*p_gas_vol_fracE );
+	// Mass balance of node p_node with the fluxes of its west and east faces, p_faces[ 0 ] and
+	// p_faces[ 1 ]. The last node ('L') lets the mixture out at its own velocity and density instead.
+	template <class T>
+	T DriftFluxWell::do_R_m(
+								 T p_pressureP,
+								 T p_gas_vol_fracP,
+								 T p_oil_vol_fracP,
+								 T p_velocityP,
+								 const FaceFluxes<T> p_faces[],
+								 uint_type p_node,
+								 string_type	   position
+								 )
+	{
+		bool last = ( position == 'L' );
+		real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
+		real_type dSe = last ? 0. : 0.5*this->segment_length( m_coordinates[ p_node ], m_coordinates[ p_node+1 ] );
+		real_type dS  = dSw + dSe;
+		real_type dV = this->Volume( dS );
 
+		real_type water_vol_fracOld = 1.0 - (m_oil_vol_frac_old[ p_node ] + m_gas_vol_frac_old[ p_node ]);
+		T water_vol_fracP	= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
 
-                return (rho_P-rho_P_old)*dV/dt() - mixture_inlet 
-                    + area()*( m_e_oil+m_e_water+m_e_gas - ( m_w_oil+m_w_water+m_w_gas ) );
+		real_type rho_P_old = this->mean_density(m_oil_vol_frac_old[ p_node ], water_vol_fracOld, m_gas_vol_frac_old[ p_node ], m_pressure_old[ p_node ]);
+		T rho_P = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);
 
+		T mixture_inlet;
 
-				/*real_type ksi_e = this->ksi( p_velocityP );
-				real_type ksi_w = this->ksi( p_velocityW );			
+		real_type Qoil = m_oil_flow[ p_node ]->get_current_value();
+		real_type Qwater = m_water_flow[ p_node ]->get_current_value();
+		real_type Qgas = m_gas_flow[ p_node ]->get_current_value();
 
-			return (rho_P-rho_P_old)*dV/dt() - mixture_inlet 
-				  + area()*( p_velocityP*( (0.5+ksi_e)*rho_P + (0.5-ksi_e)*rho_E )
-						   - p_velocityW*( (0.5+ksi_w)*rho_W + (0.5-ksi_w)*rho_P ) );*/
-						
-			}
-		default:
-			return 0.;	
-		}
-		
+		if(m_mass_flux){   
+			mixture_inlet = Qoil + Qwater + Qgas;
+		}                      
+		else
+		{
+			T rhoGas_P	     = this->gas_density	( p_pressureP, p_node );
+			T rhoWater_P	 = this->water_density	( p_pressureP, p_node );
+			T rhoOil_P	     = this->oil_density	( p_pressureP, p_node );
+			mixture_inlet  = rhoOil_P*Qoil + rhoWater_P*Qwater + rhoGas_P*Qgas;
+		}  
+
+		const FaceFluxes<T>& w = p_faces[ 0 ];
+		const FaceFluxes<T>& e = p_faces[ 1 ];
+		T outflow = last ? p_velocityP*rho_P : e.oil+e.water+e.gas;
+
+		return (rho_P-rho_P_old)*dV/dt() - mixture_inlet 
+			+ area()*( outflow - ( w.oil+w.water+w.gas ) );
 	}
 
 	real_type DriftFluxWell::R_g(
@@ -907,127 +1601,51 @@ namespace WellSimulator {
 								 string_type	   position = 'C'
 								 )
 	{
-		switch( position )
-		{
+		FaceFluxes<real_type> faces[ 2 ];
+		this->do_node_face_fluxes<real_type>(
+			p_pressureW, p_pressureP, p_pressureE,
+			p_gas_vol_fracW, p_gas_vol_fracP, p_gas_vol_fracE,
+			p_oil_vol_fracW, p_oil_vol_fracP, p_oil_vol_fracE,
+			p_velocityW, p_velocityP,
+			p_node, position, faces
+			);
+		return this->do_R_g<real_type>( p_pressureP, p_gas_vol_fracP, p_oil_vol_fracP, p_velocityP, faces, p_node, position );
+	}
 
-		case 'L':
-			{
-				real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
-				real_type dSe = 0.;
-				real_type dS  = dSw + dSe;
-				real_type dV = this->Volume( dS );
-
-				real_type water_vol_fracW	= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-				real_type water_vol_fracP	= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
-
-				real_type rho_P		= this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);			
-				real_type rho_W		= this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW, p_pressureW);
-
-				real_type rhoG_P_old	= this->gas_density( m_pressure_old[ p_node ] );	
-				real_type rhoG_P		= this->gas_density( p_pressureP );			
-				real_type rhoG_W		= this->gas_density( p_pressureW );
-
-				real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );			
-				real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-                
-                real_type gas_inlet;
-
-                real_type Qgas = m_gas_flow[ p_node ]->get_current_value();
-                if(m_mass_flux){
-                    gas_inlet = Qgas;
-                }                      
-                else
-                {
-                    gas_inlet = rhoG_P*Qgas;
-                }
-
-
-
-				real_type mod_Vgj_w	= this->mod_v_drift_flux( 
-					p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-					0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-					);
-
-                real_type gas_velocity_w = p_velocityW + 0.5*(rhoL_W + rhoL_P)/(0.5*(rho_W + rho_P))*mod_Vgj_w;
-				real_type ksi_w = this->ksi( gas_velocity_w );	
-
-                return (p_gas_vol_fracP*rhoG_P - m_gas_vol_frac_old[ p_node ]*rhoG_P_old)*dV/dt() - gas_inlet				 
-				 + p_velocityP*area()*rhoG_P*p_gas_vol_fracP
-				 - gas_velocity_w*area()*( (0.5+ksi_w)*rhoG_W*p_gas_vol_fracW + (0.5-ksi_w)*rhoG_P*p_gas_vol_fracP );				 
-
-			//return (p_gas_vol_fracP*rhoG_P - m_gas_vol_frac_old[ p_node ]*rhoG_P_old)*dV/dt() - gas_inlet				 
-			//	 + p_velocityP*area()*rhoG_P*p_gas_vol_fracP
-			//	 - p_velocityW*area()*( (0.5+ksi_w)*rhoG_W*p_gas_vol_fracW + (0.5-ksi_w)*rhoG_P*p_gas_vol_fracP )				 
-			//	 //+ mod_Vgj_e*area()*( rhoG_P*rhoL_P/rho_P * p_gas_vol_fracP )
-			//	 - mod_Vgj_w*area()*( (0.5+ksi_w)*rhoG_W*rhoL_W/rho_W * p_gas_vol_fracW + (0.5-ksi_w)*rhoG_P*rhoL_P/rho_P * p_gas_vol_fracP );			
-			
-			}
-			
-
-		case 'C':
-			{
-				real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
-				real_type dSe = 0.5*this->segment_length( m_coordinates[ p_node ], m_coordinates[ p_node+1 ] );
-				real_type dS  = dSw + dSe;
-				real_type dV  = this->Volume( dS );			
-
-				real_type water_vol_fracW	= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-				real_type water_vol_fracP	= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
-				real_type water_vol_fracE	= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);
-
-				real_type rho_P		= this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);	
-				real_type rho_E		= this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
-				real_type rho_W		= this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW, p_pressureW);
-
-				real_type rhoG_P_old = this->gas_density( m_pressure_old[ p_node ] );	
-				real_type rhoG_P		= this->gas_density( p_pressureP );
-				real_type rhoG_E		= this->gas_density( p_pressureE );
-				real_type rhoG_W		= this->gas_density( p_pressureW );
-
-				real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
-				real_type rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
-				real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-
-                real_type gas_inlet;
-                real_type Qgas = m_gas_flow[ p_node ]->get_current_value();
-                if(m_mass_flux){
-                    gas_inlet = Qgas;
-                }                      
-                else
-                {
-                    gas_inlet = rhoG_P*Qgas;
-                }
+	template <class T>
+	T DriftFluxWell::do_R_g(
+								 T p_pressureP,
+								 T p_gas_vol_fracP,
+								 T /*p_oil_vol_fracP*/,
+								 T p_velocityP,
+								 const FaceFluxes<T> p_faces[],
+								 uint_type p_node,
+								 string_type	   position
+								 )
+	{
+		bool last = ( position == 'L' );
+		real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
+		real_type dSe = last ? 0. : 0.5*this->segment_length( m_coordinates[ p_node ], m_coordinates[ p_node+1 ] );
+		real_type dS  = dSw + dSe;
+		real_type dV  = this->Volume( dS );			
+
+		real_type rhoG_P_old = this->gas_density( m_pressure_old[ p_node ] );	
+		T rhoG_P		= this->gas_density( p_pressureP, p_node );
+
+		T gas_inlet;
+		real_type Qgas = m_gas_flow[ p_node ]->get_current_value();
+		if(m_mass_flux){
+			gas_inlet = Qgas;
+		}                      
+		else
+		{
+			gas_inlet = rhoG_P*Qgas;
+		}
 
-				real_type mod_Vgj_e		= this->mod_v_drift_flux( 
-					p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-					0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
-					);
-
-				real_type mod_Vgj_w		= this->mod_v_drift_flux( 
-					p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-					0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-					);
-
-                real_type gas_velocity_w = p_velocityW + 0.5*(rhoL_W + rhoL_P)/(0.5*(rho_W + rho_P))*mod_Vgj_w;
-                real_type gas_velocity_e = p_velocityP + 0.5*(rhoL_P + rhoL_E)/(0.5*(rho_P + rho_E))*mod_Vgj_e;
-
-				real_type ksi_e = this->ksi( gas_velocity_e );
-				real_type ksi_w = this->ksi( gas_velocity_w );
-                return (p_gas_vol_fracP*rhoG_P - m_gas_vol_frac_old[ p_node ]*rhoG_P_old)*dV/dt() - gas_inlet
-                    + gas_velocity_e*area()*( (0.5+ksi_e)*rhoG_P*p_gas_vol_fracP + (0.5-ksi_e)*rhoG_E*p_gas_vol_fracE )
-                    - gas_velocity_w*area()*( (0.5+ksi_w)*rhoG_W*p_gas_vol_fracW + (0.5-ksi_w)*rhoG_P*p_gas_vol_fracP );
-                   
-			/*return (p_gas_vol_fracP*rhoG_P - m_gas_vol_frac_old[ p_node ]*rhoG_P_old)*dV/dt() - gas_inlet
-				 + p_velocityP*area()*( (0.5+ksi_e)*rhoG_P*p_gas_vol_fracP + (0.5-ksi_e)*rhoG_E*p_gas_vol_fracE )
-				 - p_velocityW*area()*( (0.5+ksi_w)*rhoG_W*p_gas_vol_fracW + (0.5-ksi_w)*rhoG_P*p_gas_vol_fracP )
-				 + mod_Vgj_e*area()*( (0.5+ksi_e)*rhoG_P*rhoL_P/rho_P * p_gas_vol_fracP + (0.5-ksi_e)*rhoG_E*rhoL_E/rho_E * p_gas_vol_fracE )
-				 - mod_Vgj_w*area()*( (0.5+ksi_w)*rhoG_W*rhoL_W/rho_W * p_gas_vol_fracW + (0.5-ksi_w)*rhoG_P*rhoL_P/rho_P * p_gas_vol_fracP );*/
-			}
+		T outflow = last ? p_velocityP*rhoG_P*p_gas_vol_fracP : p_faces[ 1 ].gas;
 
-		default:
-			return 0.;
-			
-		}
+		return (p_gas_vol_fracP*rhoG_P - m_gas_vol_frac_old[ p_node ]*rhoG_P_old)*dV/dt() - gas_inlet
+			+ area()*( outflow - p_faces[ 0 ].gas );
 	}
 
 	real_type DriftFluxWell::R_o(
@@ -1046,187 +1664,51 @@ namespace WellSimulator {
 								 string_type	   position = 'C'
 								 )
 	{
-		switch( position )
-		{
-
-		case 'L':
-			{
-				real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
-				real_type dSe = 0.;
-				real_type dS  = dSw + dSe;
-				real_type dV = this->Volume( dS );
-
-				real_type water_vol_fracW	= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-				real_type water_vol_fracP	= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP); 
-                
-				real_type rho_P		= this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);	                
-				real_type rho_W		= this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW, p_pressureW);
-
-									
-				real_type rhoG_P		= this->gas_density( p_pressureP );			
-				real_type rhoG_W		= this->gas_density( p_pressureW );
-
-				real_type rhoW_P		= this->water_density( p_pressureP );			
-				real_type rhoW_W		= this->water_density( p_pressureW );
-
-				real_type rhoO_P_old	= this->oil_density( m_pressure_old[ p_node ] );	
-				real_type rhoO_P		= this->oil_density( p_pressureP );			
-				real_type rhoO_W		= this->oil_density( p_pressureW );
-
-				real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );			
-				real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-                
-                real_type oil_inlet;
-                real_type Qoil = m_oil_flow[ p_node ]->get_current_value();
-                if(m_mass_flux){
-                    oil_inlet = Qoil;
-                }                      
-                else
-                {
-                    oil_inlet = rhoO_P*Qoil;
-                }
-				
-
-				real_type mod_Vow_w	= this->mod_v_drift_flux_ow( 
-					p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-					0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-					);
-               
-
-				real_type mod_Vgj_w	= this->mod_v_drift_flux( 
-					p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-					0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-					);
-
-				//real_type mod_Vgj_e	= this->mod_v_drift_flux(p_velocityP, p_gas_vol_fracP, p_oil_vol_fracP,	water_vol_fracP, p_pressureP);
-                real_type gas_vol_frac_w = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
-                real_type rho_g_w = 0.5*(rhoG_W + rhoG_P);
-                real_type rho_w_w = 0.5*(rhoW_W + rhoW_P);
-                real_type rho_l_w = 0.5*(rhoL_W + rhoL_P);
-                real_type rho_w = 0.5*(rho_W + rho_P);
-                real_type liquid_velocity_w = p_velocityW - gas_vol_frac_w/(1 - gas_vol_frac_w + 1.0e-20)*rho_g_w/rho_w*mod_Vgj_w;	 
-                
-                real_type oil_velocity_w = liquid_velocity_w + rho_w_w/rho_l_w*mod_Vow_w;               
-				real_type ksi_w = this->ksi( oil_velocity_w );
-
-                return (p_oil_vol_fracP*rhoO_P - m_oil_vol_frac_old[ p_node ]*rhoO_P_old)*dV/dt() - oil_inlet				 
-                    + p_velocityP*area()*rhoO_P*p_oil_vol_fracP 
-                    - oil_velocity_w*area()*( (0.5+ksi_w)*rhoO_W*p_oil_vol_fracW + (0.5-ksi_w)*rhoO_P*p_oil_vol_fracP );				 
-                                
-			//return (p_oil_vol_fracP*rhoO_P - m_oil_vol_frac_old[ p_node ]*rhoO_P_old)*dV/dt() - oil_inlet				 
-			//	 + p_velocityP*area()*rhoO_P*p_oil_vol_fracP 
-   //              - p_velocityW*area()*( (0.5+ksi_w)*rhoO_W*p_oil_vol_fracW + (0.5-ksi_w)*rhoO_P*p_oil_vol_fracP )				 
-			//	 - mod_Vow_w*area()*( rhoW_W/rhoL_W*(0.5+ksi_w)*rhoO_W*p_oil_vol_fracW + rhoW_P/rhoL_P*(0.5-ksi_w)*rhoO_P*p_oil_vol_fracP )	
-			//	 //- mod_Vgj_e*area()*( rhoG_P/rho_P*p_gas_vol_fracP/(1.0-p_gas_vol_fracP + 1.0e-20)*rhoO_P*p_oil_vol_fracP )
-			//	 + mod_Vgj_w*area()*( rhoG_W/rho_W*p_gas_vol_fracW/(1.0-p_gas_vol_fracW + 1.0e-20)*(0.5+ksi_w)*rhoO_W*p_oil_vol_fracW 
-			//						+ rhoG_P/rho_P*p_gas_vol_fracP/(1.0-p_gas_vol_fracP + 1.0e-20)*(0.5-ksi_w)*rhoO_P*p_oil_vol_fracP );
-			
-			}
-			
+		FaceFluxes<real_type> faces[ 2 ];
+		this->do_node_face_fluxes<real_type>(
+			p_pressureW, p_pressureP, p_pressureE,
+			p_gas_vol_fracW, p_gas_vol_fracP, p_gas_vol_fracE,
+			p_oil_vol_fracW, p_oil_vol_fracP, p_oil_vol_fracE,
+			p_velocityW, p_velocityP,
+			p_node, position, faces
+			);
+		return this->do_R_o<real_type>( p_pressureP, p_gas_vol_fracP, p_oil_vol_fracP, p_velocityP, faces, p_node, position );
+	}
 
-		case 'C':
-			{
-				real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
-				real_type dSe = 0.5*this->segment_length( m_coordinates[ p_node ], m_coordinates[ p_node+1 ] );
-				real_type dS  = dSw + dSe;
-				real_type dV  = this->Volume( dS );	
-
-				real_type water_vol_fracW	= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-				real_type water_vol_fracP	= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
-				real_type water_vol_fracE	= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);
-
-				real_type rho_P		= this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);	
-				real_type rho_E		= this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
-				real_type rho_W		= this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW, p_pressureW);
-								
-				real_type rhoG_P		= this->gas_density( p_pressureP );
-				real_type rhoG_E		= this->gas_density( p_pressureE );
-				real_type rhoG_W		= this->gas_density( p_pressureW );
-
-				real_type rhoW_P		= this->water_density( p_pressureP );
-				real_type rhoW_E		= this->water_density( p_pressureE );
-				real_type rhoW_W		= this->water_density( p_pressureW );
-
-				real_type rhoO_P_old	= this->oil_density( m_pressure_old[ p_node ] );	
-				real_type rhoO_P		= this->oil_density( p_pressureP );
-				real_type rhoO_E		= this->oil_density( p_pressureE );
-				real_type rhoO_W		= this->oil_density( p_pressureW );
-
-				real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
-				real_type rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
-				real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-
-                real_type oil_inlet;
-                real_type Qoil = m_oil_flow[ p_node ]->get_current_value();
-                if(m_mass_flux){
-                    oil_inlet = Qoil;
-                }                      
-                else
-                {
-                    oil_inlet = rhoO_P*Qoil;
-                }
+	template <class T>
+	T DriftFluxWell::do_R_o(
+								 T p_pressureP,
+								 T /*p_gas_vol_fracP*/,
+								 T p_oil_vol_fracP,
+								 T p_velocityP,
+								 const FaceFluxes<T> p_faces[],
+								 uint_type p_node,
+								 string_type	   position
+								 )
+	{
+		bool last = ( position == 'L' );
+		real_type dSw = 0.5*this->segment_length( m_coordinates[ p_node-1 ], m_coordinates[ p_node ] );
+		real_type dSe = last ? 0. : 0.5*this->segment_length( m_coordinates[ p_node ], m_coordinates[ p_node+1 ] );
+		real_type dS  = dSw + dSe;
+		real_type dV  = this->Volume( dS );	
+
+		real_type rhoO_P_old	= this->oil_density( m_pressure_old[ p_node ] );	
+		T rhoO_P		= this->oil_density( p_pressureP, p_node );
+
+		T oil_inlet;
+		real_type Qoil = m_oil_flow[ p_node ]->get_current_value();
+		if(m_mass_flux){
+			oil_inlet = Qoil;
+		}                      
+		else
+		{
+			oil_inlet = rhoO_P*Qoil;
+		}
 
-				real_type mod_Vow_e	= this->mod_v_drift_flux_ow( 
-					p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-					0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
-					);
-
-				real_type mod_Vow_w	= this->mod_v_drift_flux_ow( 
-					p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-					0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-					);
-
-				real_type mod_Vgj_e		= this->mod_v_drift_flux( 
-					p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-					0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
-					);
-
-				real_type mod_Vgj_w		= this->mod_v_drift_flux( 
-					p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-					0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-					);
-
-                real_type gas_vol_frac_w = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
-                real_type rho_g_w = 0.5*(rhoG_W + rhoG_P);
-                real_type rho_w_w = 0.5*(rhoW_W + rhoW_P);
-                real_type rho_l_w = 0.5*(rhoL_W + rhoL_P);
-                real_type rho_w = 0.5*(rho_W + rho_P);
-                real_type liquid_velocity_w = p_velocityW - gas_vol_frac_w/(1 - gas_vol_frac_w + 1.0e-20)*rho_g_w/rho_w*mod_Vgj_w;	 
-
-                real_type oil_velocity_w = liquid_velocity_w + rho_w_w/rho_l_w*mod_Vow_w;  
-
-                real_type gas_vol_frac_e = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE);
-                real_type rho_g_e = 0.5*(rhoG_E + rhoG_P);
-                real_type rho_w_e = 0.5*(rhoW_E + rhoW_P);
-                real_type rho_l_e = 0.5*(rhoL_E + rhoL_P);
-                real_type rho_e = 0.5*(rho_E + rho_P);
-                real_type liquid_velocity_e = p_velocityP - gas_vol_frac_e/(1 - gas_vol_frac_e + 1.0e-20)*rho_g_e/rho_e*mod_Vgj_e;	 
-
-                real_type oil_velocity_e = liquid_velocity_e + rho_w_e/rho_l_e*mod_Vow_e;  
-                
-				real_type ksi_e = this->ksi( oil_velocity_e );
-				real_type ksi_w = this->ksi( oil_velocity_w );
-
-                return (p_oil_vol_fracP*rhoO_P - m_oil_vol_frac_old[ p_node ]*rhoO_P_old)*dV/dt() - oil_inlet
-                    + oil_velocity_e*area()*( (0.5+ksi_e)*rhoO_P*p_oil_vol_fracP + (0.5-ksi_e)*rhoO_E*p_oil_vol_fracE )
-                    - oil_velocity_w*area()*( (0.5+ksi_w)*rhoO_W*p_oil_vol_fracW + (0.5-ksi_w)*rhoO_P*p_oil_vol_fracP );
-                    
-               
-			/*return (p_oil_vol_fracP*rhoO_P - m_oil_vol_frac_old[ p_node ]*rhoO_P_old)*dV/dt() - oil_inlet
-				 + p_velocityP*area()*( (0.5+ksi_e)*rhoO_P*p_oil_vol_fracP + (0.5-ksi_e)*rhoO_E*p_oil_vol_fracE )
-				 - p_velocityW*area()*( (0.5+ksi_w)*rhoO_W*p_oil_vol_fracW + (0.5-ksi_w)*rhoO_P*p_oil_vol_fracP )
-				 + mod_Vow_e*area()*( rhoW_P/rhoL_P*(0.5+ksi_e)*rhoO_P*p_oil_vol_fracP + rhoW_E/rhoL_E*(0.5-ksi_e)*rhoO_E*p_oil_vol_fracE )
-				 - mod_Vow_w*area()*( rhoW_W/rhoL_W*(0.5+ksi_w)*rhoO_W*p_oil_vol_fracW + rhoW_P/rhoL_P*(0.5-ksi_w)*rhoO_P*p_oil_vol_fracP )
-				 - mod_Vgj_e*area()*( rhoG_P/rho_P*p_gas_vol_fracP/(1.0-p_gas_vol_fracP + 1.0e-20)*(0.5+ksi_e)*rhoO_P*p_oil_vol_fracP 
-									+ rhoG_E/rho_E*p_gas_vol_fracE/(1.0-p_gas_vol_fracE + 1.0e-20)*(0.5-ksi_e)*rhoO_E*p_oil_vol_fracE )
-				 + mod_Vgj_w*area()*( rhoG_W/rho_W*p_gas_vol_fracW/(1.0-p_gas_vol_fracW + 1.0e-20)*(0.5+ksi_w)*rhoO_W*p_oil_vol_fracW 
-									+ rhoG_P/rho_P*p_gas_vol_fracP/(1.0-p_gas_vol_fracP + 1.0e-20)*(0.5-ksi_w)*rhoO_P*p_oil_vol_fracP );*/
-			}
+		T outflow = last ? p_velocityP*rhoO_P*p_oil_vol_fracP : p_faces[ 1 ].oil;
 
-		default:
-			return 0.;
-			
-		}
+		return (p_oil_vol_fracP*rhoO_P - m_oil_vol_frac_old[ p_node ]*rhoO_P_old)*dV/dt() - oil_inlet
+			+ area()*( outflow - p_faces[ 0 ].oil );
 	}
 
 	
@@ -1252,6 +1734,36 @@ namespace WellSimulator {
 								 uint_type p_node,
 								 string_type	   position = 'C'
 								 )
+	{
+		return this->do_R_v<real_type>(
+			p_pressureW, p_pressureP, p_pressureE, p_pressureEE,
+			p_gas_vol_fracW, p_gas_vol_fracP, p_gas_vol_fracE, p_gas_vol_fracEE,
+			p_oil_vol_fracW, p_oil_vol_fracP, p_oil_vol_fracE, p_oil_vol_fracEE,
+			p_velocityW, p_velocityP, p_velocityE,
+			p_node, position
+			);
+	}
+
+	template <class T>
+	T DriftFluxWell::do_R_v(
+                                 T p_pressureW,
+								 T p_pressureP,
+								 T p_pressureE,
+                                 T p_pressureEE,
+                                 T p_gas_vol_fracW,
+								 T p_gas_vol_fracP,
+								 T p_gas_vol_fracE,
+                                 T p_gas_vol_fracEE,
+                                 T p_oil_vol_fracW,
+								 T p_oil_vol_fracP,
+								 T p_oil_vol_fracE,
+                                 T p_oil_vol_fracEE,
+								 T p_velocityW,
+								 T p_velocityP,
+								 T p_velocityE,
+								 uint_type p_node,
+								 string_type	   position
+								 )
 	{		
 		switch( position )
 		{
@@ -1259,148 +1771,110 @@ namespace WellSimulator {
 			{
 			real_type dS  = this->segment_length( m_coordinates[ p_node ], m_coordinates[ p_node+1 ] );
 			real_type dSe = this->segment_length( m_coordinates[ p_node+1 ], m_coordinates[ p_node+2 ] );
-			real_type dSw = 0.;
 			real_type dV = this->Volume( dS );
 
 			
 			real_type water_vol_fracP_old	= 1.0 - (m_oil_vol_frac_old[ p_node ]   + m_gas_vol_frac_old[ p_node ]	);
 			real_type water_vol_fracE_old	= 1.0 - (m_oil_vol_frac_old[ p_node+1 ] + m_gas_vol_frac_old[ p_node+1 ]);
-            real_type water_vol_fracW		= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-            real_type water_vol_fracP		= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
-            real_type water_vol_fracE		= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);	
-            real_type water_vol_fracEE		= 1.0 - (p_gas_vol_fracEE + p_oil_vol_fracEE);
+            T water_vol_fracP		= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
+            T water_vol_fracE		= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);	
+            T water_vol_fracEE		= 1.0 - (p_gas_vol_fracEE + p_oil_vol_fracEE);
 
 			real_type rho_P_old = this->mean_density(m_oil_vol_frac_old[ p_node ], water_vol_fracP_old, m_gas_vol_frac_old[ p_node ], m_pressure_old[ p_node ]);
 			real_type rho_E_old = this->mean_density(m_oil_vol_frac_old[ p_node+1 ], water_vol_fracE_old, m_gas_vol_frac_old[ p_node+1 ], m_pressure_old[ p_node+1 ]);
 
-			vector_type S( 3 );
-			S[ 0 ] = m_coordinates[ p_node ].getX() - m_coordinates[ p_node+1 ].getX();
-			S[ 1 ] = m_coordinates[ p_node ].getY() - m_coordinates[ p_node+1 ].getY();
-			S[ 2 ] = m_coordinates[ p_node ].getZ() - m_coordinates[ p_node+1 ].getZ();
-
 			real_type d_e = dS/(dS+dSe);
-			real_type d_w = dS/(dS+dSw);
 						
 			real_type angle = get_inclination() - PI/2;//PI/2 - 0*acos( dot( m_gravity, S )/(norm(m_gravity)*norm(S)) );
 			
-            real_type rho_W   = this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW , p_pressureW );
-            real_type rho_P   = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);
-            real_type rho_E   = this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
-            real_type rho_EE  = this->mean_density(p_oil_vol_fracEE, water_vol_fracEE, p_gas_vol_fracEE , p_pressureEE);
-
-            real_type rhoG_W		= this->gas_density( p_pressureW );
-            real_type rhoG_P		= this->gas_density( p_pressureP );
-            real_type rhoG_E		= this->gas_density( p_pressureE );
-            real_type rhoG_EE		= this->gas_density( p_pressureEE );
-
-            real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-            real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
-            real_type rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
-            real_type rhoL_EE		= this->liquid_density( p_oil_vol_fracEE, water_vol_fracEE, p_pressureEE );
-
-            real_type rhoW_W		= this->water_density( p_pressureW );
-            real_type rhoW_P		= this->water_density( p_pressureP );
-            real_type rhoW_E		= this->water_density( p_pressureE );
-            real_type rhoW_EE		= this->water_density( p_pressureEE );
-
-            real_type rhoO_W		= this->oil_density( p_pressureW );
-            real_type rhoO_P		= this->oil_density( p_pressureP );
-            real_type rhoO_E		= this->oil_density( p_pressureE );
-            real_type rhoO_EE		= this->oil_density( p_pressureEE ); 
+            T rho_P   = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);
+            T rho_E   = this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
+            T rho_EE  = this->mean_density(p_oil_vol_fracEE, water_vol_fracEE, p_gas_vol_fracEE , p_pressureEE);
+
+            T rhoG_P		= this->gas_density( p_pressureP, p_node );
+            T rhoG_E		= this->gas_density( p_pressureE, p_node+1 );
+            T rhoG_EE		= this->gas_density( p_pressureEE, p_node+2 );
+
+            T rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
+            T rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
+            T rhoL_EE		= this->liquid_density( p_oil_vol_fracEE, water_vol_fracEE, p_pressureEE );
+
+            T rhoW_P		= this->water_density( p_pressureP, p_node );
+            T rhoW_E		= this->water_density( p_pressureE, p_node+1 );
+            T rhoW_EE		= this->water_density( p_pressureEE, p_node+2 );
+
+            T rhoO_P		= this->oil_density( p_pressureP, p_node );
+            T rhoO_E		= this->oil_density( p_pressureE, p_node+1 );
+            T rhoO_EE		= this->oil_density( p_pressureEE, p_node+2 ); 
 			
-			real_type mean_pressure = 0.5*(p_pressureP + p_pressureE);
-			real_type viscosity = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE)*gas_viscosity	 ( mean_pressure ) 
-								+ 0.5*(p_oil_vol_fracP + p_oil_vol_fracE)*oil_viscosity	 ( mean_pressure ) 
-								+ 0.5*(water_vol_fracP + water_vol_fracE)*water_viscosity( mean_pressure );
+			T mean_pressure = 0.5*(p_pressureP + p_pressureE);
+			T viscosity = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE)*gas_viscosity	 ( mean_pressure, p_node ) 
+								+ 0.5*(p_oil_vol_fracP + p_oil_vol_fracE)*oil_viscosity	 ( mean_pressure, p_node ) 
+								+ 0.5*(water_vol_fracP + water_vol_fracE)*water_viscosity( mean_pressure, p_node );
 
 
-            real_type mod_Vow_W	= this->mod_v_drift_flux_ow( 
-                p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-                );
-            real_type mod_Vow_P	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_P	= this->mod_v_drift_flux_ow( 
                 p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
+                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE), p_node
                 );
-            real_type mod_Vow_E	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_E	= this->mod_v_drift_flux_ow( 
                 p_velocityE, 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE), 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE),
-                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE)
+                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE), p_node+1
                 );
 
-            real_type mod_Vgj_W	= this->mod_v_drift_flux( 
-                p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
-                );
-            real_type mod_Vgj_P	= this->mod_v_drift_flux( 
+            T mod_Vgj_P	= this->mod_v_drift_flux( 
                 p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
+                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE), p_node
                 );
-            real_type mod_Vgj_E	= this->mod_v_drift_flux( 
+            T mod_Vgj_E	= this->mod_v_drift_flux( 
                 p_velocityE, 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE), 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE),
-                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE)
+                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE), p_node+1
                 );
 
 
-            //real_type Vc  = p_velocityP;			
-            //real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2*m_radius/viscosity);
-            //real_type f_P = this->friction_factor( Re );
+            //T Vc  = p_velocityP;			
+            //T Re  = abs(0.5*(rho_P + rho_E)*Vc*2*m_radius/viscosity);
+            //T f_P = this->friction_factor( Re );
 
             // OTHER Vc = j
-            real_type Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
-            real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
-            real_type f_P = this->friction_factor( Re );
-
+            T Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
+            T Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
+            T f_P = this->friction_factor( Re );
 
-            real_type gas_vol_frac_W   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
-            real_type oil_vol_frac_W   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracW);
-            real_type water_vol_frac_W = 0.5*(water_vol_fracP + water_vol_fracW);
-            real_type rho_g_W = 0.5*(rhoG_W + rhoG_P);
-            real_type rho_o_W = 0.5*(rhoO_W + rhoO_P);
-            real_type rho_w_W = 0.5*(rhoW_W + rhoW_P);
-            real_type rho_l_W = 0.5*(rhoL_W + rhoL_P);
-            real_type rho_m_W = 0.5*(rho_W + rho_P);
 
-            real_type gas_velocity_W    = p_velocityW + rho_l_W/rho_g_W*mod_Vgj_W;
-            real_type liquid_velocity_W = p_velocityW - gas_vol_frac_W/(1 - gas_vol_frac_W + 1.0e-20)*rho_g_W/rho_m_W*mod_Vgj_W;	 
-            real_type water_velocity_W  = liquid_velocity_W - (oil_vol_frac_W/(water_vol_frac_W + 1.0e-20))*(rho_o_W/rho_l_W)*mod_Vow_W;               
-            real_type oil_velocity_W    = liquid_velocity_W + rho_w_W/rho_l_W*mod_Vow_W;  
 
 
 
-            real_type gas_vol_frac_P   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE);
-            real_type oil_vol_frac_P   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracE);
-            real_type water_vol_frac_P = 0.5*(water_vol_fracP + water_vol_fracE);
-            real_type rho_g_P = 0.5*(rhoG_E + rhoG_P);
-            real_type rho_o_P = 0.5*(rhoO_E + rhoO_P);
-            real_type rho_w_P = 0.5*(rhoW_E + rhoW_P);
-            real_type rho_l_P = 0.5*(rhoL_E + rhoL_P);
-            real_type rho_m_P = 0.5*(rho_E + rho_P);
+            T gas_vol_frac_P   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE);
+            T oil_vol_frac_P   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracE);
+            T water_vol_frac_P = 0.5*(water_vol_fracP + water_vol_fracE);
+            T rho_g_P = 0.5*(rhoG_E + rhoG_P);
+            T rho_o_P = 0.5*(rhoO_E + rhoO_P);
+            T rho_w_P = 0.5*(rhoW_E + rhoW_P);
+            T rho_l_P = 0.5*(rhoL_E + rhoL_P);
+            T rho_m_P = 0.5*(rho_E + rho_P);
 
-            real_type gas_velocity_P    = p_velocityP + rho_l_P/rho_g_P*mod_Vgj_P;
-            real_type liquid_velocity_P = p_velocityP - gas_vol_frac_P/(1 - gas_vol_frac_P + 1.0e-20)*rho_g_P/rho_m_P*mod_Vgj_P;	 
-            real_type water_velocity_P  = liquid_velocity_P - (oil_vol_frac_P/(water_vol_frac_P + 1.0e-20))*(rho_o_P/rho_l_P)*mod_Vow_P;               
-            real_type oil_velocity_P    = liquid_velocity_P + rho_w_P/rho_l_P*mod_Vow_P;
+            T gas_velocity_P    = p_velocityP + rho_l_P/rho_g_P*mod_Vgj_P;
+            T liquid_velocity_P = p_velocityP - gas_vol_frac_P/(1 - gas_vol_frac_P + 1.0e-20)*rho_g_P/rho_m_P*mod_Vgj_P;	 
+            T water_velocity_P  = liquid_velocity_P - (oil_vol_frac_P/(water_vol_frac_P + 1.0e-20))*(rho_o_P/rho_l_P)*mod_Vow_P;               
+            T oil_velocity_P    = liquid_velocity_P + rho_w_P/rho_l_P*mod_Vow_P;
 
-            real_type gas_vol_frac_E   = 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE);
-            real_type oil_vol_frac_E   = 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE);
-            real_type water_vol_frac_E = 0.5*(water_vol_fracE + water_vol_fracEE);
-            real_type rho_g_E = 0.5*(rhoG_E + rhoG_EE);
-            real_type rho_o_E = 0.5*(rhoO_E + rhoO_EE);
-            real_type rho_w_E = 0.5*(rhoW_E + rhoW_EE);
-            real_type rho_l_E = 0.5*(rhoL_E + rhoL_EE);
-            real_type rho_m_E = 0.5*(rho_E + rho_EE);
+            T gas_vol_frac_E   = 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE);
+            T oil_vol_frac_E   = 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE);
+            T water_vol_frac_E = 0.5*(water_vol_fracE + water_vol_fracEE);
+            T rho_g_E = 0.5*(rhoG_E + rhoG_EE);
+            T rho_o_E = 0.5*(rhoO_E + rhoO_EE);
+            T rho_w_E = 0.5*(rhoW_E + rhoW_EE);
+            T rho_l_E = 0.5*(rhoL_E + rhoL_EE);
+            T rho_m_E = 0.5*(rho_E + rho_EE);
 
-            real_type gas_velocity_E    = p_velocityE + rho_l_E/rho_g_E*mod_Vgj_E;
-            real_type liquid_velocity_E = p_velocityE - gas_vol_frac_E/(1 - gas_vol_frac_E + 1.0e-20)*rho_g_E/rho_m_E*mod_Vgj_E;	 
-            real_type water_velocity_E  = liquid_velocity_E - (oil_vol_frac_E/(water_vol_frac_E + 1.0e-20))*(rho_o_E/rho_l_E)*mod_Vow_E;               
-            real_type oil_velocity_E    = liquid_velocity_E + rho_w_E/rho_l_E*mod_Vow_E;
+            T gas_velocity_E    = p_velocityE + rho_l_E/rho_g_E*mod_Vgj_E;
+            T liquid_velocity_E = p_velocityE - gas_vol_frac_E/(1 - gas_vol_frac_E + 1.0e-20)*rho_g_E/rho_m_E*mod_Vgj_E;	 
+            T water_velocity_E  = liquid_velocity_E - (oil_vol_frac_E/(water_vol_frac_E + 1.0e-20))*(rho_o_E/rho_l_E)*mod_Vow_E;               
+            T oil_velocity_E    = liquid_velocity_E + rho_w_E/rho_l_E*mod_Vow_E;
 
 
 
-            real_type ksi_W_oil     = this->ksi( oil_velocity_W   );
-            real_type ksi_W_gas     = this->ksi( gas_velocity_W   );
-            real_type ksi_W_water   = this->ksi( water_velocity_W );
-
             real_type ksi_P_oil     = this->ksi( oil_velocity_P   );
             real_type ksi_P_gas     = this->ksi( gas_velocity_P   );
             real_type ksi_P_water   = this->ksi( water_velocity_P );
@@ -1409,35 +1883,28 @@ namespace WellSimulator {
             real_type ksi_E_gas     = this->ksi( gas_velocity_E   );
             real_type ksi_E_water   = this->ksi( water_velocity_E );
 
-            real_type m_W_oil   = oil_velocity_W  *( (0.5+ksi_W_oil  )*rhoO_W*p_oil_vol_fracW + (0.5-ksi_W_oil  )*rhoO_P*p_oil_vol_fracP );
-            real_type m_W_water = water_velocity_W*( (0.5+ksi_W_water)*rhoW_W*water_vol_fracW + (0.5-ksi_W_water)*rhoW_P*water_vol_fracP );
-            real_type m_W_gas   = gas_velocity_W  *( (0.5+ksi_W_gas  )*rhoG_W*p_gas_vol_fracW + (0.5-ksi_W_gas  )*rhoG_P*p_gas_vol_fracP );
-
-            real_type m_P_oil   = oil_velocity_P  *( (0.5+ksi_P_oil  )*rhoO_P*p_oil_vol_fracP + (0.5-ksi_P_oil  )*rhoO_E*p_oil_vol_fracE );
-            real_type m_P_water = water_velocity_P*( (0.5+ksi_P_water)*rhoW_P*water_vol_fracP + (0.5-ksi_P_water)*rhoW_E*water_vol_fracE );
-            real_type m_P_gas   = gas_velocity_P  *( (0.5+ksi_P_gas  )*rhoG_P*p_gas_vol_fracP + (0.5-ksi_P_gas  )*rhoG_E*p_gas_vol_fracE );
+            T m_P_oil   = oil_velocity_P  *( (0.5+ksi_P_oil  )*rhoO_P*p_oil_vol_fracP + (0.5-ksi_P_oil  )*rhoO_E*p_oil_vol_fracE );
+            T m_P_water = water_velocity_P*( (0.5+ksi_P_water)*rhoW_P*water_vol_fracP + (0.5-ksi_P_water)*rhoW_E*water_vol_fracE );
+            T m_P_gas   = gas_velocity_P  *( (0.5+ksi_P_gas  )*rhoG_P*p_gas_vol_fracP + (0.5-ksi_P_gas  )*rhoG_E*p_gas_vol_fracE );
 
-            real_type m_E_oil   = oil_velocity_E  *( (0.5+ksi_E_oil  )*rhoO_P*p_oil_vol_fracE + (0.5-ksi_E_oil  )*rhoO_E*p_oil_vol_fracEE );
-            real_type m_E_water = water_velocity_E*( (0.5+ksi_E_water)*rhoW_P*water_vol_fracE + (0.5-ksi_E_water)*rhoW_E*water_vol_fracEE );
-            real_type m_E_gas   = gas_velocity_E  *( (0.5+ksi_E_gas  )*rhoG_P*p_gas_vol_fracE + (0.5-ksi_E_gas  )*rhoG_E*p_gas_vol_fracEE );
+            T m_E_oil   = oil_velocity_E  *( (0.5+ksi_E_oil  )*rhoO_P*p_oil_vol_fracE + (0.5-ksi_E_oil  )*rhoO_E*p_oil_vol_fracEE );
+            T m_E_water = water_velocity_E*( (0.5+ksi_E_water)*rhoW_P*water_vol_fracE + (0.5-ksi_E_water)*rhoW_E*water_vol_fracEE );
+            T m_E_gas   = gas_velocity_E  *( (0.5+ksi_E_gas  )*rhoG_P*p_gas_vol_fracE + (0.5-ksi_E_gas  )*rhoG_E*p_gas_vol_fracEE );
 
             real_type ksi_e_oil = this->ksi( (1-d_e)*oil_velocity_P + d_e*oil_velocity_E );
-            real_type ksi_w_oil = this->ksi( (1-d_w)*oil_velocity_P + d_w*oil_velocity_W );
             real_type ksi_e_water = this->ksi( (1-d_e)*water_velocity_P + d_e*water_velocity_E );
-            real_type ksi_w_water = this->ksi( (1-d_w)*water_velocity_P + d_w*water_velocity_W );
             real_type ksi_e_gas = this->ksi( (1-d_e)*gas_velocity_P + d_e*gas_velocity_E );
-            real_type ksi_w_gas = this->ksi( (1-d_w)*gas_velocity_P + d_w*gas_velocity_W );
 
-            real_type m_e = 0.5*(m_E_oil  +m_P_oil)  *( (0.5+ksi_e_oil  )*oil_velocity_P   + (0.5-ksi_e_oil  )*oil_velocity_E )
+            T m_e = 0.5*(m_E_oil  +m_P_oil)  *( (0.5+ksi_e_oil  )*oil_velocity_P   + (0.5-ksi_e_oil  )*oil_velocity_E )
                           + 0.5*(m_E_water+m_P_water)*( (0.5+ksi_e_water)*water_velocity_P + (0.5-ksi_e_water)*water_velocity_E )
                           + 0.5*(m_E_gas  +m_P_gas)  *( (0.5+ksi_e_gas  )*gas_velocity_P   + (0.5-ksi_e_gas  )*gas_velocity_E );
 
-            /*real_type m_w = 0.5*(m_W_oil  +m_P_oil)  *( (0.5+ksi_w_oil  )*oil_velocity_W   + (0.5-ksi_w_oil  )*oil_velocity_P )
+            /*T m_w = 0.5*(m_W_oil  +m_P_oil)  *( (0.5+ksi_w_oil  )*oil_velocity_W   + (0.5-ksi_w_oil  )*oil_velocity_P )
                           + 0.5*(m_W_water+m_P_water)*( (0.5+ksi_w_water)*water_velocity_W + (0.5-ksi_w_water)*water_velocity_P )
                           + 0.5*(m_W_gas  +m_P_gas)  *( (0.5+ksi_w_gas  )*gas_velocity_W   + (0.5-ksi_w_gas  )*gas_velocity_P ); */ 
-            real_type m_w = m_P_oil*oil_velocity_P +m_P_water*water_velocity_P + m_P_gas*gas_velocity_P ; 
+            T m_w = m_P_oil*oil_velocity_P +m_P_water*water_velocity_P + m_P_gas*gas_velocity_P ; 
 
-            real_type m_t =  oil_velocity_P  *(rhoO_P*p_oil_vol_fracP + rhoO_E*p_oil_vol_fracE)
+            T m_t =  oil_velocity_P  *(rhoO_P*p_oil_vol_fracP + rhoO_E*p_oil_vol_fracE)
                           +  water_velocity_P*(rhoW_P*water_vol_fracP + rhoW_E*water_vol_fracE)
                           +  gas_velocity_P  *(rhoG_P*p_gas_vol_fracP + rhoG_E*p_gas_vol_fracE);
 
@@ -1450,30 +1917,30 @@ namespace WellSimulator {
 
             // New friction factor wells
             //OUYANG
-            //real_type q_w = ((*m_oil_flow)[ p_node ] + (*m_gas_flow)[ p_node ] + (*m_water_flow)[ p_node ])/dS;
-            //real_type v_eq = q_w/(PI*2*m_radius);
-            //real_type Re_w = abs(0.5*(rho_P + rho_E)*v_eq*2*m_radius/viscosity);
-			//real_type f_P = this->friction_factor( Re )*(1+0.04304*pow(Re_w,0.6142));
+            //T q_w = ((*m_oil_flow)[ p_node ] + (*m_gas_flow)[ p_node ] + (*m_water_flow)[ p_node ])/dS;
+            //T v_eq = q_w/(PI*2*m_radius);
+            //T Re_w = abs(0.5*(rho_P + rho_E)*v_eq*2*m_radius/viscosity);
+			//T f_P = this->friction_factor( Re )*(1+0.04304*pow(Re_w,0.6142));
             // ASHEIM
-            //real_type q_m = p_velocityP*area();
-            //real_type q_i = ((*m_oil_flow)[ p_node ] + (*m_gas_flow)[ p_node ] + (*m_water_flow)[ p_node ]);
-            //real_type f_complet = q_m == 0? 0.0 : 4*2*m_radius*q_i/dS/q_m + 2*m_radius*q_i/dS/q_m*q_i/dS/q_m;
-            //real_type f_P = this->friction_factor( Re ) + f_complet;
+            //T q_m = p_velocityP*area();
+            //T q_i = ((*m_oil_flow)[ p_node ] + (*m_gas_flow)[ p_node ] + (*m_water_flow)[ p_node ]);
+            //T f_complet = q_m == 0? 0.0 : 4*2*m_radius*q_i/dS/q_m + 2*m_radius*q_i/dS/q_m*q_i/dS/q_m;
+            //T f_P = this->friction_factor( Re ) + f_complet;
             
 
-			//real_type mod_Vgj_P		= this->mod_v_drift_flux( 
+			//T mod_Vgj_P		= this->mod_v_drift_flux( 
 			//												 (1-d_w)*p_velocityP + d_w*p_velocityW, p_gas_vol_fracP, p_oil_vol_fracP,
 			//												 water_vol_fracP, p_pressureP
 			//												 );
-			//real_type mod_Vgj_E		= this->mod_v_drift_flux( 
+			//T mod_Vgj_E		= this->mod_v_drift_flux( 
 			//												 (1-d_e)*p_velocityP + d_e*p_velocityE, p_gas_vol_fracE, p_oil_vol_fracE,
 			//												 water_vol_fracE, p_pressureE
 			//												 );
 
 			//// OTHER Vc = j
-			////real_type Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
-			////real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2*m_radius/viscosity);
-			////real_type f_P = this->friction_factor( Re );
+			////T Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
+			////T Re  = abs(0.5*(rho_P + rho_E)*Vc*2*m_radius/viscosity);
+			////T f_P = this->friction_factor( Re );
 
 			//real_type ksi_e = this->ksi( (1-d_e)*p_velocityP + d_e*p_velocityE );
 			//real_type ksi_w = this->ksi( (1-d_w)*p_velocityP + d_w*p_velocityW );
@@ -1489,9 +1956,9 @@ namespace WellSimulator {
 			//real_type ksi_E = this->ksi( p_velocityE );
 			//real_type ksi_P = this->ksi( p_velocityP );			
 
-			//real_type m_E	= ((0.5+ksi_E)*rho_E + (0.5-ksi_E)*rho_EE )*p_velocityE*area();
-			//real_type m_P	= ((0.5+ksi_P)*rho_P + (0.5-ksi_P)*rho_E  )*p_velocityP*area();
-			//real_type m_W	= rho_P*p_velocityP*area();
+			//T m_E	= ((0.5+ksi_E)*rho_E + (0.5-ksi_E)*rho_EE )*p_velocityE*area();
+			//T m_P	= ((0.5+ksi_P)*rho_P + (0.5-ksi_P)*rho_E  )*p_velocityP*area();
+			//T m_W	= rho_P*p_velocityP*area();
 
 			//return ( (rho_P+rho_E)*p_velocityP - (rho_P_old+rho_E_old)*m_mean_velocity_old[ p_node ] )*0.5*dV/dt()
 			//	 + 0.5*(m_E+m_P)*( (0.5+ksi_e)*p_velocityP + (0.5-ksi_e)*p_velocityE )
@@ -1525,136 +1992,131 @@ namespace WellSimulator {
 
 			real_type water_vol_fracP_old	= 1.0 - (m_oil_vol_frac_old[ p_node ]   + m_gas_vol_frac_old[ p_node ]	);
 			real_type water_vol_fracE_old	= 1.0 - (m_oil_vol_frac_old[ p_node+1 ] + m_gas_vol_frac_old[ p_node+1 ]);
-            real_type water_vol_fracW		= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-            real_type water_vol_fracP		= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
-            real_type water_vol_fracE		= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);	
-            real_type water_vol_fracEE		= 1.0 - (p_gas_vol_fracEE + p_oil_vol_fracEE);		
+            T water_vol_fracW		= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
+            T water_vol_fracP		= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
+            T water_vol_fracE		= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);	
+            T water_vol_fracEE		= 1.0 - (p_gas_vol_fracEE + p_oil_vol_fracEE);		
 
 			real_type rho_P_old = this->mean_density(m_oil_vol_frac_old[ p_node ], water_vol_fracP_old, m_gas_vol_frac_old[ p_node ], m_pressure_old[ p_node ]);
 			real_type rho_E_old = this->mean_density(m_oil_vol_frac_old[ p_node+1 ], water_vol_fracE_old, m_gas_vol_frac_old[ p_node+1 ], m_pressure_old[ p_node+1 ]);
 
-			vector_type S( 3 );
-			S[ 0 ] = m_coordinates[ p_node ].getX() - m_coordinates[ p_node+1 ].getX();
-			S[ 1 ] = m_coordinates[ p_node ].getY() - m_coordinates[ p_node+1 ].getY();
-			S[ 2 ] = m_coordinates[ p_node ].getZ() - m_coordinates[ p_node+1 ].getZ();
-
 			real_type d_e = dS/(dS+dSe);
 			real_type d_w = dS/(dS+dSw);
 
 			real_type angle = get_inclination() - PI/2; //- 0*acos( dot( m_gravity, S )/(norm(m_gravity)*norm(S)) );						
 			
-            real_type rho_W   = this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW , p_pressureW );
-            real_type rho_P   = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);
-            real_type rho_E   = this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
-            real_type rho_EE  = this->mean_density(p_oil_vol_fracEE, water_vol_fracEE, p_gas_vol_fracEE , p_pressureEE);
-
-            real_type rhoG_W		= this->gas_density( p_pressureW );
-            real_type rhoG_P		= this->gas_density( p_pressureP );
-            real_type rhoG_E		= this->gas_density( p_pressureE );
-            real_type rhoG_EE		= this->gas_density( p_pressureEE );
-
-            real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-            real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
-            real_type rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
-            real_type rhoL_EE		= this->liquid_density( p_oil_vol_fracEE, water_vol_fracEE, p_pressureEE );
-
-            real_type rhoW_W		= this->water_density( p_pressureW );
-            real_type rhoW_P		= this->water_density( p_pressureP );
-            real_type rhoW_E		= this->water_density( p_pressureE );
-            real_type rhoW_EE		= this->water_density( p_pressureEE );
-
-            real_type rhoO_W		= this->oil_density( p_pressureW );
-            real_type rhoO_P		= this->oil_density( p_pressureP );
-            real_type rhoO_E		= this->oil_density( p_pressureE );
-            real_type rhoO_EE		= this->oil_density( p_pressureEE ); 
+            T rho_W   = this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW , p_pressureW );
+            T rho_P   = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);
+            T rho_E   = this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
+            T rho_EE  = this->mean_density(p_oil_vol_fracEE, water_vol_fracEE, p_gas_vol_fracEE , p_pressureEE);
+
+            T rhoG_W		= this->gas_density( p_pressureW, p_node-1 );
+            T rhoG_P		= this->gas_density( p_pressureP, p_node );
+            T rhoG_E		= this->gas_density( p_pressureE, p_node+1 );
+            T rhoG_EE		= this->gas_density( p_pressureEE, p_node+2 );
+
+            T rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
+            T rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
+            T rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
+            T rhoL_EE		= this->liquid_density( p_oil_vol_fracEE, water_vol_fracEE, p_pressureEE );
+
+            T rhoW_W		= this->water_density( p_pressureW, p_node-1 );
+            T rhoW_P		= this->water_density( p_pressureP, p_node );
+            T rhoW_E		= this->water_density( p_pressureE, p_node+1 );
+            T rhoW_EE		= this->water_density( p_pressureEE, p_node+2 );
+
+            T rhoO_W		= this->oil_density( p_pressureW, p_node-1 );
+            T rhoO_P		= this->oil_density( p_pressureP, p_node );
+            T rhoO_E		= this->oil_density( p_pressureE, p_node+1 );
+            T rhoO_EE		= this->oil_density( p_pressureEE, p_node+2 ); 
 			
-			real_type mean_pressure = 0.5*(p_pressureP + p_pressureE);
-			real_type viscosity = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE)*gas_viscosity	 ( mean_pressure ) 
-								+ 0.5*(p_oil_vol_fracP + p_oil_vol_fracE)*oil_viscosity	 ( mean_pressure ) 
-								+ 0.5*(water_vol_fracP + water_vol_fracE)*water_viscosity( mean_pressure );
+			T mean_pressure = 0.5*(p_pressureP + p_pressureE);
+			T viscosity = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE)*gas_viscosity	 ( mean_pressure, p_node ) 
+								+ 0.5*(p_oil_vol_fracP + p_oil_vol_fracE)*oil_viscosity	 ( mean_pressure, p_node ) 
+								+ 0.5*(water_vol_fracP + water_vol_fracE)*water_viscosity( mean_pressure, p_node );
 
 
-            real_type mod_Vow_W	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_W	= this->mod_v_drift_flux_ow( 
                 p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
+                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW), p_node-1
                 );
-            real_type mod_Vow_P	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_P	= this->mod_v_drift_flux_ow( 
                 p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
+                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE), p_node
                 );
-            real_type mod_Vow_E	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_E	= this->mod_v_drift_flux_ow( 
                 p_velocityE, 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE), 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE),
-                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE)
+                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE), p_node+1
                 );
 
-            real_type mod_Vgj_W	= this->mod_v_drift_flux( 
+            T mod_Vgj_W	= this->mod_v_drift_flux( 
                 p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
+                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW), p_node-1
                 );
-            real_type mod_Vgj_P	= this->mod_v_drift_flux( 
+            T mod_Vgj_P	= this->mod_v_drift_flux( 
                 p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
+                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE), p_node
                 );
-            real_type mod_Vgj_E	= this->mod_v_drift_flux( 
+            T mod_Vgj_E	= this->mod_v_drift_flux( 
                 p_velocityE, 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE), 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE),
-                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE)
+                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE), p_node+1
                 );
 
 
-            //real_type Vc  = p_velocityP;			
-            //real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
-            //real_type f_P = this->friction_factor( Re );
+            //T Vc  = p_velocityP;			
+            //T Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
+            //T f_P = this->friction_factor( Re );
 
             // OTHER Vc = j
-            real_type Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
-            real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
-            real_type f_P = this->friction_factor( Re );
+            T Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
+            T Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
+            T f_P = this->friction_factor( Re );
 
 
 
-            real_type gas_vol_frac_W   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
-            real_type oil_vol_frac_W   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracW);
-            real_type water_vol_frac_W = 0.5*(water_vol_fracP + water_vol_fracW);
-            real_type rho_g_W = 0.5*(rhoG_W + rhoG_P);
-            real_type rho_o_W = 0.5*(rhoO_W + rhoO_P);
-            real_type rho_w_W = 0.5*(rhoW_W + rhoW_P);
-            real_type rho_l_W = 0.5*(rhoL_W + rhoL_P);
-            real_type rho_m_W = 0.5*(rho_W + rho_P);
+            T gas_vol_frac_W   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
+            T oil_vol_frac_W   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracW);
+            T water_vol_frac_W = 0.5*(water_vol_fracP + water_vol_fracW);
+            T rho_g_W = 0.5*(rhoG_W + rhoG_P);
+            T rho_o_W = 0.5*(rhoO_W + rhoO_P);
+            T rho_w_W = 0.5*(rhoW_W + rhoW_P);
+            T rho_l_W = 0.5*(rhoL_W + rhoL_P);
+            T rho_m_W = 0.5*(rho_W + rho_P);
 
-            real_type gas_velocity_W    = p_velocityW + rho_l_W/rho_m_W*mod_Vgj_W;
-            real_type liquid_velocity_W = p_velocityW - gas_vol_frac_W/(1 - gas_vol_frac_W + 1.0e-20)*rho_g_W/rho_m_W*mod_Vgj_W;	 
-            real_type water_velocity_W  = liquid_velocity_W - (oil_vol_frac_W/(water_vol_frac_W + 1.0e-20))*(rho_o_W/rho_l_W)*mod_Vow_W;               
-            real_type oil_velocity_W    = liquid_velocity_W + rho_w_W/rho_l_W*mod_Vow_W;  
+            T gas_velocity_W    = p_velocityW + rho_l_W/rho_m_W*mod_Vgj_W;
+            T liquid_velocity_W = p_velocityW - gas_vol_frac_W/(1 - gas_vol_frac_W + 1.0e-20)*rho_g_W/rho_m_W*mod_Vgj_W;	 
+            T water_velocity_W  = liquid_velocity_W - (oil_vol_frac_W/(water_vol_frac_W + 1.0e-20))*(rho_o_W/rho_l_W)*mod_Vow_W;               
+            T oil_velocity_W    = liquid_velocity_W + rho_w_W/rho_l_W*mod_Vow_W;  
 
 
 
-            real_type gas_vol_frac_P   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE);
-            real_type oil_vol_frac_P   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracE);
-            real_type water_vol_frac_P = 0.5*(water_vol_fracP + water_vol_fracE);
-            real_type rho_g_P = 0.5*(rhoG_E + rhoG_P);
-            real_type rho_o_P = 0.5*(rhoO_E + rhoO_P);
-            real_type rho_w_P = 0.5*(rhoW_E + rhoW_P);
-            real_type rho_l_P = 0.5*(rhoL_E + rhoL_P);
-            real_type rho_m_P = 0.5*(rho_E + rho_P);
+            T gas_vol_frac_P   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE);
+            T oil_vol_frac_P   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracE);
+            T water_vol_frac_P = 0.5*(water_vol_fracP + water_vol_fracE);
+            T rho_g_P = 0.5*(rhoG_E + rhoG_P);
+            T rho_o_P = 0.5*(rhoO_E + rhoO_P);
+            T rho_w_P = 0.5*(rhoW_E + rhoW_P);
+            T rho_l_P = 0.5*(rhoL_E + rhoL_P);
+            T rho_m_P = 0.5*(rho_E + rho_P);
 
-            real_type gas_velocity_P    = p_velocityP + rho_l_P/rho_m_P*mod_Vgj_P;
-            real_type liquid_velocity_P = p_velocityP - gas_vol_frac_P/(1 - gas_vol_frac_P + 1.0e-20)*rho_g_P/rho_m_P*mod_Vgj_P;	 
-            real_type water_velocity_P  = liquid_velocity_P - (oil_vol_frac_P/(water_vol_frac_P + 1.0e-20))*(rho_o_P/rho_l_P)*mod_Vow_P;               
-            real_type oil_velocity_P    = liquid_velocity_P + rho_w_P/rho_l_P*mod_Vow_P;
+            T gas_velocity_P    = p_velocityP + rho_l_P/rho_m_P*mod_Vgj_P;
+            T liquid_velocity_P = p_velocityP - gas_vol_frac_P/(1 - gas_vol_frac_P + 1.0e-20)*rho_g_P/rho_m_P*mod_Vgj_P;	 
+            T water_velocity_P  = liquid_velocity_P - (oil_vol_frac_P/(water_vol_frac_P + 1.0e-20))*(rho_o_P/rho_l_P)*mod_Vow_P;               
+            T oil_velocity_P    = liquid_velocity_P + rho_w_P/rho_l_P*mod_Vow_P;
 
-            real_type gas_vol_frac_E   = 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE);
-            real_type oil_vol_frac_E   = 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE);
-            real_type water_vol_frac_E = 0.5*(water_vol_fracE + water_vol_fracEE);
-            real_type rho_g_E = 0.5*(rhoG_E + rhoG_EE);
-            real_type rho_o_E = 0.5*(rhoO_E + rhoO_EE);
-            real_type rho_w_E = 0.5*(rhoW_E + rhoW_EE);
-            real_type rho_l_E = 0.5*(rhoL_E + rhoL_EE);
-            real_type rho_m_E = 0.5*(rho_E + rho_EE);
+            T gas_vol_frac_E   = 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE);
+            T oil_vol_frac_E   = 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE);
+            T water_vol_frac_E = 0.5*(water_vol_fracE + water_vol_fracEE);
+            T rho_g_E = 0.5*(rhoG_E + rhoG_EE);
+            T rho_o_E = 0.5*(rhoO_E + rhoO_EE);
+            T rho_w_E = 0.5*(rhoW_E + rhoW_EE);
+            T rho_l_E = 0.5*(rhoL_E + rhoL_EE);
+            T rho_m_E = 0.5*(rho_E + rho_EE);
 
-            real_type gas_velocity_E    = p_velocityE + rho_l_E/rho_m_E*mod_Vgj_E;
-            real_type liquid_velocity_E = p_velocityE - gas_vol_frac_E/(1 - gas_vol_frac_E + 1.0e-20)*rho_g_E/rho_m_E*mod_Vgj_E;	 
-            real_type water_velocity_E  = liquid_velocity_E - (oil_vol_frac_E/(water_vol_frac_E + 1.0e-20))*(rho_o_E/rho_l_E)*mod_Vow_E;               
-            real_type oil_velocity_E    = liquid_velocity_E + rho_w_E/rho_l_E*mod_Vow_E;
+            T gas_velocity_E    = p_velocityE + rho_l_E/rho_m_E*mod_Vgj_E;
+            T liquid_velocity_E = p_velocityE - gas_vol_frac_E/(1 - gas_vol_frac_E + 1.0e-20)*rho_g_E/rho_m_E*mod_Vgj_E;	 
+            T water_velocity_E  = liquid_velocity_E - (oil_vol_frac_E/(water_vol_frac_E + 1.0e-20))*(rho_o_E/rho_l_E)*mod_Vow_E;               
+            T oil_velocity_E    = liquid_velocity_E + rho_w_E/rho_l_E*mod_Vow_E;
 
 
 
@@ -1670,17 +2132,17 @@ namespace WellSimulator {
             real_type ksi_E_gas     = this->ksi( gas_velocity_E   );
             real_type ksi_E_water   = this->ksi( water_velocity_E );
 
-            real_type m_W_oil   = oil_velocity_W  *( (0.5+ksi_W_oil  )*rhoO_W*p_oil_vol_fracW + (0.5-ksi_W_oil  )*rhoO_P*p_oil_vol_fracP );
-            real_type m_W_water = water_velocity_W*( (0.5+ksi_W_water)*rhoW_W*water_vol_fracW + (0.5-ksi_W_water)*rhoW_P*water_vol_fracP );
-            real_type m_W_gas   = gas_velocity_W  *( (0.5+ksi_W_gas  )*rhoG_W*p_gas_vol_fracW + (0.5-ksi_W_gas  )*rhoG_P*p_gas_vol_fracP );
+            T m_W_oil   = oil_velocity_W  *( (0.5+ksi_W_oil  )*rhoO_W*p_oil_vol_fracW + (0.5-ksi_W_oil  )*rhoO_P*p_oil_vol_fracP );
+            T m_W_water = water_velocity_W*( (0.5+ksi_W_water)*rhoW_W*water_vol_fracW + (0.5-ksi_W_water)*rhoW_P*water_vol_fracP );
+            T m_W_gas   = gas_velocity_W  *( (0.5+ksi_W_gas  )*rhoG_W*p_gas_vol_fracW + (0.5-ksi_W_gas  )*rhoG_P*p_gas_vol_fracP );
 
-            real_type m_P_oil   = oil_velocity_P  *( (0.5+ksi_P_oil  )*rhoO_P*p_oil_vol_fracP + (0.5-ksi_P_oil  )*rhoO_E*p_oil_vol_fracE );
-            real_type m_P_water = water_velocity_P*( (0.5+ksi_P_water)*rhoW_P*water_vol_fracP + (0.5-ksi_P_water)*rhoW_E*water_vol_fracE );
-            real_type m_P_gas   = gas_velocity_P  *( (0.5+ksi_P_gas  )*rhoG_P*p_gas_vol_fracP + (0.5-ksi_P_gas  )*rhoG_E*p_gas_vol_fracE );
+            T m_P_oil   = oil_velocity_P  *( (0.5+ksi_P_oil  )*rhoO_P*p_oil_vol_fracP + (0.5-ksi_P_oil  )*rhoO_E*p_oil_vol_fracE );
+            T m_P_water = water_velocity_P*( (0.5+ksi_P_water)*rhoW_P*water_vol_fracP + (0.5-ksi_P_water)*rhoW_E*water_vol_fracE );
+            T m_P_gas   = gas_velocity_P  *( (0.5+ksi_P_gas  )*rhoG_P*p_gas_vol_fracP + (0.5-ksi_P_gas  )*rhoG_E*p_gas_vol_fracE );
 
-            real_type m_E_oil   = oil_velocity_E  *( (0.5+ksi_E_oil  )*rhoO_P*p_oil_vol_fracE + (0.5-ksi_E_oil  )*rhoO_E*p_oil_vol_fracEE );
-            real_type m_E_water = water_velocity_E*( (0.5+ksi_E_water)*rhoW_P*water_vol_fracE + (0.5-ksi_E_water)*rhoW_E*water_vol_fracEE );
-            real_type m_E_gas   = gas_velocity_E  *( (0.5+ksi_E_gas  )*rhoG_P*p_gas_vol_fracE + (0.5-ksi_E_gas  )*rhoG_E*p_gas_vol_fracEE );
+            T m_E_oil   = oil_velocity_E  *( (0.5+ksi_E_oil  )*rhoO_P*p_oil_vol_fracE + (0.5-ksi_E_oil  )*rhoO_E*p_oil_vol_fracEE );
+            T m_E_water = water_velocity_E*( (0.5+ksi_E_water)*rhoW_P*water_vol_fracE + (0.5-ksi_E_water)*rhoW_E*water_vol_fracEE );
+            T m_E_gas   = gas_velocity_E  *( (0.5+ksi_E_gas  )*rhoG_P*p_gas_vol_fracE + (0.5-ksi_E_gas  )*rhoG_E*p_gas_vol_fracEE );
 
             real_type ksi_e_oil = this->ksi( (1-d_e)*oil_velocity_P + d_e*oil_velocity_E );
             real_type ksi_w_oil = this->ksi( (1-d_w)*oil_velocity_P + d_w*oil_velocity_W );
@@ -1689,16 +2151,16 @@ namespace WellSimulator {
             real_type ksi_e_gas = this->ksi( (1-d_e)*gas_velocity_P + d_e*gas_velocity_E );
             real_type ksi_w_gas = this->ksi( (1-d_w)*gas_velocity_P + d_w*gas_velocity_W );
 
-            real_type m_e = 0.5*(m_E_oil  +m_P_oil)  *( (0.5+ksi_e_oil  )*oil_velocity_P   + (0.5-ksi_e_oil  )*oil_velocity_E )
+            T m_e = 0.5*(m_E_oil  +m_P_oil)  *( (0.5+ksi_e_oil  )*oil_velocity_P   + (0.5-ksi_e_oil  )*oil_velocity_E )
                 + 0.5*(m_E_water+m_P_water)*( (0.5+ksi_e_water)*water_velocity_P + (0.5-ksi_e_water)*water_velocity_E )
                 + 0.5*(m_E_gas  +m_P_gas)  *( (0.5+ksi_e_gas  )*gas_velocity_P   + (0.5-ksi_e_gas  )*gas_velocity_E );
 
-            real_type m_w = 0.5*(m_W_oil  +m_P_oil)  *( (0.5+ksi_w_oil  )*oil_velocity_W   + (0.5-ksi_w_oil  )*oil_velocity_P )
+            T m_w = 0.5*(m_W_oil  +m_P_oil)  *( (0.5+ksi_w_oil  )*oil_velocity_W   + (0.5-ksi_w_oil  )*oil_velocity_P )
                 + 0.5*(m_W_water+m_P_water)*( (0.5+ksi_w_water)*water_velocity_W + (0.5-ksi_w_water)*water_velocity_P )
                 + 0.5*(m_W_gas  +m_P_gas)  *( (0.5+ksi_w_gas  )*gas_velocity_W   + (0.5-ksi_w_gas  )*gas_velocity_P );  
 
 
-            real_type m_t =  oil_velocity_P  *(rhoO_P*p_oil_vol_fracP + rhoO_E*p_oil_vol_fracE)
+            T m_t =  oil_velocity_P  *(rhoO_P*p_oil_vol_fracP + rhoO_E*p_oil_vol_fracE)
                           +  water_velocity_P*(rhoW_P*water_vol_fracP + rhoW_E*water_vol_fracE)
                           +  gas_velocity_P  *(rhoG_P*p_gas_vol_fracP + rhoG_E*p_gas_vol_fracE);
 
@@ -1712,30 +2174,30 @@ namespace WellSimulator {
 
             // New friction factor wells
             // OUYANG
-            //real_type q_w = 0.5*((*m_oil_flow)[ p_node ]+(*m_oil_flow)[ p_node +1] + (*m_gas_flow)[ p_node ]+(*m_gas_flow)[ p_node +1] + (*m_water_flow)[ p_node ]+(*m_water_flow)[ p_node+1 ])/dS;
-            //real_type v_eq = q_w/(PI*2*m_radius);
-            //real_type Re_w = abs(0.5*(rho_P + rho_E)*v_eq*2*m_radius/viscosity);
-            //real_type f_P = this->friction_factor( Re )*(1+0.04304*pow(Re_w,0.6142));
+            //T q_w = 0.5*((*m_oil_flow)[ p_node ]+(*m_oil_flow)[ p_node +1] + (*m_gas_flow)[ p_node ]+(*m_gas_flow)[ p_node +1] + (*m_water_flow)[ p_node ]+(*m_water_flow)[ p_node+1 ])/dS;
+            //T v_eq = q_w/(PI*2*m_radius);
+            //T Re_w = abs(0.5*(rho_P + rho_E)*v_eq*2*m_radius/viscosity);
+            //T f_P = this->friction_factor( Re )*(1+0.04304*pow(Re_w,0.6142));
             // ASHEIM
-            //real_type q_m = p_velocityP*area();
-            //real_type q_i = 0.5*((*m_oil_flow)[ p_node ] + (*m_oil_flow)[ p_node+1 ] + (*m_gas_flow)[ p_node ]+ (*m_gas_flow)[ p_node+1 ] + (*m_water_flow)[ p_node ] + (*m_water_flow)[ p_node+1 ]);
-            //real_type f_complet = q_m == 0? 0.0 : 4*2*m_radius*q_i/dS/q_m + 2*m_radius*q_i/dS/q_m*q_i/dS/q_m;
-            //real_type f_P = this->friction_factor( Re ) + f_complet;
+            //T q_m = p_velocityP*area();
+            //T q_i = 0.5*((*m_oil_flow)[ p_node ] + (*m_oil_flow)[ p_node+1 ] + (*m_gas_flow)[ p_node ]+ (*m_gas_flow)[ p_node+1 ] + (*m_water_flow)[ p_node ] + (*m_water_flow)[ p_node+1 ]);
+            //T f_complet = q_m == 0? 0.0 : 4*2*m_radius*q_i/dS/q_m + 2*m_radius*q_i/dS/q_m*q_i/dS/q_m;
+            //T f_P = this->friction_factor( Re ) + f_complet;
             
-			//real_type mod_Vgj_P		= this->mod_v_drift_flux( 
+			//T mod_Vgj_P		= this->mod_v_drift_flux( 
 			//												 (1-d_w)*p_velocityP + d_w*p_velocityW, p_gas_vol_fracP, p_oil_vol_fracP,
 			//												 water_vol_fracP, p_pressureP
 			//												 );
-			//real_type mod_Vgj_E		= this->mod_v_drift_flux( 
+			//T mod_Vgj_E		= this->mod_v_drift_flux( 
 			//												 (1-d_e)*p_velocityP + d_e*p_velocityE, p_gas_vol_fracE, p_oil_vol_fracE,
 			//												 water_vol_fracE, p_pressureE
 			//												 );
 
 			//
 			//// OTHER Vc = j
-			////real_type Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
-			////real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2*m_radius/viscosity);
-			////real_type f_P = this->friction_factor( Re );
+			////T Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
+			////T Re  = abs(0.5*(rho_P + rho_E)*Vc*2*m_radius/viscosity);
+			////T f_P = this->friction_factor( Re );
 
 			//real_type ksi_e = this->ksi( (1-d_e)*p_velocityP + d_e*p_velocityE );
 			//real_type ksi_w = this->ksi( (1-d_w)*p_velocityP + d_w*p_velocityW );
@@ -1752,9 +2214,9 @@ namespace WellSimulator {
 			//real_type ksi_P = this->ksi( p_velocityP );
 			//real_type ksi_W = this->ksi( p_velocityW );
 
-			//real_type m_E	= rho_E*p_velocityE*area();
-			//real_type m_P	= ((0.5+ksi_P)*rho_P + (0.5-ksi_P)*rho_E  )*p_velocityP*area();
-			//real_type m_W	= ((0.5+ksi_W)*rho_W + (0.5-ksi_W)*rho_P  )*p_velocityW*area();
+			//T m_E	= rho_E*p_velocityE*area();
+			//T m_P	= ((0.5+ksi_P)*rho_P + (0.5-ksi_P)*rho_E  )*p_velocityP*area();
+			//T m_W	= ((0.5+ksi_W)*rho_W + (0.5-ksi_W)*rho_P  )*p_velocityW*area();
 
    //                    
 			//return ( (rho_P+rho_E)*p_velocityP - (rho_P_old+rho_E_old)*m_mean_velocity_old[ p_node ] )*0.5*dV/dt()
@@ -1787,170 +2249,162 @@ namespace WellSimulator {
 
 			real_type water_vol_fracP_old	= 1.0 - (m_oil_vol_frac_old[ p_node ]   + m_gas_vol_frac_old[ p_node ]	);
 			real_type water_vol_fracE_old	= 1.0 - (m_oil_vol_frac_old[ p_node+1 ] + m_gas_vol_frac_old[ p_node+1 ]);
-			real_type water_vol_fracW		= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
-			real_type water_vol_fracP		= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
-			real_type water_vol_fracE		= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);	
-			real_type water_vol_fracEE		= 1.0 - (p_gas_vol_fracEE + p_oil_vol_fracEE);
+			T water_vol_fracW		= 1.0 - (p_gas_vol_fracW + p_oil_vol_fracW);
+			T water_vol_fracP		= 1.0 - (p_gas_vol_fracP + p_oil_vol_fracP);
+			T water_vol_fracE		= 1.0 - (p_gas_vol_fracE + p_oil_vol_fracE);	
+			T water_vol_fracEE		= 1.0 - (p_gas_vol_fracEE + p_oil_vol_fracEE);
 
 			real_type rho_P_old = this->mean_density(m_oil_vol_frac_old[ p_node ], water_vol_fracP_old, m_gas_vol_frac_old[ p_node ], m_pressure_old[ p_node ]);
 			real_type rho_E_old = this->mean_density(m_oil_vol_frac_old[ p_node+1 ], water_vol_fracE_old, m_gas_vol_frac_old[ p_node+1 ], m_pressure_old[ p_node+1 ]);
-            real_type rhoG_P_old = this->gas_density( m_pressure_old[ p_node ] );
-            real_type rhoO_P_old = this->oil_density( m_pressure_old[ p_node ] );
-            real_type rhoW_P_old = this->water_density( m_pressure_old[ p_node ] );
-
-			vector_type S( 3 );
-			S[ 0 ] = m_coordinates[ p_node ].getX() - m_coordinates[ p_node+1 ].getX();
-			S[ 1 ] = m_coordinates[ p_node ].getY() - m_coordinates[ p_node+1 ].getY();
-			S[ 2 ] = m_coordinates[ p_node ].getZ() - m_coordinates[ p_node+1 ].getZ();
-			
+
 			real_type d_e = dS/(dS+dSe);
 			real_type d_w = dS/(dS+dSw);
 
 			real_type angle = get_inclination() - PI/2;// - 0*acos( dot( m_gravity, S )/(norm(m_gravity)*norm(S)) );		
 			
-			real_type rho_W   = this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW , p_pressureW );
-			real_type rho_P   = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);
-			real_type rho_E   = this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
-			real_type rho_EE  = this->mean_density(p_oil_vol_fracEE, water_vol_fracEE, p_gas_vol_fracEE , p_pressureEE);
+			T rho_W   = this->mean_density(p_oil_vol_fracW, water_vol_fracW, p_gas_vol_fracW , p_pressureW );
+			T rho_P   = this->mean_density(p_oil_vol_fracP, water_vol_fracP, p_gas_vol_fracP, p_pressureP);
+			T rho_E   = this->mean_density(p_oil_vol_fracE, water_vol_fracE, p_gas_vol_fracE, p_pressureE);
+			T rho_EE  = this->mean_density(p_oil_vol_fracEE, water_vol_fracEE, p_gas_vol_fracEE , p_pressureEE);
 			
-            real_type rhoG_W		= this->gas_density( p_pressureW );
-			real_type rhoG_P		= this->gas_density( p_pressureP );
-			real_type rhoG_E		= this->gas_density( p_pressureE );
-            real_type rhoG_EE		= this->gas_density( p_pressureEE );
-
-            real_type rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
-			real_type rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
-			real_type rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
-            real_type rhoL_EE		= this->liquid_density( p_oil_vol_fracEE, water_vol_fracEE, p_pressureEE );
-
-            real_type rhoW_W		= this->water_density( p_pressureW );
-            real_type rhoW_P		= this->water_density( p_pressureP );
-            real_type rhoW_E		= this->water_density( p_pressureE );
-            real_type rhoW_EE		= this->water_density( p_pressureEE );
-
-            real_type rhoO_W		= this->oil_density( p_pressureW );
-            real_type rhoO_P		= this->oil_density( p_pressureP );
-            real_type rhoO_E		= this->oil_density( p_pressureE );
-            real_type rhoO_EE		= this->oil_density( p_pressureEE );            
+            T rhoG_W		= this->gas_density( p_pressureW, p_node-1 );
+			T rhoG_P		= this->gas_density( p_pressureP, p_node );
+			T rhoG_E		= this->gas_density( p_pressureE, p_node+1 );
+            T rhoG_EE		= this->gas_density( p_pressureEE, p_node+2 );
+
+            T rhoL_W		= this->liquid_density( p_oil_vol_fracW, water_vol_fracW, p_pressureW );
+			T rhoL_P		= this->liquid_density( p_oil_vol_fracP, water_vol_fracP, p_pressureP );
+			T rhoL_E		= this->liquid_density( p_oil_vol_fracE, water_vol_fracE, p_pressureE );
+            T rhoL_EE		= this->liquid_density( p_oil_vol_fracEE, water_vol_fracEE, p_pressureEE );
+
+            T rhoW_W		= this->water_density( p_pressureW, p_node-1 );
+            T rhoW_P		= this->water_density( p_pressureP, p_node );
+            T rhoW_E		= this->water_density( p_pressureE, p_node+1 );
+            T rhoW_EE		= this->water_density( p_pressureEE, p_node+2 );
+
+            T rhoO_W		= this->oil_density( p_pressureW, p_node-1 );
+            T rhoO_P		= this->oil_density( p_pressureP, p_node );
+            T rhoO_E		= this->oil_density( p_pressureE, p_node+1 );
+            T rhoO_EE		= this->oil_density( p_pressureEE, p_node+2 );            
 			
-			real_type mean_pressure = 0.5*(p_pressureP + p_pressureE);
-			real_type viscosity = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE)*gas_viscosity	 ( mean_pressure ) 
-								+ 0.5*(p_oil_vol_fracP + p_oil_vol_fracE)*oil_viscosity	 ( mean_pressure ) 
-								+ 0.5*(water_vol_fracP + water_vol_fracE)*water_viscosity( mean_pressure );	
+			T mean_pressure = 0.5*(p_pressureP + p_pressureE);
+			T viscosity = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE)*gas_viscosity	 ( mean_pressure, p_node ) 
+								+ 0.5*(p_oil_vol_fracP + p_oil_vol_fracE)*oil_viscosity	 ( mean_pressure, p_node ) 
+								+ 0.5*(water_vol_fracP + water_vol_fracE)*water_viscosity( mean_pressure, p_node );	
 
 
             // New friction factor wells
             // OUYANG
-            //real_type q_w = 0.5*((*m_oil_flow)[ p_node ]+(*m_oil_flow)[ p_node +1] + (*m_gas_flow)[ p_node ]+(*m_gas_flow)[ p_node +1] + (*m_water_flow)[ p_node ]+(*m_water_flow)[ p_node+1 ])/dS;
-            //real_type v_eq = q_w/(PI*2*m_radius);
-            //real_type Re_w = abs(0.5*(rho_P + rho_E)*v_eq*2*m_radius/viscosity);
-            //real_type f_P = this->friction_factor( Re )*(1+0.04304*pow(Re_w,0.6142));
+            //T q_w = 0.5*((*m_oil_flow)[ p_node ]+(*m_oil_flow)[ p_node +1] + (*m_gas_flow)[ p_node ]+(*m_gas_flow)[ p_node +1] + (*m_water_flow)[ p_node ]+(*m_water_flow)[ p_node+1 ])/dS;
+            //T v_eq = q_w/(PI*2*m_radius);
+            //T Re_w = abs(0.5*(rho_P + rho_E)*v_eq*2*m_radius/viscosity);
+            //T f_P = this->friction_factor( Re )*(1+0.04304*pow(Re_w,0.6142));
             // ASHEIM
-            //real_type q_m = p_velocityP*area();
-            //real_type q_i = 0.5*((*m_oil_flow)[ p_node ] + (*m_oil_flow)[ p_node+1 ] + (*m_gas_flow)[ p_node ]+ (*m_gas_flow)[ p_node+1 ] + (*m_water_flow)[ p_node ] + (*m_water_flow)[ p_node+1 ]);
-            //real_type f_complet = q_m == 0? 0.0 : 4*2*m_radius*q_i/dS/q_m + 2*m_radius*q_i/dS/q_m*q_i/dS/q_m;
-            //real_type f_P = this->friction_factor( Re ) + f_complet;
+            //T q_m = p_velocityP*area();
+            //T q_i = 0.5*((*m_oil_flow)[ p_node ] + (*m_oil_flow)[ p_node+1 ] + (*m_gas_flow)[ p_node ]+ (*m_gas_flow)[ p_node+1 ] + (*m_water_flow)[ p_node ] + (*m_water_flow)[ p_node+1 ]);
+            //T f_complet = q_m == 0? 0.0 : 4*2*m_radius*q_i/dS/q_m + 2*m_radius*q_i/dS/q_m*q_i/dS/q_m;
+            //T f_P = this->friction_factor( Re ) + f_complet;
            
 
-			/*real_type mod_Vgj_P		= this->mod_v_drift_flux( 
+			/*T mod_Vgj_P		= this->mod_v_drift_flux( 
 															(1-d_w)*p_velocityP + d_w*p_velocityW, p_gas_vol_fracP, p_oil_vol_fracP,
 															 water_vol_fracP, p_pressureP
 															 );
-			real_type mod_Vgj_E		= this->mod_v_drift_flux( 
+			T mod_Vgj_E		= this->mod_v_drift_flux( 
 															 (1-d_e)*p_velocityP + d_e*p_velocityE, p_gas_vol_fracE, p_oil_vol_fracE,
 															 water_vol_fracE, p_pressureE
 															 );
-            real_type mod_Vow_P	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_P	= this->mod_v_drift_flux_ow( 
 															(1-d_w)*p_velocityP + d_w*p_velocityW, p_gas_vol_fracP, p_oil_vol_fracP,
 															 water_vol_fracP, p_pressureP
 															 );
-			real_type mod_Vow_E	= this->mod_v_drift_flux_ow( 
+			T mod_Vow_E	= this->mod_v_drift_flux_ow( 
 															 (1-d_e)*p_velocityP + d_e*p_velocityE, p_gas_vol_fracE, p_oil_vol_fracE,
 															 water_vol_fracE, p_pressureE
 															 );*/
 
 
-            real_type mod_Vow_W	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_W	= this->mod_v_drift_flux_ow( 
                 p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
+                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW), p_node-1
                 );
-            real_type mod_Vow_P	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_P	= this->mod_v_drift_flux_ow( 
                 p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
+                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE), p_node
                 );
-            real_type mod_Vow_E	= this->mod_v_drift_flux_ow( 
+            T mod_Vow_E	= this->mod_v_drift_flux_ow( 
                 p_velocityE, 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE), 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE),
-                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE)
+                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE), p_node+1
                 );
 
-            real_type mod_Vgj_W	= this->mod_v_drift_flux( 
+            T mod_Vgj_W	= this->mod_v_drift_flux( 
                 p_velocityW, 0.5*(p_gas_vol_fracP + p_gas_vol_fracW), 0.5*(p_oil_vol_fracP + p_oil_vol_fracW),
-                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW)
+                0.5*(water_vol_fracP + water_vol_fracW), 0.5*(p_pressureP + p_pressureW), p_node-1
                 );
-            real_type mod_Vgj_P	= this->mod_v_drift_flux( 
+            T mod_Vgj_P	= this->mod_v_drift_flux( 
                 p_velocityP, 0.5*(p_gas_vol_fracP + p_gas_vol_fracE), 0.5*(p_oil_vol_fracP + p_oil_vol_fracE),
-                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE)
+                0.5*(water_vol_fracP + water_vol_fracE), 0.5*(p_pressureP + p_pressureE), p_node
                 );
-            real_type mod_Vgj_E	= this->mod_v_drift_flux( 
+            T mod_Vgj_E	= this->mod_v_drift_flux( 
                 p_velocityE, 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE), 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE),
-                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE)
+                0.5*(water_vol_fracE + water_vol_fracEE), 0.5*(p_pressureE + p_pressureEE), p_node+1
                 );
                 
 
-            //real_type Vc  = p_velocityP;			
-            //real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
-            //real_type f_P = this->friction_factor( Re );
+            //T Vc  = p_velocityP;			
+            //T Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
+            //T f_P = this->friction_factor( Re );
 
             // OTHER Vc = j
-            real_type Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
-            real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
-            real_type f_P = this->friction_factor( Re );
+            T Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
+            T Re  = abs(0.5*(rho_P + rho_E)*Vc*2.0*m_radius/viscosity);
+            T f_P = this->friction_factor( Re );
 
 
 
-            real_type gas_vol_frac_W   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
-            real_type oil_vol_frac_W   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracW);
-            real_type water_vol_frac_W = 0.5*(water_vol_fracP + water_vol_fracW);
-            real_type rho_g_W = 0.5*(rhoG_W + rhoG_P);
-            real_type rho_o_W = 0.5*(rhoO_W + rhoO_P);
-            real_type rho_w_W = 0.5*(rhoW_W + rhoW_P);
-            real_type rho_l_W = 0.5*(rhoL_W + rhoL_P);
-            real_type rho_m_W = 0.5*(rho_W + rho_P);
+            T gas_vol_frac_W   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracW);
+            T oil_vol_frac_W   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracW);
+            T water_vol_frac_W = 0.5*(water_vol_fracP + water_vol_fracW);
+            T rho_g_W = 0.5*(rhoG_W + rhoG_P);
+            T rho_o_W = 0.5*(rhoO_W + rhoO_P);
+            T rho_w_W = 0.5*(rhoW_W + rhoW_P);
+            T rho_l_W = 0.5*(rhoL_W + rhoL_P);
+            T rho_m_W = 0.5*(rho_W + rho_P);
 
-            real_type gas_velocity_W    = p_velocityW + rho_l_W/rho_m_W*mod_Vgj_W;
-            real_type liquid_velocity_W = p_velocityW - gas_vol_frac_W/(1 - gas_vol_frac_W + 1.0e-20)*rho_g_W/rho_m_W*mod_Vgj_W;	 
-            real_type water_velocity_W  = liquid_velocity_W - (oil_vol_frac_W/(water_vol_frac_W + 1.0e-20))*(rho_o_W/rho_l_W)*mod_Vow_W;               
-            real_type oil_velocity_W    = liquid_velocity_W + rho_w_W/rho_l_W*mod_Vow_W;  
+            T gas_velocity_W    = p_velocityW + rho_l_W/rho_m_W*mod_Vgj_W;
+            T liquid_velocity_W = p_velocityW - gas_vol_frac_W/(1 - gas_vol_frac_W + 1.0e-20)*rho_g_W/rho_m_W*mod_Vgj_W;	 
+            T water_velocity_W  = liquid_velocity_W - (oil_vol_frac_W/(water_vol_frac_W + 1.0e-20))*(rho_o_W/rho_l_W)*mod_Vow_W;               
+            T oil_velocity_W    = liquid_velocity_W + rho_w_W/rho_l_W*mod_Vow_W;  
 
 
 
-            real_type gas_vol_frac_P   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE);
-            real_type oil_vol_frac_P   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracE);
-            real_type water_vol_frac_P = 0.5*(water_vol_fracP + water_vol_fracE);
-            real_type rho_g_P = 0.5*(rhoG_E + rhoG_P);
-            real_type rho_o_P = 0.5*(rhoO_E + rhoO_P);
-            real_type rho_w_P = 0.5*(rhoW_E + rhoW_P);
-            real_type rho_l_P = 0.5*(rhoL_E + rhoL_P);
-            real_type rho_m_P = 0.5*(rho_E + rho_P);
+            T gas_vol_frac_P   = 0.5*(p_gas_vol_fracP + p_gas_vol_fracE);
+            T oil_vol_frac_P   = 0.5*(p_oil_vol_fracP + p_oil_vol_fracE);
+            T water_vol_frac_P = 0.5*(water_vol_fracP + water_vol_fracE);
+            T rho_g_P = 0.5*(rhoG_E + rhoG_P);
+            T rho_o_P = 0.5*(rhoO_E + rhoO_P);
+            T rho_w_P = 0.5*(rhoW_E + rhoW_P);
+            T rho_l_P = 0.5*(rhoL_E + rhoL_P);
+            T rho_m_P = 0.5*(rho_E + rho_P);
 
-            real_type gas_velocity_P    = p_velocityP + rho_l_P/rho_m_P*mod_Vgj_P;
-            real_type liquid_velocity_P = p_velocityP - gas_vol_frac_P/(1 - gas_vol_frac_P + 1.0e-20)*rho_g_P/rho_m_P*mod_Vgj_P;	 
-            real_type water_velocity_P  = liquid_velocity_P - (oil_vol_frac_P/(water_vol_frac_P + 1.0e-20))*(rho_o_P/rho_l_P)*mod_Vow_P;               
-            real_type oil_velocity_P    = liquid_velocity_P + rho_w_P/rho_l_P*mod_Vow_P;
+            T gas_velocity_P    = p_velocityP + rho_l_P/rho_m_P*mod_Vgj_P;
+            T liquid_velocity_P = p_velocityP - gas_vol_frac_P/(1 - gas_vol_frac_P + 1.0e-20)*rho_g_P/rho_m_P*mod_Vgj_P;	 
+            T water_velocity_P  = liquid_velocity_P - (oil_vol_frac_P/(water_vol_frac_P + 1.0e-20))*(rho_o_P/rho_l_P)*mod_Vow_P;               
+            T oil_velocity_P    = liquid_velocity_P + rho_w_P/rho_l_P*mod_Vow_P;
 
-            real_type gas_vol_frac_E   = 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE);
-            real_type oil_vol_frac_E   = 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE);
-            real_type water_vol_frac_E = 0.5*(water_vol_fracE + water_vol_fracEE);
-            real_type rho_g_E = 0.5*(rhoG_E + rhoG_EE);
-            real_type rho_o_E = 0.5*(rhoO_E + rhoO_EE);
-            real_type rho_w_E = 0.5*(rhoW_E + rhoW_EE);
-            real_type rho_l_E = 0.5*(rhoL_E + rhoL_EE);
-            real_type rho_m_E = 0.5*(rho_E + rho_EE);
+            T gas_vol_frac_E   = 0.5*(p_gas_vol_fracE + p_gas_vol_fracEE);
+            T oil_vol_frac_E   = 0.5*(p_oil_vol_fracE + p_oil_vol_fracEE);
+            T water_vol_frac_E = 0.5*(water_vol_fracE + water_vol_fracEE);
+            T rho_g_E = 0.5*(rhoG_E + rhoG_EE);
+            T rho_o_E = 0.5*(rhoO_E + rhoO_EE);
+            T rho_w_E = 0.5*(rhoW_E + rhoW_EE);
+            T rho_l_E = 0.5*(rhoL_E + rhoL_EE);
+            T rho_m_E = 0.5*(rho_E + rho_EE);
 
-            real_type gas_velocity_E    = p_velocityE + rho_l_E/rho_m_E*mod_Vgj_E;
-            real_type liquid_velocity_E = p_velocityE - gas_vol_frac_E/(1 - gas_vol_frac_E + 1.0e-20)*rho_g_E/rho_m_E*mod_Vgj_E;	 
-            real_type water_velocity_E  = liquid_velocity_E - (oil_vol_frac_E/(water_vol_frac_E + 1.0e-20))*(rho_o_E/rho_l_E)*mod_Vow_E;               
-            real_type oil_velocity_E    = liquid_velocity_E + rho_w_E/rho_l_E*mod_Vow_E;
+            T gas_velocity_E    = p_velocityE + rho_l_E/rho_m_E*mod_Vgj_E;
+            T liquid_velocity_E = p_velocityE - gas_vol_frac_E/(1 - gas_vol_frac_E + 1.0e-20)*rho_g_E/rho_m_E*mod_Vgj_E;	 
+            T water_velocity_E  = liquid_velocity_E - (oil_vol_frac_E/(water_vol_frac_E + 1.0e-20))*(rho_o_E/rho_l_E)*mod_Vow_E;               
+            T oil_velocity_E    = liquid_velocity_E + rho_w_E/rho_l_E*mod_Vow_E;
 
 
 
@@ -1966,17 +2420,17 @@ namespace WellSimulator {
             real_type ksi_E_gas     = this->ksi( gas_velocity_E   );
             real_type ksi_E_water   = this->ksi( water_velocity_E );
 
-            real_type m_W_oil   = oil_velocity_W  *( (0.5+ksi_W_oil  )*rhoO_W*p_oil_vol_fracW + (0.5-ksi_W_oil  )*rhoO_P*p_oil_vol_fracP );
-            real_type m_W_water = water_velocity_W*( (0.5+ksi_W_water)*rhoW_W*water_vol_fracW + (0.5-ksi_W_water)*rhoW_P*water_vol_fracP );
-            real_type m_W_gas   = gas_velocity_W  *( (0.5+ksi_W_gas  )*rhoG_W*p_gas_vol_fracW + (0.5-ksi_W_gas  )*rhoG_P*p_gas_vol_fracP );
+            T m_W_oil   = oil_velocity_W  *( (0.5+ksi_W_oil  )*rhoO_W*p_oil_vol_fracW + (0.5-ksi_W_oil  )*rhoO_P*p_oil_vol_fracP );
+            T m_W_water = water_velocity_W*( (0.5+ksi_W_water)*rhoW_W*water_vol_fracW + (0.5-ksi_W_water)*rhoW_P*water_vol_fracP );
+            T m_W_gas   = gas_velocity_W  *( (0.5+ksi_W_gas  )*rhoG_W*p_gas_vol_fracW + (0.5-ksi_W_gas  )*rhoG_P*p_gas_vol_fracP );
 
-            real_type m_P_oil   = oil_velocity_P  *( (0.5+ksi_P_oil  )*rhoO_P*p_oil_vol_fracP + (0.5-ksi_P_oil  )*rhoO_E*p_oil_vol_fracE );
-            real_type m_P_water = water_velocity_P*( (0.5+ksi_P_water)*rhoW_P*water_vol_fracP + (0.5-ksi_P_water)*rhoW_E*water_vol_fracE );
-            real_type m_P_gas   = gas_velocity_P  *( (0.5+ksi_P_gas  )*rhoG_P*p_gas_vol_fracP + (0.5-ksi_P_gas  )*rhoG_E*p_gas_vol_fracE );
+            T m_P_oil   = oil_velocity_P  *( (0.5+ksi_P_oil  )*rhoO_P*p_oil_vol_fracP + (0.5-ksi_P_oil  )*rhoO_E*p_oil_vol_fracE );
+            T m_P_water = water_velocity_P*( (0.5+ksi_P_water)*rhoW_P*water_vol_fracP + (0.5-ksi_P_water)*rhoW_E*water_vol_fracE );
+            T m_P_gas   = gas_velocity_P  *( (0.5+ksi_P_gas  )*rhoG_P*p_gas_vol_fracP + (0.5-ksi_P_gas  )*rhoG_E*p_gas_vol_fracE );
 
-            real_type m_E_oil   = oil_velocity_E  *( (0.5+ksi_E_oil  )*rhoO_P*p_oil_vol_fracE + (0.5-ksi_E_oil  )*rhoO_E*p_oil_vol_fracEE );
-            real_type m_E_water = water_velocity_E*( (0.5+ksi_E_water)*rhoW_P*water_vol_fracE + (0.5-ksi_E_water)*rhoW_E*water_vol_fracEE );
-            real_type m_E_gas   = gas_velocity_E  *( (0.5+ksi_E_gas  )*rhoG_P*p_gas_vol_fracE + (0.5-ksi_E_gas  )*rhoG_E*p_gas_vol_fracEE );
+            T m_E_oil   = oil_velocity_E  *( (0.5+ksi_E_oil  )*rhoO_P*p_oil_vol_fracE + (0.5-ksi_E_oil  )*rhoO_E*p_oil_vol_fracEE );
+            T m_E_water = water_velocity_E*( (0.5+ksi_E_water)*rhoW_P*water_vol_fracE + (0.5-ksi_E_water)*rhoW_E*water_vol_fracEE );
+            T m_E_gas   = gas_velocity_E  *( (0.5+ksi_E_gas  )*rhoG_P*p_gas_vol_fracE + (0.5-ksi_E_gas  )*rhoG_E*p_gas_vol_fracEE );
 
             real_type ksi_e_oil = this->ksi( (1-d_e)*oil_velocity_P + d_e*oil_velocity_E );
             real_type ksi_w_oil = this->ksi( (1-d_w)*oil_velocity_P + d_w*oil_velocity_W );
@@ -1985,23 +2439,23 @@ namespace WellSimulator {
             real_type ksi_e_gas = this->ksi( (1-d_e)*gas_velocity_P + d_e*gas_velocity_E );
             real_type ksi_w_gas = this->ksi( (1-d_w)*gas_velocity_P + d_w*gas_velocity_W );
 
-            real_type m_e = 0.5*(m_E_oil  +m_P_oil)  *( (0.5+ksi_e_oil  )*oil_velocity_P   + (0.5-ksi_e_oil  )*oil_velocity_E )
+            T m_e = 0.5*(m_E_oil  +m_P_oil)  *( (0.5+ksi_e_oil  )*oil_velocity_P   + (0.5-ksi_e_oil  )*oil_velocity_E )
                           + 0.5*(m_E_water+m_P_water)*( (0.5+ksi_e_water)*water_velocity_P + (0.5-ksi_e_water)*water_velocity_E )
                           + 0.5*(m_E_gas  +m_P_gas)  *( (0.5+ksi_e_gas  )*gas_velocity_P   + (0.5-ksi_e_gas  )*gas_velocity_E );
 
-            real_type m_w = 0.5*(m_W_oil  +m_P_oil)  *( (0.5+ksi_w_oil  )*oil_velocity_W   + (0.5-ksi_w_oil  )*oil_velocity_P )
+            T m_w = 0.5*(m_W_oil  +m_P_oil)  *( (0.5+ksi_w_oil  )*oil_velocity_W   + (0.5-ksi_w_oil  )*oil_velocity_P )
                           + 0.5*(m_W_water+m_P_water)*( (0.5+ksi_w_water)*water_velocity_W + (0.5-ksi_w_water)*water_velocity_P )
                           + 0.5*(m_W_gas  +m_P_gas)  *( (0.5+ksi_w_gas  )*gas_velocity_W   + (0.5-ksi_w_gas  )*gas_velocity_P );
 
-          /*  real_type m_e = rhoO_E*p_oil_vol_fracE*((1-d_e)*oil_velocity_P + d_e*oil_velocity_E )*( (0.5+ksi_e_oil  )*oil_velocity_P   + (0.5-ksi_e_oil  )*oil_velocity_E )
+          /*  T m_e = rhoO_E*p_oil_vol_fracE*((1-d_e)*oil_velocity_P + d_e*oil_velocity_E )*( (0.5+ksi_e_oil  )*oil_velocity_P   + (0.5-ksi_e_oil  )*oil_velocity_E )
                           + rhoW_E*water_vol_fracE*((1-d_e)*water_velocity_P + d_e*water_velocity_E )*( (0.5+ksi_e_water)*water_velocity_P + (0.5-ksi_e_water)*water_velocity_E )
                           + rhoG_E*p_gas_vol_fracE*((1-d_e)*gas_velocity_P + d_e*gas_velocity_E )*( (0.5+ksi_e_gas  )*gas_velocity_P   + (0.5-ksi_e_gas  )*gas_velocity_E );
 
-            real_type m_w = rhoO_P*p_oil_vol_fracP*((1-d_w)*oil_velocity_P + d_w*oil_velocity_W )*( (0.5+ksi_w_oil  )*oil_velocity_W   + (0.5-ksi_w_oil  )*oil_velocity_P )
+            T m_w = rhoO_P*p_oil_vol_fracP*((1-d_w)*oil_velocity_P + d_w*oil_velocity_W )*( (0.5+ksi_w_oil  )*oil_velocity_W   + (0.5-ksi_w_oil  )*oil_velocity_P )
                           + rhoW_P*water_vol_fracP*((1-d_w)*water_velocity_P + d_w*water_velocity_W )*( (0.5+ksi_w_water)*water_velocity_W + (0.5-ksi_w_water)*water_velocity_P )
                           + rhoG_P*p_gas_vol_fracP*((1-d_w)*gas_velocity_P + d_w*gas_velocity_W )*( (0.5+ksi_w_gas  )*gas_velocity_W   + (0.5-ksi_w_gas  )*gas_velocity_P );
         */    
-            real_type m_t =  oil_velocity_P  *(rhoO_P*p_oil_vol_fracP + rhoO_E*p_oil_vol_fracE)
+            T m_t =  oil_velocity_P  *(rhoO_P*p_oil_vol_fracP + rhoO_E*p_oil_vol_fracE)
                           +  water_velocity_P*(rhoW_P*water_vol_fracP + rhoW_E*water_vol_fracE)
                           +  gas_velocity_P  *(rhoG_P*p_gas_vol_fracP + rhoG_E*p_gas_vol_fracE);
 
@@ -2012,9 +2466,9 @@ namespace WellSimulator {
 
 
 			// OTHER Vc = j
-			//real_type Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
-			//real_type Re  = abs(0.5*(rho_P + rho_E)*Vc*2*m_radius/viscosity);
-			//real_type f_P = this->friction_factor( Re );
+			//T Vc = p_velocityP + 0.5*(p_gas_vol_fracP*(rhoL_P - rhoG_P)/rho_P*mod_Vgj_P + p_gas_vol_fracE*(rhoL_E - rhoG_E)/rho_E*mod_Vgj_E);
+			//T Re  = abs(0.5*(rho_P + rho_E)*Vc*2*m_radius/viscosity);
+			//T f_P = this->friction_factor( Re );
 
 		
 		/*	real_type ksi_e = this->ksi( (1-d_e)*p_velocityP + d_e*p_velocityE );
@@ -2031,9 +2485,9 @@ namespace WellSimulator {
 			//real_type ksi_P = this->ksi( p_velocityP );
 			//real_type ksi_W = this->ksi( p_velocityW );
 
-			//real_type m_E	= ((0.5+ksi_E)*rho_E + (0.5-ksi_E)*rho_EE )*p_velocityE*area();
-			//real_type m_P	= ((0.5+ksi_P)*rho_P + (0.5-ksi_P)*rho_E  )*p_velocityP*area();
-			//real_type m_W	= ((0.5+ksi_W)*rho_W + (0.5-ksi_W)*rho_P  )*p_velocityW*area();
+			//T m_E	= ((0.5+ksi_E)*rho_E + (0.5-ksi_E)*rho_EE )*p_velocityE*area();
+			//T m_P	= ((0.5+ksi_P)*rho_P + (0.5-ksi_P)*rho_E  )*p_velocityP*area();
+			//T m_W	= ((0.5+ksi_W)*rho_W + (0.5-ksi_W)*rho_P  )*p_velocityW*area();
 
 			//return ( (rho_P+rho_E)*p_velocityP - (rho_P_old+rho_E_old)*m_mean_velocity_old[ p_node ] )*0.5*dV/dt()
 			//	 + 0.5*(m_E+m_P)*( (0.5+ksi_e)*p_velocityP + (0.5-ksi_e)*p_velocityE )
@@ -2058,30 +2512,944 @@ namespace WellSimulator {
 		}
 	}
 
-	
+	// Residuals of block row p_node from the W, P, E and EE values of its stencil (zero beyond the
+	// well ends), with the boundary conventions of compute_Jacobian_FD. Only the equations flagged
+	// in p_equations are evaluated.
+	template <class T>
+	void DriftFluxWell::do_block_row_residual(
+											  uint_type		p_node,
+											  const bool	p_equations[],
+											  T				p_pressure[],
+											  T				p_gas_vol_frac[],
+											  T				p_oil_vol_frac[],
+											  T				p_velocity[],
+											  const FaceFluxes<T> p_faces[],
+											  T				p_R[]
+											  )
+	{
+		enum{ WEST, CENT, EAST, EEAST };
+		uint_type i    = p_node;
+		uint_type LAST = this->number_of_nodes()-1;
+
+		if( i == 0 ){
+			// The first node stands in for its west neighbour
+			p_pressure[ WEST ]	   = p_pressure[ CENT ];
+			p_gas_vol_frac[ WEST ] = p_gas_vol_frac[ CENT ];
+			p_oil_vol_frac[ WEST ] = p_oil_vol_frac[ CENT ];
+			p_velocity[ WEST ]	   = p_velocity[ CENT ];
+		}
+		if( i == LAST - 1 ){
+			// ... and the last node for the east-east one
+			p_pressure[ EEAST ]		= p_pressure[ EAST ];
+			p_gas_vol_frac[ EEAST ] = p_gas_vol_frac[ EAST ];
+			p_oil_vol_frac[ EEAST ] = p_oil_vol_frac[ EAST ];
+		}
+		string_type position = ( i == 0 ) ? 'F' : ( ( i + 1 < LAST ) ? 'C' : 'L' );
+		string_type mass_position = ( i == LAST ) ? 'L' : 'C';
+
+		// The mass balances only need the fluxes of the two faces of the node: those of the face
+		// loop when given, else from the stencil
+		FaceFluxes<T> stencil_faces[ 2 ];
+		const FaceFluxes<T>* faces = p_faces;
+		if( !faces && ( p_equations[ P ] || p_equations[ alpha_g ] || p_equations[ alpha_o ] ) ){
+			this->do_node_face_fluxes<T>( p_pressure[ WEST ], p_pressure[ CENT ], p_pressure[ EAST ],
+										  p_gas_vol_frac[ WEST ], p_gas_vol_frac[ CENT ], p_gas_vol_frac[ EAST ],
+										  p_oil_vol_frac[ WEST ], p_oil_vol_frac[ CENT ], p_oil_vol_frac[ EAST ],
+										  p_velocity[ WEST ], p_velocity[ CENT ], i, mass_position, stencil_faces );
+			faces = stencil_faces;
+		}
+
+		if( p_equations[ P ] ){
+			p_R[ P ] = this->do_R_m<T>( p_pressure[ CENT ], p_gas_vol_frac[ CENT ], p_oil_vol_frac[ CENT ], p_velocity[ CENT ],
+									    faces, i, mass_position );
+		}
+		if( p_equations[ alpha_g ] ){
+			p_R[ alpha_g ] = this->do_R_g<T>( p_pressure[ CENT ], p_gas_vol_frac[ CENT ], p_oil_vol_frac[ CENT ], p_velocity[ CENT ],
+											  faces, i, mass_position );
+		}
+		if( p_equations[ alpha_o ] ){
+			p_R[ alpha_o ] = this->do_R_o<T>( p_pressure[ CENT ], p_gas_vol_frac[ CENT ], p_oil_vol_frac[ CENT ], p_velocity[ CENT ],
+											  faces, i, mass_position );
+		}
+		if( p_equations[ v ] ){
+			p_R[ v ] = this->do_R_v<T>( p_pressure[ WEST ], p_pressure[ CENT ], p_pressure[ EAST ], p_pressure[ EEAST ],
+									    p_gas_vol_frac[ WEST ], p_gas_vol_frac[ CENT ], p_gas_vol_frac[ EAST ], p_gas_vol_frac[ EEAST ],
+									    p_oil_vol_frac[ WEST ], p_oil_vol_frac[ CENT ], p_oil_vol_frac[ EAST ], p_oil_vol_frac[ EEAST ],
+									    p_velocity[ WEST ], p_velocity[ CENT ], p_velocity[ EAST ], i, position );
+		}
+	}
 
-	void DriftFluxWell::GMRES_Solve( smatrix_type &A, svector_type &x, svector_type &b )
+	// Rows without a residual are identity rows (boundary conditions, or alpha_g without gas)
+	bool DriftFluxWell::has_residual( uint_type p_node, uint_type p_equation ){
+		uint_type LAST = this->number_of_nodes()-1;
+		switch( p_equation ){
+		case alpha_g:
+			return p_node > 0 && m_with_gas;
+		case v:
+			return p_node < LAST;
+		default:
+			return p_node > 0;
+		}
+	}
+
+	// With p_face_loop the mass balances take their face fluxes from m_face_fluxes (compute_face_fluxes())
+	void DriftFluxWell::compute_block_row_residual( uint_type p_node, const bool p_equations[], real_type p_R[], bool p_face_loop )
+	{
+		enum{ stencil_size = 4 };
+		real_type pressure[ stencil_size ];
+		real_type gas_vol_frac[ stencil_size ];
+		real_type oil_vol_frac[ stencil_size ];
+		real_type velocity[ stencil_size ];
+
+		int LAST = int( this->number_of_nodes() ) - 1;
+		for( int b = 0; b < stencil_size; ++b ){
+			int node = int( p_node ) + b - 1;
+			bool inside = node >= 0 && node <= LAST;
+			pressure[ b ]	  = inside ? m_pressure[ node ]		 : 0.;
+			gas_vol_frac[ b ] = inside ? m_gas_vol_frac[ node ]	 : 0.;
+			oil_vol_frac[ b ] = inside ? m_oil_vol_frac[ node ]	 : 0.;
+			velocity[ b ]	  = inside ? m_mean_velocity[ node ] : 0.;
+		}
+
+		FaceFluxes<real_type> faces[ 2 ];
+		if( p_face_loop ){
+			if( int( p_node ) > 0 )	  faces[ 0 ] = m_face_fluxes[ p_node-1 ];
+			if( int( p_node ) < LAST ) faces[ 1 ] = m_face_fluxes[ p_node ];
+		}
+		this->do_block_row_residual<real_type>( p_node, p_equations, pressure, gas_vol_frac, oil_vol_frac, velocity,
+												p_face_loop ? faces : 0, p_R );
+	}
+
+	// The fluxes of every face at the current state, each evaluated once
+	void DriftFluxWell::compute_face_fluxes()
 	{
+		int faces = int( this->number_of_nodes() ) - 1;
+		m_face_fluxes.resize( faces );
+		#pragma omp parallel for num_threads( m_number_of_threads ) schedule( static )
+		for( int k = 0; k < faces; ++k ){
+			this->do_face_fluxes<real_type>( m_pressure[ k ], m_pressure[ k+1 ], m_gas_vol_frac[ k ], m_gas_vol_frac[ k+1 ],
+											 m_oil_vol_frac[ k ], m_oil_vol_frac[ k+1 ], m_mean_velocity[ k ], k, m_face_fluxes[ k ] );
+		}
+	}
+
+	// R(x), laid out like the unknowns. Identity rows hold zero.
+	void DriftFluxWell::compute_residual( vector_type& p_residual )
+	{
+		uint_type LAST = this->number_of_nodes()-1;
+		p_residual.assign( total_var*( LAST + 1 ), 0. );
+		this->update_property_cache();
+		this->prepare_thread_status();
+		this->compute_face_fluxes();
+		#pragma omp parallel for num_threads( m_number_of_threads ) schedule( static )
+		for( int i = 0; i <= int( LAST ); ++i ){
+			bool equations[ total_var ];
+			for( int eq = 0; eq < total_var; ++eq ) equations[ eq ] = this->has_residual( i, eq );
+			this->compute_block_row_residual( i, equations, &p_residual[ id(i, P) ], true );
+		}
+		this->gather_thread_status();
+	}
+
+	// F(u): the residual at the unknowns p_unknowns, and the unknown itself on the identity rows, so
+	// that its Jacobian is the Newton matrix. The state of the well is left as it was.
+	void DriftFluxWell::newton_function( const vector_type& p_unknowns, vector_type& p_F )
+	{
+		this->get_unknowns( m_newton_function_state );
+		this->set_unknowns( p_unknowns );
+		this->compute_residual( p_F );
+		this->set_unknowns( m_newton_function_state );
+
+		for( uint_type i = 0; i < this->number_of_nodes(); ++i ){
+			for( int eq = 0; eq < total_var; ++eq ){
+				if( !this->has_residual( i, eq ) ) p_F[ id(i, eq) ] = p_unknowns[ id(i, eq) ];
+			}
+		}
+	}
+
+	// Unknowns laid out like m_variables
+	void DriftFluxWell::get_unknowns( vector_type& p_unknowns )
+	{
+		p_unknowns.resize( m_state.number_of_unknowns() );
+		m_state.get_unknowns( p_unknowns );
+	}
+
+	void DriftFluxWell::set_unknowns( const vector_type& p_unknowns )
+	{
+		m_state.set_unknowns( p_unknowns );
+		for( uint_type i = 0; i < this->number_of_nodes(); ++i ){
+			m_water_vol_frac[ i ] = 1.0 - (m_gas_vol_frac[ i ] + m_oil_vol_frac[ i ]);
+		}
+	}
+
+	void DriftFluxWell::linear_solve( bmatrix_type &A, svector_type &x, svector_type &b )
+	{
+		if( m_inexact_newton ){
+			// Eisenstat-Walker bounds the residual of the step itself, so the step starts from zero
+			this->update_forcing_term( itl::two_norm( b ) );
+			for( uint_type k = 0; k < x.size(); ++k ) x[ k ] = 0.0;
+		}
+		if( m_jacobian_method == JACOBIAN_FREE ){
+			// There is no A to solve with
+			JacobianFree_Solve( x, b );
+			return;
+		}
+		switch( m_linear_solver ){
+		case BLOCK_BANDED_LU:
+			BlockBanded_Solve( A, x, b );
+			break;
+		case PARALLEL_BLOCK_BANDED_LU:
+			PartitionedBlockBanded_Solve( A, x, b );
+			break;
+		default:
+			Krylov_Solve( A, x, b );
+		}
+	}
+
+	bool DriftFluxWell::set_krylov_solver( const std::string& p_method, const std::string& p_preconditioner )
+	{
+		if( p_method == "auto" ){
+			this->set_krylov_auto_tune( true, m_tuning_jacobians );
+			return true;
+		}
+		int method = 0, preconditioner = 0;
+		while( method < total_krylov_methods && p_method != KRYLOV_METHOD_NAMES[ method ] ) ++method;
+		while( preconditioner < total_preconditioners && p_preconditioner != PRECONDITIONER_NAMES[ preconditioner ] ) ++preconditioner;
+		if( method == total_krylov_methods || preconditioner == total_preconditioners ) return false;
+		if( !krylov_pair_supported( krylov_method_type( method ), preconditioner_type( preconditioner ) ) ) return false;
+
+		this->set_krylov_solver( krylov_method_type( method ), preconditioner_type( preconditioner ) );
+		return true;
+	}
+
+	void DriftFluxWell::Krylov_Solve( bmatrix_type &A, svector_type &x, svector_type &b )
+	{
+		if( m_krylov_auto_tune && m_tuned_jacobians < m_tuning_jacobians ){
+			this->Krylov_Tune( A, x, b );
+			return;
+		}
 		m_convergence_status = true;
-            			
-        itl::ILU<smatrix_type> precond(A);
-        // SSOR preconditioner			
-        //itl::SSOR<smatrix_type> precond(A);		
-        svector_type b2( A.ncols() );			
-        itl::solve(precond(), b, b2); //gmres needs the preconditioned b to pass into iter object.
-        //iteration
-        int max_iter = 1000;	//ex: 1000			
-        itl::noisy_iteration<double> iter(b2, max_iter, 0.0, 1E-6);
+
+		// The factors are kept from earlier iterations while they still work
+		bool factored = m_preconditioner != NO_PRECONDITIONER;
+		bool reused = factored && m_preconditioner_reuse && m_refactor_reason == NO_REFACTOR
+				   && this->preconditioner_blocks() == A.number_of_blocks();
+		if( reused ){
+			++m_preconditioner_statistics.reuses;
+		}
+		else if( factored && !this->refactor_preconditioner( A ) ){
+			return;
+		}
+
+		// Stale factors only get a few times the iterations of fresh ones before a refactor
+		int max_iterations = MAX_KRYLOV_ITERATIONS;
+		if( reused ){
+			max_iterations = int( std::max( m_refactor_iteration_growth*m_iterations_after_refactor, real_type( m_refactor_min_iterations ) ) );
+		}
+		int iterations = 0;
+		m_convergence_status = this->Krylov_Iterate( m_krylov_method, m_preconditioner, A, x, b, max_iterations, iterations );
+		if( m_convergence_status && reused ){
+			// Too stale to converge, or to converge in time: refactor and solve again
+			this->request_refactor( iterations >= max_iterations ? ITERATION_GROWTH : FAILED_SOLVE );
+			if( !this->refactor_preconditioner( A ) ) return;
+			m_convergence_status = this->Krylov_Iterate( m_krylov_method, m_preconditioner, A, x, b, MAX_KRYLOV_ITERATIONS, iterations );
+			reused = false;
+		}
+
+		if( !reused ){
+			m_iterations_after_refactor = iterations;
+			// Worse than when it was chosen even with fresh factors: another pair may do better now
+			if( m_krylov_auto_tune && ( m_convergence_status
+				|| iterations > std::max( m_refactor_iteration_growth*m_tuned_iterations, real_type( m_refactor_min_iterations ) ) ) ){
+				m_tuned_jacobians = 0;
+			}
+		}
+	}
+
+	// One Jacobian of an auto-tuning round: every pair of Krylov method and preconditioner solves it
+	// from the same initial guess, and the time it took, its factorization included, adds to the
+	// pair's total. Newton goes on with the solution of the fastest. The factorizations count in
+	// tuning_factorizations, not in factorizations.
+	void DriftFluxWell::Krylov_Tune( bmatrix_type &A, svector_type &x, svector_type &b )
+	{
+		if( m_tuned_jacobians == 0 ){
+			++m_preconditioner_statistics.krylov_tunings;
+			for( int k = 0; k < total_krylov_methods; ++k ){
+				for( int p = 0; p < total_preconditioners; ++p ){
+					KrylovTrial& trial = m_krylov_trials[ k ][ p ];
+					trial.time = 0.0;
+					trial.iterations = 0;
+					trial.last_iterations = 0;
+					trial.failed = false;
+				}
+			}
+		}
+		if( m_tuning_guess.size() != x.size() ){
+			m_tuning_guess = svector_type( x.size() );
+			m_tuning_solution = svector_type( x.size() );
+			++m_newton_statistics.workspace_resizes;
+		}
+		itl::copy( x, m_tuning_guess );
+
+		Timer timer;
+		real_type best_time = -1.0;
+		for( int p = 0; p < total_preconditioners; ++p ){
+			if( p != NO_PRECONDITIONER ) ++m_preconditioner_statistics.tuning_factorizations;
+			timer.start();
+			bool factored = this->factor_preconditioner( preconditioner_type( p ), A );
+			timer.stop();
+			real_type factor_time = timer.elapsed();
+
+			for( int k = 0; k < total_krylov_methods; ++k ){
+				// A pair that failed once can't be kept, so it isn't run again
+				KrylovTrial& trial = m_krylov_trials[ k ][ p ];
+				if( !factored || trial.failed || !krylov_pair_supported( krylov_method_type( k ), preconditioner_type( p ) ) ){
+					trial.failed = true;
+					continue;
+				}
+				itl::copy( m_tuning_guess, x );
+				int iterations = 0;
+				timer.start();
+				bool failed = this->Krylov_Iterate( krylov_method_type( k ), preconditioner_type( p ), A, x, b, MAX_KRYLOV_ITERATIONS, iterations ) != 0;
+				timer.stop();
+				real_type time = factor_time + timer.elapsed();
+
+				trial.time += time;
+				trial.iterations += iterations;
+				trial.last_iterations = iterations;
+				trial.failed = trial.failed || failed;
+				if( !failed && ( best_time < 0.0 || time < best_time ) ){
+					best_time = time;
+					itl::copy( x, m_tuning_solution );
+				}
+			}
+		}
+
+		m_convergence_status = best_time < 0.0;
+		if( !m_convergence_status ) itl::copy( m_tuning_solution, x );
+		if( ++m_tuned_jacobians == m_tuning_jacobians ) this->finish_krylov_tuning();
+	}
+
+	// Keeps the pair that converged on every Jacobian of the round in the least time; the current
+	// one if none did. The times are clock() times, too coarse on a short well to tell close pairs
+	// apart: GMRES + block ILU, the default, is only given up for a pair TUNING_MARGIN faster, and
+	// between the others fewer iterations break ties. All the preconditioners were just factored on
+	// the last Jacobian, so the kept one is fresh; the scalar ones share m_scalar_preconditioner,
+	// and preconditioner_blocks() has the kept one refactored if another was factored after it.
+	void DriftFluxWell::finish_krylov_tuning()
+	{
+		const KrylovTrial* const fallback = &m_krylov_trials[ KRYLOV_GMRES ][ BLOCK_ILU ];
+		const KrylovTrial* best = 0;
+		if( !fallback->failed ){
+			best = fallback;
+			m_krylov_method  = KRYLOV_GMRES;
+			m_preconditioner = BLOCK_ILU;
+		}
+		for( int k = 0; k < total_krylov_methods; ++k ){
+			for( int p = 0; p < total_preconditioners; ++p ){
+				const KrylovTrial& trial = m_krylov_trials[ k ][ p ];
+				if( trial.failed || &trial == fallback ) continue;
+				bool faster;
+				if( best == 0 )				faster = true;
+				else if( best == fallback )	faster = trial.time < ( 1.0 - TUNING_MARGIN )*best->time;
+				else						faster = trial.time < best->time || ( trial.time == best->time && trial.iterations < best->iterations );
+				if( faster ){
+					best = &trial;
+					m_krylov_method  = krylov_method_type( k );
+					m_preconditioner = preconditioner_type( p );
+				}
+			}
+		}
+		if( best == 0 ) std::cout << "\nKrylov_Tune: no pair converged on every Jacobian";
+		else			std::cout << "\nKrylov_Tune: " << krylov_method_name( m_krylov_method ) << " + " << preconditioner_name( m_preconditioner );
+		m_tuned_iterations = m_krylov_trials[ m_krylov_method ][ m_preconditioner ].last_iterations;
+		m_iterations_after_refactor = m_tuned_iterations;
+		m_refactor_reason = NO_REFACTOR;
+	}
+
+	// Returns the ITL error code: 0 on convergence
+	int DriftFluxWell::Krylov_Iterate( krylov_method_type p_method, preconditioner_type p_preconditioner, bmatrix_type &A, svector_type &x, svector_type &b, int p_max_iterations, int &p_iterations )
+	{
+		switch( p_preconditioner ){
+		case BLOCK_ILU:
+			if( m_mixed_precision ) return this->run_krylov_method( p_method, m_float_block_solver, A, x, b, p_max_iterations, p_iterations );
+			return this->run_krylov_method( p_method, m_block_solver, A, x, b, p_max_iterations, p_iterations );
+		case BLOCK_JACOBI:
+			return this->run_krylov_method( p_method, m_block_diagonal, A, x, b, p_max_iterations, p_iterations );
+		case CPR:
+			m_cpr.set_matrix( A );
+			return this->run_krylov_method( p_method, m_cpr, A, x, b, p_max_iterations, p_iterations );
+		case SCHWARZ:
+			return this->run_krylov_method( p_method, m_schwarz, A, x, b, p_max_iterations, p_iterations );
+		case SCALAR_ILU:
+		case ILUT:
+		case SSOR:
+		case DIAGONAL:
+			return this->run_krylov_method( p_method, m_scalar_preconditioner, A, x, b, p_max_iterations, p_iterations );
+		default:
+			return this->run_krylov_method( p_method, itl::identity_preconditioner(), A, x, b, p_max_iterations, p_iterations );
+		}
+	}
+
+	// GMRES, GCR and GCRO-DR are preconditioned on the left and test the preconditioned residual, so
+	// their tolerance is relative to M^-1 b; BiCGSTAB, CGS and TFQMR on the right and test the true
+	// one, as does QMR. All of them but QMR run on the Krylov workspace, so after the first call they
+	// don't allocate. The recycled space of GCRO-DR stays in the workspace across Newton iterations
+	// and timesteps.
+	template <class Preconditioner>
+	int DriftFluxWell::run_krylov_method( krylov_method_type p_method, const Preconditioner& M, bmatrix_type &A, svector_type &x, svector_type &b, int p_max_iterations, int &p_iterations )
+	{
         int restart = 10; //restart constant: 10
-        // modified_gram_schmidt				
-        itl::modified_gram_schmidt<svector_type> orth( restart, x.size() );			
-        //gmres algorithm	            
-        m_convergence_status = itl::gmres(A, x, b, precond(), restart, iter, orth); 
-			
-	
+        int max_iter = p_max_iterations;
+        if( m_krylov_workspace.reserve( A.ncols(), restart ) ) ++m_newton_statistics.workspace_resizes;
+        svector_type& b2 = m_krylov_workspace.rhs();
+        if( p_method == KRYLOV_GMRES || p_method == KRYLOV_GCR || p_method == KRYLOV_GCRODR ) itl::solve(M, b, b2);
+        else itl::copy(b, b2);
+        itl::noisy_iteration<double> iter(b2, max_iter, 0.0, this->krylov_tolerance( itl::two_norm( b2 ) ));
+
+        int error;
+        switch( p_method ){
+        case KRYLOV_BICGSTAB:
+            error = m_krylov_workspace.bicgstab(A, x, b, M, iter);
+            break;
+        case KRYLOV_TFQMR:
+            error = m_krylov_workspace.tfqmr(A, x, b, M, iter);
+            break;
+        case KRYLOV_CGS:
+            error = m_krylov_workspace.cgs(A, x, b, M, iter);
+            break;
+        case KRYLOV_GCR:
+            error = m_krylov_workspace.gcr(A, x, b, M, restart, iter);
+            break;
+        case KRYLOV_GCRODR:
+            error = m_krylov_workspace.gcrodr(A, x, b, M, restart, m_krylov_recycle_dimension, iter);
+            m_preconditioner_statistics.recycled_iterations_saved += m_krylov_workspace.iterations_saved();
+            m_preconditioner_statistics.recycle_applies += m_krylov_workspace.recycle_applies();
+            break;
+        case KRYLOV_QMR:
+            error = run_qmr(A, x, b, M, iter);
+            break;
+        default:
+            //gmres algorithm, on the basis and work vectors of the workspace
+            error = m_krylov_workspace.gmres(A, x, b, M, restart, iter);
+        }
+        p_iterations = iter.iterations();
+        this->count_krylov_iterations( p_iterations, iter.resid(), iter.normb() );
+        return error;
+	}
+
+	// Numeric factorization only: the block pattern of the preconditioner is kept from the first one.
+	bool DriftFluxWell::refactor_preconditioner( bmatrix_type &A )
+	{
+		++m_preconditioner_statistics.factorizations;
+		++m_preconditioner_statistics.refactor_reasons[ m_refactor_reason ];
+		m_refactor_reason = NO_REFACTOR;
+
+		if( !this->factor_preconditioner( m_preconditioner, A ) ){
+			std::cout << "\nKrylov_Solve: singular diagonal block in the preconditioner";
+			this->request_refactor( FAILED_SOLVE );
+			return false;
+		}
+		return true;
+	}
+
+	bool DriftFluxWell::factor_preconditioner( preconditioner_type p_preconditioner, bmatrix_type &A )
+	{
+		switch( p_preconditioner ){
+		case BLOCK_ILU:
+			if( m_mixed_precision ){
+				m_float_block_solver.load( A );
+				return m_float_block_solver.factorize();
+			}
+			m_block_solver.load( A );
+			return m_block_solver.factorize();
+		case BLOCK_JACOBI:
+			m_block_diagonal.resize( A.number_of_blocks() );
+			for( uint_type i = 0; i < A.number_of_blocks(); ++i ){
+				block4x4::copy( A.block( i, bmatrix_type::C ), m_block_diagonal.block( i ) );
+			}
+			return m_block_diagonal.factorize();
+		case CPR:
+			return m_cpr.factorize( A );
+		case SCHWARZ:
+			m_schwarz.set_number_of_threads( m_number_of_threads );
+			return m_schwarz.factorize( A );
+		case SCALAR_ILU:
+		case ILUT:
+		case SSOR:
+		case DIAGONAL:
+			return m_scalar_preconditioner.factorize( A, scalar_preconditioner_kind( p_preconditioner ) );
+		default:
+			return true;
+		}
+	}
+
+	// Block rows of the factors of m_preconditioner, 0 before the first factorization
+	uint_type DriftFluxWell::preconditioner_blocks() const
+	{
+		switch( m_preconditioner ){
+		case BLOCK_ILU:		return m_mixed_precision ? m_float_block_solver.number_of_blocks() : m_block_solver.number_of_blocks();
+		case BLOCK_JACOBI:	return m_block_diagonal.number_of_blocks();
+		case CPR:			return m_cpr.number_of_blocks();
+		case SCHWARZ:		return m_schwarz.number_of_blocks();
+		case SCALAR_ILU:
+		case ILUT:
+		case SSOR:
+		case DIAGONAL:		return m_scalar_preconditioner.kind() == scalar_preconditioner_kind( m_preconditioner ) ? m_scalar_preconditioner.number_of_blocks() : 0;
+		default:			return 0;
+		}
+	}
+
+	// Eisenstat-Walker choice 2: eta_k = gamma*( ||F_k||/||F_k-1|| )^alpha, capped at eta_max. With
+	// 0.9 as the cap Newton wandered far from the solution, so it is 0.1; with globalization it is
+	// 0.01, as the steps of the left preconditioned GMRES at 0.1 were too poor for the line search
+	// to make progress. At 0.01 the usual safeguard against a sudden drop of eta can never trigger.
+	// The last Newton step need not be solved beyond NEWTON_CRIT.
+	void DriftFluxWell::update_forcing_term( real_type p_residual_norm )
+	{
+		const real_type gamma	= 0.9;
+		const real_type alpha	= 2.0;
+		const real_type eta_max = m_newton_globalization ? 0.01 : 0.1;
+
+		real_type eta = eta_max;
+		if( m_previous_residual_norm > 0.0 ) eta = gamma*pow( p_residual_norm/m_previous_residual_norm, alpha );
+		if( p_residual_norm > 0.0 ) eta = std::max( eta, 0.5*this->NEWTON_CRIT/p_residual_norm );
+
+		m_previous_residual_norm = p_residual_norm;
+		m_forcing_term			 = std::min( eta, eta_max );
+	}
+
+	// Starts a new sequence of Newton iterations (new timestep or a cut one)
+	void DriftFluxWell::reset_forcing_term()
+	{
+		m_previous_residual_norm = -1.0;
+	}
+
+	// Absolute tolerance of the Krylov iterations on a right hand side of norm p_rhs_norm. The
+	// exact mode solves every step to KRYLOV_TOLERANCE, the inexact one never tighter, unless the
+	// right hand side is already below it: the step starts from zero, so the solve would stop before
+	// its first iteration and Newton would stall on zero steps just above NEWTON_CRIT.
+	real_type DriftFluxWell::krylov_tolerance( real_type p_rhs_norm ) const
+	{
+		if( !m_inexact_newton ) return KRYLOV_TOLERANCE;
+		real_type tolerance = std::max( m_forcing_term*p_rhs_norm, KRYLOV_TOLERANCE );
+		return tolerance < p_rhs_norm ? tolerance : m_forcing_term*p_rhs_norm;
+	}
+
+	// Counts the iterations of one Krylov solve, down from p_rhs_norm to p_residual. The iterations
+	// an exact solve would have taken are extrapolated from the observed convergence rate.
+	void DriftFluxWell::count_krylov_iterations( int p_iterations, real_type p_residual, real_type p_rhs_norm )
+	{
+		m_preconditioner_statistics.krylov_iterations += p_iterations;
+		if( !m_inexact_newton || p_iterations == 0 || !( p_residual > KRYLOV_TOLERANCE && p_residual < p_rhs_norm ) ) return;
+
+		real_type rate = pow( p_residual/p_rhs_norm, 1.0/p_iterations );
+		int exact_iterations = int( ceil( log( KRYLOV_TOLERANCE/p_rhs_norm )/log( rate ) ) );
+		if( exact_iterations > p_iterations ) m_preconditioner_statistics.krylov_iterations_saved += exact_iterations - p_iterations;
+	}
+
+	// The next Krylov_Solve, or the next compute_Jacobian_free, refactors the preconditioner
+	// Nothing to refactor before the first factorization, whose reason is kept
+	void DriftFluxWell::request_refactor( refactor_reason_type p_reason )
+	{
+		if( m_refactor_reason == FIRST_FACTORIZATION ) return;
+		m_refactor_reason = p_reason;
+	}
+
+	void DriftFluxWell::reset_preconditioner_statistics()
+	{
+		m_preconditioner_statistics.factorizations	   = 0;
+		m_preconditioner_statistics.reuses			   = 0;
+		m_preconditioner_statistics.krylov_iterations = 0;
+		m_preconditioner_statistics.krylov_iterations_saved = 0;
+		for( int k = 0; k < total_refactor_reasons; ++k ) m_preconditioner_statistics.refactor_reasons[ k ] = 0;
+		m_preconditioner_statistics.krylov_tunings = 0;
+		m_preconditioner_statistics.tuning_factorizations = 0;
+		m_preconditioner_statistics.refinement_steps = 0;
+		m_preconditioner_statistics.recycled_iterations_saved = 0.0;
+		m_preconditioner_statistics.recycle_applies = 0;
+	}
+
+	// Direct O(N) solve exploiting the W/P/E/EE block structure of the Jacobian.
+	void DriftFluxWell::BlockBanded_Solve( bmatrix_type &A, svector_type &x, svector_type &b )
+	{
+		m_convergence_status = true;
+
+		if( m_mixed_precision ){
+			this->BlockBanded_Refine( A, x, b );
+			return;
+		}
+		m_block_solver.load( A );
+		if( !m_block_solver.factorize() ){
+			std::cout << "\nBlockBanded_Solve: singular diagonal block";
+			return;
+		}
+		m_block_solver.solve( b, x );
+
+		m_convergence_status = false;
+	}
+
+	// Mixed precision BLOCK_BANDED_LU: iterative refinement x <- x + LU^-1 ( b - A x ) with the
+	// single precision factors and the residual in double, until the residual is down to the
+	// tolerance the Krylov solve would reach. Each pass gains about the digits of a float solve.
+	void DriftFluxWell::BlockBanded_Refine( bmatrix_type &A, svector_type &x, svector_type &b )
+	{
+		const int max_refinement_steps = 10;
+
+		m_float_block_solver.load( A );
+		if( !m_float_block_solver.factorize() ){
+			std::cout << "\nBlockBanded_Solve: singular diagonal block";
+			return;
+		}
+		if( m_refinement_residual.size() != b.size() ){
+			m_refinement_residual = svector_type( b.size() );
+			++m_newton_statistics.workspace_resizes;
+		}
+		svector_type& r = m_refinement_residual;
+		real_type tolerance = this->krylov_tolerance( itl::two_norm( b ) );
+
+		itl::copy( b, r );
+		for( uint_type k = 0; k < x.size(); ++k ) x[ k ] = 0.0;
+		for( int step = 0; step < max_refinement_steps; ++step ){
+			++m_preconditioner_statistics.refinement_steps;
+			m_float_block_solver.solve( r, r );
+			itl::add( r, x );
+			itl::mult( A, itl::scaled( x, -1.0 ), b, r );
+			if( itl::two_norm( r ) <= tolerance ){
+				m_convergence_status = false;
+				return;
+			}
+		}
+		std::cout << "\nBlockBanded_Solve: no convergence of the mixed precision refinement";
+	}
+
+	// BlockBanded_Solve on one partition of the well per thread, for long wells where the serial
+	// elimination dominates the Newton iteration.
+	void DriftFluxWell::PartitionedBlockBanded_Solve( bmatrix_type &A, svector_type &x, svector_type &b )
+	{
+		m_convergence_status = true;
+
+		m_partitioned_solver.set_number_of_threads( m_number_of_threads );
+		m_partitioned_solver.load( A );
+		if( !m_partitioned_solver.factorize() ){
+			std::cout << "\nPartitionedBlockBanded_Solve: singular diagonal block";
+			return;
+		}
+		m_partitioned_solver.solve( b, x );
+
+		m_convergence_status = false;
+	}
+
+	// Newton-Krylov without the Jacobian: GMRES only needs J*x, taken by differencing the residual
+	// around the state of the last compute_Jacobian_free(). The lagged diagonal blocks precondition
+	// on the right, so GMRES tests the true residual and not the differencing error scaled by D^-1.
+	void DriftFluxWell::JacobianFree_Solve( svector_type &x, svector_type &b )
+	{
+		m_convergence_status = true;
+
+		int restart = JFNK_RESTART;
+		if( m_krylov_workspace.reserve( x.size(), restart ) ) ++m_newton_statistics.workspace_resizes;
+		if( !m_jacobian_free || m_jacobian_free->nrows() != x.size() ){
+			// The operators keep pointers to m_newton_unknowns, m_newton_function and m_block_diagonal
+			NewtonFunction F = { this };
+			m_jacobian_free = MakeShared<jacobian_free_type>( F, m_newton_unknowns, m_newton_function );
+			m_preconditioned_jacobian_free = MakeShared<preconditioned_jacobian_free_type>( *m_jacobian_free, m_block_diagonal );
+			++m_newton_statistics.workspace_resizes;
+		}
+
+		svector_type& y = m_krylov_workspace.solution();
+		for( uint_type k = 0; k < y.size(); ++k ) y[ k ] = 0.0;
+		itl::noisy_iteration<double> iter(b, MAX_KRYLOV_ITERATIONS, 0.0, this->krylov_tolerance( itl::two_norm( b ) ));
+		itl::identity_preconditioner I;
+		m_convergence_status = m_krylov_workspace.gmres(*m_preconditioned_jacobian_free, y, b, I, restart, iter);
+		m_block_diagonal.solve( y, x );
+		this->count_krylov_iterations( iter.iterations(), iter.resid(), iter.normb() );
 	}
 
 	void DriftFluxWell::compute_Jacobian()
+	{
+		this->update_property_cache();
+		// Jacobian-free mode never assembles the matrix, so it is only allocated here
+		if( m_jacobian_method != JACOBIAN_FREE && m_matrix->number_of_blocks() != this->number_of_nodes() ){
+			m_matrix->resize( this->number_of_nodes() );
+			++m_newton_statistics.workspace_resizes;
+		}
+		switch( m_jacobian_method ){
+		case FINITE_DIFFERENCE:
+			compute_Jacobian_FD();
+			break;
+		case COLORED_FINITE_DIFFERENCE:
+			compute_Jacobian_colored_FD();
+			break;
+		case JACOBIAN_FREE:
+			compute_Jacobian_free();
+			break;
+		default:
+			compute_Jacobian_AD();
+		}
+	}
+
+	// Forward-mode AD: every residual is evaluated once with the unknowns of its W, P, E and EE
+	// nodes seeded, which gives the whole block row exactly. Boundary rows follow compute_Jacobian_FD.
+	void DriftFluxWell::compute_Jacobian_AD()
+	{
+		uint_type LAST = this->number_of_nodes()-1;
+		this->prepare_thread_status();
+		this->compute_AD_face_fluxes();
+		#pragma omp parallel for num_threads( m_number_of_threads ) schedule( static )
+		for( int i = 0; i <= int( LAST ); ++i ){
+			this->compute_Jacobian_AD_row( i );
+		}
+		this->gather_thread_status();
+	}
+
+	void DriftFluxWell::compute_Jacobian_AD_row( uint_type p_node )
+	{
+		enum{ WEST, CENT, EAST, EEAST, stencil_size };
+
+		bool equations[ total_var ];
+		ad_type R[ total_var ];
+		this->compute_AD_row_residual( p_node, equations, R );
+
+		uint_type i = p_node;
+		for( int b = WEST; b < stencil_size; ++b ){
+			double* block = m_matrix->block( i, b - 1 );
+			if( !block ) continue;
+			for( int eq = 0; eq < total_var; ++eq ){
+				for( int var = 0; var < total_var; ++var ){
+					block[ total_var*eq + var ] = equations[ eq ] ? R[ eq ].derivative( total_var*b + var )
+																  : ( ( b == CENT && var == eq ) ? 1. : 0. );
+				}
+			}
+		}
+		for( int eq = 0; eq < total_var; ++eq ){
+			if( equations[ eq ] ) (*this->m_source)[ id(i, eq) ] = -R[ eq ].value();
+		}
+	}
+
+	// The fluxes of every face with the unknowns of its west and east nodes seeded as the P and E
+	// nodes of a stencil, which is how the west node of the face sees them
+	void DriftFluxWell::compute_AD_face_fluxes()
+	{
+		enum{ CENT = 1, EAST = 2 };
+		int faces = int( this->number_of_nodes() ) - 1;
+		m_ad_face_fluxes.resize( faces );
+		#pragma omp parallel for num_threads( m_number_of_threads ) schedule( static )
+		for( int k = 0; k < faces; ++k ){
+			this->do_face_fluxes<ad_type>(
+				ad_type( m_pressure[ k ],		total_var*CENT + P ),		ad_type( m_pressure[ k+1 ],		total_var*EAST + P ),
+				ad_type( m_gas_vol_frac[ k ],	total_var*CENT + alpha_g ), ad_type( m_gas_vol_frac[ k+1 ], total_var*EAST + alpha_g ),
+				ad_type( m_oil_vol_frac[ k ],	total_var*CENT + alpha_o ), ad_type( m_oil_vol_frac[ k+1 ], total_var*EAST + alpha_o ),
+				ad_type( m_mean_velocity[ k ],	total_var*CENT + v ),
+				k, m_ad_face_fluxes[ k ]
+				);
+		}
+	}
+
+	// Residuals of block row p_node with the unknowns of its W, P, E and EE nodes seeded, the mass
+	// balances from the face fluxes of compute_AD_face_fluxes(); p_equations tells which rows have
+	// a residual.
+	void DriftFluxWell::compute_AD_row_residual( uint_type p_node, bool p_equations[], ad_type p_R[] )
+	{
+		enum{ WEST, CENT, EAST, EEAST, stencil_size };
+
+		ad_type pressure[ stencil_size ];
+		ad_type gas_vol_frac[ stencil_size ];
+		ad_type oil_vol_frac[ stencil_size ];
+		ad_type velocity[ stencil_size ];
+
+		uint_type i    = p_node;
+		uint_type LAST = this->number_of_nodes()-1;
+		for( int b = WEST; b < stencil_size; ++b ){
+			int node = int( i ) + b - 1;
+			if( node < 0 || node > int( LAST ) ){
+				pressure[ b ] = gas_vol_frac[ b ] = oil_vol_frac[ b ] = velocity[ b ] = ad_type();
+				continue;
+			}
+			pressure[ b ]	  = ad_type( m_pressure[ node ],		total_var*b + P );
+			gas_vol_frac[ b ] = ad_type( m_gas_vol_frac[ node ],	total_var*b + alpha_g );
+			oil_vol_frac[ b ] = ad_type( m_oil_vol_frac[ node ],	total_var*b + alpha_o );
+			velocity[ b ]	  = ad_type( m_mean_velocity[ node ],	total_var*b + v );
+		}
+
+		// The east node of the west face sees its unknowns as the P node: one stencil node east
+		FaceFluxes<ad_type> faces[ 2 ];
+		if( i > 0 ){
+			const FaceFluxes<ad_type>& west = m_ad_face_fluxes[ i-1 ];
+			faces[ 0 ].gas	 = seeded_one_node_west( west.gas );
+			faces[ 0 ].oil	 = seeded_one_node_west( west.oil );
+			faces[ 0 ].water = seeded_one_node_west( west.water );
+		}
+		if( i < LAST ) faces[ 1 ] = m_ad_face_fluxes[ i ];
+
+		for( int eq = 0; eq < total_var; ++eq ) p_equations[ eq ] = this->has_residual( i, eq );
+		this->do_block_row_residual<ad_type>( i, p_equations, pressure, gas_vol_frac, oil_vol_frac, velocity, faces, p_R );
+	}
+
+	// Jacobian-free mode: only the residual (the source) and, every m_preconditioner_lag Newton
+	// iterations, the diagonal blocks for the preconditioner. m_matrix is left untouched.
+	void DriftFluxWell::compute_Jacobian_free()
+	{
+		uint_type LAST = this->number_of_nodes()-1;
+		this->get_unknowns( m_newton_unknowns );
+		this->newton_function( m_newton_unknowns, m_newton_function );
+		for( uint_type i = 0; i <= LAST; ++i ){
+			for( int eq = 0; eq < total_var; ++eq ){
+				if( this->has_residual( i, eq ) ) (*this->m_source)[ id(i, eq) ] = -m_newton_function[ id(i, eq) ];
+			}
+		}
+
+		if( m_block_diagonal.number_of_blocks() != LAST + 1 || m_preconditioner_age >= m_preconditioner_lag
+			|| m_refactor_reason != NO_REFACTOR ){
+			if( m_refactor_reason == NO_REFACTOR ) m_refactor_reason = PRECONDITIONER_LAG;
+			++m_preconditioner_statistics.factorizations;
+			++m_preconditioner_statistics.refactor_reasons[ m_refactor_reason ];
+			m_refactor_reason = NO_REFACTOR;
+			this->compute_block_diagonal();
+			m_preconditioner_age = 0;
+		}
+		else{
+			++m_preconditioner_statistics.reuses;
+		}
+		++m_preconditioner_age;
+	}
+
+	// Diagonal blocks of the Jacobian by AD, factored for the block Jacobi preconditioner. Only the
+	// unknowns of the row's own node are seeded, 4 directions rather than the 16 of a block row, and
+	// the mass balances take the fluxes of the two faces of the node from its stencil.
+	void DriftFluxWell::compute_block_diagonal()
+	{
+		enum{ WEST, CENT, EAST, EEAST, stencil_size };
+		int LAST = int( this->number_of_nodes() ) - 1;
+		m_block_diagonal.resize( LAST + 1 );
+
+		this->prepare_thread_status();
+		#pragma omp parallel for num_threads( m_number_of_threads ) schedule( static )
+		for( int i = 0; i <= LAST; ++i ){
+			ad_node_type pressure[ stencil_size ];
+			ad_node_type gas_vol_frac[ stencil_size ];
+			ad_node_type oil_vol_frac[ stencil_size ];
+			ad_node_type velocity[ stencil_size ];
+			for( int b = WEST; b < stencil_size; ++b ){
+				int node = i + b - 1;
+				if( node < 0 || node > LAST ) continue;
+				if( b == CENT ){
+					pressure[ b ]	  = ad_node_type( m_pressure[ node ],		P );
+					gas_vol_frac[ b ] = ad_node_type( m_gas_vol_frac[ node ],	alpha_g );
+					oil_vol_frac[ b ] = ad_node_type( m_oil_vol_frac[ node ],	alpha_o );
+					velocity[ b ]	  = ad_node_type( m_mean_velocity[ node ],	v );
+				}
+				else{
+					pressure[ b ]	  = m_pressure[ node ];
+					gas_vol_frac[ b ] = m_gas_vol_frac[ node ];
+					oil_vol_frac[ b ] = m_oil_vol_frac[ node ];
+					velocity[ b ]	  = m_mean_velocity[ node ];
+				}
+			}
+
+			bool equations[ total_var ];
+			ad_node_type R[ total_var ];
+			for( int eq = 0; eq < total_var; ++eq ) equations[ eq ] = this->has_residual( i, eq );
+			this->do_block_row_residual<ad_node_type>( i, equations, pressure, gas_vol_frac, oil_vol_frac, velocity, 0, R );
+
+			double* block = m_block_diagonal.block( i );
+			for( int eq = 0; eq < total_var; ++eq ){
+				for( int var = 0; var < total_var; ++var ){
+					block[ total_var*eq + var ] = equations[ eq ] ? R[ eq ].derivative( var ) : ( var == eq ? 1. : 0. );
+				}
+			}
+		}
+		this->gather_thread_status();
+
+		if( !m_block_diagonal.factorize() ){
+			std::cout << "\ncompute_block_diagonal: singular diagonal block";
+			m_convergence_status = true;
+		}
+	}
+
+	// Curtis-Powell-Reed finite differences. Column node j only enters rows j-2..j+1, so nodes four
+	// apart never share a row: one variable of every fourth node is perturbed at once and one full
+	// residual over all rows gives all of those columns. The Jacobian takes 16 residuals plus the
+	// base one whatever the number of nodes, each face evaluated once per residual, and it is
+	// compute_Jacobian_FD's matrix bit for bit: the increments are its own. At node 0 the residual
+	// copies the node into the missing W slot of its stencil, so a column of node 0 is the W plus
+	// the P derivative of row 0, as compute_Jacobian_FD perturbs both; likewise E and EE in row
+	// LAST-1.
+	void DriftFluxWell::compute_Jacobian_colored_FD()
+	{
+		enum{ number_of_colors = 4 };
+		uint_type LAST = this->number_of_nodes()-1;
+		WellState::field state[ total_var ] = { m_pressure, m_gas_vol_frac, m_oil_vol_frac, m_mean_velocity };
+		vector_type& R0	   = m_colored_residual;
+		vector_type& R	   = m_colored_perturbed;
+		vector_type& saved = m_colored_saved;
+		vector_type& delta = m_colored_delta;
+		if( saved.size() != LAST + 1 ){
+			saved.resize( LAST + 1 );
+			delta.resize( LAST + 1 );
+			++m_newton_statistics.workspace_resizes;
+		}
+
+		this->compute_residual( R0 );
+		for( uint_type i = 0; i <= LAST; ++i ){
+			for( int eq = 0; eq < total_var; ++eq ){
+				if( this->has_residual( i, eq ) ) (*this->m_source)[ id(i, eq) ] = -R0[ id(i, eq) ];
+			}
+		}
+
+		for( int var = 0; var < total_var; ++var ){
+			WellState::field x = state[ var ];
+			for( int color = 0; color < number_of_colors; ++color ){
+				for( uint_type j = color; j <= LAST; j += number_of_colors ){
+					saved[ j ] = x[ j ];
+					delta[ j ] = fd_increment( var, x[ j ], m_delta[ var ] );
+					x[ j ] += delta[ j ];
+				}
+				this->compute_residual( R );
+				for( uint_type j = color; j <= LAST; j += number_of_colors ) x[ j ] = saved[ j ];
+
+				#pragma omp parallel for num_threads( m_number_of_threads ) schedule( static )
+				for( int i = 0; i <= int( LAST ); ++i ){
+					// Offset of the one perturbed node in the W..EE stencil of row i
+					int offset = ( ( color - i ) % number_of_colors + number_of_colors + 1 ) % number_of_colors - 1;
+					double* block = m_matrix->block( i, offset );
+					if( !block ) continue;
+
+					for( int eq = 0; eq < total_var; ++eq ){
+						real_type& entry = block[ total_var*eq + var ];
+						if( !this->has_residual( i, eq ) )					entry = ( offset == 0 && var == eq ) ? 1. : 0.;
+						else if( residual_depends_on( eq, var, offset ) )	entry = ( R[ id(i, eq) ] - R0[ id(i, eq) ] )/delta[ i + offset ];
+						else												entry = 0.;
+					}
+				}
+			}
+		}
+
+		// The entries compute_Jacobian_FD takes with the outer increments, all of row 0 and the EE
+		// columns of the others, are differenced again where those differ from the above, that is
+		// at volume fractions and velocities below 1e-8. They are all in the momentum balance.
+		const bool equations[ total_var ] = { false, false, false, true };
+		real_type R_row[ total_var ];
+		this->prepare_thread_status();
+		for( uint_type i = 0; i + 2 <= LAST; ++i ){
+			for( int offset = ( i == 0 ) ? 0 : 2; offset <= 2; ++offset ){
+				double* block = m_matrix->block( i, offset );
+				for( int var = 0; var < total_var; ++var ){
+					if( !residual_depends_on( v, var, offset ) ) continue;
+					real_type& x_j = state[ var ][ i + offset ];
+					real_type increment = fd_outer_increment( var, x_j, m_delta[ var ] );
+					if( increment == fd_increment( var, x_j, m_delta[ var ] ) ) continue;
+
+					real_type value = x_j;
+					x_j += increment;
+					this->compute_block_row_residual( i, equations, R_row, false );
+					x_j = value;
+					block[ total_var*v + var ] = ( R_row[ v ] - R0[ id(i, v) ] )/increment;
+				}
+			}
+		}
+		this->gather_thread_status();
+	}
+
+	void DriftFluxWell::compute_Jacobian_FD()
 	{
 		bool WITH_GAS = this->m_with_gas;
 		bool WITH_MOMENTUM = true;
@@ -2175,258 +3543,44 @@ namespace WellSimulator {
 			R_v_dalphaOilE = this->R_v(m_pressure[ CENT ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
 									   m_oil_vol_frac[ CENT ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ CENT ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], 0, 'F');
 			R_v_dalphaOilEE= this->R_v(m_pressure[ CENT ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-									   m_oil_vol_frac[ CENT ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ] + delta_alphaOilEE, m_mean_velocity[ CENT ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], 0, 'F');
-			R_v_dvP		   = this->R_v(m_pressure[ CENT ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-									   m_oil_vol_frac[ CENT ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ CENT ], m_mean_velocity[ CENT ] + delta_vP, m_mean_velocity[ EAST ], 0, 'F');
-			R_v_dvE		   = this->R_v(m_pressure[ CENT ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-									   m_oil_vol_frac[ CENT ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ CENT ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ] + delta_vE, 0, 'F');
-			//CENTRAL		
-			(*this->m_matrix)( id(0,v), id(0,P) )	    = (R_v_dPP - s_R_v)/delta_PP;		
-			(*this->m_matrix)( id(0,v), id(0,alpha_g) ) = (R_v_dalphaGasP - s_R_v)/delta_alphaGasP;
-			(*this->m_matrix)( id(0,v), id(0,alpha_o) ) = (R_v_dalphaOilP - s_R_v)/delta_alphaOilP;
-			(*this->m_matrix)( id(0,v), id(0,v) )	    = (R_v_dvP - s_R_v)/delta_vP;
-			//EAST	
-			(*this->m_matrix)( id(0,v), id(0,P) + total_var )	    = (R_v_dPE - s_R_v)/delta_PE;
-			(*this->m_matrix)( id(0,v), id(0,alpha_g) + total_var ) = (R_v_dalphaGasE - s_R_v)/delta_alphaGasE;
-			(*this->m_matrix)( id(0,v), id(0,alpha_o) + total_var ) = (R_v_dalphaOilE - s_R_v)/delta_alphaOilE;
-			(*this->m_matrix)( id(0,v), id(0,v) + total_var )	    = (R_v_dvE - s_R_v)/delta_vE;
-			(*this->m_source)[ id(0, v) ]						    = -s_R_v;
-            //EEAST	
-            (*this->m_matrix)( id(0,v), id(0,P) + 2*total_var )	      = (R_v_dPEE - s_R_v)/delta_PEE;
-            (*this->m_matrix)( id(0,v), id(0,alpha_g) + 2*total_var ) = (R_v_dalphaGasEE - s_R_v)/delta_alphaGasEE;
-            (*this->m_matrix)( id(0,v), id(0,alpha_o) + 2*total_var ) = (R_v_dalphaOilEE - s_R_v)/delta_alphaOilEE;
-		}
-		else{
-			(*this->m_matrix)( id(0,v), id(0,P) + total_var ) = 1.;			
-		}
-
-		
-
-		++CENT;
-		++EAST;
-		uint_type LAST = this->number_of_nodes()-1;
-		for( uint_type i = 1; i < LAST - 1; ++i )
-		{
-
-			delta_PP		= m_delta[ P ]*m_pressure[ CENT ];
-			delta_alphaGasP	= m_gas_vol_frac[ CENT ] > 1e-12 ? m_delta[ alpha_g ]*m_gas_vol_frac[ CENT ] : m_delta[ alpha_g ];
-			delta_alphaOilP	= m_oil_vol_frac[ CENT ] > 1e-12 ? m_delta[ alpha_o ]*m_oil_vol_frac[ CENT ] : m_delta[ alpha_o ];
-			delta_vP		= abs(m_mean_velocity[ CENT ]) > 1e-12 ? m_delta[ v ]*m_mean_velocity[ CENT ] : m_delta[ v ];
-						
-			delta_PE		= m_delta[ P ]*m_pressure[ EAST ];
-			delta_alphaGasE	= m_gas_vol_frac[ EAST ] > 1e-12 ? m_delta[ alpha_g ]*m_gas_vol_frac[ EAST ] : m_delta[ alpha_g ];
-			delta_alphaOilE	= m_oil_vol_frac[ EAST ] > 1e-12 ? m_delta[ alpha_o ]*m_oil_vol_frac[ EAST ] : m_delta[ alpha_o ];
-			delta_vE		= abs(m_mean_velocity[ EAST ]) > 1e-12 ? m_delta[ v ]*m_mean_velocity[ EAST ] : m_delta[ v ];
-
-            delta_PEE		    = m_delta[ P ]*m_pressure[ EAST+1 ];
-            delta_alphaGasEE	= m_gas_vol_frac[ EAST+1 ] > 1e-8 ? m_delta[ alpha_g ]*m_gas_vol_frac[ EAST+1 ] : 1e-4*m_delta[ alpha_g ];
-            delta_alphaOilEE	= m_oil_vol_frac[ EAST+1 ] > 1e-8 ? m_delta[ alpha_o ]*m_oil_vol_frac[ EAST+1 ] : 1e-4*m_delta[ alpha_o ];
-
-			delta_PW		= m_delta[ P ]*m_pressure[ WEST ];
-			delta_alphaGasW	= m_gas_vol_frac[ WEST ] > 1e-12 ? m_delta[ alpha_g ]*m_gas_vol_frac[ WEST ] : m_delta[ alpha_g ];
-			delta_alphaOilW	= m_oil_vol_frac[ WEST ] > 1e-12 ? m_delta[ alpha_o ]*m_oil_vol_frac[ WEST ] : m_delta[ alpha_o ];
-			delta_vW		= abs(m_mean_velocity[ WEST ]) > 1e-12 ? m_delta[ v ]*m_mean_velocity[ WEST ] : m_delta[ v ];
-			
-		//MIXTURE
-			s_R_m		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dPW		   = this->R_m(m_pressure[ WEST ] + delta_PW, m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dPP		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ] + delta_PP, m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dPE		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ] + delta_PE, m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dalphaGasW = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ] + delta_alphaGasW, m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dalphaGasP = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ] + delta_alphaGasP, m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dalphaGasE = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ] + delta_alphaGasE,  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dalphaOilW = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ] + delta_alphaOilW, m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dalphaOilP = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ] + delta_alphaOilP, m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dalphaOilE = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-			R_m_dvW		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ] + delta_vW, m_mean_velocity[ CENT ], i, 'C');
-			R_m_dvP		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ] + delta_vP, i, 'C');
-			//WEST			
-			(*this->m_matrix)( id(i,P), id(i,P) - total_var )		= (R_m_dPW - s_R_m)/delta_PW;
-			(*this->m_matrix)( id(i,P), id(i,alpha_g) - total_var )	= (R_m_dalphaGasW - s_R_m)/delta_alphaGasW;
-			(*this->m_matrix)( id(i,P), id(i,alpha_o) - total_var )	= (R_m_dalphaOilW - s_R_m)/delta_alphaOilW;
-			(*this->m_matrix)( id(i,P), id(i,v)  - total_var )		= (R_m_dvW - s_R_m)/delta_vW;
-			//CENTRAL			
-			(*this->m_matrix)( id(i,P), id(i,P) )		= (R_m_dPP - s_R_m)/delta_PP;
-			(*this->m_matrix)( id(i,P), id(i,alpha_g) )	= (R_m_dalphaGasP - s_R_m)/delta_alphaGasP;
-			(*this->m_matrix)( id(i,P), id(i,alpha_o) )	= (R_m_dalphaOilP - s_R_m)/delta_alphaOilP;
-			(*this->m_matrix)( id(i,P), id(i,v) )		= (R_m_dvP - s_R_m)/delta_vP;
-			//EAST						
-			(*this->m_matrix)( id(i,P), id(i,P) + total_var )		= (R_m_dPE - s_R_m)/delta_PE;
-			(*this->m_matrix)( id(i,P), id(i,alpha_g) + total_var )	= (R_m_dalphaGasE - s_R_m)/delta_alphaGasE;
-			(*this->m_matrix)( id(i,P), id(i,alpha_o) + total_var )	= (R_m_dalphaOilE - s_R_m)/delta_alphaOilE;
-			//SOURCE
-			(*this->m_source)[ id(i, P) ]	 = -s_R_m;		
-
-			if( WITH_GAS ){
-			//GAS
-				s_R_g		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-										   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dPW		   = this->R_g(m_pressure[ WEST ] + delta_PW, m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dPP		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ] + delta_PP, m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dPE		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ] + delta_PE, m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dalphaGasW = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ] + delta_alphaGasW, m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dalphaGasP = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ] + delta_alphaGasP, m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dalphaGasE = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ] + delta_alphaGasE,  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dalphaOilW = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ] + delta_alphaOilW, m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dalphaOilP = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ] + delta_alphaOilP, m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dalphaOilE = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_g_dvW		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ] + delta_vW, m_mean_velocity[ CENT ], i, 'C');
-				R_g_dvP		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ] + delta_vP, i, 'C');
-
-				//WEST			
-				(*this->m_matrix)( id(i,alpha_g), id(i,P) - total_var )			= (R_g_dPW - s_R_g)/delta_PW;
-				(*this->m_matrix)( id(i,alpha_g), id(i,alpha_g) - total_var )	= (R_g_dalphaGasW - s_R_g)/delta_alphaGasW;
-				(*this->m_matrix)( id(i,alpha_g), id(i,alpha_o) - total_var )	= (R_g_dalphaOilW - s_R_g)/delta_alphaOilW;
-				(*this->m_matrix)( id(i,alpha_g), id(i,v) - total_var )			= (R_g_dvW - s_R_g)/delta_vW;
-				//CENTRAL			
-				(*this->m_matrix)( id(i,alpha_g), id(i,P) )			= (R_g_dPP - s_R_g)/delta_PP;
-				(*this->m_matrix)( id(i,alpha_g), id(i,alpha_g) )	= (R_g_dalphaGasP - s_R_g)/delta_alphaGasP;
-				(*this->m_matrix)( id(i,alpha_g), id(i,alpha_o) )	= (R_g_dalphaOilP - s_R_g)/delta_alphaOilP;
-				(*this->m_matrix)( id(i,alpha_g), id(i,v) )			= (R_g_dvP - s_R_g)/delta_vP;
-				//EAST				
-				(*this->m_matrix)( id(i,alpha_g), id(i,P) + total_var )			= (R_g_dPE - s_R_g)/delta_PE;
-				(*this->m_matrix)( id(i,alpha_g), id(i,alpha_g) + total_var )	= (R_g_dalphaGasE - s_R_g)/delta_alphaGasE;
-				(*this->m_matrix)( id(i,alpha_g), id(i,alpha_o) + total_var )	= (R_g_dalphaOilE - s_R_g)/delta_alphaOilE;
-
-				// SOURCE
-				(*this->m_source)[ id(i, alpha_g) ] = -s_R_g;
-			}
-			else{
-				(*this->m_matrix)( id(i,alpha_g), id(i,alpha_g) ) = 1.;
-			}
-
-			
-			//Oil
-				s_R_o		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-										   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dPW		   = this->R_o(m_pressure[ WEST ] + delta_PW, m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dPP		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ] + delta_PP, m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dPE		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ] + delta_PE, m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dalphaGasW = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ] + delta_alphaGasW, m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dalphaGasP = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ] + delta_alphaGasP, m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dalphaGasE = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ] + delta_alphaGasE,  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dalphaOilW = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ] + delta_alphaOilW, m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dalphaOilP = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ] + delta_alphaOilP, m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dalphaOilE = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
-				R_o_dvW		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ] + delta_vW, m_mean_velocity[ CENT ], i, 'C');
-				R_o_dvP		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
-									       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ] + delta_vP, i, 'C');
-
-				//WEST			
-				(*this->m_matrix)( id(i,alpha_o), id(i,P) - total_var )			= (R_o_dPW - s_R_o)/delta_PW;
-				(*this->m_matrix)( id(i,alpha_o), id(i,alpha_g) - total_var )	= (R_o_dalphaGasW - s_R_o)/delta_alphaGasW;
-				(*this->m_matrix)( id(i,alpha_o), id(i,alpha_o) - total_var )	= (R_o_dalphaOilW - s_R_o)/delta_alphaOilW;
-				(*this->m_matrix)( id(i,alpha_o), id(i,v) - total_var )			= (R_o_dvW - s_R_o)/delta_vW;
-				//CENTRAL			
-				(*this->m_matrix)( id(i,alpha_o), id(i,P) )			= (R_o_dPP - s_R_o)/delta_PP;
-				(*this->m_matrix)( id(i,alpha_o), id(i,alpha_g) )	= (R_o_dalphaGasP - s_R_o)/delta_alphaGasP;
-				(*this->m_matrix)( id(i,alpha_o), id(i,alpha_o) )	= (R_o_dalphaOilP - s_R_o)/delta_alphaOilP;
-				(*this->m_matrix)( id(i,alpha_o), id(i,v) )			= (R_o_dvP - s_R_o)/delta_vP;
-				//EAST				
-				(*this->m_matrix)( id(i,alpha_o), id(i,P) + total_var )			= (R_o_dPE - s_R_o)/delta_PE;
-				(*this->m_matrix)( id(i,alpha_o), id(i,alpha_g) + total_var )	= (R_o_dalphaGasE - s_R_o)/delta_alphaGasE;
-				(*this->m_matrix)( id(i,alpha_o), id(i,alpha_o) + total_var )	= (R_o_dalphaOilE - s_R_o)/delta_alphaOilE;
-
-				// SOURCE
-				(*this->m_source)[ id(i, alpha_o) ] = -s_R_o;
-			
+									   m_oil_vol_frac[ CENT ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ] + delta_alphaOilEE, m_mean_velocity[ CENT ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], 0, 'F');
+			R_v_dvP		   = this->R_v(m_pressure[ CENT ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+									   m_oil_vol_frac[ CENT ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ CENT ], m_mean_velocity[ CENT ] + delta_vP, m_mean_velocity[ EAST ], 0, 'F');
+			R_v_dvE		   = this->R_v(m_pressure[ CENT ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+									   m_oil_vol_frac[ CENT ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ CENT ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ] + delta_vE, 0, 'F');
+			//CENTRAL		
+			(*this->m_matrix)( id(0,v), id(0,P) )	    = (R_v_dPP - s_R_v)/delta_PP;		
+			(*this->m_matrix)( id(0,v), id(0,alpha_g) ) = (R_v_dalphaGasP - s_R_v)/delta_alphaGasP;
+			(*this->m_matrix)( id(0,v), id(0,alpha_o) ) = (R_v_dalphaOilP - s_R_v)/delta_alphaOilP;
+			(*this->m_matrix)( id(0,v), id(0,v) )	    = (R_v_dvP - s_R_v)/delta_vP;
+			//EAST	
+			(*this->m_matrix)( id(0,v), id(0,P) + total_var )	    = (R_v_dPE - s_R_v)/delta_PE;
+			(*this->m_matrix)( id(0,v), id(0,alpha_g) + total_var ) = (R_v_dalphaGasE - s_R_v)/delta_alphaGasE;
+			(*this->m_matrix)( id(0,v), id(0,alpha_o) + total_var ) = (R_v_dalphaOilE - s_R_v)/delta_alphaOilE;
+			(*this->m_matrix)( id(0,v), id(0,v) + total_var )	    = (R_v_dvE - s_R_v)/delta_vE;
+			(*this->m_source)[ id(0, v) ]						    = -s_R_v;
+            //EEAST	
+            (*this->m_matrix)( id(0,v), id(0,P) + 2*total_var )	      = (R_v_dPEE - s_R_v)/delta_PEE;
+            (*this->m_matrix)( id(0,v), id(0,alpha_g) + 2*total_var ) = (R_v_dalphaGasEE - s_R_v)/delta_alphaGasEE;
+            (*this->m_matrix)( id(0,v), id(0,alpha_o) + 2*total_var ) = (R_v_dalphaOilEE - s_R_v)/delta_alphaOilEE;
+		}
+		else{
+			(*this->m_matrix)( id(0,v), id(0,P) + total_var ) = 1.;			
+		}
 
-			if( WITH_MOMENTUM ){
-                s_R_v		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dPW		   = this->R_v(m_pressure[ WEST ] + delta_PW, m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ],
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');              
-                R_v_dPP		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ] + delta_PP, m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ],
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dPE		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ] + delta_PE, m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dPEE	   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ] + delta_PEE, m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dalphaGasW = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ] + delta_alphaGasW, m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');               
-                R_v_dalphaGasP = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ] + delta_alphaGasP, m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dalphaGasE = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ] + delta_alphaGasE, m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dalphaGasEE= this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ] + delta_alphaGasEE, 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dalphaOilW = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ] + delta_alphaOilW, m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dalphaOilP = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ] + delta_alphaOilP, m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dalphaOilE = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dalphaOilEE= this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ] + delta_alphaOilEE, m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dvW		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ],  
-					m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ] + delta_vW, m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
-                R_v_dvP		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ] + delta_vP, m_mean_velocity[ EAST ], i, 'C');
-                R_v_dvE		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
-                    m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ] + delta_vE, i, 'C');
-
-				//WEST	
-                (*this->m_matrix)( id(i,v), id(i,P) - total_var )		    = (R_v_dPW - s_R_v)/delta_PW;	
-                (*this->m_matrix)( id(i,v), id(i,alpha_g) - total_var )     = (R_v_dalphaGasW - s_R_v)/delta_alphaGasW;
-                (*this->m_matrix)( id(i,v), id(i,alpha_o) - total_var  )    = (R_v_dalphaOilW - s_R_v)/delta_alphaOilW;
-				(*this->m_matrix)( id(i,v), id(i,v) - total_var )           = (R_v_dvW - s_R_v)/delta_vW;
-				//CENTRAL			
-				(*this->m_matrix)( id(i,v), id(i,P) )		 = (R_v_dPP - s_R_v)/delta_PP;	
-				(*this->m_matrix)( id(i,v), id(i,alpha_g) )  = (R_v_dalphaGasP - s_R_v)/delta_alphaGasP;
-				(*this->m_matrix)( id(i,v), id(i,alpha_o) )  = (R_v_dalphaOilP - s_R_v)/delta_alphaOilP;
-				(*this->m_matrix)( id(i,v), id(i,v) )		 = (R_v_dvP - s_R_v)/delta_vP;
-				//EAST				
-				(*this->m_matrix)( id(i,v), id(i,P) + total_var )		 = (R_v_dPE - s_R_v)/delta_PE;	
-				(*this->m_matrix)( id(i,v), id(i,alpha_g) + total_var )  = (R_v_dalphaGasE - s_R_v)/delta_alphaGasE;
-				(*this->m_matrix)( id(i,v), id(i,alpha_o) + total_var )  = (R_v_dalphaOilE - s_R_v)/delta_alphaOilE;
-				(*this->m_matrix)( id(i,v), id(i,v) + total_var )		 = (R_v_dvE - s_R_v)/delta_vE;
-                //EEAST				
-                (*this->m_matrix)( id(i,v), id(i,P) + 2*total_var )		   = (R_v_dPEE - s_R_v)/delta_PEE;	
-                (*this->m_matrix)( id(i,v), id(i,alpha_g) + 2*total_var )  = (R_v_dalphaGasEE - s_R_v)/delta_alphaGasEE;
-                (*this->m_matrix)( id(i,v), id(i,alpha_o) + 2*total_var )  = (R_v_dalphaOilEE - s_R_v)/delta_alphaOilEE;
-				//SOURCE
-				(*this->m_source)[ id(i, v) ]	 = -s_R_v;
-			}
-			else{
-				(*this->m_matrix)( id(i,v), id(i,P) + total_var ) = 1.;
-			}
 		
-						
-			++WEST;	++CENT;	++EAST;
+
+		uint_type LAST = this->number_of_nodes()-1;
+		// Interior rows only read the state of their own stencil
+		this->prepare_thread_status();
+		#pragma omp parallel for num_threads( m_number_of_threads ) schedule( static )
+		for( int i = 1; i < int( LAST ) - 1; ++i ){
+			this->compute_Jacobian_FD_row( i );
 		}
+		this->gather_thread_status();
+		WEST = LAST - 2;
+		CENT = LAST - 1;
+		EAST = LAST;
 
 		delta_PP		= m_delta[ P ]*m_pressure[ CENT ];
 		delta_alphaGasP	= m_gas_vol_frac[ CENT ] > 1e-12 ? m_delta[ alpha_g ]*m_gas_vol_frac[ CENT ] : m_delta[ alpha_g ];
@@ -2786,6 +3940,270 @@ namespace WellSimulator {
 
 	}
 
+	void DriftFluxWell::compute_Jacobian_FD_row( uint_type p_node )
+	{
+		bool WITH_GAS = this->m_with_gas;
+		bool WITH_MOMENTUM = true;
+
+		real_type s_R_m;			real_type s_R_g;			real_type s_R_o;			real_type s_R_v;
+		real_type R_m_dPW;			real_type R_g_dPW;			real_type R_o_dPW;			real_type R_v_dPP;  
+		real_type R_m_dPP;			real_type R_g_dPP;			real_type R_o_dPP;			real_type R_v_dPE; 
+		real_type R_m_dPE;			real_type R_g_dPE;			real_type R_o_dPE;			real_type R_v_dalphaGasP;
+		real_type R_m_dalphaGasW;	real_type R_g_dalphaGasW;	real_type R_o_dalphaGasW;	real_type R_v_dalphaGasE;  
+		real_type R_m_dalphaGasP;	real_type R_g_dalphaGasP;	real_type R_o_dalphaGasP;	real_type R_v_dalphaOilP; 
+		real_type R_m_dalphaGasE;	real_type R_g_dalphaGasE;	real_type R_o_dalphaGasE;	real_type R_v_dalphaOilE;
+		real_type R_m_dalphaOilW;	real_type R_g_dalphaOilW;	real_type R_o_dalphaOilW;	real_type R_v_dvW;  
+		real_type R_m_dalphaOilP;	real_type R_g_dalphaOilP;	real_type R_o_dalphaOilP;	real_type R_v_dvP; 
+		real_type R_m_dalphaOilE;	real_type R_g_dalphaOilE;	real_type R_o_dalphaOilE;	real_type R_v_dvE;
+		real_type R_m_dvW;			real_type R_g_dvW;			real_type R_o_dvW;			
+		real_type R_m_dvP;			real_type R_g_dvP;			real_type R_o_dvP;			
+		
+        // EXTRA DERIVATIVES 
+		real_type R_v_dPW;
+        real_type R_v_dPEE;
+        real_type R_v_dalphaGasW;
+        real_type R_v_dalphaGasEE;
+        real_type R_v_dalphaOilW;
+        real_type R_v_dalphaOilEE;
+
+		real_type delta_PP;	
+		real_type delta_alphaGasP;
+		real_type delta_alphaOilP;
+		real_type delta_vP;
+		real_type delta_PW;	
+		real_type delta_alphaGasW;
+		real_type delta_alphaOilW;
+		real_type delta_vW;	
+		real_type delta_PE;	
+		real_type delta_alphaGasE;
+		real_type delta_alphaOilE;
+		real_type delta_vE;	
+        real_type delta_PEE;	
+        real_type delta_alphaGasEE;
+        real_type delta_alphaOilEE;
+
+		uint_type i    = p_node;
+		uint_type WEST = i - 1;
+		uint_type CENT = i;
+		uint_type EAST = i + 1;
+
+		delta_PP		= m_delta[ P ]*m_pressure[ CENT ];
+		delta_alphaGasP	= m_gas_vol_frac[ CENT ] > 1e-12 ? m_delta[ alpha_g ]*m_gas_vol_frac[ CENT ] : m_delta[ alpha_g ];
+		delta_alphaOilP	= m_oil_vol_frac[ CENT ] > 1e-12 ? m_delta[ alpha_o ]*m_oil_vol_frac[ CENT ] : m_delta[ alpha_o ];
+		delta_vP		= abs(m_mean_velocity[ CENT ]) > 1e-12 ? m_delta[ v ]*m_mean_velocity[ CENT ] : m_delta[ v ];
+					
+		delta_PE		= m_delta[ P ]*m_pressure[ EAST ];
+		delta_alphaGasE	= m_gas_vol_frac[ EAST ] > 1e-12 ? m_delta[ alpha_g ]*m_gas_vol_frac[ EAST ] : m_delta[ alpha_g ];
+		delta_alphaOilE	= m_oil_vol_frac[ EAST ] > 1e-12 ? m_delta[ alpha_o ]*m_oil_vol_frac[ EAST ] : m_delta[ alpha_o ];
+		delta_vE		= abs(m_mean_velocity[ EAST ]) > 1e-12 ? m_delta[ v ]*m_mean_velocity[ EAST ] : m_delta[ v ];
+
+        delta_PEE		    = m_delta[ P ]*m_pressure[ EAST+1 ];
+        delta_alphaGasEE	= m_gas_vol_frac[ EAST+1 ] > 1e-8 ? m_delta[ alpha_g ]*m_gas_vol_frac[ EAST+1 ] : 1e-4*m_delta[ alpha_g ];
+        delta_alphaOilEE	= m_oil_vol_frac[ EAST+1 ] > 1e-8 ? m_delta[ alpha_o ]*m_oil_vol_frac[ EAST+1 ] : 1e-4*m_delta[ alpha_o ];
+
+		delta_PW		= m_delta[ P ]*m_pressure[ WEST ];
+		delta_alphaGasW	= m_gas_vol_frac[ WEST ] > 1e-12 ? m_delta[ alpha_g ]*m_gas_vol_frac[ WEST ] : m_delta[ alpha_g ];
+		delta_alphaOilW	= m_oil_vol_frac[ WEST ] > 1e-12 ? m_delta[ alpha_o ]*m_oil_vol_frac[ WEST ] : m_delta[ alpha_o ];
+		delta_vW		= abs(m_mean_velocity[ WEST ]) > 1e-12 ? m_delta[ v ]*m_mean_velocity[ WEST ] : m_delta[ v ];
+		
+	//MIXTURE
+		s_R_m		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dPW		   = this->R_m(m_pressure[ WEST ] + delta_PW, m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dPP		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ] + delta_PP, m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dPE		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ] + delta_PE, m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dalphaGasW = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ] + delta_alphaGasW, m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dalphaGasP = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ] + delta_alphaGasP, m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dalphaGasE = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ] + delta_alphaGasE,  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dalphaOilW = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ] + delta_alphaOilW, m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dalphaOilP = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ] + delta_alphaOilP, m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dalphaOilE = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+		R_m_dvW		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ] + delta_vW, m_mean_velocity[ CENT ], i, 'C');
+		R_m_dvP		   = this->R_m(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ] + delta_vP, i, 'C');
+		//WEST			
+		(*this->m_matrix)( id(i,P), id(i,P) - total_var )		= (R_m_dPW - s_R_m)/delta_PW;
+		(*this->m_matrix)( id(i,P), id(i,alpha_g) - total_var )	= (R_m_dalphaGasW - s_R_m)/delta_alphaGasW;
+		(*this->m_matrix)( id(i,P), id(i,alpha_o) - total_var )	= (R_m_dalphaOilW - s_R_m)/delta_alphaOilW;
+		(*this->m_matrix)( id(i,P), id(i,v)  - total_var )		= (R_m_dvW - s_R_m)/delta_vW;
+		//CENTRAL			
+		(*this->m_matrix)( id(i,P), id(i,P) )		= (R_m_dPP - s_R_m)/delta_PP;
+		(*this->m_matrix)( id(i,P), id(i,alpha_g) )	= (R_m_dalphaGasP - s_R_m)/delta_alphaGasP;
+		(*this->m_matrix)( id(i,P), id(i,alpha_o) )	= (R_m_dalphaOilP - s_R_m)/delta_alphaOilP;
+		(*this->m_matrix)( id(i,P), id(i,v) )		= (R_m_dvP - s_R_m)/delta_vP;
+		//EAST						
+		(*this->m_matrix)( id(i,P), id(i,P) + total_var )		= (R_m_dPE - s_R_m)/delta_PE;
+		(*this->m_matrix)( id(i,P), id(i,alpha_g) + total_var )	= (R_m_dalphaGasE - s_R_m)/delta_alphaGasE;
+		(*this->m_matrix)( id(i,P), id(i,alpha_o) + total_var )	= (R_m_dalphaOilE - s_R_m)/delta_alphaOilE;
+		//SOURCE
+		(*this->m_source)[ id(i, P) ]	 = -s_R_m;		
+
+		if( WITH_GAS ){
+		//GAS
+			s_R_g		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dPW		   = this->R_g(m_pressure[ WEST ] + delta_PW, m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dPP		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ] + delta_PP, m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dPE		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ] + delta_PE, m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dalphaGasW = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ] + delta_alphaGasW, m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dalphaGasP = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ] + delta_alphaGasP, m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dalphaGasE = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ] + delta_alphaGasE,  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dalphaOilW = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ] + delta_alphaOilW, m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dalphaOilP = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ] + delta_alphaOilP, m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dalphaOilE = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_g_dvW		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ] + delta_vW, m_mean_velocity[ CENT ], i, 'C');
+			R_g_dvP		   = this->R_g(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ] + delta_vP, i, 'C');
+
+			//WEST			
+			(*this->m_matrix)( id(i,alpha_g), id(i,P) - total_var )			= (R_g_dPW - s_R_g)/delta_PW;
+			(*this->m_matrix)( id(i,alpha_g), id(i,alpha_g) - total_var )	= (R_g_dalphaGasW - s_R_g)/delta_alphaGasW;
+			(*this->m_matrix)( id(i,alpha_g), id(i,alpha_o) - total_var )	= (R_g_dalphaOilW - s_R_g)/delta_alphaOilW;
+			(*this->m_matrix)( id(i,alpha_g), id(i,v) - total_var )			= (R_g_dvW - s_R_g)/delta_vW;
+			//CENTRAL			
+			(*this->m_matrix)( id(i,alpha_g), id(i,P) )			= (R_g_dPP - s_R_g)/delta_PP;
+			(*this->m_matrix)( id(i,alpha_g), id(i,alpha_g) )	= (R_g_dalphaGasP - s_R_g)/delta_alphaGasP;
+			(*this->m_matrix)( id(i,alpha_g), id(i,alpha_o) )	= (R_g_dalphaOilP - s_R_g)/delta_alphaOilP;
+			(*this->m_matrix)( id(i,alpha_g), id(i,v) )			= (R_g_dvP - s_R_g)/delta_vP;
+			//EAST				
+			(*this->m_matrix)( id(i,alpha_g), id(i,P) + total_var )			= (R_g_dPE - s_R_g)/delta_PE;
+			(*this->m_matrix)( id(i,alpha_g), id(i,alpha_g) + total_var )	= (R_g_dalphaGasE - s_R_g)/delta_alphaGasE;
+			(*this->m_matrix)( id(i,alpha_g), id(i,alpha_o) + total_var )	= (R_g_dalphaOilE - s_R_g)/delta_alphaOilE;
+
+			// SOURCE
+			(*this->m_source)[ id(i, alpha_g) ] = -s_R_g;
+		}
+		else{
+			(*this->m_matrix)( id(i,alpha_g), id(i,alpha_g) ) = 1.;
+		}
+
+		
+		//Oil
+			s_R_o		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+									   m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dPW		   = this->R_o(m_pressure[ WEST ] + delta_PW, m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dPP		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ] + delta_PP, m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dPE		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ] + delta_PE, m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dalphaGasW = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ] + delta_alphaGasW, m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dalphaGasP = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ] + delta_alphaGasP, m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dalphaGasE = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ] + delta_alphaGasE,  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dalphaOilW = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ] + delta_alphaOilW, m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dalphaOilP = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ] + delta_alphaOilP, m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dalphaOilE = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], i, 'C');
+			R_o_dvW		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ] + delta_vW, m_mean_velocity[ CENT ], i, 'C');
+			R_o_dvP		   = this->R_o(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ],  
+								       m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ] + delta_vP, i, 'C');
+
+			//WEST			
+			(*this->m_matrix)( id(i,alpha_o), id(i,P) - total_var )			= (R_o_dPW - s_R_o)/delta_PW;
+			(*this->m_matrix)( id(i,alpha_o), id(i,alpha_g) - total_var )	= (R_o_dalphaGasW - s_R_o)/delta_alphaGasW;
+			(*this->m_matrix)( id(i,alpha_o), id(i,alpha_o) - total_var )	= (R_o_dalphaOilW - s_R_o)/delta_alphaOilW;
+			(*this->m_matrix)( id(i,alpha_o), id(i,v) - total_var )			= (R_o_dvW - s_R_o)/delta_vW;
+			//CENTRAL			
+			(*this->m_matrix)( id(i,alpha_o), id(i,P) )			= (R_o_dPP - s_R_o)/delta_PP;
+			(*this->m_matrix)( id(i,alpha_o), id(i,alpha_g) )	= (R_o_dalphaGasP - s_R_o)/delta_alphaGasP;
+			(*this->m_matrix)( id(i,alpha_o), id(i,alpha_o) )	= (R_o_dalphaOilP - s_R_o)/delta_alphaOilP;
+			(*this->m_matrix)( id(i,alpha_o), id(i,v) )			= (R_o_dvP - s_R_o)/delta_vP;
+			//EAST				
+			(*this->m_matrix)( id(i,alpha_o), id(i,P) + total_var )			= (R_o_dPE - s_R_o)/delta_PE;
+			(*this->m_matrix)( id(i,alpha_o), id(i,alpha_g) + total_var )	= (R_o_dalphaGasE - s_R_o)/delta_alphaGasE;
+			(*this->m_matrix)( id(i,alpha_o), id(i,alpha_o) + total_var )	= (R_o_dalphaOilE - s_R_o)/delta_alphaOilE;
+
+			// SOURCE
+			(*this->m_source)[ id(i, alpha_o) ] = -s_R_o;
+		
+
+		if( WITH_MOMENTUM ){
+            s_R_v		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dPW		   = this->R_v(m_pressure[ WEST ] + delta_PW, m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ],
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');              
+            R_v_dPP		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ] + delta_PP, m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ],
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dPE		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ] + delta_PE, m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dPEE	   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ] + delta_PEE, m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dalphaGasW = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ] + delta_alphaGasW, m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');               
+            R_v_dalphaGasP = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ] + delta_alphaGasP, m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dalphaGasE = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ] + delta_alphaGasE, m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dalphaGasEE= this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ] + delta_alphaGasEE, 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dalphaOilW = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ] + delta_alphaOilW, m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dalphaOilP = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ] + delta_alphaOilP, m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dalphaOilE = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ] + delta_alphaOilE, m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dalphaOilEE= this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ] + delta_alphaOilEE, m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dvW		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ],  
+				m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ] + delta_vW, m_mean_velocity[ CENT ], m_mean_velocity[ EAST ], i, 'C');
+            R_v_dvP		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ] + delta_vP, m_mean_velocity[ EAST ], i, 'C');
+            R_v_dvE		   = this->R_v(m_pressure[ WEST ], m_pressure[ CENT ], m_pressure[ EAST ], m_pressure[ EAST+1 ], m_gas_vol_frac[ WEST ], m_gas_vol_frac[ CENT ], m_gas_vol_frac[ EAST ], m_gas_vol_frac[ EAST+1 ], 
+                m_oil_vol_frac[ WEST ], m_oil_vol_frac[ CENT ], m_oil_vol_frac[ EAST ], m_oil_vol_frac[ EAST+1 ], m_mean_velocity[ WEST ], m_mean_velocity[ CENT ], m_mean_velocity[ EAST ] + delta_vE, i, 'C');
+
+			//WEST	
+            (*this->m_matrix)( id(i,v), id(i,P) - total_var )		    = (R_v_dPW - s_R_v)/delta_PW;	
+            (*this->m_matrix)( id(i,v), id(i,alpha_g) - total_var )     = (R_v_dalphaGasW - s_R_v)/delta_alphaGasW;
+            (*this->m_matrix)( id(i,v), id(i,alpha_o) - total_var  )    = (R_v_dalphaOilW - s_R_v)/delta_alphaOilW;
+			(*this->m_matrix)( id(i,v), id(i,v) - total_var )           = (R_v_dvW - s_R_v)/delta_vW;
+			//CENTRAL			
+			(*this->m_matrix)( id(i,v), id(i,P) )		 = (R_v_dPP - s_R_v)/delta_PP;	
+			(*this->m_matrix)( id(i,v), id(i,alpha_g) )  = (R_v_dalphaGasP - s_R_v)/delta_alphaGasP;
+			(*this->m_matrix)( id(i,v), id(i,alpha_o) )  = (R_v_dalphaOilP - s_R_v)/delta_alphaOilP;
+			(*this->m_matrix)( id(i,v), id(i,v) )		 = (R_v_dvP - s_R_v)/delta_vP;
+			//EAST				
+			(*this->m_matrix)( id(i,v), id(i,P) + total_var )		 = (R_v_dPE - s_R_v)/delta_PE;	
+			(*this->m_matrix)( id(i,v), id(i,alpha_g) + total_var )  = (R_v_dalphaGasE - s_R_v)/delta_alphaGasE;
+			(*this->m_matrix)( id(i,v), id(i,alpha_o) + total_var )  = (R_v_dalphaOilE - s_R_v)/delta_alphaOilE;
+			(*this->m_matrix)( id(i,v), id(i,v) + total_var )		 = (R_v_dvE - s_R_v)/delta_vE;
+            //EEAST				
+            (*this->m_matrix)( id(i,v), id(i,P) + 2*total_var )		   = (R_v_dPEE - s_R_v)/delta_PEE;	
+            (*this->m_matrix)( id(i,v), id(i,alpha_g) + 2*total_var )  = (R_v_dalphaGasEE - s_R_v)/delta_alphaGasEE;
+            (*this->m_matrix)( id(i,v), id(i,alpha_o) + 2*total_var )  = (R_v_dalphaOilEE - s_R_v)/delta_alphaOilEE;
+			//SOURCE
+			(*this->m_source)[ id(i, v) ]	 = -s_R_v;
+		}
+		else{
+			(*this->m_matrix)( id(i,v), id(i,P) + total_var ) = 1.;
+		}
+	}
+
     real_type DriftFluxWell::calculate_new_delta_t_size_diverged_solution(real_type delta_t_old){
         return 0.5*delta_t_old;
     }
@@ -2824,64 +4242,11 @@ namespace WellSimulator {
     }
 
     void DriftFluxWell::restore_initial_guess(){
-        for( uint_type i = 0; i < number_of_nodes()-1; ++i )
-        {
-            this->m_pressure[ i ]		= m_pressure_old[ i ];
-            this->m_gas_vol_frac[ i ]	= m_gas_vol_frac_old[ i ];
-            this->m_oil_vol_frac[ i ]	= m_oil_vol_frac_old[ i ];
-            this->m_mean_velocity[ i ]	= m_mean_velocity_old[ i ];
-                                           
-            (*this->m_variables)[ total_var*i ]             = 0.0;
-            (*this->m_variables)[ total_var*i + alpha_g ]   = 0.0;
-            (*this->m_variables)[ total_var*i + alpha_o ]   = 0.0;
-            (*this->m_variables)[ total_var*i + v ]         = 0.0;
-
-          /*  this->m_water_vol_frac[ i ] = 1.0 - (m_gas_vol_frac[ i ] + m_oil_vol_frac[ i ]);
-
-
-
-            real_type KSI	   = this->ksi( m_mean_velocity[ i ] );
-            real_type c_P	   = (0.5+KSI)*m_pressure[ i ] + (0.5-KSI)*m_pressure[ i+1 ];
-            real_type c_alphaG = (0.5+KSI)*m_gas_vol_frac[ i ] + (0.5-KSI)*m_gas_vol_frac[ i+1 ];
-            real_type c_alphaO = (0.5+KSI)*m_oil_vol_frac[ i ] + (0.5-KSI)*m_oil_vol_frac[ i+1 ];
-            real_type c_alphaW = 1.0 - (c_alphaG+ c_alphaO);
-
-            real_type rho  = this->mean_density  ( c_alphaO, c_alphaW, c_alphaG, c_P );
-            real_type rhoL = this->liquid_density(c_alphaO, c_alphaW, c_P);
-            real_type rhoG = this->gas_density   ( c_P );
-            real_type rhoO = this->gas_density   ( c_P );
-            real_type rhoW = this->gas_density   ( c_P );
-
-            real_type mod_Vgj = this->mod_v_drift_flux( m_mean_velocity[ i ], 0.5*(m_gas_vol_frac[ i ]+m_gas_vol_frac[ i+1 ]), 0.5*(m_oil_vol_frac[ i ]+m_oil_vol_frac[ i+1 ]), 0.5*(m_water_vol_frac[ i ] + m_water_vol_frac[ i+1 ]), 0.5*(m_pressure[ i ]+m_pressure[ i+1 ]) );
-            real_type mod_Vow = this->mod_v_drift_flux_ow( m_mean_velocity[ i ], 0.5*(m_gas_vol_frac[ i ]+m_gas_vol_frac[ i+1 ]), 0.5*(m_oil_vol_frac[ i ]+m_oil_vol_frac[ i+1 ]), 0.5*(m_water_vol_frac[ i ] + m_water_vol_frac[ i+1 ]), 0.5*(m_pressure[ i ]+m_pressure[ i+1 ]) );
-
-
-            this->m_gas_velocity[ i ] = m_mean_velocity[ i ] + rhoL/rho*mod_Vgj;			
-            real_type liquid_velocity = m_mean_velocity[ i ] - c_alphaG/(1 - c_alphaG + 1.0e-20)*rhoG/rho*mod_Vgj;	
-
-            this->m_oil_velocity[ i ]   = liquid_velocity + rhoW/rhoL*mod_Vow;
-            this->m_water_velocity[ i ] = liquid_velocity - (c_alphaO/c_alphaW)*(rhoO/rhoL)*mod_Vow;		*/
-
-        }
-
-        unsigned i = number_of_nodes()-1;
-
-        this->m_pressure[ i ]		= m_pressure_old[ i ];
-        this->m_gas_vol_frac[ i ]	= m_gas_vol_frac_old[ i ];
-        this->m_oil_vol_frac[ i ]	= m_oil_vol_frac_old[ i ];
-        this->m_mean_velocity[ i ]	= m_mean_velocity_old[ i ];
-
-        (*this->m_variables)[ total_var*i ]             = 0.0;
-        (*this->m_variables)[ total_var*i + alpha_g ]   = 0.0;
-        (*this->m_variables)[ total_var*i + alpha_o ]   = 0.0;
-        (*this->m_variables)[ total_var*i + v ]         = 0.0;
-
-      /*  this->m_water_vol_frac[ i ] = 1.0 - (m_gas_vol_frac[ i ] + m_oil_vol_frac[ i ]);
-        this->m_gas_velocity[ i ]	= m_mean_velocity[ i ];
-        this->m_oil_velocity[ i ]   = m_mean_velocity[ i ];
-        this->m_water_velocity[ i ] = m_mean_velocity[ i ];*/
-
-
+        ++m_newton_statistics.timestep_cuts;
+        this->request_refactor( TIMESTEP_CUT );
+        this->reset_forcing_term();
+        m_state.restore();
+        for( uint_type k = 0; k < m_state.number_of_unknowns(); ++k ) (*this->m_variables)[ k ] = 0.0;
 
         // Last volume fraction must be equal
         this->m_gas_vol_frac[ 0 ] = this->m_gas_vol_frac[ 1 ];
@@ -2893,22 +4258,24 @@ namespace WellSimulator {
 	void DriftFluxWell::update_variables()
 	{
 		
-		for( uint_type i = 0; i < number_of_nodes()-1; ++i )
-		{
-			this->m_pressure[ i ]		+= (*this->m_variables)[ total_var*i ];
-			this->m_gas_vol_frac[ i ]	+= (*this->m_variables)[ total_var*i + alpha_g ];
-			this->m_oil_vol_frac[ i ]	+= (*this->m_variables)[ total_var*i + alpha_o ];
-			this->m_mean_velocity[ i ]	+= (*this->m_variables)[ total_var*i + v ];
-
-           // (*this->m_variables)[ total_var*i ]             = 0.0;
-           // (*this->m_variables)[ total_var*i + alpha_g ]   = 0.0;
-           // (*this->m_variables)[ total_var*i + alpha_o ]   = 0.0;
-          //  (*this->m_variables)[ total_var*i + v ]         = 0.0;
+		// m_variables has the layout of the state unknowns
+		real_type* x = m_state.unknowns();
+		const svector_type& dx = *this->m_variables;
+		for( uint_type k = 0; k < m_state.number_of_unknowns(); ++k ) x[ k ] += dx[ k ];
 
+		for( uint_type i = 0; i < number_of_nodes(); ++i )
+		{
 			this->m_water_vol_frac[ i ] = 1.0 - (m_gas_vol_frac[ i ] + m_oil_vol_frac[ i ]);
+		}
 
-						
-			
+		// Last volume fraction must be equal
+		this->m_gas_vol_frac[ 0 ] = this->m_gas_vol_frac[ 1 ];
+		this->m_oil_vol_frac[ 0 ] = this->m_oil_vol_frac[ 1 ];
+
+		// The phase velocities of the updated state, from the closures the next Jacobian will use
+		this->update_property_cache();
+		for( uint_type i = 0; i < number_of_nodes()-1; ++i )
+		{
 			real_type KSI	   = this->ksi( m_mean_velocity[ i ] );
 			real_type c_P	   = (0.5+KSI)*m_pressure[ i ] + (0.5-KSI)*m_pressure[ i+1 ];
 			real_type c_alphaG = (0.5+KSI)*m_gas_vol_frac[ i ] + (0.5-KSI)*m_gas_vol_frac[ i+1 ];
@@ -2921,8 +4288,10 @@ namespace WellSimulator {
 			real_type rhoO = this->gas_density   ( c_P );
 			real_type rhoW = this->gas_density   ( c_P );
 			
-			real_type mod_Vgj = this->mod_v_drift_flux( m_mean_velocity[ i ], 0.5*(m_gas_vol_frac[ i ]+m_gas_vol_frac[ i+1 ]), 0.5*(m_oil_vol_frac[ i ]+m_oil_vol_frac[ i+1 ]), 0.5*(m_water_vol_frac[ i ] + m_water_vol_frac[ i+1 ]), 0.5*(m_pressure[ i ]+m_pressure[ i+1 ]) );
-			real_type mod_Vow = this->mod_v_drift_flux_ow( m_mean_velocity[ i ], 0.5*(m_gas_vol_frac[ i ]+m_gas_vol_frac[ i+1 ]), 0.5*(m_oil_vol_frac[ i ]+m_oil_vol_frac[ i+1 ]), 0.5*(m_water_vol_frac[ i ] + m_water_vol_frac[ i+1 ]), 0.5*(m_pressure[ i ]+m_pressure[ i+1 ]) );
+			real_type water_vol_fracW = 1.0 - (m_gas_vol_frac[ i ] + m_oil_vol_frac[ i ]);
+			real_type water_vol_fracE = 1.0 - (m_gas_vol_frac[ i+1 ] + m_oil_vol_frac[ i+1 ]);
+			real_type mod_Vgj = this->mod_v_drift_flux( m_mean_velocity[ i ], 0.5*(m_gas_vol_frac[ i ]+m_gas_vol_frac[ i+1 ]), 0.5*(m_oil_vol_frac[ i ]+m_oil_vol_frac[ i+1 ]), 0.5*(water_vol_fracW + water_vol_fracE), 0.5*(m_pressure[ i ]+m_pressure[ i+1 ]), i );
+			real_type mod_Vow = this->mod_v_drift_flux_ow( m_mean_velocity[ i ], 0.5*(m_gas_vol_frac[ i ]+m_gas_vol_frac[ i+1 ]), 0.5*(m_oil_vol_frac[ i ]+m_oil_vol_frac[ i+1 ]), 0.5*(water_vol_fracW + water_vol_fracE), 0.5*(m_pressure[ i ]+m_pressure[ i+1 ]), i );
 
 			
 			this->m_gas_velocity[ i ] = m_mean_velocity[ i ] + rhoL/rho*mod_Vgj;			
@@ -2934,32 +4303,124 @@ namespace WellSimulator {
 		}
 
 		unsigned i = number_of_nodes()-1;
-
-
-		this->m_pressure[ i ]		+= (*this->m_variables)[ total_var*i ];
-		this->m_gas_vol_frac[ i ]	+= (*this->m_variables)[ total_var*i + alpha_g ];
-		this->m_oil_vol_frac[ i ]	+= (*this->m_variables)[ total_var*i + alpha_o ];
-		this->m_mean_velocity[ i ]	+= (*this->m_variables)[ total_var*i + v ];
-
-      //  (*this->m_variables)[ total_var*i ]             = 0.0;
-      //  (*this->m_variables)[ total_var*i + alpha_g ]   = 0.0;
-      //  (*this->m_variables)[ total_var*i + alpha_o ]   = 0.0;
-     //   (*this->m_variables)[ total_var*i + v ]         = 0.0;
-
-		this->m_water_vol_frac[ i ] = 1.0 - (m_gas_vol_frac[ i ] + m_oil_vol_frac[ i ]);
 		this->m_gas_velocity[ i ]	= m_mean_velocity[ i ];
 		this->m_oil_velocity[ i ]   = m_mean_velocity[ i ];
 		this->m_water_velocity[ i ] = m_mean_velocity[ i ];
+		
+	}
 
 	
 
-		// Last volume fraction must be equal
-		this->m_gas_vol_frac[ 0 ] = this->m_gas_vol_frac[ 1 ];
-		this->m_oil_vol_frac[ 0 ] = this->m_oil_vol_frac[ 1 ];
-		
+	// Applies the Newton step in m_variables. With globalization the step is first scaled down to
+	// the update limits, as a whole so that it keeps its direction, then cut back to the physical
+	// bounds, then halved until the residual norm decreases enough (Armijo). After m_max_backtracks
+	// halvings the last step is taken anyway, unless it or its residual isn't finite: then the well
+	// is left as it was and false is returned, for the caller to cut the timestep.
+	bool DriftFluxWell::apply_newton_update()
+	{
+		++m_newton_statistics.newton_iterations;
+		svector_type& dx = *this->m_variables;
+		for( uint_type k = 0; k < dx.size(); ++k ){
+			// A failed linear solve: no shorter step will do any better
+			if( !( std::fabs( dx[ k ] ) < std::numeric_limits<real_type>::infinity() ) ){
+				for( uint_type r = 0; r < dx.size(); ++r ) dx[ r ] = 0.0;
+				return false;
+			}
+		}
+		if( !m_newton_globalization ){
+			this->update_variables();
+			return true;
+		}
+
+		real_type chop = this->update_limit_factor();
+		if( chop < 1.0 ){
+			++m_newton_statistics.chopped_updates;
+			for( uint_type k = 0; k < dx.size(); ++k ) dx[ k ] *= chop;
+		}
+		this->project_update_to_bounds();
+
+		vector_type& unknowns = m_line_search_unknowns;
+		this->get_unknowns( unknowns );
+		const real_type sufficient_decrease = 1E-4;
+		real_type initial_norm = itl::two_norm( *this->m_source );
+		real_type step = 1.0;
+		for( uint_type k = 0; ; ++k ){
+			this->update_variables();
+			if( initial_norm <= this->NEWTON_CRIT ) return true;
+
+			this->compute_residual( m_line_search_residual );
+			real_type norm = 0.0;
+			for( uint_type r = 0; r < m_line_search_residual.size(); ++r ) norm += m_line_search_residual[ r ]*m_line_search_residual[ r ];
+			norm = sqrt( norm );
+			if( norm <= ( 1.0 - sufficient_decrease*step )*initial_norm ) return true;
+
+			bool finite = norm < std::numeric_limits<real_type>::infinity();
+			if( k == m_max_backtracks && finite ) return true;
+
+			this->set_unknowns( unknowns );
+			if( k == m_max_backtracks ){
+				for( uint_type r = 0; r < dx.size(); ++r ) dx[ r ] = 0.0;
+				this->update_variables();
+				return false;
+			}
+			++m_newton_statistics.backtracks;
+			step *= 0.5;
+			for( uint_type r = 0; r < dx.size(); ++r ) dx[ r ] *= 0.5;
+		}
 	}
 
-	
+	// Largest factor, up to 1, that keeps every volume fraction change within m_max_vol_frac_change
+	// and every pressure change within m_max_relative_pressure_change of the pressure
+	real_type DriftFluxWell::update_limit_factor()
+	{
+		const svector_type& dx = *this->m_variables;
+		real_type factor = 1.0;
+		for( uint_type i = 0; i < number_of_nodes(); ++i ){
+			real_type max_dP = m_max_relative_pressure_change*std::fabs( m_pressure[ i ] );
+			if( std::fabs( dx[ id(i, P) ] ) > max_dP )
+				factor = std::min( factor, max_dP/std::fabs( dx[ id(i, P) ] ) );
+			for( int var = alpha_g; var <= alpha_o; ++var ){
+				if( std::fabs( dx[ id(i, var) ] ) > m_max_vol_frac_change )
+					factor = std::min( factor, m_max_vol_frac_change/std::fabs( dx[ id(i, var) ] ) );
+			}
+		}
+		return factor;
+	}
+
+	// Cuts the volume fraction updates so that every fraction, water included, ends in [0,1]. The
+	// fractions before the update are taken as feasible, so any shorter step stays feasible too.
+	void DriftFluxWell::project_update_to_bounds()
+	{
+		svector_type& dx = *this->m_variables;
+		for( uint_type i = 0; i < number_of_nodes(); ++i ){
+			real_type gas = std::min( std::max( m_gas_vol_frac[ i ] + dx[ id(i, alpha_g) ], 0.0 ), 1.0 );
+			real_type oil = std::min( std::max( m_oil_vol_frac[ i ] + dx[ id(i, alpha_o) ], 0.0 ), 1.0 );
+			if( gas + oil > 1.0 ){
+				real_type scale = 1.0/( gas + oil );
+				gas *= scale;
+				oil *= scale;
+			}
+			dx[ id(i, alpha_g) ] = gas - m_gas_vol_frac[ i ];
+			dx[ id(i, alpha_o) ] = oil - m_oil_vol_frac[ i ];
+		}
+	}
+
+	void DriftFluxWell::reset_newton_statistics()
+	{
+		m_newton_statistics.newton_iterations = 0;
+		m_newton_statistics.timestep_cuts	  = 0;
+		m_newton_statistics.chopped_updates	  = 0;
+		m_newton_statistics.backtracks		  = 0;
+		m_newton_statistics.workspace_resizes = 0;
+	}
+
+	void DriftFluxWell::reset_property_cache_statistics()
+	{
+		m_cache_statistics.property_hits		= 0;
+		m_cache_statistics.property_evaluations	= 0;
+		m_cache_statistics.closure_hits			= 0;
+		m_cache_statistics.closure_evaluations	= 0;
+	}
 
 	void DriftFluxWell::set_boundary_velocity( real_type p_velocity ){
 		this->m_mean_velocity[ number_of_nodes() - 1 ] = p_velocity;
@@ -2973,14 +4434,8 @@ namespace WellSimulator {
 	}
 
     void DriftFluxWell::update_variables_for_new_timestep(){
+        m_state.snapshot();
         for( uint_type i = 0; i < number_of_nodes(); ++i){
-
-            m_gas_vol_frac_old[ i ]   = m_gas_vol_frac[ i ];			
-            m_oil_vol_frac_old[ i ]   = m_oil_vol_frac[ i ];
-            m_water_vol_frac_old[ i ] = m_water_vol_frac[ i ];
-            m_pressure_old[ i ]		  = m_pressure[ i ];		
-            m_mean_velocity_old[ i ]  = m_mean_velocity[ i ];
-
             m_water_flow[i]->calculate_value_at_time(m_current_time);
             m_oil_flow[i]->calculate_value_at_time(m_current_time);
             m_gas_flow[i]->calculate_value_at_time(m_current_time);               
@@ -2998,7 +4453,7 @@ namespace WellSimulator {
 		
 		this->set_bottom_pressure( m_HEEL_PRESSURE ); // Pressure at heel is set
 
-        bool log_output_is_active = true;
+        bool log_output_is_active = m_output_files;
 
         std::ofstream log_results_file;
         if(log_output_is_active)
@@ -3049,8 +4504,9 @@ namespace WellSimulator {
 			}
 			
 			uint_type r = 0;
-            std::queue<real_type> norm_history;
+            m_norm_history.clear();
 			real_type norma;
+			this->reset_forcing_term();
 			do
 			{
 				static Timer timer;
@@ -3062,21 +4518,21 @@ namespace WellSimulator {
                 timer.print("\njacobian time = ");
 
 				timer.start();
-				GMRES_Solve( *m_matrix, *m_variables, *m_source );
+				linear_solve( *m_matrix, *m_variables, *m_source );
 				
 				timer.stop();
                 timer.print("\nsolver time = ");
 								
-				this->update_variables();			
+				bool updated = this->apply_newton_update();			
 				
                 std::cout << std::setprecision(10);
 				
 				norma = itl::two_norm(*m_source);				
                 std::cout << "\n----norma residuo: " << norma << "-----\n";
 				
-                norm_history.push(norma);
+                m_norm_history.push(norma);
                 if(r > 3){
-                    norm_history.pop();
+                    m_norm_history.pop();
                 }
 				/*for( uint_type i = 0; i < number_of_nodes()-1; ++i ){
 					cout << setprecision(10);				
@@ -3090,14 +4546,14 @@ namespace WellSimulator {
 					cout << "mean_velocity[ "<< i <<" ] = " << this->m_mean_velocity[ i ] << "\n";			
 
 				}*/
-                //if( norm_history.front() < norm_history.back() && r > 3)    m_convergence_status = true;
-                m_convergence_status = false;
+                //if( m_norm_history.front() < m_norm_history.back() && r > 3)    m_convergence_status = true;
+                m_convergence_status = !updated; // no usable step: cut the timestep right away
                 if(norma > this->NEWTON_CRIT && r > 50 || m_convergence_status){
                     set_dt( calculate_new_delta_t_size_diverged_solution( dt() ) ); 
                     std::cout << "\n********* Breaking timestep = " << dt();
                     int r_inner = 0;
                     real_type new_norm = 0.0;
-                    std::queue<real_type> new_norm_history;
+                    m_cut_norm_history.clear();
                     restore_initial_guess();
                     do{                                
                         // Restart solution with half timestep 
@@ -3107,24 +4563,24 @@ namespace WellSimulator {
                         timer.print("\njacobian time = ");
 
                         timer.start();
-                        GMRES_Solve( *m_matrix, *m_variables, *m_source );
+                        linear_solve( *m_matrix, *m_variables, *m_source );
 
                         timer.stop();
                         timer.print("\nsolver time = ");
                        
-                        this->update_variables();			
+                        if( !this->apply_newton_update() ) break;
 
                         std::cout << std::setprecision(10);
 
                         new_norm = itl::two_norm(*m_source);				
                         std::cout << "\n----norma residuo: " << new_norm << "-----\n";
 
-                        new_norm_history.push(new_norm);
+                        m_cut_norm_history.push(new_norm);
                         if(r_inner > 2){
-                            new_norm_history.pop();
+                            m_cut_norm_history.pop();
                         }
                        // if( new_norm > norma && r_inner > 10) break;
-                        if( new_norm_history.front() < new_norm_history.back() && r_inner > 2) {
+                        if( m_cut_norm_history.front() < m_cut_norm_history.back() && r_inner > 2) {
                            // restore_initial_guess();
                             break;
                         }
@@ -3166,6 +4622,7 @@ namespace WellSimulator {
             transient_norm = transient_norm/dt();*/
 
             //if(transient_norm < 1e-6 && TIMESTEP > 0 || TIMESTEP == FINAL_TIMESTEP-1 || abs(m_current_time - m_final_time) < 1.0e-8 )
+            if( ( TIMESTEP == FINAL_TIMESTEP-1 || abs(m_current_time - m_final_time) < 1.0e-8 ) && !m_output_files ) break;
             if(TIMESTEP == FINAL_TIMESTEP-1 || abs(m_current_time - m_final_time) < 1.0e-8 )
             {
                 std::ofstream results_file;
@@ -3200,6 +4657,37 @@ namespace WellSimulator {
         {  
             log_results_file.close();                     
         }
+
+        std::cout << "\nPreconditioner: " << m_preconditioner_statistics.factorizations << " factorizations ("
+            << m_preconditioner_statistics.refactor_reasons[ ITERATION_GROWTH ] << " iteration growth, "
+            << m_preconditioner_statistics.refactor_reasons[ TIMESTEP_CHANGE ]  << " timestep change, "
+            << m_preconditioner_statistics.refactor_reasons[ TIMESTEP_CUT ]     << " timestep cut), "
+            << m_preconditioner_statistics.reuses << " reuses, "
+            << m_preconditioner_statistics.krylov_iterations << " Krylov iterations";
+        if( m_inexact_newton ) std::cout << " (~" << m_preconditioner_statistics.krylov_iterations_saved << " saved by inexact Newton)";
+        if( m_mixed_precision ) std::cout << ", single precision factors, " << m_preconditioner_statistics.refinement_steps << " refinement steps";
+        std::cout << "\n";
+        if( m_linear_solver == GMRES_ILU && m_jacobian_method != JACOBIAN_FREE ){
+            std::cout << "Krylov: " << krylov_method_name( m_krylov_method ) << " + " << preconditioner_name( m_preconditioner );
+            if( m_krylov_auto_tune ){
+                std::cout << " (" << m_preconditioner_statistics.krylov_tunings << " auto-tuning rounds, "
+                    << m_preconditioner_statistics.tuning_factorizations << " factorizations)";
+            }
+            if( m_krylov_method == KRYLOV_GCRODR ){
+                std::cout << ", ~" << int( m_preconditioner_statistics.recycled_iterations_saved + 0.5 ) << " iterations saved by projecting on the recycled space, "
+                    << m_preconditioner_statistics.recycle_applies << " applies to refresh it";
+            }
+            std::cout << "\n";
+        }
+        std::cout << "Newton: " << m_newton_statistics.newton_iterations << " iterations, "
+            << m_newton_statistics.timestep_cuts << " timestep cuts, "
+            << m_newton_statistics.chopped_updates << " chopped updates, "
+            << m_newton_statistics.backtracks << " line search backtracks, "
+            << m_newton_statistics.workspace_resizes << " workspace resizes\n";
+        std::cout << "Property cache: " << m_cache_statistics.property_hits << " property lookups hit, "
+            << m_cache_statistics.property_evaluations << " model evaluations; "
+            << m_cache_statistics.closure_hits << " drift-flux closure lookups hit, "
+            << m_cache_statistics.closure_evaluations << " closure evaluations\n";
 	}
 
 
@@ -3213,16 +4701,19 @@ namespace WellSimulator {
         m_total_production[GasPhase]    = 0.0;
         m_total_production[WaterPhase]  = 0.0;
 
+        // Steady state over one timestep; if it can't be reached, march physical time as usual
+        if( m_steady_state && this->solve_steady_state() ){
+            m_current_time += this->dt();
+            m_total_production[OilPhase]    += m_oil_vol_frac[0]  *abs(m_oil_velocity[0])  *area()*dt();
+            m_total_production[GasPhase]    += m_gas_vol_frac[0]  *abs(m_gas_velocity[0])  *area()*dt();
+            m_total_production[WaterPhase]  += m_water_vol_frac[0]*abs(m_water_velocity[0])*area()*dt();
+            for(uint_type i = 1; i < this->number_of_nodes(); ++i){
+                p_pressure[i-1] = this->m_pressure[i];
+            }
+            return;
+        }
+
 		uint_type FINAL_TIMESTEP = this->m_FINAL_TIMESTEP;
-		for( uint_type i = 0; i < number_of_nodes(); ++i){
-			
-			m_gas_vol_frac_old[ i ]   = m_gas_vol_frac[ i ];			
-			m_oil_vol_frac_old[ i ]   = m_oil_vol_frac[ i ];
-			m_water_vol_frac_old[ i ] = m_water_vol_frac[ i ];
-			m_pressure_old[ i ]		  = m_pressure[ i ];		
-			m_mean_velocity_old[ i ]  = m_mean_velocity[ i ];
-			
-		}
 		
 		this->set_bottom_pressure( m_HEEL_PRESSURE ); // Pressure at heel is set
 		
@@ -3237,15 +4728,24 @@ namespace WellSimulator {
 					m_mean_velocity_old[ i ] = m_mean_velocity[ i ]; 				
 				}
 			}
+			m_state.snapshot();
 			
 			uint_type r = 0;
 			real_type norma;
+			this->reset_forcing_term();
 			do
 			{
 				
 				this->compute_Jacobian();
-				GMRES_Solve( *m_matrix, *m_variables, *m_source ); 
-				this->update_variables();			
+				linear_solve( *m_matrix, *m_variables, *m_source ); 
+				if( !this->apply_newton_update() ){
+					// No usable step: start the timestep over with half of it
+					set_dt( calculate_new_delta_t_size_diverged_solution( dt() ) );
+					restore_initial_guess();
+					norma = std::numeric_limits<real_type>::infinity();
+					++r;
+					continue;
+				}
 				
 				//cout << setprecision(10);   				
 				norma = itl::two_norm(*m_source);				
@@ -3328,7 +4828,7 @@ namespace WellSimulator {
                 break;
             }
 		}
-        for(uint_type i = 1; i < this->m_pressure.size(); ++i){
+        for(uint_type i = 1; i < this->number_of_nodes(); ++i){
             p_pressure[i-1] = this->m_pressure[i];
         }
         // TODO:
@@ -3350,6 +4850,75 @@ namespace WellSimulator {
             << "\t\t---PhaseGas: "<< m_total_production[GasPhase]      << " m^3\n";*/
 	}
 
+	// Steady state by pseudo-transient continuation: one Newton iteration per backward Euler step
+	// in pseudo time, each step starting from the state it left. The accumulation terms vanish at
+	// the start of a step, so the residual there is the steady one, and switched evolution
+	// relaxation grows the step as it falls: dt_k+1 = dt_k*||R_k-1||/||R_k||, up to m_max_pseudo_dt,
+	// where the iteration is Newton on the steady equations. The well starts from the state it was
+	// left in, and after a converged call from the last pseudo step too, so a call on a state close
+	// to steady costs a few Newton iterations. Returns false if m_max_pseudo_steps weren't enough,
+	// with the well at the start of the last pseudo step. The pseudo step is m_pseudo_dt, put in
+	// m_dt only while it is taken: it changes every step, and refactoring the preconditioner for each
+	// is up to the reuse policy. m_dt is as it was on return.
+	bool DriftFluxWell::solve_steady_state()
+	{
+		const real_type physical_dt = m_dt;
+		this->set_bottom_pressure( m_HEEL_PRESSURE );
+		if( m_pseudo_dt <= 0.0 ) m_pseudo_dt = m_initial_pseudo_dt;
+		this->reset_forcing_term();
+
+		bool converged = false;
+		bool stepped = false;
+		real_type previous_norm = -1.0;
+		for( uint_type k = 0; k < m_max_pseudo_steps; ++k ){
+			m_state.snapshot();
+
+			this->compute_residual( m_steady_state_residual );
+			real_type norm = 0.0;
+			for( uint_type r = 0; r < m_steady_state_residual.size(); ++r ) norm += m_steady_state_residual[ r ]*m_steady_state_residual[ r ];
+			norm = sqrt( norm );
+			if( !( norm < std::numeric_limits<real_type>::infinity() ) ){
+				if( !stepped ) break;
+				// The last pseudo step broke the state: go back and take it ten times shorter
+				this->set_unknowns( m_steady_state_unknowns );
+				m_pseudo_dt *= 0.1;
+				previous_norm = -1.0;
+				continue;
+			}
+			if( norm <= this->NEWTON_CRIT ){
+				std::cout << "----WELL---- steady state in " << k << " pseudo steps, residual " << norm << "\n";
+				converged = true;
+				break;
+			}
+			if( previous_norm > 0.0 ) m_pseudo_dt = std::min( m_pseudo_dt*previous_norm/norm, m_max_pseudo_dt );
+			previous_norm = norm;
+
+			this->get_unknowns( m_steady_state_unknowns );
+			stepped = true;
+			m_dt = m_pseudo_dt;
+			this->compute_Jacobian();
+			linear_solve( *m_matrix, *m_variables, *m_source );
+			if( !this->apply_newton_update() ){
+				// Nothing was applied: retry the step ten times shorter
+				m_pseudo_dt *= 0.1;
+				previous_norm = -1.0;
+			}
+		}
+
+		m_dt = physical_dt;
+		// Factors kept from a pseudo step don't belong to the physical one
+		if( stepped ) this->request_refactor( TIMESTEP_CHANGE );
+		if( converged ) return true;
+
+		std::cout << "----WELL---- no steady state after " << m_max_pseudo_steps << " pseudo steps\n";
+		if( stepped ){
+			this->set_unknowns( m_steady_state_unknowns );
+			m_state.snapshot();
+		}
+		m_pseudo_dt = 0.0;
+		return false;
+	}
+
 
 
 
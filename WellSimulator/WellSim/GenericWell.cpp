@@ -81,9 +81,6 @@ namespace WellSimulator {
 	coord_type* GenericWell::coordinates(uint_type p_index)	{
 		return &(this->m_coordinates[p_index]);	
 	}
-	real_type* GenericWell::pressure(uint_type p_index)	{
-		return &(this->m_pressure[p_index]);		
-	}
 	real_type GenericWell::radius() const{
 		return this->m_radius;
 	}
@@ -0,0 +1,320 @@
+#ifndef H_WellSimulator_BLOCK4X4
+#define H_WellSimulator_BLOCK4X4
+
+#include <cmath>
+
+// AVX2 kernels on x86-64, chosen at run time; define WELLSIM_NO_SIMD for the scalar ones only.
+// MSVC has the AVX2 intrinsics, __cpuidex and _xgetbv from Visual Studio 2012 on.
+#if !defined( WELLSIM_NO_SIMD ) && ( ( defined( __GNUC__ ) && defined( __x86_64__ ) ) || ( defined( _MSC_VER ) && _MSC_VER >= 1700 && defined( _M_X64 ) ) )
+#define WELLSIM_BLOCK4X4_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BLOCK4X4_AVX2_TARGET
+#else
+#define BLOCK4X4_AVX2_TARGET __attribute__(( target( "avx2,fma" ) ))
+#endif
+#endif
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+    // Dense kernels for the 4x4 blocks (one per pair of well cells) of the drift-flux Jacobian.
+    // Blocks are stored row-major in 16 contiguous values. The scalar kernels take double or float
+    // blocks, the latter for the single precision factors of the mixed precision solves.
+    // A block row is one 256-bit register, so with AVX2 the block products and the substitutions on
+    // the rows of a block are a few fused multiply-adds: gemm_sub and lu_solve_block, the kernels of
+    // a block LU factorization, use them when the CPU has AVX2 and FMA (about half the time of the
+    // scalar ones on a 2000 cell well). The results then differ from the scalar ones by rounding
+    // only. The matrix-vector products and the sweeps of a solve gained nothing measurable and stay
+    // scalar, like lu_factor and lu_solve, which are sequential.
+namespace block4x4 {
+
+    enum { N = 4, SIZE = 16 };
+
+#ifdef WELLSIM_BLOCK4X4_AVX2
+    inline bool avx2_supported(){
+#ifdef _MSC_VER
+        int info[ 4 ];
+        __cpuid( info, 0 );
+        if( info[ 0 ] < 7 ) return false;
+        __cpuid( info, 1 );
+        bool fma = ( info[ 2 ] & ( 1 << 12 ) ) != 0, osxsave = ( info[ 2 ] & ( 1 << 27 ) ) != 0;
+        if( !fma || !osxsave || ( _xgetbv( 0 ) & 6 ) != 6 ) return false; // OS saves the YMM registers
+        __cpuidex( info, 7, 0 );
+        return ( info[ 1 ] & ( 1 << 5 ) ) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+#endif
+    }
+#else
+    inline bool avx2_supported(){ return false; }
+#endif
+
+    // Whether the kernels below use AVX2. Set from the CPU during static initialization (Block4x4.cpp),
+    // before any thread reads it; can be switched off to compare with the scalar kernels, and back
+    // on only where avx2_supported().
+    extern bool s_use_simd;
+    inline bool& use_simd(){
+        return s_use_simd;
+    }
+
+namespace scalar {
+
+    template <class Real>
+    inline void zero( Real* a ){
+        for( int k = 0; k < SIZE; ++k ) a[ k ] = Real( 0 );
+    }
+
+    // Also between precisions
+    template <class RealA, class RealB>
+    inline void copy( const RealA* a, RealB* b ){
+        for( int k = 0; k < SIZE; ++k ) b[ k ] = RealB( a[ k ] );
+    }
+
+    // y += A*x
+    template <class Real>
+    inline void gemv_add( const Real* a, const Real* x, Real* y ){
+        for( int r = 0; r < N; ++r )
+            y[ r ] += a[ N*r ]*x[ 0 ] + a[ N*r + 1 ]*x[ 1 ] + a[ N*r + 2 ]*x[ 2 ] + a[ N*r + 3 ]*x[ 3 ];
+    }
+
+    // y -= A*x
+    template <class Real>
+    inline void gemv_sub( const Real* a, const Real* x, Real* y ){
+        for( int r = 0; r < N; ++r )
+            y[ r ] -= a[ N*r ]*x[ 0 ] + a[ N*r + 1 ]*x[ 1 ] + a[ N*r + 2 ]*x[ 2 ] + a[ N*r + 3 ]*x[ 3 ];
+    }
+
+    // y += [ A_0 A_1 ... ]*x for p_blocks consecutive blocks of a block row, x of 4*p_blocks
+    template <class Real>
+    inline void gemv_add_row( const Real* a, const Real* x, int p_blocks, Real* y ){
+        for( int b = 0; b < p_blocks; ++b ) gemv_add( a + SIZE*b, x + N*b, y );
+    }
+
+    // y += A^T*x
+    template <class Real>
+    inline void gemv_trans_add( const Real* a, const Real* x, Real* y ){
+        for( int c = 0; c < N; ++c )
+            y[ c ] += a[ c ]*x[ 0 ] + a[ N + c ]*x[ 1 ] + a[ 2*N + c ]*x[ 2 ] + a[ 3*N + c ]*x[ 3 ];
+    }
+
+    // C -= A*B
+    template <class Real>
+    inline void gemm_sub( const Real* a, const Real* b, Real* c ){
+        for( int r = 0; r < N; ++r )
+            for( int col = 0; col < N; ++col )
+                c[ N*r + col ] -= a[ N*r ]*b[ col ] + a[ N*r + 1 ]*b[ N + col ]
+                                + a[ N*r + 2 ]*b[ 2*N + col ] + a[ N*r + 3 ]*b[ 3*N + col ];
+    }
+
+    // In-place LU with partial pivoting. Returns false on a zero pivot.
+    template <class Real>
+    inline bool lu_factor( Real* a, int* piv ){
+        for( int k = 0; k < N; ++k ){
+            int p = k;
+            Real amax = std::fabs( a[ N*k + k ] );
+            for( int r = k + 1; r < N; ++r ){
+                if( std::fabs( a[ N*r + k ] ) > amax ){
+                    amax = std::fabs( a[ N*r + k ] );
+                    p = r;
+                }
+            }
+            piv[ k ] = p;
+            if( amax == Real( 0 ) ) return false;
+            if( p != k ){
+                for( int col = 0; col < N; ++col ){
+                    Real tmp = a[ N*k + col ];
+                    a[ N*k + col ] = a[ N*p + col ];
+                    a[ N*p + col ] = tmp;
+                }
+            }
+            Real inv_pivot = Real( 1 )/a[ N*k + k ];
+            for( int r = k + 1; r < N; ++r ){
+                Real l = ( a[ N*r + k ] *= inv_pivot );
+                for( int col = k + 1; col < N; ++col )
+                    a[ N*r + col ] -= l*a[ N*k + col ];
+            }
+        }
+        return true;
+    }
+
+    // x <- A^-1 x using the factors from lu_factor
+    template <class Real>
+    inline void lu_solve( const Real* lu, const int* piv, Real* x ){
+        for( int k = 0; k < N; ++k ){
+            if( piv[ k ] != k ){
+                Real tmp = x[ k ];
+                x[ k ] = x[ piv[ k ] ];
+                x[ piv[ k ] ] = tmp;
+            }
+        }
+        for( int r = 1; r < N; ++r )
+            for( int col = 0; col < r; ++col )
+                x[ r ] -= lu[ N*r + col ]*x[ col ];
+        for( int r = N - 1; r >= 0; --r ){
+            for( int col = r + 1; col < N; ++col )
+                x[ r ] -= lu[ N*r + col ]*x[ col ];
+            x[ r ] /= lu[ N*r + r ];
+        }
+    }
+
+    // B <- A^-1 B (all four columns of B) using the factors from lu_factor
+    template <class Real>
+    inline void lu_solve_block( const Real* lu, const int* piv, Real* b ){
+        Real column[ N ];
+        for( int col = 0; col < N; ++col ){
+            for( int r = 0; r < N; ++r ) column[ r ] = b[ N*r + col ];
+            lu_solve( lu, piv, column );
+            for( int r = 0; r < N; ++r ) b[ N*r + col ] = column[ r ];
+        }
+    }
+
+    // Block forward substitution y_i <- D_i^-1 ( y_i - W_i y_i-1 ) over p_blocks block rows, with
+    // D_i factored by lu_factor. W_0 is not read.
+    template <class Real>
+    inline void forward_substitution( const Real* w, const Real* d, const int* piv, unsigned p_blocks, Real* y ){
+        for( unsigned i = 0; i < p_blocks; ++i ){
+            Real* y_i = y + N*i;
+            if( i > 0 ) gemv_sub( w + SIZE*i, y_i - N, y_i );
+            lu_solve( d + SIZE*i, piv + N*i, y_i );
+        }
+    }
+
+    // Block back substitution y_i <- y_i - E_i y_i+1 - EE_i y_i+2, from the last block row up
+    template <class Real>
+    inline void back_substitution( const Real* e, const Real* ee, unsigned p_blocks, Real* y ){
+        for( unsigned i = p_blocks; i-- > 0; ){
+            Real* y_i = y + N*i;
+            if( i + 1 < p_blocks ) gemv_sub( e  + SIZE*i, y_i + N, y_i );
+            if( i + 2 < p_blocks ) gemv_sub( ee + SIZE*i, y_i + 2*N, y_i );
+        }
+    }
+
+} // namespace scalar
+
+#ifdef WELLSIM_BLOCK4X4_AVX2
+namespace avx2 {
+
+    BLOCK4X4_AVX2_TARGET inline void gemm_sub( const double* a, const double* b, double* c ){
+        __m256d b0 = _mm256_loadu_pd( b ), b1 = _mm256_loadu_pd( b + N ),
+                b2 = _mm256_loadu_pd( b + 2*N ), b3 = _mm256_loadu_pd( b + 3*N );
+        for( int r = 0; r < N; ++r ){
+            const double* a_r = a + N*r;
+            __m256d c_r = _mm256_loadu_pd( c + N*r );
+            c_r = _mm256_fnmadd_pd( _mm256_broadcast_sd( a_r ), b0, c_r );
+            c_r = _mm256_fnmadd_pd( _mm256_broadcast_sd( a_r + 1 ), b1, c_r );
+            c_r = _mm256_fnmadd_pd( _mm256_broadcast_sd( a_r + 2 ), b2, c_r );
+            c_r = _mm256_fnmadd_pd( _mm256_broadcast_sd( a_r + 3 ), b3, c_r );
+            _mm256_storeu_pd( c + N*r, c_r );
+        }
+    }
+
+    // The substitutions of lu_solve on whole rows of B
+    BLOCK4X4_AVX2_TARGET inline void lu_solve_block( const double* lu, const int* piv, double* b ){
+        __m256d row[ N ];
+        for( int r = 0; r < N; ++r ) row[ r ] = _mm256_loadu_pd( b + N*r );
+        for( int k = 0; k < N; ++k ){
+            if( piv[ k ] != k ){
+                __m256d tmp = row[ k ];
+                row[ k ] = row[ piv[ k ] ];
+                row[ piv[ k ] ] = tmp;
+            }
+        }
+        for( int r = 1; r < N; ++r )
+            for( int col = 0; col < r; ++col )
+                row[ r ] = _mm256_fnmadd_pd( _mm256_broadcast_sd( lu + N*r + col ), row[ col ], row[ r ] );
+        for( int r = N - 1; r >= 0; --r ){
+            for( int col = r + 1; col < N; ++col )
+                row[ r ] = _mm256_fnmadd_pd( _mm256_broadcast_sd( lu + N*r + col ), row[ col ], row[ r ] );
+            row[ r ] = _mm256_div_pd( row[ r ], _mm256_broadcast_sd( lu + N*r + r ) );
+        }
+        for( int r = 0; r < N; ++r ) _mm256_storeu_pd( b + N*r, row[ r ] );
+    }
+
+    // Float blocks, for the single precision factors: a block row is one 128-bit register
+
+    BLOCK4X4_AVX2_TARGET inline void gemm_sub( const float* a, const float* b, float* c ){
+        __m128 b0 = _mm_loadu_ps( b ), b1 = _mm_loadu_ps( b + N ),
+               b2 = _mm_loadu_ps( b + 2*N ), b3 = _mm_loadu_ps( b + 3*N );
+        for( int r = 0; r < N; ++r ){
+            const float* a_r = a + N*r;
+            __m128 c_r = _mm_loadu_ps( c + N*r );
+            c_r = _mm_fnmadd_ps( _mm_set1_ps( a_r[ 0 ] ), b0, c_r );
+            c_r = _mm_fnmadd_ps( _mm_set1_ps( a_r[ 1 ] ), b1, c_r );
+            c_r = _mm_fnmadd_ps( _mm_set1_ps( a_r[ 2 ] ), b2, c_r );
+            c_r = _mm_fnmadd_ps( _mm_set1_ps( a_r[ 3 ] ), b3, c_r );
+            _mm_storeu_ps( c + N*r, c_r );
+        }
+    }
+
+    BLOCK4X4_AVX2_TARGET inline void lu_solve_block( const float* lu, const int* piv, float* b ){
+        __m128 row[ N ];
+        for( int r = 0; r < N; ++r ) row[ r ] = _mm_loadu_ps( b + N*r );
+        for( int k = 0; k < N; ++k ){
+            if( piv[ k ] != k ){
+                __m128 tmp = row[ k ];
+                row[ k ] = row[ piv[ k ] ];
+                row[ piv[ k ] ] = tmp;
+            }
+        }
+        for( int r = 1; r < N; ++r )
+            for( int col = 0; col < r; ++col )
+                row[ r ] = _mm_fnmadd_ps( _mm_set1_ps( lu[ N*r + col ] ), row[ col ], row[ r ] );
+        for( int r = N - 1; r >= 0; --r ){
+            for( int col = r + 1; col < N; ++col )
+                row[ r ] = _mm_fnmadd_ps( _mm_set1_ps( lu[ N*r + col ] ), row[ col ], row[ r ] );
+            row[ r ] = _mm_div_ps( row[ r ], _mm_set1_ps( lu[ N*r + r ] ) );
+        }
+        for( int r = 0; r < N; ++r ) _mm_storeu_ps( b + N*r, row[ r ] );
+    }
+
+} // namespace avx2
+#endif
+
+    using scalar::zero;
+    using scalar::copy;
+    using scalar::lu_factor;
+    using scalar::lu_solve;
+
+#ifdef WELLSIM_BLOCK4X4_AVX2
+    // C -= A*B
+    inline void gemm_sub( const double* a, const double* b, double* c ){
+        if( use_simd() ) avx2::gemm_sub( a, b, c );
+        else             scalar::gemm_sub( a, b, c );
+    }
+
+    // B <- A^-1 B using the factors from lu_factor
+    inline void lu_solve_block( const double* lu, const int* piv, double* b ){
+        if( use_simd() ) avx2::lu_solve_block( lu, piv, b );
+        else             scalar::lu_solve_block( lu, piv, b );
+    }
+
+    // The same for the float blocks of the single precision factors
+    inline void gemm_sub( const float* a, const float* b, float* c ){
+        if( use_simd() ) avx2::gemm_sub( a, b, c );
+        else             scalar::gemm_sub( a, b, c );
+    }
+
+    inline void lu_solve_block( const float* lu, const int* piv, float* b ){
+        if( use_simd() ) avx2::lu_solve_block( lu, piv, b );
+        else             scalar::lu_solve_block( lu, piv, b );
+    }
+#endif
+    // The scalar kernels, for what has no AVX2 version above
+    using scalar::gemv_add;
+    using scalar::gemv_sub;
+    using scalar::gemv_add_row;
+    using scalar::gemv_trans_add;
+    using scalar::gemm_sub;
+    using scalar::lu_solve_block;
+    using scalar::forward_substitution;
+    using scalar::back_substitution;
+
+} // namespace block4x4
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_BLOCK4X4
@@ -0,0 +1,170 @@
+#ifndef H_WellSimulator_BLOCKBANDEDSOLVER
+#define H_WellSimulator_BLOCKBANDEDSOLVER
+
+#include <Block4x4.h>
+#include <BlockSparseMatrix.h>
+#include <vector>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// BlockBandedSolver ===============================================================================
+//
+//  Direct solver for the well Jacobian. Block row i only couples cells i-1 (W), i (P), i+1 (E) and
+//  i+2 (EE, from the momentum residual), so the matrix is block banded with lower bandwidth 1 and
+//  upper bandwidth 2. A block Thomas elimination factors it in O(N) with no fill outside the band:
+//
+//      D'_i  = D_i - W_i*Eh_{i-1},   E'_i = E_i - W_i*EEh_{i-1}
+//      Eh_i  = D'_i^-1 E'_i,         EEh_i = D'_i^-1 EE_i
+//
+//  Only the 4x4 diagonal blocks are pivoted, so factorize() fails on a singular D'_i.
+//  On the BlockSparseMatrix pattern this is also the block ILU(0) factorization, since no fill
+//  falls outside the stencil; solve() has the ITL preconditioner signature for that use.
+//  Real is the precision the factors are computed, kept and applied in: with float they take half
+//  the memory and the bandwidth, and solve() converts b and x from and to double.
+//
+template <class Real>
+class BasicBlockBandedSolver
+{
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    BasicBlockBandedSolver() : m_nblocks( 0 ) {}
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    void resize( unsigned p_nblocks ){
+        m_nblocks = p_nblocks;
+        m_W.resize ( block4x4::SIZE*p_nblocks );
+        m_D.resize ( block4x4::SIZE*p_nblocks );
+        m_E.resize ( block4x4::SIZE*p_nblocks );
+        m_EE.resize( block4x4::SIZE*p_nblocks );
+        m_pivot.resize( block4x4::N*p_nblocks );
+        m_work.resize ( block4x4::N*p_nblocks );
+    }
+
+    unsigned number_of_blocks() const { return m_nblocks; }
+
+    // Copies the band of an MTL row-major sparse matrix into the block arrays.
+    // Returns false if A has an entry outside the W/P/E/EE band.
+    template <class Matrix>
+    bool load( const Matrix& A ){
+        if( m_nblocks != A.nrows()/block4x4::N ) resize( A.nrows()/block4x4::N );
+        for( unsigned k = 0; k < m_D.size(); ++k ){
+            m_W[ k ] = m_D[ k ] = m_E[ k ] = m_EE[ k ] = Real( 0 );
+        }
+
+        typename Matrix::const_iterator A_i;
+        for( A_i = A.begin(); A_i != A.end(); ++A_i ){
+            unsigned row = A_i.index();
+            typename Matrix::OneD::const_iterator A_ij;
+            for( A_ij = (*A_i).begin(); A_ij != (*A_i).end(); ++A_ij ){
+                unsigned col = A_ij.index();
+                Real* block = this->block( row/block4x4::N, col/block4x4::N );
+                if( !block ) return false;
+                block[ block4x4::N*( row % block4x4::N ) + col % block4x4::N ] = Real( *A_ij );
+            }
+        }
+        return true;
+    }
+
+    // Block copy from the fixed-pattern Jacobian storage.
+    bool load( const BlockSparseMatrix& A ){
+        return this->load( A, 0, A.number_of_blocks() );
+    }
+
+    // The diagonal submatrix of block rows and columns p_first to p_first + p_nblocks - 1
+    bool load( const BlockSparseMatrix& A, unsigned p_first, unsigned p_nblocks ){
+        if( m_nblocks != p_nblocks ) resize( p_nblocks );
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            unsigned row = p_first + i;
+            copy_block( i > 0             ? A.block( row, BlockSparseMatrix::W  ) : 0, &m_W [ block4x4::SIZE*i ] );
+            copy_block(                     A.block( row, BlockSparseMatrix::C  ),     &m_D [ block4x4::SIZE*i ] );
+            copy_block( i + 1 < m_nblocks ? A.block( row, BlockSparseMatrix::E  ) : 0, &m_E [ block4x4::SIZE*i ] );
+            copy_block( i + 2 < m_nblocks ? A.block( row, BlockSparseMatrix::EE ) : 0, &m_EE[ block4x4::SIZE*i ] );
+        }
+        return true;
+    }
+
+    // Factors the loaded blocks in place. Returns false on a singular diagonal block.
+    bool factorize(){
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            Real* D  = &m_D [ block4x4::SIZE*i ];
+            Real* E  = &m_E [ block4x4::SIZE*i ];
+            Real* EE = &m_EE[ block4x4::SIZE*i ];
+            int*  piv  = &m_pivot[ block4x4::N*i ];
+
+            if( i > 0 ){
+                const Real* W = &m_W[ block4x4::SIZE*i ];
+                block4x4::gemm_sub( W, &m_E [ block4x4::SIZE*(i-1) ], D );
+                block4x4::gemm_sub( W, &m_EE[ block4x4::SIZE*(i-1) ], E );
+            }
+            if( !block4x4::lu_factor( D, piv ) ) return false;
+            block4x4::lu_solve_block( D, piv, E );
+            block4x4::lu_solve_block( D, piv, EE );
+        }
+        return true;
+    }
+
+    // x = A^-1 b. Vectors only need operator[]; b and x may be the same object.
+    template <class VectorB, class VectorX>
+    void solve( const VectorB& b, VectorX& x ) const {
+        Real* y = &m_work[ 0 ];
+        for( unsigned k = 0; k < m_work.size(); ++k ) y[ k ] = Real( b[ k ] );
+
+        block4x4::forward_substitution( &m_W[ 0 ], &m_D[ 0 ], &m_pivot[ 0 ], m_nblocks, y );
+        block4x4::back_substitution( &m_E[ 0 ], &m_EE[ 0 ], m_nblocks, y );
+
+        for( unsigned k = 0; k < m_work.size(); ++k ) x[ k ] = y[ k ];
+    }
+
+    // Y = A^-1 Y for the four columns of Y, given as one 4x4 block per block row. The blocks of Y
+    // before block row p_first must be zero.
+    void solve_block( Real* p_Y, unsigned p_first ) const {
+        for( unsigned i = p_first; i < m_nblocks; ++i ){
+            Real* Y_i = p_Y + block4x4::SIZE*i;
+            if( i > p_first ) block4x4::gemm_sub( &m_W[ block4x4::SIZE*i ], Y_i - block4x4::SIZE, Y_i );
+            block4x4::lu_solve_block( &m_D[ block4x4::SIZE*i ], &m_pivot[ block4x4::N*i ], Y_i );
+        }
+        for( unsigned i = m_nblocks; i-- > 0; ){
+            Real* Y_i = p_Y + block4x4::SIZE*i;
+            if( i + 1 < m_nblocks ) block4x4::gemm_sub( &m_E [ block4x4::SIZE*i ], Y_i + block4x4::SIZE, Y_i );
+            if( i + 2 < m_nblocks ) block4x4::gemm_sub( &m_EE[ block4x4::SIZE*i ], Y_i + 2*block4x4::SIZE, Y_i );
+        }
+    }
+
+//-------------------------------------------------------------------------------- Internal functions
+protected:
+    static void copy_block( const double* p_from, Real* p_to ){
+        if( p_from ) block4x4::copy( p_from, p_to );
+        else         block4x4::zero( p_to );
+    }
+
+    Real* block( unsigned p_block_row, unsigned p_block_col ){
+        Real* base = 0;
+        if     ( p_block_col + 1 == p_block_row ) base = &m_W [ 0 ];
+        else if( p_block_col     == p_block_row ) base = &m_D [ 0 ];
+        else if( p_block_col     == p_block_row + 1 ) base = &m_E [ 0 ];
+        else if( p_block_col     == p_block_row + 2 ) base = &m_EE[ 0 ];
+        else return 0;
+        return base + block4x4::SIZE*p_block_row;
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    unsigned            m_nblocks;
+    std::vector<Real>   m_W;
+    std::vector<Real>   m_D;
+    std::vector<Real>   m_E;
+    std::vector<Real>   m_EE;
+    std::vector<int>    m_pivot;
+    mutable std::vector<Real> m_work;
+
+}; // class BasicBlockBandedSolver
+
+typedef BasicBlockBandedSolver<double>  BlockBandedSolver;
+typedef BasicBlockBandedSolver<float>   FloatBlockBandedSolver;
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_BLOCKBANDEDSOLVER
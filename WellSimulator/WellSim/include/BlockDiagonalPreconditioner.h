@@ -0,0 +1,65 @@
+#ifndef H_WellSimulator_BLOCKDIAGONALPRECONDITIONER
+#define H_WellSimulator_BLOCKDIAGONALPRECONDITIONER
+
+#include <Block4x4.h>
+#include <vector>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// BlockDiagonalPreconditioner =====================================================================
+//
+//  Block Jacobi: the inverse of the 4x4 diagonal blocks (the P block of every row) of the well
+//  Jacobian, each factored on its own. Needs no more than the diagonal blocks, so it can be kept
+//  when the full Jacobian is never assembled. solve() has the ITL preconditioner signature.
+//
+class BlockDiagonalPreconditioner
+{
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    BlockDiagonalPreconditioner() : m_nblocks( 0 ) {}
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    void resize( unsigned p_nblocks ){
+        m_nblocks = p_nblocks;
+        m_D.resize( block4x4::SIZE*p_nblocks );
+        m_pivot.resize( block4x4::N*p_nblocks );
+    }
+
+    unsigned number_of_blocks() const { return m_nblocks; }
+
+    // Diagonal block of block row p_row, to be filled before factorize()
+    double* block( unsigned p_row ){ return &m_D[ block4x4::SIZE*p_row ]; }
+
+    // Factors the blocks in place. Returns false on a singular block.
+    bool factorize(){
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            if( !block4x4::lu_factor( &m_D[ block4x4::SIZE*i ], &m_pivot[ block4x4::N*i ] ) ) return false;
+        }
+        return true;
+    }
+
+    // x = D^-1 b. Vectors only need operator[]; b and x may be the same object.
+    template <class VectorB, class VectorX>
+    void solve( const VectorB& b, VectorX& x ) const {
+        double y[ block4x4::N ];
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            for( int r = 0; r < block4x4::N; ++r ) y[ r ] = b[ block4x4::N*i + r ];
+            block4x4::lu_solve( &m_D[ block4x4::SIZE*i ], &m_pivot[ block4x4::N*i ], y );
+            for( int r = 0; r < block4x4::N; ++r ) x[ block4x4::N*i + r ] = y[ r ];
+        }
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    unsigned            m_nblocks;
+    std::vector<double> m_D;
+    std::vector<int>    m_pivot;
+
+}; // class BlockDiagonalPreconditioner
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_BLOCKDIAGONALPRECONDITIONER
@@ -0,0 +1,196 @@
+#ifndef H_WellSimulator_BLOCKSPARSEMATRIX
+#define H_WellSimulator_BLOCKSPARSEMATRIX
+
+#include <Block4x4.h>
+#include <vector>
+#include <cassert>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// BlockSparseMatrix ===============================================================================
+//
+//  Block sparse row (BSR) storage for the well Jacobian with the stencil fixed at construction.
+//  Block row i holds the 4x4 blocks of columns i-1 (W), i (P), i+1 (E) and i+2 (EE), clipped at
+//  the well ends, stored contiguously row after row. Since the pattern never changes, the slot
+//  of any entry is computed arithmetically and assembly never searches or allocates.
+//  It is not an MTL matrix: the scalar ITL preconditioners (itl::ILU, itl::SSOR, ...) take its
+//  copy_to() copy, see ScalarPreconditioner. Its block ILU(0) is BlockBandedSolver, which the
+//  stencil makes an exact factorization.
+//
+class BlockSparseMatrix
+{
+//--------------------------------------------------------------------------------- Type Definitions
+public:
+    typedef double      value_type;
+    typedef unsigned    size_type;
+    enum { W = -1, C = 0, E = 1, EE = 2 }; // block offsets of the stencil
+
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    BlockSparseMatrix() : m_nblocks( 0 ) {}
+    BlockSparseMatrix( size_type p_nrows, size_type p_ncols ) : m_nblocks( 0 ) {
+        assert( p_nrows == p_ncols && p_nrows % block4x4::N == 0 );
+        resize( p_nrows/block4x4::N );
+    }
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    void resize( size_type p_nblocks ){
+        m_nblocks = p_nblocks;
+        m_row_ptr.resize( p_nblocks + 1 );
+        m_row_ptr[ 0 ] = 0;
+        for( size_type i = 0; i < p_nblocks; ++i ){
+            size_type first = ( i > 0 ) ? i - 1 : 0;
+            size_type last  = ( i + 2 < p_nblocks ) ? i + 2 : p_nblocks - 1;
+            m_row_ptr[ i + 1 ] = m_row_ptr[ i ] + ( last - first + 1 );
+        }
+        m_values.assign( block4x4::SIZE*m_row_ptr[ p_nblocks ], 0.0 );
+    }
+
+    size_type nrows() const { return block4x4::N*m_nblocks; }
+    size_type ncols() const { return block4x4::N*m_nblocks; }
+    size_type nnz()   const { return m_values.size(); }
+    size_type number_of_blocks() const { return m_nblocks; }
+
+    // Block of block row p_row at stencil offset p_offset (W, C, E or EE), or 0 if clipped.
+    double* block( size_type p_row, int p_offset ){
+        int col = int( p_row ) + p_offset;
+        if( col < 0 || col >= int( m_nblocks ) ) return 0;
+        return &m_values[ block4x4::SIZE*slot( p_row, col ) ];
+    }
+    const double* block( size_type p_row, int p_offset ) const {
+        return const_cast<BlockSparseMatrix*>( this )->block( p_row, p_offset );
+    }
+
+    // Scalar access, only valid inside the stencil.
+    double& operator()( size_type p_row, size_type p_col ){
+        size_type bi = p_row/block4x4::N, bj = p_col/block4x4::N;
+        assert( bj + 1 >= bi && bj <= bi + 2 );
+        return m_values[ block4x4::SIZE*slot( bi, bj ) + block4x4::N*( p_row % block4x4::N ) + p_col % block4x4::N ];
+    }
+    double operator()( size_type p_row, size_type p_col ) const {
+        return const_cast<BlockSparseMatrix&>( *this )( p_row, p_col );
+    }
+
+    void set_zero(){
+        for( size_type k = 0; k < m_values.size(); ++k ) m_values[ k ] = 0.0;
+    }
+
+    // Copies the blocks into an MTL row-major sparse matrix, zeros inside the stencil included.
+    // A matrix holding the pattern of an earlier copy is only overwritten, entry after entry in
+    // the order it stores them; any other is first made nrows() x ncols() and filled by A(r,c).
+    template <class Matrix>
+    void copy_to( Matrix& A ) const {
+        if( A.nrows() != nrows() || A.ncols() != ncols() || A.nnz() != nnz() ){
+            A = Matrix( nrows(), ncols() );
+            for( size_type i = 0; i < m_nblocks; ++i ){
+                size_type first = ( i > 0 ) ? i - 1 : 0;
+                for( size_type k = m_row_ptr[ i ]; k < m_row_ptr[ i + 1 ]; ++k )
+                    for( int r = 0; r < block4x4::N; ++r )
+                        for( int c = 0; c < block4x4::N; ++c )
+                            A( block4x4::N*i + r, block4x4::N*( first + k - m_row_ptr[ i ] ) + c ) = m_values[ block4x4::SIZE*k + block4x4::N*r + c ];
+            }
+            return;
+        }
+        typename Matrix::iterator A_i;
+        for( A_i = A.begin(); A_i != A.end(); ++A_i ){
+            size_type row = A_i.index(), i = row/block4x4::N;
+            const double* values = &m_values[ block4x4::SIZE*slot( i, ( i > 0 ) ? i - 1 : 0 ) + block4x4::N*( row % block4x4::N ) ];
+            size_type first_col = block4x4::N*( ( i > 0 ) ? i - 1 : 0 );
+            typename Matrix::OneD::iterator A_ij;
+            for( A_ij = (*A_i).begin(); A_ij != (*A_i).end(); ++A_ij ){
+                size_type col = A_ij.index() - first_col;
+                *A_ij = values[ block4x4::SIZE*( col/block4x4::N ) + col % block4x4::N ];
+            }
+        }
+    }
+
+    // y = A*x
+    template <class VecX, class VecY>
+    void mult( const VecX& x, VecY& y ) const {
+        double y_i[ block4x4::N ];
+        for( size_type i = 0; i < m_nblocks; ++i ){
+            y_i[ 0 ] = y_i[ 1 ] = y_i[ 2 ] = y_i[ 3 ] = 0.0;
+            row_mult( i, x, y_i );
+            for( int r = 0; r < block4x4::N; ++r ) y[ block4x4::N*i + r ] = y_i[ r ];
+        }
+    }
+
+    // z = A*x + y
+    template <class VecX, class VecY, class VecZ>
+    void mult( const VecX& x, const VecY& y, VecZ& z ) const {
+        double z_i[ block4x4::N ];
+        for( size_type i = 0; i < m_nblocks; ++i ){
+            for( int r = 0; r < block4x4::N; ++r ) z_i[ r ] = y[ block4x4::N*i + r ];
+            row_mult( i, x, z_i );
+            for( int r = 0; r < block4x4::N; ++r ) z[ block4x4::N*i + r ] = z_i[ r ];
+        }
+    }
+
+    // y = A^T*x, for QMR: block row i of A scatters into the block rows of y its columns span
+    template <class VecX, class VecY>
+    void trans_mult( const VecX& x, VecY& y ) const {
+        double x_i[ block4x4::N ], y_j[ block4x4::N ];
+        for( size_type k = 0; k < nrows(); ++k ) y[ k ] = 0.0;
+        for( size_type i = 0; i < m_nblocks; ++i ){
+            for( int r = 0; r < block4x4::N; ++r ) x_i[ r ] = x[ block4x4::N*i + r ];
+            size_type first = ( i > 0 ) ? i - 1 : 0;
+            for( size_type k = m_row_ptr[ i ]; k < m_row_ptr[ i + 1 ]; ++k ){
+                size_type j = first + k - m_row_ptr[ i ];
+                for( int r = 0; r < block4x4::N; ++r ) y_j[ r ] = y[ block4x4::N*j + r ];
+                block4x4::gemv_trans_add( &m_values[ block4x4::SIZE*k ], x_i, y_j );
+                for( int r = 0; r < block4x4::N; ++r ) y[ block4x4::N*j + r ] = y_j[ r ];
+            }
+        }
+    }
+
+//-------------------------------------------------------------------------------- Internal functions
+protected:
+    // y_i += block row p_row times x, in one kernel call over the blocks of the row
+    template <class VecX>
+    void row_mult( size_type p_row, const VecX& x, double* y_i ) const {
+        double x_row[ 4*block4x4::N ];
+        size_type first = ( p_row > 0 ) ? p_row - 1 : 0;
+        int blocks = int( m_row_ptr[ p_row + 1 ] - m_row_ptr[ p_row ] );
+        for( int r = 0; r < block4x4::N*blocks; ++r ) x_row[ r ] = x[ block4x4::N*first + r ];
+        block4x4::gemv_add_row( &m_values[ block4x4::SIZE*m_row_ptr[ p_row ] ], x_row, blocks, y_i );
+    }
+
+    size_type slot( size_type p_row, size_type p_col ) const {
+        return m_row_ptr[ p_row ] + p_col - ( ( p_row > 0 ) ? p_row - 1 : 0 );
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    size_type               m_nblocks;
+    std::vector<size_type>  m_row_ptr;
+    std::vector<double>     m_values;
+
+}; // class BlockSparseMatrix
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+
+// ITL interface ===================================================================================
+namespace itl {
+
+    template <class VecX, class VecY>
+    inline void mult( const WellSimulator::BlockSparseMatrix& A, const VecX& x, const VecY& y ){
+        A.mult( x, const_cast<VecY&>( y ) );
+    }
+
+    template <class VecX, class VecY, class VecZ>
+    inline void mult( const WellSimulator::BlockSparseMatrix& A, const VecX& x, const VecY& y, const VecZ& z ){
+        A.mult( x, y, const_cast<VecZ&>( z ) );
+    }
+
+    template <class VecX, class VecY>
+    inline void trans_mult( const WellSimulator::BlockSparseMatrix& A, const VecX& x, const VecY& y ){
+        A.trans_mult( x, const_cast<VecY&>( y ) );
+    }
+
+} // namespace itl
+
+#endif // H_WellSimulator_BLOCKSPARSEMATRIX
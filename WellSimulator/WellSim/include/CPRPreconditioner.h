@@ -0,0 +1,158 @@
+#ifndef H_WellSimulator_CPRPRECONDITIONER
+#define H_WellSimulator_CPRPRECONDITIONER
+
+#include <Block4x4.h>
+#include <BlockBandedSolver.h>
+#include <BlockSparseMatrix.h>
+#include <vector>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// CPRPreconditioner ===============================================================================
+//
+//  Constrained pressure residual, a two-stage preconditioner for the well Jacobian:
+//
+//      p  = A_p^-1 W^T r                       pressure stage
+//      x  = e_P p + M^-1 ( r - A e_P p )       block ILU(0) stage on the full system
+//
+//  W^T is the quasi-IMPES reduction: block row i is weighted by w_i, the pressure row of D_i^-1,
+//  which removes from it the volume fractions and the velocity of cell i. The pressure matrix
+//  A_p = W^T A e_P has one scalar per stencil block, so it is banded like A (lower bandwidth 1,
+//  upper 2) and is factored exactly by scalar elimination. The second stage corrects the residual
+//  left by the pressure stage with the current values of A, so even with factors kept from an
+//  earlier Jacobian the pressure error is solved for on the present one.
+//  solve() has the ITL preconditioner signature and applies the A of the last factorize() or
+//  set_matrix(), which must outlive the solves.
+//
+//  When to choose it: only with set_preconditioner_reuse(true), and block ILU(0) ("ilu") remains
+//  the default. With fresh factors the second stage is the exact LU of this stencil, so the pressure
+//  stage is pure cost. With reused factors, over 8 timesteps of 20 to 200 cells with GMRES, it took
+//  the iterations and the time of block ILU(0) to within 10%; it is kept for Jacobians whose
+//  pressure coupling drifts further between refactorizations than in these wells.
+//
+class CPRPreconditioner
+{
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    CPRPreconditioner() : m_nblocks( 0 ), m_A( 0 ) {}
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    void resize( unsigned p_nblocks ){
+        m_nblocks = p_nblocks;
+        m_weights.resize( block4x4::N*p_nblocks );
+        m_W.resize ( p_nblocks );
+        m_D.resize ( p_nblocks );
+        m_E.resize ( p_nblocks );
+        m_EE.resize( p_nblocks );
+        m_pressure.resize( p_nblocks );
+        m_residual.resize( block4x4::N*p_nblocks );
+    }
+
+    unsigned number_of_blocks() const { return m_nblocks; }
+
+    // The matrix of the second stage, for factors kept from an earlier one of the same size
+    void set_matrix( const BlockSparseMatrix& A ){ m_A = &A; }
+
+    // Returns false on a singular diagonal block or a zero pivot of the pressure matrix.
+    bool factorize( const BlockSparseMatrix& A ){
+        if( m_nblocks != A.number_of_blocks() ) resize( A.number_of_blocks() );
+        m_A = &A;
+
+        // w_i = e_P^T D_i^-1
+        double D[ block4x4::SIZE ], D_inv[ block4x4::SIZE ];
+        int pivot[ block4x4::N ];
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            block4x4::copy( A.block( i, BlockSparseMatrix::C ), D );
+            if( !block4x4::lu_factor( D, pivot ) ) return false;
+            block4x4::zero( D_inv );
+            for( int k = 0; k < block4x4::N; ++k ) D_inv[ block4x4::N*k + k ] = 1.0;
+            block4x4::lu_solve_block( D, pivot, D_inv );
+            for( int k = 0; k < block4x4::N; ++k ) m_weights[ block4x4::N*i + k ] = D_inv[ PRESSURE*block4x4::N + k ];
+        }
+
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            m_W [ i ] = this->reduce( A, i, BlockSparseMatrix::W  );
+            m_D [ i ] = this->reduce( A, i, BlockSparseMatrix::C  );
+            m_E [ i ] = this->reduce( A, i, BlockSparseMatrix::E  );
+            m_EE[ i ] = this->reduce( A, i, BlockSparseMatrix::EE );
+        }
+
+        // Thomas elimination of the pressure band, m_W keeps the multipliers
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            if( i > 0 ){
+                m_W[ i ] /= m_D[ i-1 ];
+                m_D[ i ] -= m_W[ i ]*m_E [ i-1 ];
+                m_E[ i ] -= m_W[ i ]*m_EE[ i-1 ];
+            }
+            if( m_D[ i ] == 0.0 ) return false;
+        }
+
+        return m_smoother.load( A ) && m_smoother.factorize();
+    }
+
+    // x = M_CPR^-1 b. Vectors only need operator[]; b and x may be the same object.
+    template <class VectorB, class VectorX>
+    void solve( const VectorB& b, VectorX& x ) const {
+        const unsigned N = block4x4::N;
+        double* p = &m_pressure[ 0 ];
+        double* r = &m_residual[ 0 ];
+
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            p[ i ] = 0.0;
+            for( unsigned k = 0; k < N; ++k ) p[ i ] += m_weights[ N*i + k ]*b[ N*i + k ];
+        }
+        for( unsigned i = 1; i < m_nblocks; ++i ) p[ i ] -= m_W[ i ]*p[ i-1 ];
+        for( unsigned i = m_nblocks; i-- > 0; ){
+            if( i + 1 < m_nblocks ) p[ i ] -= m_E [ i ]*p[ i+1 ];
+            if( i + 2 < m_nblocks ) p[ i ] -= m_EE[ i ]*p[ i+2 ];
+            p[ i ] /= m_D[ i ];
+        }
+
+        // r = b - A e_P p: only the pressure column of each block is hit
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            for( unsigned k = 0; k < N; ++k ) r[ N*i + k ] = b[ N*i + k ];
+            for( int offset = BlockSparseMatrix::W; offset <= BlockSparseMatrix::EE; ++offset ){
+                const double* a = m_A->block( i, offset );
+                if( !a ) continue;
+                for( unsigned k = 0; k < N; ++k ) r[ N*i + k ] -= a[ N*k + PRESSURE ]*p[ i + offset ];
+            }
+        }
+        m_smoother.solve( m_residual, m_residual );
+
+        for( unsigned i = 0; i < m_nblocks; ++i ){
+            for( unsigned k = 0; k < N; ++k ) x[ N*i + k ] = r[ N*i + k ];
+            x[ N*i + PRESSURE ] += p[ i ];
+        }
+    }
+
+//-------------------------------------------------------------------------------- Internal functions
+protected:
+    enum{ PRESSURE = 0 }; // unknown P of each block
+
+    // w_i^T A_{i,i+offset} e_P
+    double reduce( const BlockSparseMatrix& A, unsigned i, int p_offset ) const {
+        const double* a = A.block( i, p_offset );
+        if( !a ) return 0.0;
+        double sum = 0.0;
+        for( int k = 0; k < block4x4::N; ++k ) sum += m_weights[ block4x4::N*i + k ]*a[ block4x4::N*k + PRESSURE ];
+        return sum;
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    unsigned                    m_nblocks;
+    const BlockSparseMatrix*    m_A;
+    std::vector<double>         m_weights;              // w_i, 4 per block row
+    std::vector<double>         m_W, m_D, m_E, m_EE;    // pressure band, factored in place
+    BlockBandedSolver           m_smoother;
+    mutable std::vector<double> m_pressure;
+    mutable std::vector<double> m_residual;
+
+}; // class CPRPreconditioner
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_CPRPRECONDITIONER
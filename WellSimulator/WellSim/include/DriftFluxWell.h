@@ -1,6 +1,7 @@
 #ifndef H_WellSimulator_DRIFTFLUXWELL
 #define H_WellSimulator_DRIFTFLUXWELL
 #include <Models.hpp>
+#include <DualNumber.h>
 
 #include <SharedPointer.h>
 
@@ -14,18 +15,28 @@
 #include <mtl/envelope2D.h>
 
 // Includes ITL -----------------------------------------------------------------------------
+#include <BlockSparseMatrix.h> // itl::mult overloads must precede the ITL solvers
+#include <JacobianFreeOperator.h>
 #include <itl/interface/mtl.h>
 #include <itl/preconditioner/ssor.h>
 #include <itl/itl.h>
 #include <itl/preconditioner/ilu.h>
 #include <itl/krylov/gmres.h>
 #include <itl/krylov/qmr.h>
+#include <KrylovWorkspace.h>
 
 #include <memory>
 #include <exception>
 
 //#include <WellSolver.h>
 #include <GenericWell.h>
+#include <BlockBandedSolver.h>
+#include <CPRPreconditioner.h>
+#include <SchwarzPreconditioner.h>
+#include <PartitionedBlockBandedSolver.h>
+#include <BlockDiagonalPreconditioner.h>
+#include <ScalarPreconditioner.h>
+#include <WellState.h>
 #include <string>
 
 
@@ -38,7 +49,8 @@ namespace WellSimulator {
     typedef mtl::matrix< double, mtl::rectangle<>, mtl::dense<>, mtl::row_major>::type 					   dmatrix_type; // MATRIZ DENSA
     typedef mtl::matrix< double, mtl::rectangle<>, mtl::array< mtl::compressed<> >, mtl::row_major >::type smatrix_type; // MATRIZ ESPARSA
     typedef SharedPointer<svector_type> vector_ptr;
-    typedef SharedPointer<smatrix_type> matrix_ptr;
+    typedef BlockSparseMatrix bmatrix_type; // JACOBIANA EM BLOCOS 4x4
+    typedef SharedPointer<bmatrix_type> matrix_ptr;
 
 	typedef char									string_type;
 	typedef double									real_type;
@@ -46,8 +58,75 @@ namespace WellSimulator {
 	//typedef WellSimulator::WellVector				vector_type;
     typedef std::vector<double>				vector_type;
 	typedef NodeCoordinates							coord_type;
-	typedef std::vector< std::vector<uint_type> >	id_type;
 	enum	v_variables{P, alpha_g, alpha_o, v,total_var = 4};
+	enum	linear_solver_type{GMRES_ILU, BLOCK_BANDED_LU, PARALLEL_BLOCK_BANDED_LU}; // GMRES_ILU: the Krylov method and preconditioner of set_krylov_solver()
+																		// PARALLEL_BLOCK_BANDED_LU: BLOCK_BANDED_LU on set_number_of_threads() partitions, double only; serial unless set_partition_thresholds() says otherwise
+	enum	krylov_method_type{KRYLOV_GMRES, KRYLOV_BICGSTAB, KRYLOV_TFQMR, KRYLOV_CGS, KRYLOV_GCR, KRYLOV_GCRODR, KRYLOV_QMR, total_krylov_methods}; // GCRODR: GMRES recycling a subspace across solves
+																		// QMR: ITL's, allocating, with the scalar preconditioners or none only
+	enum	preconditioner_type{BLOCK_ILU, BLOCK_JACOBI, CPR, SCHWARZ, SCALAR_ILU, ILUT, SSOR, DIAGONAL, NO_PRECONDITIONER, total_preconditioners}; // CPR: pressure stage, then block ILU(0); when to choose it: see CPRPreconditioner
+																		// SCHWARZ: overlapping segments, one per thread
+																		// SCALAR_ILU to DIAGONAL: ITL's on a CSR copy of the Jacobian, see ScalarPreconditioner
+	// Their names in the setup file
+	const char* krylov_method_name( krylov_method_type p_method );
+	const char* preconditioner_name( preconditioner_type p_preconditioner );
+	// QMR also solves with M^T, which the block preconditioners don't provide
+	bool krylov_pair_supported( krylov_method_type p_method, preconditioner_type p_preconditioner );
+	enum	jacobian_method_type{FINITE_DIFFERENCE, AUTOMATIC_DIFFERENTIATION, COLORED_FINITE_DIFFERENCE, JACOBIAN_FREE};
+	typedef ad::DualNumber< 4*total_var >	ad_type; // derivatives w.r.t. the W, P, E and EE unknowns
+	typedef ad::DualNumber< total_var >		ad_node_type; // ... w.r.t. the unknowns of the P node only
+
+	// Why the Krylov preconditioner was last refactored
+	enum	refactor_reason_type{
+		NO_REFACTOR,
+		FIRST_FACTORIZATION,
+		ITERATION_GROWTH,		// GMRES ran out of the iterations allowed with the old factors
+		TIMESTEP_CHANGE,		// set_dt() with a new step size
+		TIMESTEP_CUT,			// restore_initial_guess()
+		FAILED_SOLVE,			// GMRES didn't converge with the old factors, or they were singular
+		PRECONDITIONER_LAG,		// JACOBIAN_FREE: the lag ran out
+		total_refactor_reasons
+	};
+	struct PreconditionerStatistics{
+		uint_type factorizations;
+		uint_type reuses;			// solves with the factors of an earlier Newton iteration
+		uint_type krylov_iterations;
+		uint_type krylov_iterations_saved;	// estimated, against solving every Newton step exactly
+		uint_type refactor_reasons[ total_refactor_reasons ];
+		uint_type krylov_tunings;			// auto-tuning rounds started
+		uint_type tuning_factorizations;	// auto-tuning: of every preconditioner, on each Jacobian of a round
+		uint_type refinement_steps;			// mixed precision BLOCK_BANDED_LU: corrections by the float factors
+		real_type recycled_iterations_saved;	// KRYLOV_GCRODR: by the projection on the recycled space, estimated, a lower bound
+		uint_type recycle_applies;			// KRYLOV_GCRODR: operator applies refreshing the recycled space
+	};
+	struct NewtonStatistics{
+		uint_type newton_iterations;
+		uint_type timestep_cuts;		// restore_initial_guess()
+		uint_type chopped_updates;		// steps scaled down to the update limits
+		uint_type backtracks;			// line search halvings
+		uint_type workspace_resizes;	// Newton workspace buffers sized for a new well size or restart, none once it is warm
+	};
+	struct PropertyCacheStatistics{
+		uint_type property_hits;			// densities and viscosities read from the property cache
+		uint_type property_evaluations;		// evaluated by their models, to fill the cache or on a miss
+		uint_type closure_hits;				// drift-flux closures of a face read from the property cache
+		uint_type closure_evaluations;
+	};
+	// The last few residual norms of a Newton loop, a ring buffer so solve() doesn't allocate per timestep
+	struct NormHistory{
+		enum{ CAPACITY = 8 };
+		real_type norms[ CAPACITY ];
+		uint_type first, count;
+
+		NormHistory() : first( 0 ), count( 0 ) {}
+		void clear(){ first = count = 0; }
+		void push( real_type p_norm ){
+			if( count == CAPACITY ) pop(); // keep the newest
+			norms[ ( first + count++ ) % CAPACITY ] = p_norm;
+		}
+		void pop(){ first = ( first + 1 ) % CAPACITY; --count; }
+		real_type front() const { return norms[ first ]; }
+		real_type back() const { return norms[ ( first + count - 1 ) % CAPACITY ]; }
+	};
 
 
 
@@ -79,6 +158,8 @@ namespace WellSimulator {
 		void set_dt( real_type p_dt );
 		real_type area();
 		real_type ksi( real_type p_velocity );
+		template <int N>
+		real_type ksi( const ad::DualNumber<N>& p_velocity );
 
 		real_type mean_density(
 			const real_type& p_oil_vol_frac,
@@ -86,6 +167,13 @@ namespace WellSimulator {
 			const real_type& p_gas_vol_frac,
 			const real_type& p_pressure
 			);
+		template <int N>
+		ad::DualNumber<N> mean_density(
+			const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac,
+			const ad::DualNumber<N>& p_gas_vol_frac,
+			const ad::DualNumber<N>& p_pressure
+			);
 		void set_mean_velocity();
 		void set_constant_oil_vol_frac( real_type p_value );
 		void set_constant_vol_frac( 
@@ -98,10 +186,27 @@ namespace WellSimulator {
 
 		void solve();
         void solve(vector_type& p_pressure);
-
-		void GMRES_Solve( smatrix_type &A, svector_type &x, svector_type &b );
+		bool solve_steady_state();
+
+		void linear_solve( bmatrix_type &A, svector_type &x, svector_type &b );
+		void Krylov_Solve( bmatrix_type &A, svector_type &x, svector_type &b );
+		void Krylov_Tune( bmatrix_type &A, svector_type &x, svector_type &b );
+		int  Krylov_Iterate( krylov_method_type p_method, preconditioner_type p_preconditioner, bmatrix_type &A, svector_type &x, svector_type &b, int p_max_iterations, int &p_iterations );
+		void BlockBanded_Solve( bmatrix_type &A, svector_type &x, svector_type &b );
+		void BlockBanded_Refine( bmatrix_type &A, svector_type &x, svector_type &b );
+		void PartitionedBlockBanded_Solve( bmatrix_type &A, svector_type &x, svector_type &b );
+		void JacobianFree_Solve( svector_type &x, svector_type &b );
 		void compute_Jacobian();
+		void compute_Jacobian_FD();
+		void compute_Jacobian_AD();
+		void compute_Jacobian_colored_FD();
+		void compute_Jacobian_free();
+		void compute_residual( vector_type& p_residual );
+		real_type* pressure( uint_type p_index );
+		void get_unknowns( vector_type& p_unknowns );
+		void set_unknowns( const vector_type& p_unknowns );
 		void update_variables();
+		bool apply_newton_update();
         void update_variables_for_new_timestep();
 		
 		real_type liquid_density(
@@ -109,15 +214,40 @@ namespace WellSimulator {
 			real_type p_water_vol_frac,
 			real_type p_pressure
 			);
+		template <int N>
+		ad::DualNumber<N> liquid_density(
+			const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac,
+			const ad::DualNumber<N>& p_pressure
+			);
 		real_type gas_density	( real_type p_pressure );
 		real_type oil_density	( real_type p_pressure );
 		real_type water_density	( real_type p_pressure );
+		template <int N>
+		ad::DualNumber<N> gas_density		( const ad::DualNumber<N>& p_pressure );
+		template <int N>
+		ad::DualNumber<N> oil_density		( const ad::DualNumber<N>& p_pressure );
+		template <int N>
+		ad::DualNumber<N> water_density	( const ad::DualNumber<N>& p_pressure );
+		// Same, at node p_node: the value left by update_property_cache() when p_pressure is the one
+		// it was evaluated at, the model otherwise (perturbed unknowns, nodes outside the well).
+		real_type gas_density	( real_type p_pressure, uint_type p_node );
+		real_type oil_density	( real_type p_pressure, uint_type p_node );
+		real_type water_density	( real_type p_pressure, uint_type p_node );
+		template <int N>
+		ad::DualNumber<N> gas_density		( const ad::DualNumber<N>& p_pressure, uint_type p_node );
+		template <int N>
+		ad::DualNumber<N> oil_density		( const ad::DualNumber<N>& p_pressure, uint_type p_node );
+		template <int N>
+		ad::DualNumber<N> water_density	( const ad::DualNumber<N>& p_pressure, uint_type p_node );
 
 		real_type mean_velocity( uint_type p_index );
 		real_type C_0();
 		void set_C_0(real_type p_C_0);
 		real_type v_drift_flux( real_type p_gas_vol_frac, real_type p_pressure, real_type p_liquid_density );	
 		real_type friction_factor( real_type p_reynolds );
+		template <int N>
+		ad::DualNumber<N> friction_factor( const ad::DualNumber<N>& p_reynolds );
 
 		real_type mod_v_drift_flux(											
 			real_type p_mean_velocity, 
@@ -133,6 +263,36 @@ namespace WellSimulator {
 			real_type p_water_vol_frac,
 			real_type p_pressure  
 			); // Oil and Water Drift Velocity
+		template <int N>
+		ad::DualNumber<N> mod_v_drift_flux(
+			const ad::DualNumber<N>& p_mean_velocity,
+			const ad::DualNumber<N>& p_gas_vol_frac,
+			const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac,
+			const ad::DualNumber<N>& p_pressure
+			);
+		template <int N>
+		ad::DualNumber<N> mod_v_drift_flux_ow(
+			const ad::DualNumber<N>& p_mean_velocity,
+			const ad::DualNumber<N>& p_gas_vol_frac,
+			const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac,
+			const ad::DualNumber<N>& p_pressure
+			);
+		// Same, at face p_face (between nodes p_face and p_face+1): the value left by
+		// update_property_cache() when the arguments are the face averages it was evaluated at.
+		real_type mod_v_drift_flux( real_type p_mean_velocity, real_type p_gas_vol_frac, real_type p_oil_vol_frac, real_type p_water_vol_frac, real_type p_pressure, uint_type p_face );
+		real_type mod_v_drift_flux_ow( real_type p_mean_velocity, real_type p_gas_vol_frac, real_type p_oil_vol_frac, real_type p_water_vol_frac, real_type p_pressure, uint_type p_face );
+		template <int N>
+		ad::DualNumber<N> mod_v_drift_flux(
+			const ad::DualNumber<N>& p_mean_velocity, const ad::DualNumber<N>& p_gas_vol_frac, const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac, const ad::DualNumber<N>& p_pressure, uint_type p_face
+			);
+		template <int N>
+		ad::DualNumber<N> mod_v_drift_flux_ow(
+			const ad::DualNumber<N>& p_mean_velocity, const ad::DualNumber<N>& p_gas_vol_frac, const ad::DualNumber<N>& p_oil_vol_frac,
+			const ad::DualNumber<N>& p_water_vol_frac, const ad::DualNumber<N>& p_pressure, uint_type p_face
+			);
 
 		void set_gravity( real_type p_valueX, real_type p_valueY, real_type p_valueZ );
 		real_type gravity();
@@ -146,8 +306,27 @@ namespace WellSimulator {
 		real_type gas_viscosity( real_type p_pressure );
 		real_type oil_viscosity( real_type p_pressure );
 		real_type water_viscosity( real_type p_pressure );
-
-		uint_type id( uint_type p_node , uint_type p_variable );
+		template <int N>
+		ad::DualNumber<N> gas_viscosity( const ad::DualNumber<N>& p_pressure );
+		template <int N>
+		ad::DualNumber<N> oil_viscosity( const ad::DualNumber<N>& p_pressure );
+		template <int N>
+		ad::DualNumber<N> water_viscosity( const ad::DualNumber<N>& p_pressure );
+		// Same, at the face between nodes p_face and p_face+1
+		real_type gas_viscosity( real_type p_pressure, uint_type p_face );
+		real_type oil_viscosity( real_type p_pressure, uint_type p_face );
+		real_type water_viscosity( real_type p_pressure, uint_type p_face );
+		template <int N>
+		ad::DualNumber<N> gas_viscosity( const ad::DualNumber<N>& p_pressure, uint_type p_face );
+		template <int N>
+		ad::DualNumber<N> oil_viscosity( const ad::DualNumber<N>& p_pressure, uint_type p_face );
+		template <int N>
+		ad::DualNumber<N> water_viscosity( const ad::DualNumber<N>& p_pressure, uint_type p_face );
+		// Fills m_property_cache at the current pressures, one batch call per model
+		void update_property_cache();
+
+		// Unknowns are interleaved node by node, as in WellState
+		uint_type id( uint_type p_node , uint_type p_variable ) const { return total_var*p_node + p_variable; }
 		real_type segment_length( coord_type p_coord_i, coord_type p_coord_j );
 
         real_type GasMassFlowRate() {return gas_density(m_pressure[0])*m_gas_vol_frac[0]*abs(m_gas_velocity[0])*area();}
@@ -238,40 +417,57 @@ namespace WellSimulator {
 
         void set_gas_liquid_drift_velocity_model(SharedPointer<IDriftVelocityModel> p_gas_liquid_drift_velocity_model){
             m_gas_liquid_drift_velocity_model = p_gas_liquid_drift_velocity_model;
+            this->select_closure();
         }
         void set_oil_water_drift_velocity_model(SharedPointer<IDriftVelocityModel> p_oil_water_drift_velocity_model){
             m_oil_water_drift_velocity_model = p_oil_water_drift_velocity_model;
+            this->select_closure();
         }
         void set_gas_liquid_profile_parameter_model(SharedPointer<IProfileParameterModel> p_gas_liquid_profile_parameter_model){
             m_gas_liquid_profile_parameter_model = p_gas_liquid_profile_parameter_model;
+            this->select_closure();
         }
         void set_oil_water_profile_parameter_model(SharedPointer<IProfileParameterModel> p_oil_water_profile_parameter_model){
             m_oil_water_profile_parameter_model = p_oil_water_profile_parameter_model;
+            this->select_closure();
         }
         void set_gas_oil_interfacial_tension_model(SharedPointer<IInterfacialTensionModel> p_gas_oil_interfacial_tension_model){
             m_gas_oil_interfacial_tension_model = p_gas_oil_interfacial_tension_model;
+            m_property_cache.clear();
         }
         void set_gas_water_interfacial_tension_model(SharedPointer<IInterfacialTensionModel> p_gas_water_interfacial_tension_model){
             m_gas_water_interfacial_tension_model = p_gas_water_interfacial_tension_model;
+            m_property_cache.clear();
         }
         void set_gas_density_model(SharedPointer<IDensityModel> p_gas_density_model){
             m_gas_density_model = p_gas_density_model;
+            m_property_cache.clear();
         }
         void set_oil_density_model(SharedPointer<IDensityModel> p_oil_density_model){
             m_oil_density_model = p_oil_density_model;
+            m_property_cache.clear();
         }
         void set_water_density_model(SharedPointer<IDensityModel> p_water_density_model){
             m_water_density_model = p_water_density_model;
+            m_property_cache.clear();
         }
         void set_gas_viscosity_model(SharedPointer<IViscosityModel> p_gas_viscosity_model){
             m_gas_viscosity_model = p_gas_viscosity_model;
+            m_property_cache.clear();
         }
         void set_oil_viscosity_model(SharedPointer<IViscosityModel> p_oil_viscosity_model){
             m_oil_viscosity_model = p_oil_viscosity_model;
+            m_property_cache.clear();
         }
         void set_water_viscosity_model(SharedPointer<IViscosityModel> p_water_viscosity_model){
             m_water_viscosity_model = p_water_viscosity_model;
+            m_property_cache.clear();
         }
+        // Replaces the density, viscosity and interfacial tension models given above with monotone
+        // cubic tables of them over [p_min_pressure, p_max_pressure], sampled once here. Returns the
+        // largest error of the tables at the midpoints of their intervals, each relative to the
+        // property there. Without intervals or an empty range nothing is tabulated, and it returns 0.
+        real_type tabulate_property_models(real_type p_min_pressure, real_type p_max_pressure, uint_type p_intervals);
 
         real_type get_gas_volume_fraction(uint_type p_index){ return m_gas_vol_frac[p_index]; }
         real_type get_oil_volume_fraction(uint_type p_index){ return m_oil_vol_frac[p_index]; }
@@ -283,10 +479,12 @@ namespace WellSimulator {
 
         void set_has_inclination_correction(bool p_has_inclination_correction){
             m_has_inclination_correction = p_has_inclination_correction;
+            m_property_cache.clear();
         }
 
         void set_inclination(real_type p_inclination){
             m_well_inclination = p_inclination;
+            m_property_cache.clear();
         }
 
         real_type get_inclination(){
@@ -297,14 +495,284 @@ namespace WellSimulator {
             m_final_time = p_final_time;
         }
 
+        // solve() writes WellData/log_results.txt and WellData/results.txt, unless this is false
+        void set_output_files(bool p_output_files){
+            m_output_files = p_output_files;
+        }
+
         void set_max_delta_t(real_type p_max_delta_t){
             m_max_delta_t = p_max_delta_t;
+        }
+
+        void set_linear_solver(linear_solver_type p_linear_solver){
+            m_linear_solver = p_linear_solver;
         }                     
 
+        void set_jacobian_method(jacobian_method_type p_jacobian_method){
+            m_jacobian_method = p_jacobian_method;
+        }
+
+        // Newton iterations a JACOBIAN_FREE preconditioner is kept for
+        void set_preconditioner_lag(uint_type p_preconditioner_lag){
+            m_preconditioner_lag = p_preconditioner_lag > 0 ? p_preconditioner_lag : 1;
+        }
+
+        // Krylov method and preconditioner of GMRES_ILU: GMRES(10) and block ILU(0) by default.
+        // Auto-tuning solves each of the first p_tuning_jacobians Jacobians with every pair, keeps
+        // the one that took the least time, and tunes again once that pair needs p_iteration_growth
+        // (set_refactor_policy()) times the iterations it was tuned at even with fresh factors.
+        void set_krylov_solver(krylov_method_type p_method, preconditioner_type p_preconditioner){
+            m_krylov_method   = p_method;
+            m_preconditioner  = p_preconditioner;
+            m_krylov_auto_tune = false;
+        }
+        void set_krylov_auto_tune(bool p_auto_tune, uint_type p_tuning_jacobians){
+            m_krylov_auto_tune  = p_auto_tune;
+            m_tuning_jacobians  = p_tuning_jacobians > 0 ? p_tuning_jacobians : 1;
+            m_tuned_jacobians   = 0;
+        }
+        // KRYLOV_GCRODR: dimension of the recycled subspace, kept below the restart of 10
+        void set_krylov_recycle_dimension(uint_type p_recycle_dimension){
+            m_krylov_recycle_dimension = p_recycle_dimension > 0 ? p_recycle_dimension : 1;
+        }
+        // By the names of the setup file; "auto" as p_method tunes. Unknown names, and pairs that
+        // krylov_pair_supported() rejects, change nothing.
+        bool set_krylov_solver(const std::string& p_method, const std::string& p_preconditioner);
+        krylov_method_type krylov_method() const {
+            return m_krylov_method;
+        }
+        preconditioner_type preconditioner() const {
+            return m_preconditioner;
+        }
+
+        // With p_reuse GMRES_ILU keeps its factors across Newton iterations and timesteps. A solve with
+        // them may take max( p_iteration_growth times the iterations right after the last
+        // factorization, p_min_iterations ), past which it refactors and solves again; a step size
+        // change or a timestep cut refactors too. Off by default: block ILU(0) is the exact LU of the
+        // well Jacobian, so fresh factors converge in one or two iterations and cost less than the
+        // extra iterations of stale ones.
+        void set_preconditioner_reuse(bool p_reuse){
+            m_preconditioner_reuse = p_reuse;
+        }
+        void set_refactor_policy(real_type p_iteration_growth, uint_type p_min_iterations){
+            m_refactor_iteration_growth = p_iteration_growth;
+            m_refactor_min_iterations   = p_min_iterations;
+        }
+        // Inexact Newton: the Krylov tolerance of each Newton step follows the Eisenstat-Walker
+        // forcing term instead of a fixed 1E-6
+        void set_inexact_newton(bool p_inexact_newton){
+            m_inexact_newton = p_inexact_newton;
+        }
+        // Mixed precision: the block ILU(0) preconditioner and the BLOCK_BANDED_LU factors are
+        // computed, kept and applied in single precision. The Krylov iterations, or an iterative
+        // refinement on the double residual for BLOCK_BANDED_LU, still solve to the tolerance of
+        // the double precision solve.
+        void set_mixed_precision(bool p_mixed_precision){
+            m_mixed_precision = p_mixed_precision;
+        }
+        // SCHWARZ preconditioner: set_number_of_threads() segments sharing p_overlap cells with their
+        // neighbours, combined restricted additively (RAS) or additively
+        void set_schwarz_overlap(uint_type p_overlap, bool p_restricted){
+            m_schwarz.set_overlap( p_overlap, p_restricted );
+        }
+        const PreconditionerStatistics& preconditioner_statistics() const {
+            return m_preconditioner_statistics;
+        }
+        void reset_preconditioner_statistics();
+
+        // Newton globalization: updates limited to p_max_vol_frac_change in any volume fraction and
+        // to p_max_relative_pressure_change times the pressure, volume fractions kept in [0,1], and
+        // a backtracking line search on the residual norm
+        void set_newton_globalization(bool p_newton_globalization){
+            m_newton_globalization = p_newton_globalization;
+        }
+        void set_update_limits(real_type p_max_vol_frac_change, real_type p_max_relative_pressure_change){
+            m_max_vol_frac_change          = p_max_vol_frac_change;
+            m_max_relative_pressure_change = p_max_relative_pressure_change;
+        }
+        void set_max_backtracks(uint_type p_max_backtracks){
+            m_max_backtracks = p_max_backtracks;
+        }
+        const NewtonStatistics& newton_statistics() const {
+            return m_newton_statistics;
+        }
+        void reset_newton_statistics();
+        const PropertyCacheStatistics& property_cache_statistics() const {
+            return m_cache_statistics;
+        }
+        void reset_property_cache_statistics();
+
+        // solve(p_pressure) goes straight to steady state by pseudo-transient continuation instead of
+        // marching physical time, and marches it only if p_max_steps pseudo steps weren't enough. The
+        // pseudo timestep starts at p_initial_dt and grows up to p_max_dt; dt() is left alone.
+        void set_steady_state(bool p_steady_state){
+            m_steady_state = p_steady_state;
+        }
+        void set_pseudo_timestep(real_type p_initial_dt, real_type p_max_dt, uint_type p_max_steps){
+            m_initial_pseudo_dt = p_initial_dt;
+            m_max_pseudo_dt     = p_max_dt;
+            m_max_pseudo_steps  = p_max_steps;
+            m_pseudo_dt         = 0.0;
+        }
+
+        // Threads assembling the Jacobian rows, and the partitions of PARALLEL_BLOCK_BANDED_LU and
+        // the segments of SCHWARZ. The assembly doesn't depend on it.
+        void set_number_of_threads(uint_type p_number_of_threads){
+            m_number_of_threads = p_number_of_threads > 0 ? p_number_of_threads : 1;
+        }
+        // PARALLEL_BLOCK_BANDED_LU: a single partition, the serial elimination, below p_min_partitions
+        // partitions or p_min_partition_cells cells in a partition. By default always.
+        void set_partition_thresholds(uint_type p_min_partitions, uint_type p_min_partition_cells){
+            m_partitioned_solver.set_partition_thresholds( p_min_partitions, p_min_partition_cells );
+        }
+
         real_type calculate_new_delta_t_size_converged_solution(real_type delta_t_old);
         real_type calculate_new_delta_t_size_diverged_solution(real_type delta_t_old);
         void restore_initial_guess();         
 
+		//---------------------------------------------------------------------------- Internal functions
+	protected:
+		// Sizes m_state for p_nnodes nodes, zeroed, and points the state fields at it
+		void resize_state( uint_type p_nnodes );
+		// Assembly of one block row; rows can be assembled concurrently
+		void compute_Jacobian_FD_row( uint_type p_node );
+		void compute_Jacobian_AD_row( uint_type p_node );
+		void compute_AD_row_residual( uint_type p_node, bool p_equations[], ad_type p_R[] );
+		void compute_block_diagonal();
+		void newton_function( const vector_type& p_unknowns, vector_type& p_F );
+		bool refactor_preconditioner( bmatrix_type &A );
+		bool factor_preconditioner( preconditioner_type p_preconditioner, bmatrix_type &A );
+		uint_type preconditioner_blocks() const;
+		template <class Preconditioner>
+		int  run_krylov_method( krylov_method_type p_method, const Preconditioner& M, bmatrix_type &A, svector_type &x, svector_type &b, int p_max_iterations, int &p_iterations );
+		void finish_krylov_tuning();
+		void request_refactor( refactor_reason_type p_reason );
+		void update_forcing_term( real_type p_residual_norm );
+		void reset_forcing_term();
+		real_type krylov_tolerance( real_type p_rhs_norm ) const;
+		void count_krylov_iterations( int p_iterations, real_type p_residual, real_type p_rhs_norm );
+		real_type update_limit_factor();
+		void project_update_to_bounds();
+		bool has_residual( uint_type p_node, uint_type p_equation );
+		void compute_block_row_residual( uint_type p_node, const bool p_equations[], real_type p_R[], bool p_face_loop = false );
+		void compute_face_fluxes();
+		void compute_AD_face_fluxes();
+
+		// The closure models are pure functions of their inputs and are shared by all assembly
+		// threads. Only the invalid state flag is per thread; thread 0, and any caller outside the
+		// parallel assembly, sets m_convergence_status directly.
+		void prepare_thread_status();
+		void gather_thread_status();
+		uint_type assembly_thread();
+		void flag_invalid_state();
+		bool count_property_lookup( bool p_hit );
+		bool count_closure_lookup( bool p_hit );
+		bool is_cached_closure( uint_type p_face, real_type p_mean_velocity, real_type p_gas_vol_frac, real_type p_oil_vol_frac, real_type p_water_vol_frac, real_type p_pressure ) const;
+
+		// Residuals and closures written once for a generic scalar: T = real_type evaluates them,
+		// T = ad_type also returns their derivatives w.r.t. the seeded unknowns.
+		template <class T>
+		T do_liquid_density( T p_oil_vol_frac, T p_water_vol_frac, T p_pressure );
+		template <class Closure, class T>
+		T do_mod_v_drift_flux( const Closure& p_closure, T p_mean_velocity, T p_gas_vol_frac, T p_oil_vol_frac, T p_water_vol_frac, T p_pressure );
+		template <class Closure, class T>
+		T do_mod_v_drift_flux_ow( const Closure& p_closure, T p_mean_velocity, T p_gas_vol_frac, T p_oil_vol_frac, T p_water_vol_frac, T p_pressure );
+
+		// The drift-flux closures above are compiled once per combination of drift velocity and
+		// profile parameter models. ClosureModels holds them by value for the combinations of
+		// simulate() and simulate_provenzano(), so their correlations are called directly and
+		// inlined; any other combination goes through references to the virtual models.
+		// The interfacial tensions stay virtual: they may be tabulated (tabulate_property_models()).
+		template <class GasLiquidDrift, class OilWaterDrift, class GasLiquidProfile, class OilWaterProfile>
+		struct ClosureModels{
+			typedef GasLiquidDrift		gas_liquid_drift_velocity_type;
+			typedef OilWaterDrift		oil_water_drift_velocity_type;
+			typedef GasLiquidProfile	gas_liquid_profile_parameter_type;
+			typedef OilWaterProfile		oil_water_profile_parameter_type;
+
+			ClosureModels(
+				GasLiquidDrift p_gas_liquid_drift_velocity, OilWaterDrift p_oil_water_drift_velocity,
+				GasLiquidProfile p_gas_liquid_profile_parameter, OilWaterProfile p_oil_water_profile_parameter
+				)
+				: gas_liquid_drift_velocity		( p_gas_liquid_drift_velocity )
+				, oil_water_drift_velocity		( p_oil_water_drift_velocity )
+				, gas_liquid_profile_parameter	( p_gas_liquid_profile_parameter )
+				, oil_water_profile_parameter	( p_oil_water_profile_parameter )
+			{}
+
+			GasLiquidDrift		gas_liquid_drift_velocity;
+			OilWaterDrift		oil_water_drift_velocity;
+			GasLiquidProfile	gas_liquid_profile_parameter;
+			OilWaterProfile		oil_water_profile_parameter;
+		};
+		typedef ClosureModels<
+			ShiGasLiquidDriftVelocityModel, ShiOilWaterDriftVelocityModel,
+			ShiGasLiquidProfileParameterModel, ShiOilWaterProfileParameterModel
+			> ShiClosureModels;
+		typedef ClosureModels<
+			ConstantDriftVelocityModel, ConstantDriftVelocityModel,
+			ConstantProfileParameterModel, ConstantProfileParameterModel
+			> ConstantClosureModels;
+		typedef ClosureModels<
+			const IDriftVelocityModel&, const IDriftVelocityModel&,
+			const IProfileParameterModel&, const IProfileParameterModel&
+			> VirtualClosureModels;
+
+		void select_closure();
+		template <class Closure>
+		SharedPointer<Closure> make_closure() const;
+		VirtualClosureModels virtual_closure() const;
+
+		// Phase mass fluxes per unit area through a face, from its west node to its east node
+		template <class T>
+		struct FaceFluxes{
+			T gas, oil, water;
+		};
+		template <class T>
+		void do_face_fluxes(
+			T p_pressureW, T p_pressureE,
+			T p_gas_vol_fracW, T p_gas_vol_fracE,
+			T p_oil_vol_fracW, T p_oil_vol_fracE,
+			T p_velocity, uint_type p_face, FaceFluxes<T>& p_fluxes
+			);
+		template <class T>
+		void do_node_face_fluxes(
+			T p_pressureW, T p_pressureP, T p_pressureE,
+			T p_gas_vol_fracW, T p_gas_vol_fracP, T p_gas_vol_fracE,
+			T p_oil_vol_fracW, T p_oil_vol_fracP, T p_oil_vol_fracE,
+			T p_velocityW, T p_velocityP,
+			uint_type p_node, string_type position, FaceFluxes<T> p_faces[]
+			);
+		template <class T>
+		T do_R_m(
+			T p_pressureP, T p_gas_vol_fracP, T p_oil_vol_fracP, T p_velocityP,
+			const FaceFluxes<T> p_faces[], uint_type p_node, string_type position
+			);
+		template <class T>
+		T do_R_g(
+			T p_pressureP, T p_gas_vol_fracP, T p_oil_vol_fracP, T p_velocityP,
+			const FaceFluxes<T> p_faces[], uint_type p_node, string_type position
+			);
+		template <class T>
+		T do_R_o(
+			T p_pressureP, T p_gas_vol_fracP, T p_oil_vol_fracP, T p_velocityP,
+			const FaceFluxes<T> p_faces[], uint_type p_node, string_type position
+			);
+		template <class T>
+		T do_R_v(
+			T p_pressureW, T p_pressureP, T p_pressureE, T p_pressureEE,
+			T p_gas_vol_fracW, T p_gas_vol_fracP, T p_gas_vol_fracE, T p_gas_vol_fracEE,
+			T p_oil_vol_fracW, T p_oil_vol_fracP, T p_oil_vol_fracE, T p_oil_vol_fracEE,
+			T p_velocityW, T p_velocityP, T p_velocityE,
+			uint_type p_node, string_type position
+			);
+		template <class T>
+		void do_block_row_residual(
+			uint_type p_node, const bool p_equations[],
+			T p_pressure[], T p_gas_vol_frac[], T p_oil_vol_frac[], T p_velocity[],
+			const FaceFluxes<T> p_faces[], T p_R[]
+			);
+
 		//--------------------------------------------------------------------------------------------- Data
 	protected:
         // DRIFT MODELS
@@ -320,21 +788,27 @@ namespace WellSimulator {
         SharedPointer<IViscosityModel>    m_gas_viscosity_model;
         SharedPointer<IViscosityModel>    m_oil_viscosity_model;
         SharedPointer<IViscosityModel>    m_water_viscosity_model;
+        // Set by select_closure() when the closure models above match a compiled combination
+        SharedPointer<ShiClosureModels>         m_shi_closure;
+        SharedPointer<ConstantClosureModels>    m_constant_closure;
         
         
-		vector_type m_oil_velocity;
-		vector_type m_water_velocity;
-		vector_type m_gas_velocity;
-		vector_type m_mean_velocity;
-		vector_type m_oil_vol_frac;
-		vector_type m_water_vol_frac;
-		vector_type m_gas_vol_frac;
+		// The state lives in m_state; the fields below are views of it, set by resize_state()
+		WellState	m_state;
+		WellState::field m_pressure;
+		WellState::field m_oil_velocity;
+		WellState::field m_water_velocity;
+		WellState::field m_gas_velocity;
+		WellState::field m_mean_velocity;
+		WellState::field m_oil_vol_frac;
+		WellState::field m_water_vol_frac;
+		WellState::field m_gas_vol_frac;
 		
-		vector_type m_gas_vol_frac_old;
-		vector_type m_oil_vol_frac_old;
-		vector_type m_water_vol_frac_old;
-		vector_type m_pressure_old;
-		vector_type m_mean_velocity_old;
+		WellState::field m_gas_vol_frac_old;
+		WellState::field m_oil_vol_frac_old;
+		WellState::field m_water_vol_frac_old;
+		WellState::field m_pressure_old;
+		WellState::field m_mean_velocity_old;
 
 		bool		m_with_gas;
         bool        m_mass_flux;
@@ -345,7 +819,7 @@ namespace WellSimulator {
 		real_type   m_oil_API;
 		vector_type m_gravity; // gravity vector
 		vector_type m_delta;
-        vector_type m_total_production; // [ m ]
+        vector_type m_total_production; // [ m³ ]
 		real_type   m_dt;
         real_type m_well_inclination;
 		uint_type   m_FINAL_TIMESTEP;
@@ -358,8 +832,118 @@ namespace WellSimulator {
 		vector_ptr m_source;
 		matrix_ptr m_matrix;
 
-		id_type		 m_id;
-
+        linear_solver_type  m_linear_solver;
+        jacobian_method_type m_jacobian_method;
+
+        uint_type                   m_number_of_threads;
+        std::vector<char>           m_thread_invalid_state; // assembly threads 1, 2, ...
+        PropertyCacheStatistics                 m_cache_statistics;
+        std::vector<PropertyCacheStatistics>    m_thread_cache_statistics; // assembly threads 1, 2, ..., until gathered
+
+        // Phase properties of the state the residuals are evaluated at: densities at the node
+        // pressures, viscosities at the mean pressure of each face, with their pressure derivatives,
+        // and the drift-flux closures at the face averages, with their partial derivatives w.r.t.
+        // each argument. Each entry keeps the arguments it was evaluated at, and is only evaluated
+        // again when they change.
+        struct PropertyCache{
+            enum closure_argument{ MEAN_VELOCITY, GAS_VOL_FRAC, OIL_VOL_FRAC, WATER_VOL_FRAC, PRESSURE, total_closure_arguments };
+
+            void clear(){
+                pressure.clear();
+                face_pressure.clear();
+                closure_pressure.clear();
+            }
+
+            vector_type pressure;
+            vector_type gas_density, oil_density, water_density;
+            vector_type gas_density_derivative, oil_density_derivative, water_density_derivative;
+            vector_type face_pressure;
+            vector_type gas_viscosity, oil_viscosity, water_viscosity;
+            vector_type gas_viscosity_derivative, oil_viscosity_derivative, water_viscosity_derivative;
+            vector_type closure_mean_velocity, closure_gas_vol_frac, closure_oil_vol_frac, closure_water_vol_frac, closure_pressure;
+            vector_type gas_liquid_drift_flux, oil_water_drift_flux; // mod_v_drift_flux, mod_v_drift_flux_ow
+            vector_type gas_liquid_drift_flux_derivative[ total_closure_arguments ];
+            vector_type oil_water_drift_flux_derivative[ total_closure_arguments ];
+
+            std::vector<uint_type> changed;             // entries evaluated by the current update,
+            vector_type changed_arguments, changed_values; // and their arguments and values, packed
+        };
+        PropertyCache               m_property_cache;
+        std::vector< FaceFluxes<real_type> >    m_face_fluxes;      // of the face loops, face k between nodes k and k+1
+        std::vector< FaceFluxes<ad_type> >      m_ad_face_fluxes;
+        BlockBandedSolver   m_block_solver;
+        FloatBlockBandedSolver  m_float_block_solver; // m_block_solver in mixed precision
+        PartitionedBlockBandedSolver    m_partitioned_solver;
+
+        // JACOBIAN_FREE: the state and F of the current Newton iteration, and the lagged preconditioner
+        struct NewtonFunction{
+            DriftFluxWell* well;
+            void operator()( const vector_type& p_unknowns, vector_type& p_F ) const { well->newton_function( p_unknowns, p_F ); }
+        };
+        typedef JacobianFreeOperator<NewtonFunction>    jacobian_free_type;
+        typedef RightPreconditionedOperator<jacobian_free_type, BlockDiagonalPreconditioner> preconditioned_jacobian_free_type;
+        vector_type                 m_newton_unknowns;
+        vector_type                 m_newton_function;
+        vector_type                 m_newton_function_state; // newton_function() puts the state back from it
+        BlockDiagonalPreconditioner m_block_diagonal;
+        CPRPreconditioner           m_cpr;
+        SchwarzPreconditioner       m_schwarz;
+        ScalarPreconditioner        m_scalar_preconditioner; // SCALAR_ILU, ILUT, SSOR or DIAGONAL
+        uint_type                   m_preconditioner_lag;
+        uint_type                   m_preconditioner_age;
+
+        bool                        m_preconditioner_reuse;
+        real_type                   m_refactor_iteration_growth;
+        uint_type                   m_refactor_min_iterations;
+        refactor_reason_type        m_refactor_reason; // pending refactorization, if any
+        int                         m_iterations_after_refactor;
+        PreconditionerStatistics    m_preconditioner_statistics;
+
+        krylov_method_type          m_krylov_method;
+        preconditioner_type         m_preconditioner;
+        bool                        m_krylov_auto_tune;
+        uint_type                   m_tuning_jacobians;
+        uint_type                   m_tuned_jacobians;  // of the current round, m_tuning_jacobians once it is over
+        int                         m_tuned_iterations; // of the pair kept, on the last Jacobian of its round
+        uint_type                   m_krylov_recycle_dimension;
+        struct KrylovTrial{
+            real_type   time;               // [ s ] over the round, factorizations included
+            uint_type   iterations;         // over the round
+            int         last_iterations;
+            bool        failed;             // on any Jacobian of the round
+        };
+        KrylovTrial                 m_krylov_trials[ total_krylov_methods ][ total_preconditioners ];
+        svector_type                m_tuning_guess, m_tuning_solution;
+
+        bool                        m_mixed_precision;
+        svector_type                m_refinement_residual;
+        bool                        m_inexact_newton;
+        real_type                   m_forcing_term;
+        real_type                   m_previous_residual_norm; // < 0 at the first Newton iteration
+
+        bool                        m_newton_globalization;
+        real_type                   m_max_vol_frac_change;
+        real_type                   m_max_relative_pressure_change;
+        uint_type                   m_max_backtracks;
+        vector_type                 m_line_search_residual;
+        NewtonStatistics            m_newton_statistics;
+        NormHistory                 m_norm_history, m_cut_norm_history; // solve(): cleared each timestep and cut
+        bool                        m_output_files;
+
+        bool                        m_steady_state;
+        real_type                   m_initial_pseudo_dt;
+        real_type                   m_max_pseudo_dt;
+        uint_type                   m_max_pseudo_steps;
+        real_type                   m_pseudo_dt; // where the last converged call left it, 0 for a cold start
+        vector_type                 m_steady_state_residual;
+        vector_type                 m_steady_state_unknowns;
+
+        // Newton workspace: sized by the first iteration and kept, so the later ones don't allocate
+        KrylovWorkspace<svector_type>                       m_krylov_workspace;
+        SharedPointer<jacobian_free_type>                   m_jacobian_free;
+        SharedPointer<preconditioned_jacobian_free_type>    m_preconditioned_jacobian_free;
+        vector_type                 m_line_search_unknowns;
+        vector_type                 m_colored_residual, m_colored_perturbed, m_colored_saved, m_colored_delta;
 
 	}; // class DriftFluxWell
 
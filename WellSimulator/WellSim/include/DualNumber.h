@@ -0,0 +1,173 @@
+#ifndef H_WellSimulator_DUALNUMBER
+#define H_WellSimulator_DUALNUMBER
+
+#include <cmath>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+    // Forward-mode automatic differentiation. The math functions live in their own namespace and
+    // are found by argument dependent lookup, so they never hide ::abs, ::pow... for doubles.
+namespace ad {
+
+// DualNumber ======================================================================================
+//
+//  Value plus its gradient along N seeded directions. Evaluating a function written for a generic
+//  scalar T with T = DualNumber<N> returns the function value and N directional derivatives in
+//  one pass. Comparisons only look at the value, so branches follow the double evaluation.
+//
+template <int N>
+class DualNumber
+{
+//--------------------------------------------------------------------------------- Type Definitions
+public:
+    enum { directions = N };
+
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    DualNumber() : m_value( 0.0 ) {
+        for( int k = 0; k < N; ++k ) m_gradient[ k ] = 0.0;
+    }
+    DualNumber( double p_value ) : m_value( p_value ) {
+        for( int k = 0; k < N; ++k ) m_gradient[ k ] = 0.0;
+    }
+    // Independent variable, seeded along p_direction.
+    DualNumber( double p_value, int p_direction ) : m_value( p_value ) {
+        for( int k = 0; k < N; ++k ) m_gradient[ k ] = 0.0;
+        m_gradient[ p_direction ] = 1.0;
+    }
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    double  value() const { return m_value; }
+    double  derivative( int p_direction ) const { return m_gradient[ p_direction ]; }
+    double& derivative( int p_direction ) { return m_gradient[ p_direction ]; }
+
+    DualNumber& operator+=( const DualNumber& b ){
+        m_value += b.m_value;
+        for( int k = 0; k < N; ++k ) m_gradient[ k ] += b.m_gradient[ k ];
+        return *this;
+    }
+    DualNumber& operator-=( const DualNumber& b ){
+        m_value -= b.m_value;
+        for( int k = 0; k < N; ++k ) m_gradient[ k ] -= b.m_gradient[ k ];
+        return *this;
+    }
+    DualNumber& operator*=( const DualNumber& b ){
+        for( int k = 0; k < N; ++k ) m_gradient[ k ] = m_gradient[ k ]*b.m_value + m_value*b.m_gradient[ k ];
+        m_value *= b.m_value;
+        return *this;
+    }
+    DualNumber& operator/=( const DualNumber& b ){
+        double inv = 1.0/b.m_value;
+        m_value *= inv;
+        for( int k = 0; k < N; ++k ) m_gradient[ k ] = ( m_gradient[ k ] - m_value*b.m_gradient[ k ] )*inv;
+        return *this;
+    }
+    DualNumber& operator+=( double b ){ m_value += b; return *this; }
+    DualNumber& operator-=( double b ){ m_value -= b; return *this; }
+    DualNumber& operator*=( double b ){
+        m_value *= b;
+        for( int k = 0; k < N; ++k ) m_gradient[ k ] *= b;
+        return *this;
+    }
+    DualNumber& operator/=( double b ){ return *this *= 1.0/b; }
+
+    DualNumber operator-() const {
+        DualNumber r( *this );
+        r.m_value = -m_value;
+        for( int k = 0; k < N; ++k ) r.m_gradient[ k ] = -m_gradient[ k ];
+        return r;
+    }
+    DualNumber operator+() const { return *this; }
+
+    // this' += p_partial*x'. Directions x doesn't depend on are left untouched, even where
+    // p_partial is not finite.
+    void chain( double p_partial, const DualNumber& x ){
+        for( int k = 0; k < N; ++k ) if( x.m_gradient[ k ] != 0.0 ) m_gradient[ k ] += p_partial*x.m_gradient[ k ];
+    }
+
+    // f(x) from f(x.value) and f'(x.value).
+    static DualNumber compose( double p_f, double p_df, const DualNumber& x ){
+        DualNumber r( p_f );
+        r.chain( p_df, x );
+        return r;
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    double m_value;
+    double m_gradient[ N ];
+
+}; // class DualNumber
+
+    // Arithmetic ----------------------------------------------------------------------------------
+    template <int N> inline DualNumber<N> operator+( DualNumber<N> a, const DualNumber<N>& b ){ return a += b; }
+    template <int N> inline DualNumber<N> operator-( DualNumber<N> a, const DualNumber<N>& b ){ return a -= b; }
+    template <int N> inline DualNumber<N> operator*( DualNumber<N> a, const DualNumber<N>& b ){ return a *= b; }
+    template <int N> inline DualNumber<N> operator/( DualNumber<N> a, const DualNumber<N>& b ){ return a /= b; }
+
+    template <int N> inline DualNumber<N> operator+( DualNumber<N> a, double b ){ return a += b; }
+    template <int N> inline DualNumber<N> operator-( DualNumber<N> a, double b ){ return a -= b; }
+    template <int N> inline DualNumber<N> operator*( DualNumber<N> a, double b ){ return a *= b; }
+    template <int N> inline DualNumber<N> operator/( DualNumber<N> a, double b ){ return a /= b; }
+
+    template <int N> inline DualNumber<N> operator+( double a, DualNumber<N> b ){ return b += a; }
+    template <int N> inline DualNumber<N> operator-( double a, const DualNumber<N>& b ){ return -b + a; }
+    template <int N> inline DualNumber<N> operator*( double a, DualNumber<N> b ){ return b *= a; }
+    template <int N> inline DualNumber<N> operator/( double a, const DualNumber<N>& b ){
+        return DualNumber<N>::compose( a/b.value(), -a/( b.value()*b.value() ), b );
+    }
+
+    // Comparisons (value only) --------------------------------------------------------------------
+#define WELLSIMULATOR_AD_COMPARISON( OP )                                                               \
+    template <int N> inline bool operator OP( const DualNumber<N>& a, const DualNumber<N>& b ){ return a.value() OP b.value(); } \
+    template <int N> inline bool operator OP( const DualNumber<N>& a, double b ){ return a.value() OP b; }                      \
+    template <int N> inline bool operator OP( double a, const DualNumber<N>& b ){ return a OP b.value(); }
+
+    WELLSIMULATOR_AD_COMPARISON( <  )
+    WELLSIMULATOR_AD_COMPARISON( <= )
+    WELLSIMULATOR_AD_COMPARISON( >  )
+    WELLSIMULATOR_AD_COMPARISON( >= )
+    WELLSIMULATOR_AD_COMPARISON( == )
+    WELLSIMULATOR_AD_COMPARISON( != )
+#undef WELLSIMULATOR_AD_COMPARISON
+
+    // Math functions ------------------------------------------------------------------------------
+    template <int N> inline DualNumber<N> sqrt( const DualNumber<N>& x ){
+        double f = std::sqrt( x.value() );
+        return DualNumber<N>::compose( f, 0.5/f, x );
+    }
+    template <int N> inline DualNumber<N> exp( const DualNumber<N>& x ){
+        double f = std::exp( x.value() );
+        return DualNumber<N>::compose( f, f, x );
+    }
+    template <int N> inline DualNumber<N> log( const DualNumber<N>& x ){
+        return DualNumber<N>::compose( std::log( x.value() ), 1.0/x.value(), x );
+    }
+    template <int N> inline DualNumber<N> pow( const DualNumber<N>& x, double p ){
+        return DualNumber<N>::compose( std::pow( x.value(), p ), p*std::pow( x.value(), p - 1.0 ), x );
+    }
+    template <int N> inline DualNumber<N> sin( const DualNumber<N>& x ){
+        return DualNumber<N>::compose( std::sin( x.value() ), std::cos( x.value() ), x );
+    }
+    template <int N> inline DualNumber<N> cos( const DualNumber<N>& x ){
+        return DualNumber<N>::compose( std::cos( x.value() ), -std::sin( x.value() ), x );
+    }
+    template <int N> inline DualNumber<N> abs( const DualNumber<N>& x ){
+        return x.value() >= 0.0 ? x : -x;
+    }
+    template <int N> inline DualNumber<N> fabs( const DualNumber<N>& x ){
+        return abs( x );
+    }
+
+    // Value of a scalar that may or may not carry derivatives.
+    template <int N> inline double value_of( const DualNumber<N>& x ){ return x.value(); }
+    inline double value_of( double x ){ return x; }
+
+} // namespace ad
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_DUALNUMBER
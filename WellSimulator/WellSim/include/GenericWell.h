@@ -38,7 +38,6 @@ public:
 	virtual void set_coordinates(const std::vector<coord_type>& p_coord_vector);
 	virtual void read_coordinates(std::ifstream& p_infile);
 	virtual coord_type* coordinates(uint_type p_index); 
-	virtual real_type* pressure(uint_type p_index);
 	virtual real_type radius() const;
 	virtual uint_type number_of_nodes() const;	
 	virtual void solve();
@@ -50,7 +49,6 @@ protected:
     inflow_vector_type	m_oil_flow;
 	inflow_vector_type   m_water_flow;
 	inflow_vector_type   m_gas_flow;
-	vector_type				m_pressure;
 };
 
 
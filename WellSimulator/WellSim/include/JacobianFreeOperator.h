@@ -0,0 +1,172 @@
+#ifndef H_WellSimulator_JACOBIANFREEOPERATOR
+#define H_WellSimulator_JACOBIANFREEOPERATOR
+
+#include <vector>
+#include <cmath>
+#include <limits>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// JacobianFreeOperator ============================================================================
+//
+//  Jacobian of a nonlinear function F at u, applied without ever being formed. Each product is a
+//  directional difference of F:
+//
+//      J*x ~ ( F(u + h*x) - F(u) )/h,     h = sqrt( eps )*max( |u|.|x|, ||x||_1 )/||x||^2
+//
+//  so it costs one evaluation of F. Weighting h by |u|.|x| (Brown & Saad) keeps the increment
+//  relative to the unknowns x moves, which differ by orders of magnitude here (pressures and
+//  volume fractions). Function is anything callable as F( u, F_u ) on
+//  std::vector<double>; u and F(u) are kept by reference and must outlive the operator.
+//
+template <class Function>
+class JacobianFreeOperator
+{
+//--------------------------------------------------------------------------------- Type Definitions
+public:
+    typedef double      value_type;
+    typedef unsigned    size_type;
+
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    JacobianFreeOperator( Function p_F, const std::vector<double>& p_u, const std::vector<double>& p_F_u )
+        : m_F( p_F ), m_u( &p_u ), m_F_u( &p_F_u ), m_number_of_products( 0 ),
+          m_x( p_u.size() ), m_u_h( p_u.size() ), m_F_h( p_u.size() )
+    {}
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    // The size it was built for
+    size_type nrows() const { return m_x.size(); }
+    size_type ncols() const { return m_x.size(); }
+    unsigned  number_of_products() const { return m_number_of_products; }
+
+    // y = J*x
+    template <class VecX, class VecY>
+    void mult( const VecX& x, VecY& y ) const {
+        apply( x );
+        for( size_type k = 0; k < m_F_h.size(); ++k ) y[ k ] = m_F_h[ k ];
+    }
+
+    // z = J*x + y
+    template <class VecX, class VecY, class VecZ>
+    void mult( const VecX& x, const VecY& y, VecZ& z ) const {
+        apply( x );
+        for( size_type k = 0; k < m_F_h.size(); ++k ) z[ k ] = m_F_h[ k ] + y[ k ];
+    }
+
+//-------------------------------------------------------------------------------- Internal functions
+protected:
+    // m_F_h = J*x
+    template <class VecX>
+    void apply( const VecX& x ) const {
+        double x_norm2 = 0.0, x_norm1 = 0.0, u_dot_x = 0.0;
+        for( size_type k = 0; k < m_x.size(); ++k ){
+            m_x[ k ] = x[ k ];
+            x_norm2 += m_x[ k ]*m_x[ k ];
+            x_norm1 += std::fabs( m_x[ k ] );
+            u_dot_x += std::fabs( (*m_u)[ k ]*m_x[ k ] );
+        }
+        if( x_norm2 == 0.0 ){
+            for( size_type k = 0; k < m_F_h.size(); ++k ) m_F_h[ k ] = 0.0;
+            return;
+        }
+
+        double h = std::sqrt( std::numeric_limits<double>::epsilon() )*( u_dot_x > x_norm1 ? u_dot_x : x_norm1 )/x_norm2;
+        for( size_type k = 0; k < m_x.size(); ++k ) m_u_h[ k ] = (*m_u)[ k ] + h*m_x[ k ];
+        m_F( m_u_h, m_F_h );
+        for( size_type k = 0; k < m_F_h.size(); ++k ) m_F_h[ k ] = ( m_F_h[ k ] - (*m_F_u)[ k ] )/h;
+        ++m_number_of_products;
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    Function                    m_F;
+    const std::vector<double>*  m_u;
+    const std::vector<double>*  m_F_u;
+    mutable unsigned            m_number_of_products;
+    mutable std::vector<double> m_x;
+    mutable std::vector<double> m_u_h;
+    mutable std::vector<double> m_F_h;
+
+}; // class JacobianFreeOperator
+
+// RightPreconditionedOperator =====================================================================
+//
+//  A*M^-1, for Krylov solvers that only precondition on the left. Solving A*M^-1 y = b and taking
+//  x = M^-1 y keeps the convergence test on the true residual b - A*x, which matters when A*x
+//  is itself approximate: a left preconditioner amplifies the differencing error of J*x.
+//
+template <class Operator, class Preconditioner>
+class RightPreconditionedOperator
+{
+//--------------------------------------------------------------------------------- Type Definitions
+public:
+    typedef double      value_type;
+    typedef unsigned    size_type;
+
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    RightPreconditionedOperator( const Operator& p_A, const Preconditioner& p_M )
+        : m_A( &p_A ), m_M( &p_M ), m_x( p_A.nrows() ) {}
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    size_type nrows() const { return m_A->nrows(); }
+    size_type ncols() const { return m_A->ncols(); }
+
+    // y = A*M^-1 x
+    template <class VecX, class VecY>
+    void mult( const VecX& x, VecY& y ) const {
+        for( size_type k = 0; k < m_x.size(); ++k ) m_x[ k ] = x[ k ];
+        m_M->solve( m_x, m_x );
+        m_A->mult( m_x, y );
+    }
+
+    // z = A*M^-1 x + y
+    template <class VecX, class VecY, class VecZ>
+    void mult( const VecX& x, const VecY& y, VecZ& z ) const {
+        for( size_type k = 0; k < m_x.size(); ++k ) m_x[ k ] = x[ k ];
+        m_M->solve( m_x, m_x );
+        m_A->mult( m_x, y, z );
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    const Operator*             m_A;
+    const Preconditioner*       m_M;
+    mutable std::vector<double> m_x;
+
+}; // class RightPreconditionedOperator
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+
+// ITL interface ===================================================================================
+namespace itl {
+
+    template <class Function, class VecX, class VecY>
+    inline void mult( const WellSimulator::JacobianFreeOperator<Function>& A, const VecX& x, const VecY& y ){
+        A.mult( x, const_cast<VecY&>( y ) );
+    }
+
+    template <class Function, class VecX, class VecY, class VecZ>
+    inline void mult( const WellSimulator::JacobianFreeOperator<Function>& A, const VecX& x, const VecY& y, const VecZ& z ){
+        A.mult( x, y, const_cast<VecZ&>( z ) );
+    }
+
+    template <class Operator, class Preconditioner, class VecX, class VecY>
+    inline void mult( const WellSimulator::RightPreconditionedOperator<Operator, Preconditioner>& A, const VecX& x, const VecY& y ){
+        A.mult( x, const_cast<VecY&>( y ) );
+    }
+
+    template <class Operator, class Preconditioner, class VecX, class VecY, class VecZ>
+    inline void mult( const WellSimulator::RightPreconditionedOperator<Operator, Preconditioner>& A, const VecX& x, const VecY& y, const VecZ& z ){
+        A.mult( x, y, const_cast<VecZ&>( z ) );
+    }
+
+} // namespace itl
+
+#endif // H_WellSimulator_JACOBIANFREEOPERATOR
@@ -0,0 +1,674 @@
+#ifndef H_WellSimulator_KRYLOVWORKSPACE
+#define H_WellSimulator_KRYLOVWORKSPACE
+
+#include <itl/interface/mtl.h>
+#include <itl/itl.h>
+#include <itl/givens_rotation.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// KrylovWorkspace =================================================================================
+//
+//  Restarted GMRES with its storage kept from one solve to the next. It is itl::gmres step for
+//  step, except that the Krylov basis, the Hessenberg matrix, the rotations and the three work
+//  vectors are members: itl::gmres allocates all of them, and the basis through its
+//  modified_gram_schmidt argument, on every call. reserve() only allocates when the size or the
+//  restart grows.
+//  bicgstab(), cgs(), tfqmr() and gcr() are the ITL solvers of the same names, step for step, on
+//  the work vectors of the workspace.
+//  Two scratch vectors of the same size, rhs() and solution(), are kept for the callers.
+//  gcrodr() is GMRES with a recycled subspace, also kept from one solve to the next.
+//  The itl::mult and itl::solve overloads of the operators must be declared before this header.
+//
+template <class Vector>
+class KrylovWorkspace
+{
+//--------------------------------------------------------------------------------- Type Definitions
+public:
+    typedef double      value_type;
+    typedef unsigned    size_type;
+
+    enum{ WORK_VECTORS = 10 }; // the most of bicgstab(), cgs() and tfqmr(); gcr() takes restart + 1
+
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    KrylovWorkspace() : m_size( 0 ), m_restart( 0 ), m_recycled( 0 ), m_log_rate( 0.0 ),
+                        m_iterations_saved( 0.0 ), m_recycle_applies( 0 ) {}
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    // Returns whether it had to allocate
+    bool reserve( size_type p_size, int p_restart ){
+        if( p_size == m_size && p_restart <= m_restart ) return false;
+        if( p_size != m_size ){
+            m_restart = 0;
+            m_basis.clear();
+            m_work.clear();
+            m_U.clear();
+            m_C.clear();
+            m_recycled = 0;
+            m_w = Vector( p_size );
+            m_r = Vector( p_size );
+            m_u = Vector( p_size );
+            m_rhs = Vector( p_size );
+            m_solution = Vector( p_size );
+        }
+        m_size = p_size;
+        m_restart = std::max( m_restart, p_restart );
+        while( int( m_basis.size() ) < m_restart + 1 ) m_basis.push_back( Vector( p_size ) );
+        while( int( m_work.size() ) < std::max( int( WORK_VECTORS ), m_restart + 1 ) ) m_work.push_back( Vector( p_size ) );
+        m_H.assign( ( m_restart + 1 )*m_restart, 0.0 );
+        m_G.assign( m_H.size(), 0.0 );
+        m_F.assign( m_H.size(), 0.0 );
+        m_A1.assign( m_H.size(), 0.0 );
+        m_A2.assign( m_H.size(), 0.0 );
+        m_P.assign( m_H.size(), 0.0 );
+        m_T.assign( m_H.size(), 0.0 );
+        m_s.assign( m_restart + 1, 0.0 );
+        m_rotations.assign( m_restart + 1, itl::givens_rotation<value_type>() );
+        return true;
+    }
+
+    size_type size() const { return m_size; }
+
+    Vector& rhs() { return m_rhs; }
+    Vector& solution() { return m_solution; }
+
+    // itl::gmres( A, x, b, M, p_restart, outer, basis ) on the workspace. Returns the ITL error code.
+    template <class Matrix, class VectorB, class Preconditioner, class Iter>
+    int gmres( const Matrix& A, Vector& x, const VectorB& b, const Preconditioner& M, int p_restart, Iter& outer ){
+        this->reserve( size_type( x.size() ), p_restart );
+
+        itl::mult( A, itl::scaled( x, -1.0 ), b, m_w );
+        itl::solve( M, m_w, m_r );
+        value_type beta = std::fabs( itl::two_norm( m_r ) );
+
+        while( !outer.finished( beta ) ){
+            itl::copy( itl::scaled( m_r, 1./beta ), m_basis[ 0 ] );
+            std::fill( m_s.begin(), m_s.end(), 0.0 );
+            m_s[ 0 ] = beta;
+
+            int i = 0;
+            Iter inner( outer.normb(), p_restart, outer.tol(), outer.atol() );
+            do{
+                itl::mult( A, m_basis[ i ], m_u );
+                itl::solve( M, m_u, m_basis[ i+1 ] );
+
+                // Modified Gram-Schmidt
+                for( int k = 0; k <= i; ++k ){
+                    H( k, i ) = itl::dot_conj( m_basis[ i+1 ], m_basis[ k ] );
+                    itl::add( itl::scaled( m_basis[ k ], -H( k, i ) ), m_basis[ i+1 ] );
+                }
+                value_type H_ip1_i = itl::two_norm( m_basis[ i+1 ] );
+                H( i+1, i ) = H_ip1_i;
+                itl::scale( m_basis[ i+1 ], 1./H_ip1_i );
+
+                for( int k = 0; k < i; ++k ) m_rotations[ k ].scalar_apply( H( k, i ), H( k+1, i ) );
+                m_rotations[ i ] = itl::givens_rotation<value_type>( H( i, i ), H( i+1, i ) );
+                m_rotations[ i ].scalar_apply( H( i, i ), H( i+1, i ) );
+                m_rotations[ i ].scalar_apply( m_s[ i ], m_s[ i+1 ] );
+
+                ++inner, ++outer, ++i;
+            } while( !inner.finished( std::fabs( m_s[ i ] ) ) );
+
+            // s <- H(0:i,0:i)^-1 s, column by column like mtl::tri_solve on the column-major H
+            for( int j = i - 1; j >= 0; --j ){
+                m_s[ j ] /= H( j, j );
+                for( int k = 0; k < j; ++k ) m_s[ k ] -= H( k, j )*m_s[ j ];
+            }
+            for( int j = 0; j < i; ++j ) itl::add( itl::scaled( m_basis[ j ], m_s[ j ] ), x );
+
+            itl::mult( A, itl::scaled( x, -1.0 ), b, m_w );
+            itl::solve( M, m_w, m_r );
+            beta = std::fabs( itl::two_norm( m_r ) );
+        }
+        return outer.error_code();
+    }
+
+    // itl::bicgstab( A, x, b, M, iter ) on the workspace
+    template <class Matrix, class VectorB, class Preconditioner, class Iter>
+    int bicgstab( const Matrix& A, Vector& x, const VectorB& b, const Preconditioner& M, Iter& iter ){
+        this->reserve( size_type( x.size() ), m_restart );
+        Vector &p = m_work[ 0 ], &phat = m_work[ 1 ], &s = m_work[ 2 ], &shat = m_work[ 3 ],
+               &t = m_work[ 4 ], &v = m_work[ 5 ], &r = m_work[ 6 ], &rtilde = m_work[ 7 ];
+        value_type rho_1, rho_2 = 0.0, alpha = 0.0, beta, omega = 0.0;
+
+        itl::mult( A, itl::scaled( x, -1.0 ), b, r );
+        itl::copy( r, rtilde );
+
+        while( !iter.finished( r ) ){
+            rho_1 = itl::dot( rtilde, r );
+            if( rho_1 == 0.0 ){
+                iter.fail( 2, "bicg breakdown #1" );
+                break;
+            }
+            if( iter.first() ) itl::copy( r, p );
+            else{
+                if( omega == 0.0 ){
+                    iter.fail( 3, "bicg breakdown #2" );
+                    break;
+                }
+                beta = ( rho_1/rho_2 )*( alpha/omega );
+                itl::add( itl::scaled( v, -omega ), p );
+                itl::add( r, itl::scaled( p, beta ), p );
+            }
+            itl::solve( M, p, phat );
+            itl::mult( A, phat, v );
+            alpha = rho_1/itl::dot( v, rtilde );
+            itl::add( r, itl::scaled( v, -alpha ), s );
+
+            if( iter.finished( s ) ){
+                itl::add( itl::scaled( phat, alpha ), x );
+                break;
+            }
+
+            itl::solve( M, s, shat );
+            itl::mult( A, shat, t );
+            omega = itl::dot( t, s )/itl::dot( t, t );
+
+            itl::add( itl::scaled( phat, alpha ), x );
+            itl::add( itl::scaled( shat, omega ), x );
+            itl::add( s, itl::scaled( t, -omega ), r );
+
+            rho_2 = rho_1;
+            ++iter;
+        }
+        return iter.error_code();
+    }
+
+    // itl::cgs( A, x, b, M, iter ) on the workspace
+    template <class Matrix, class VectorB, class Preconditioner, class Iter>
+    int cgs( const Matrix& A, Vector& x, const VectorB& b, const Preconditioner& M, Iter& iter ){
+        this->reserve( size_type( x.size() ), m_restart );
+        Vector &p = m_work[ 0 ], &phat = m_work[ 1 ], &q = m_work[ 2 ], &qhat = m_work[ 3 ], &vhat = m_work[ 4 ],
+               &u = m_work[ 5 ], &uhat = m_work[ 6 ], &r = m_work[ 7 ], &rtilde = m_work[ 8 ];
+        value_type rho_1, rho_2 = 0.0, alpha, beta;
+
+        itl::mult( A, itl::scaled( x, -1.0 ), b, r );
+        itl::copy( r, rtilde );
+
+        while( !iter.finished( r ) ){
+            rho_1 = itl::dot( rtilde, r );
+            if( rho_1 == 0.0 ){
+                iter.fail( 2, "cgs breakdown" );
+                break;
+            }
+            if( iter.first() ){
+                itl::copy( r, u );
+                itl::copy( u, p );
+            }
+            else{
+                beta = rho_1/rho_2;
+                itl::add( r, itl::scaled( q, beta ), u );
+                itl::add( q, itl::scaled( p, beta ), p );
+                itl::add( u, itl::scaled( p, beta ), p );
+            }
+            itl::solve( M, p, phat );
+            itl::mult( A, phat, vhat );
+            alpha = rho_1/itl::dot( rtilde, vhat );
+            itl::add( u, itl::scaled( vhat, -alpha ), q );
+
+            itl::add( q, u );
+            itl::solve( M, u, uhat );
+
+            itl::add( x, itl::scaled( uhat, alpha ), x );
+            itl::mult( A, uhat, qhat );
+            itl::add( r, itl::scaled( qhat, -alpha ), r );
+
+            rho_2 = rho_1;
+            ++iter;
+        }
+        return iter.error_code();
+    }
+
+    // itl::tfqmr( A, x, b, itl::identity_preconditioner(), M, iter ) on the workspace: preconditioned
+    // on the right only, so the solves with the identity are left out
+    template <class Matrix, class VectorB, class Preconditioner, class Iter>
+    int tfqmr( const Matrix& A, Vector& x, const VectorB& b, const Preconditioner& M, Iter& iter ){
+        this->reserve( size_type( x.size() ), m_restart );
+        Vector &tmp = m_work[ 0 ], &r0 = m_work[ 1 ], &v = m_work[ 2 ], &h = m_work[ 3 ], &w = m_work[ 4 ],
+               &y1 = m_work[ 5 ], &g = m_work[ 6 ], &d = m_work[ 7 ], &rtilde = m_work[ 8 ], &y0 = m_work[ 9 ];
+        value_type sigma, alpha, c, kappa, beta;
+
+        itl::solve( M, x, r0 );
+        itl::mult( A, r0, tmp );
+        itl::add( b, itl::scaled( tmp, -1. ), r0 );
+
+        itl::copy( r0, w );
+        itl::copy( r0, y1 );
+
+        itl::solve( M, y1, tmp );
+        itl::mult( A, tmp, v );
+
+        itl::copy( v, g );
+        for( size_type e = 0; e < m_size; ++e ) d[ e ] = 0.0;
+
+        value_type tau = itl::two_norm( r0 );
+        value_type theta = 0.0;
+        value_type eta = 0.0;
+
+        itl::copy( r0, rtilde );
+        value_type rho = itl::dot( rtilde, r0 );
+        value_type rho0 = rho;
+        for( ;; ){
+            sigma = itl::dot( rtilde, v );
+            if( sigma == 0. ){ iter.fail( 5, "tfqmr breakdown: sigma=0" ); break; }
+            alpha = rho/sigma;
+
+            itl::add( y1, itl::scaled( v, -alpha ), y0 );
+            itl::solve( M, y0, tmp );
+            itl::mult( A, tmp, h );
+
+            itl::add( w, itl::scaled( g, -alpha ), w );
+            if( alpha == 0. ){ iter.fail( 3, "tfqmr breakdown: alpha=0" ); break; }
+            itl::add( y1, itl::scaled( d, theta*theta*eta/alpha ), d );
+
+            if( tau == 0. ){ iter.fail( 2, "tfqmr breakdown: tau=0" ); break; }
+            theta = itl::two_norm( w )/tau;
+            c = 1./std::sqrt( 1. + theta*theta );
+            tau = tau*c*theta;
+            eta = c*c*alpha;
+
+            itl::add( x, itl::scaled( d, eta ), x );
+            kappa = tau*std::sqrt( 2.*( iter.iterations() + 1 ) );
+            if( iter.finished( kappa ) ){
+                itl::solve( M, x, tmp );
+                itl::copy( tmp, x );
+                break;
+            }
+            itl::copy( h, g );
+
+            itl::add( w, itl::scaled( g, -alpha ), w );
+            if( alpha == 0. ){ iter.fail( 3, "tfqmr breakdown: alpha=0" ); break; }
+            itl::add( y0, itl::scaled( d, theta*theta*eta/alpha ), d );
+            if( tau == 0. ){ iter.fail( 2, "tfqmr breakdown: tau=0" ); break; }
+            theta = itl::two_norm( w )/tau;
+            c = 1./std::sqrt( 1. + theta*theta );
+            tau = tau*c*theta;
+            eta = c*c*alpha;
+
+            itl::add( x, itl::scaled( d, eta ), x );
+            kappa = tau*std::sqrt( 2.*( iter.iterations() + 1 ) + 1. );
+            if( iter.finished( kappa ) ){
+                itl::solve( M, x, tmp );
+                itl::copy( tmp, x );
+                break;
+            }
+
+            rho0 = rho;
+            rho = itl::dot( rtilde, w );
+            if( rho0 == 0. ){ iter.fail( 4, "tfqmr breakdown: beta=0" ); break; }
+            beta = rho/rho0;
+
+            itl::add( w, itl::scaled( y0, beta ), y1 );
+            itl::solve( M, y1, tmp );
+            itl::mult( A, tmp, g );
+
+            itl::add( g, itl::scaled( h, beta ), itl::scaled( v, beta*beta ), v );
+            ++iter;
+        }
+        return iter.error_code();
+    }
+
+    // itl::gcr( A, x, b, M, p_restart, outer ) on the workspace: the directions in the basis, their
+    // images in the work vectors. Like itl::gcr, each new direction is only made orthogonal to the
+    // image of the last one.
+    template <class Matrix, class VectorB, class Preconditioner, class Iter>
+    int gcr( const Matrix& A, Vector& x, const VectorB& b, const Preconditioner& M, int p_restart, Iter& outer ){
+        this->reserve( size_type( x.size() ), p_restart );
+        std::vector<Vector>& p = m_basis;
+        std::vector<Vector>& w = m_work;
+        std::vector<value_type>& beta = m_s;
+        value_type alpha;
+
+        itl::mult( A, itl::scaled( x, -1. ), b, m_u );
+        itl::solve( M, m_u, m_r );
+        value_type normr = itl::two_norm( m_r );
+
+        while( !outer.finished( normr ) ){
+            Iter inner( outer.normb(), p_restart, outer.tol(), outer.atol() );
+            itl::copy( itl::scaled( m_r, 1./normr ), p[ 0 ] );
+
+            int j = 0;
+            while( !inner.finished( m_r ) ){
+                itl::mult( A, p[ j ], m_u );
+                itl::solve( M, m_u, w[ j ] );
+
+                beta[ j ] = itl::dot_conj( w[ j ], w[ j ] );
+                alpha = itl::dot_conj( w[ j ], m_r )/beta[ j ];
+
+                itl::add( x, itl::scaled( p[ j ], alpha ), x );
+                itl::add( m_r, itl::scaled( w[ j ], -alpha ), m_r );
+
+                itl::mult( A, m_r, m_u );
+                itl::solve( M, m_u, m_w );
+
+                for( int i = 0; i <= j; ++i )
+                    itl::add( m_r, itl::scaled( p[ i ], -itl::dot_conj( w[ i ], m_w )/beta[ i ] ), p[ j+1 ] );
+
+                ++inner; ++outer; ++j;
+            }
+            normr = itl::two_norm( m_r );
+        }
+        return outer.error_code();
+    }
+
+    // GCRO-DR( p_restart, p_recycle ), Parks et al. 2006, preconditioned on the left like gmres().
+    // The recycled space U, with C = M^-1 A U orthonormal, is kept from the last solve: C is
+    // recomputed for the new A and M, the part of the residual in range( C ) is solved for at once,
+    // and the restarts run p_restart - p_recycle Arnoldi steps of ( I - C C^T ) M^-1 A. After each
+    // cycle U becomes the span of the p_recycle harmonic Ritz vectors of the smallest magnitude.
+    // Returns the ITL error code.
+    template <class Matrix, class VectorB, class Preconditioner, class Iter>
+    int gcrodr( const Matrix& A, Vector& x, const VectorB& b, const Preconditioner& M, int p_restart, int p_recycle, Iter& outer ){
+        this->reserve( size_type( x.size() ), p_restart );
+        this->reserve_recycle( std::max( 1, std::min( p_recycle, p_restart - 1 ) ) );
+        m_iterations_saved = 0.0;
+        m_recycle_applies = 0;
+
+        itl::mult( A, itl::scaled( x, -1.0 ), b, m_w );
+        itl::solve( M, m_w, m_r );
+        value_type initial_beta = std::fabs( itl::two_norm( m_r ) );
+        value_type beta = initial_beta;
+        if( m_recycled > 0 && !outer.finished( beta ) ){
+            this->refresh_recycle_space( A, M );
+            this->project_residual( x );
+            beta = std::fabs( itl::two_norm( m_r ) );
+        }
+        const value_type projected_beta = beta;
+        const int first_iteration = outer.iterations();
+
+        while( !outer.finished( beta ) ){
+            const int k = m_recycled;
+            itl::copy( itl::scaled( m_r, 1./beta ), m_basis[ 0 ] );
+            std::fill( m_s.begin(), m_s.end(), 0.0 );
+            m_s[ k ] = beta;
+            std::fill( m_G.begin(), m_G.end(), 0.0 );
+            std::fill( m_H.begin(), m_H.end(), 0.0 );
+            for( int i = 0; i < k; ++i ) G( i, i ) = H( i, i ) = 1.0;
+
+            int j = 0;
+            Iter inner( outer.normb(), p_restart - k, outer.tol(), outer.atol() );
+            do{
+                itl::mult( A, m_basis[ j ], m_u );
+                itl::solve( M, m_u, m_basis[ j+1 ] );
+
+                // Against C, then modified Gram-Schmidt
+                for( int i = 0; i < k; ++i ){
+                    G( i, k+j ) = itl::dot_conj( m_basis[ j+1 ], m_C[ i ] );
+                    itl::add( itl::scaled( m_C[ i ], -G( i, k+j ) ), m_basis[ j+1 ] );
+                }
+                for( int i = 0; i <= j; ++i ){
+                    G( k+i, k+j ) = itl::dot_conj( m_basis[ j+1 ], m_basis[ i ] );
+                    itl::add( itl::scaled( m_basis[ i ], -G( k+i, k+j ) ), m_basis[ j+1 ] );
+                }
+                value_type h = itl::two_norm( m_basis[ j+1 ] );
+                G( k+j+1, k+j ) = h;
+                if( h != 0.0 ) itl::scale( m_basis[ j+1 ], 1./h );
+
+                // The first k columns are already triangular, the rotations only act below them
+                for( int i = 0; i <= k+j+1; ++i ) H( i, k+j ) = G( i, k+j );
+                for( int i = 0; i < j; ++i ) m_rotations[ i ].scalar_apply( H( k+i, k+j ), H( k+i+1, k+j ) );
+                m_rotations[ j ] = itl::givens_rotation<value_type>( H( k+j, k+j ), H( k+j+1, k+j ) );
+                m_rotations[ j ].scalar_apply( H( k+j, k+j ), H( k+j+1, k+j ) );
+                m_rotations[ j ].scalar_apply( m_s[ k+j ], m_s[ k+j+1 ] );
+
+                ++inner, ++outer, ++j;
+                if( h == 0.0 ) break;
+            } while( !inner.finished( std::fabs( m_s[ k+j ] ) ) );
+
+            // s <- H(0:k+j,0:k+j)^-1 s, then x += [ U V ] s
+            for( int c = k + j - 1; c >= 0; --c ){
+                m_s[ c ] /= H( c, c );
+                for( int i = 0; i < c; ++i ) m_s[ i ] -= H( i, c )*m_s[ c ];
+            }
+            for( int i = 0; i < k; ++i ) itl::add( itl::scaled( m_U[ i ], m_s[ i ] ), x );
+            for( int i = 0; i < j; ++i ) itl::add( itl::scaled( m_basis[ i ], m_s[ k+i ] ), x );
+
+            this->update_recycle_space( k, j );
+
+            itl::mult( A, itl::scaled( x, -1.0 ), b, m_w );
+            itl::solve( M, m_w, m_r );
+            this->project_residual( x );
+            beta = std::fabs( itl::two_norm( m_r ) );
+        }
+
+        // The iterations the projection on C spared, at the convergence rate of the rest of the solve.
+        // Only a lower bound: the deflated cycles also converge faster than GMRES would.
+        int error = outer.error_code();
+        int iterations = outer.iterations() - first_iteration;
+        if( error == 0 && iterations > 0 && beta > 0.0 && beta < projected_beta ) m_log_rate = std::log( beta/projected_beta )/iterations;
+        if( error == 0 && projected_beta < initial_beta && m_log_rate < 0.0 ){
+            m_iterations_saved = std::log( std::max( projected_beta, beta )/initial_beta )/m_log_rate;
+        }
+        return error;
+    }
+
+    // Of the last gcrodr(): Krylov iterations saved by the projection on the recycled space (an
+    // estimate, and a lower bound of what recycling saved), and the operator and preconditioner
+    // applies spent refreshing it
+    value_type iterations_saved() const { return m_iterations_saved; }
+    int recycle_applies() const { return m_recycle_applies; }
+
+//-------------------------------------------------------------------------------- Internal functions
+protected:
+    // Column-major ( restart+1 ) x restart Hessenberg matrix
+    value_type& H( int p_row, int p_column ) { return m_H[ ( m_restart + 1 )*p_column + p_row ]; }
+    // The same shape, unrotated: [ C V ]^T M^-1 A [ U V ] of the last cycle
+    value_type& G( int p_row, int p_column ) { return m_G[ ( m_restart + 1 )*p_column + p_row ]; }
+
+    void reserve_recycle( int p_recycle ){
+        if( int( m_U.size() ) == p_recycle ) return;
+        m_U.assign( p_recycle, Vector() );
+        m_C.assign( p_recycle, Vector() );
+        m_U_new.assign( p_recycle, Vector() );
+        m_C_new.assign( p_recycle, Vector() );
+        for( int i = 0; i < p_recycle; ++i ){
+            m_U[ i ] = Vector( m_size );
+            m_C[ i ] = Vector( m_size );
+            m_U_new[ i ] = Vector( m_size );
+            m_C_new[ i ] = Vector( m_size );
+        }
+        m_recycled = 0;
+    }
+
+    // C = M^-1 A U for the current A and M, orthonormalized by modified Gram-Schmidt with the same
+    // operations on U so that C = M^-1 A U still holds. Dependent vectors are dropped.
+    template <class Matrix, class Preconditioner>
+    void refresh_recycle_space( const Matrix& A, const Preconditioner& M ){
+        for( int i = 0; i < m_recycled; ++i ){
+            itl::mult( A, m_U[ i ], m_u );
+            itl::solve( M, m_u, m_C[ i ] );
+            ++m_recycle_applies;
+        }
+        for( int i = 0; i < m_recycled; ++i ){
+            value_type norm = itl::two_norm( m_C[ i ] );
+            for( int l = 0; l < i; ++l ){
+                value_type r = itl::dot_conj( m_C[ i ], m_C[ l ] );
+                itl::add( itl::scaled( m_C[ l ], -r ), m_C[ i ] );
+                itl::add( itl::scaled( m_U[ l ], -r ), m_U[ i ] );
+            }
+            value_type r = itl::two_norm( m_C[ i ] );
+            if( !( r > 1e-12*norm ) ){
+                m_recycled = i;
+                return;
+            }
+            itl::scale( m_C[ i ], 1./r );
+            itl::scale( m_U[ i ], 1./r );
+        }
+    }
+
+    // x += U C^T r, r -= C C^T r
+    void project_residual( Vector& x ){
+        for( int i = 0; i < m_recycled; ++i ){
+            value_type c = itl::dot_conj( m_r, m_C[ i ] );
+            itl::add( itl::scaled( m_U[ i ], c ), x );
+            itl::add( itl::scaled( m_C[ i ], -c ), m_r );
+        }
+    }
+
+    // After a cycle of k recycled and j Arnoldi vectors: W = [ C V_0..V_j ], V = [ U V_0..V_j-1 ],
+    // M^-1 A V = W G. The harmonic Ritz vectors V p solve G^T G p = theta G^T W^T V p, and those of
+    // the smallest |theta| span the dominant invariant subspace of S = ( G^T G )^-1 G^T W^T V, found
+    // by orthogonal iteration: in real arithmetic, and with complex pairs kept together. Then
+    // [ Q, R ] = qr( G P ), C = W Q and U = V P R^-1.
+    void update_recycle_space( int k, int j ){
+        const int n = k + j, rows = n + 1;
+        const int kn = std::min( int( m_U.size() ), n );
+        if( j == 0 ) return;
+
+        // F = W^T V, column-major rows x n
+        std::fill( m_F.begin(), m_F.begin() + rows*n, 0.0 );
+        for( int l = 0; l < k; ++l ){
+            for( int i = 0; i < k; ++i ) m_F[ rows*l + i ] = itl::dot_conj( m_U[ l ], m_C[ i ] );
+            for( int i = 0; i <= j; ++i ) m_F[ rows*l + k + i ] = itl::dot_conj( m_U[ l ], m_basis[ i ] );
+        }
+        for( int l = 0; l < j; ++l ) m_F[ rows*( k + l ) + k + l ] = 1.0;
+
+        // A1 = G^T G, A2 = G^T F, both n x n
+        for( int c = 0; c < n; ++c ){
+            for( int r = 0; r < n; ++r ){
+                value_type a1 = 0.0, a2 = 0.0;
+                for( int i = 0; i < rows; ++i ){
+                    a1 += G( i, r )*G( i, c );
+                    a2 += G( i, r )*m_F[ rows*c + i ];
+                }
+                m_A1[ n*c + r ] = a1;
+                m_A2[ n*c + r ] = a2;
+            }
+        }
+        if( !dense_solve( &m_A1[ 0 ], &m_A2[ 0 ], n ) ) return;
+
+        // Orthogonal iteration on S = m_A2, from a fixed full rank start
+        for( int c = 0; c < kn; ++c )
+            for( int r = 0; r < n; ++r ) m_P[ n*c + r ] = ( r == c ) ? 1.0 : 1.0/( 2 + r + c );
+        if( !orthonormalize( &m_P[ 0 ], n, kn ) ) return;
+        for( int step = 0; step < 100; ++step ){
+            for( int c = 0; c < kn; ++c ){
+                for( int r = 0; r < n; ++r ){
+                    value_type sum = 0.0;
+                    for( int i = 0; i < n; ++i ) sum += m_A2[ n*i + r ]*m_P[ n*c + i ];
+                    m_T[ n*c + r ] = sum;
+                }
+            }
+            if( !orthonormalize( &m_T[ 0 ], n, kn ) ) return;
+            std::copy( m_T.begin(), m_T.begin() + n*kn, m_P.begin() );
+        }
+
+        // G P = Q R in m_T ( rows x kn ) and m_A1 ( kn x kn )
+        for( int c = 0; c < kn; ++c ){
+            for( int r = 0; r < rows; ++r ){
+                value_type sum = 0.0;
+                for( int i = 0; i < n; ++i ) sum += G( r, i )*m_P[ n*c + i ];
+                m_T[ rows*c + r ] = sum;
+            }
+        }
+        for( int c = 0; c < kn; ++c ){
+            for( int l = 0; l < c; ++l ){
+                value_type r = 0.0;
+                for( int i = 0; i < rows; ++i ) r += m_T[ rows*l + i ]*m_T[ rows*c + i ];
+                for( int i = 0; i < rows; ++i ) m_T[ rows*c + i ] -= r*m_T[ rows*l + i ];
+                m_A1[ kn*c + l ] = r;
+            }
+            value_type r = 0.0;
+            for( int i = 0; i < rows; ++i ) r += m_T[ rows*c + i ]*m_T[ rows*c + i ];
+            r = std::sqrt( r );
+            if( !( r > 0.0 ) ) return;
+            for( int i = 0; i < rows; ++i ) m_T[ rows*c + i ] /= r;
+            m_A1[ kn*c + c ] = r;
+        }
+
+        for( int c = 0; c < kn; ++c ){
+            Vector& U = m_U_new[ c ];
+            Vector& C = m_C_new[ c ];
+            for( size_type e = 0; e < m_size; ++e ) U[ e ] = C[ e ] = 0.0;
+            for( int i = 0; i < k; ++i ){
+                itl::add( itl::scaled( m_U[ i ], m_P[ n*c + i ] ), U );
+                itl::add( itl::scaled( m_C[ i ], m_T[ rows*c + i ] ), C );
+            }
+            for( int i = 0; i < j; ++i ) itl::add( itl::scaled( m_basis[ i ], m_P[ n*c + k + i ] ), U );
+            for( int i = 0; i <= j; ++i ) itl::add( itl::scaled( m_basis[ i ], m_T[ rows*c + k + i ] ), C );
+            // U <- U R^-1, column by column
+            for( int l = 0; l < c; ++l ) itl::add( itl::scaled( m_U_new[ l ], -m_A1[ kn*c + l ] ), U );
+            itl::scale( U, 1./m_A1[ kn*c + c ] );
+        }
+        m_U.swap( m_U_new );
+        m_C.swap( m_C_new );
+        m_recycled = kn;
+    }
+
+    // B <- A^-1 B for column-major n x n matrices, Gaussian elimination with partial pivoting.
+    // A is overwritten. Returns false on a zero pivot.
+    static bool dense_solve( value_type* A, value_type* B, int n ){
+        for( int k = 0; k < n; ++k ){
+            int p = k;
+            for( int i = k + 1; i < n; ++i ) if( std::fabs( A[ n*k + i ] ) > std::fabs( A[ n*k + p ] ) ) p = i;
+            if( A[ n*k + p ] == 0.0 ) return false;
+            for( int c = 0; c < n; ++c ){
+                std::swap( A[ n*c + k ], A[ n*c + p ] );
+                std::swap( B[ n*c + k ], B[ n*c + p ] );
+            }
+            for( int i = k + 1; i < n; ++i ){
+                value_type l = A[ n*k + i ]/A[ n*k + k ];
+                for( int c = k; c < n; ++c ) A[ n*c + i ] -= l*A[ n*c + k ];
+                for( int c = 0; c < n; ++c ) B[ n*c + i ] -= l*B[ n*c + k ];
+            }
+        }
+        for( int c = 0; c < n; ++c ){
+            for( int k = n - 1; k >= 0; --k ){
+                for( int i = k + 1; i < n; ++i ) B[ n*c + k ] -= A[ n*i + k ]*B[ n*c + i ];
+                B[ n*c + k ] /= A[ n*k + k ];
+            }
+        }
+        return true;
+    }
+
+    // Modified Gram-Schmidt on the p_columns columns of the column-major n-row P
+    static bool orthonormalize( value_type* P, int n, int p_columns ){
+        for( int c = 0; c < p_columns; ++c ){
+            for( int l = 0; l < c; ++l ){
+                value_type r = 0.0;
+                for( int i = 0; i < n; ++i ) r += P[ n*l + i ]*P[ n*c + i ];
+                for( int i = 0; i < n; ++i ) P[ n*c + i ] -= r*P[ n*l + i ];
+            }
+            value_type r = 0.0;
+            for( int i = 0; i < n; ++i ) r += P[ n*c + i ]*P[ n*c + i ];
+            r = std::sqrt( r );
+            if( !( r > 0.0 ) ) return false;
+            for( int i = 0; i < n; ++i ) P[ n*c + i ] /= r;
+        }
+        return true;
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    size_type                   m_size;
+    int                         m_restart;
+    std::vector<Vector>         m_basis;
+    std::vector<Vector>         m_work;
+    Vector                      m_w, m_r, m_u;
+    Vector                      m_rhs, m_solution;
+    std::vector<value_type>     m_H;
+    std::vector<value_type>     m_s;
+    std::vector< itl::givens_rotation<value_type> > m_rotations;
+
+    // gcrodr(): the recycled space and its images, the next ones while they are built, and the
+    // small dense matrices of the harmonic Ritz problem
+    std::vector<Vector>         m_U, m_C;
+    std::vector<Vector>         m_U_new, m_C_new;
+    int                         m_recycled;         // vectors of m_U in use
+    std::vector<value_type>     m_G, m_F, m_A1, m_A2, m_P, m_T;
+    value_type                  m_log_rate;         // log of the residual reduction per iteration of the last converged solve
+    value_type                  m_iterations_saved;
+    int                         m_recycle_applies;
+
+}; // class KrylovWorkspace
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_KRYLOVWORKSPACE
@@ -0,0 +1,417 @@
+#ifndef H_WellSimulator_PARTITIONEDBLOCKBANDEDSOLVER
+#define H_WellSimulator_PARTITIONEDBLOCKBANDEDSOLVER
+
+#include <Block4x4.h>
+#include <BlockBandedSolver.h>
+#include <BlockSparseMatrix.h>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// PartitionedBlockBandedSolver ====================================================================
+//
+//  Multithreaded direct solver for the well Jacobian, a SPIKE-like partitioning of the block
+//  Thomas elimination of BlockBandedSolver. The cells are split into P partitions I_p separated by
+//  pairs of cells S_q = { a_q, b_q }: the band reaches two cells up, so a pair is what keeps
+//  neighbouring partitions from coupling. Eliminating the partitions leaves the Schur complement
+//  of the separators, block tridiagonal in 8x8 blocks with one block row per pair:
+//
+//      y_I = A_II^-1 b_I                           one partition per thread
+//      S x_S = b_S - A_SI y_I,  S = A_SS - A_SI A_II^-1 A_IS
+//      x_I = A_II^-1 ( b_I - A_IS x_S )            one partition per thread
+//
+//  A partition only couples to its two separators through its first and last two cells, so
+//  factorize() needs A_II^-1 A_IS, the spikes, at three cells of each partition; they are computed
+//  by the threads with three 4-column solves each. S has P-1 block rows and is factored serially
+//  with partial pivoting inside the 8x8 blocks.
+//  The factorization does about four times the flops of BlockBandedSolver and solve() twice, split
+//  over the threads. The solution is the one of the serial solver up to rounding.
+//  Below the thresholds of set_partition_thresholds() there is a single partition, which is
+//  BlockBandedSolver; by default always.
+//
+class PartitionedBlockBandedSolver
+{
+//--------------------------------------------------------------------------------- Type Definitions
+public:
+    enum{ NS = 2*block4x4::N, SIZE_S = NS*NS };
+
+    // Couplings of a partition with its separators, in the order of the spikes
+    enum{ LEFT_W, LAST2_EE, LAST_E, LAST_EE, total_couplings };
+
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    PartitionedBlockBandedSolver()
+        : m_nblocks( 0 ), m_nthreads( 1 ), m_npartitions( 0 ), m_min_partitions( std::numeric_limits<unsigned>::max() ), m_min_partition( 8 ) {}
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    // One partition per thread. Takes effect on the next load().
+    void set_number_of_threads( unsigned p_nthreads ){
+        p_nthreads = std::max( 1u, p_nthreads );
+        if( p_nthreads == m_nthreads ) return;
+        m_nthreads = p_nthreads;
+        m_nblocks = 0;
+    }
+
+    // Fewer partitions than p_min_partitions, or partitions shorter than p_min_partition cells,
+    // make a single partition; p_min_partition is at least the 3 cells the spikes are taken at.
+    // By default no thread count reaches p_min_partitions: where the threads make up for the
+    // extra work of the partitions depends on the machine. Takes effect on the next load().
+    void set_partition_thresholds( unsigned p_min_partitions, unsigned p_min_partition ){
+        m_min_partitions = p_min_partitions;
+        m_min_partition = std::max( 3u, p_min_partition );
+        m_nblocks = 0;
+    }
+
+    unsigned number_of_blocks() const { return m_nblocks; }
+    unsigned number_of_partitions() const { return m_npartitions; }
+
+    bool load( const BlockSparseMatrix& A ){
+        if( m_nblocks != A.number_of_blocks() ) this->partition( A.number_of_blocks() );
+
+        const int P = int( m_npartitions );
+        #pragma omp parallel for num_threads( P ) schedule( static )
+        for( int p = 0; p < P; ++p ){
+            unsigned first = m_first[ p ], last = first + m_size[ p ] - 1;
+            m_interior[ p ].load( A, first, m_size[ p ] );
+            if( P == 1 ) continue;
+            copy_block( A.block( first,    BlockSparseMatrix::W  ), coupling( p, LEFT_W   ) );
+            copy_block( A.block( last - 1, BlockSparseMatrix::EE ), coupling( p, LAST2_EE ) );
+            copy_block( A.block( last,     BlockSparseMatrix::E  ), coupling( p, LAST_E   ) );
+            copy_block( A.block( last,     BlockSparseMatrix::EE ), coupling( p, LAST_EE  ) );
+        }
+        for( unsigned q = 0; q + 1 < m_npartitions; ++q ){
+            for( unsigned l = 0; l < 2; ++l ){
+                unsigned row = this->separator( q ) + l;
+                for( int offset = BlockSparseMatrix::W; offset <= BlockSparseMatrix::EE; ++offset ){
+                    copy_block( A.block( row, offset ), separator_block( q, l, offset ) );
+                }
+            }
+        }
+        return true;
+    }
+
+    // Returns false on a singular diagonal block of a partition or of the separator system.
+    bool factorize(){
+        const int P = int( m_npartitions );
+        int failed = 0;
+        #pragma omp parallel for num_threads( P ) schedule( static ) reduction( +: failed )
+        for( int p = 0; p < P; ++p ){
+            if( m_interior[ p ].factorize() ) this->compute_spikes( p );
+            else ++failed;
+        }
+        if( failed ) return false;
+        return this->factorize_separators();
+    }
+
+    // x = A^-1 b. Vectors only need operator[]; b and x may be the same object.
+    template <class VectorB, class VectorX>
+    void solve( const VectorB& b, VectorX& x ) const {
+        const int P = int( m_npartitions );
+        const unsigned N = block4x4::N;
+        if( P == 1 ){
+            m_interior[ 0 ].solve( b, x );
+            return;
+        }
+
+        #pragma omp parallel for num_threads( P ) schedule( static )
+        for( int p = 0; p < P; ++p ){
+            std::vector<double>& y = m_rhs[ p ];
+            unsigned first = N*m_first[ p ];
+            for( unsigned k = 0; k < y.size(); ++k ) y[ k ] = b[ first + k ];
+            m_interior[ p ].solve( y, y );
+        }
+
+        for( unsigned q = 0; q + 1 < m_npartitions; ++q ){
+            double* r = &m_separator_x[ NS*q ];
+            unsigned a = this->separator( q );
+            for( unsigned k = 0; k < NS; ++k ) r[ k ] = b[ N*a + k ];
+
+            const std::vector<double>& y_left = m_rhs[ q ];
+            const std::vector<double>& y_right = m_rhs[ q + 1 ];
+            block4x4::gemv_sub( separator_block( q, 0, BlockSparseMatrix::W  ), &y_left[ y_left.size() - N ], r );
+            block4x4::gemv_sub( separator_block( q, 0, BlockSparseMatrix::EE ), &y_right[ 0 ], r );
+            block4x4::gemv_sub( separator_block( q, 1, BlockSparseMatrix::E  ), &y_right[ 0 ], r + N );
+            block4x4::gemv_sub( separator_block( q, 1, BlockSparseMatrix::EE ), &y_right[ N ], r + N );
+        }
+        this->solve_separators();
+
+        #pragma omp parallel for num_threads( P ) schedule( static )
+        for( int p = 0; p < P; ++p ){
+            std::vector<double>& y = m_rhs[ p ];
+            unsigned first = N*m_first[ p ], last = y.size() - N;
+            for( unsigned k = 0; k < y.size(); ++k ) y[ k ] = b[ first + k ];
+            if( p > 0 ){
+                block4x4::gemv_sub( coupling( p, LEFT_W ), &m_separator_x[ NS*( p - 1 ) + N ], &y[ 0 ] );
+            }
+            if( p + 1 < P ){
+                const double* x_a = &m_separator_x[ NS*p ];
+                block4x4::gemv_sub( coupling( p, LAST2_EE ), x_a,     &y[ last - N ] );
+                block4x4::gemv_sub( coupling( p, LAST_E   ), x_a,     &y[ last ] );
+                block4x4::gemv_sub( coupling( p, LAST_EE  ), x_a + N, &y[ last ] );
+            }
+            m_interior[ p ].solve( y, y );
+            for( unsigned k = 0; k < y.size(); ++k ) x[ first + k ] = y[ k ];
+        }
+
+        for( unsigned q = 0; q + 1 < m_npartitions; ++q ){
+            unsigned a = this->separator( q );
+            for( unsigned k = 0; k < NS; ++k ) x[ N*a + k ] = m_separator_x[ NS*q + k ];
+        }
+    }
+
+//-------------------------------------------------------------------------------- Internal functions
+protected:
+    static void copy_block( const double* p_from, double* p_to ){
+        if( p_from ) block4x4::copy( p_from, p_to );
+        else         block4x4::zero( p_to );
+    }
+
+    // First cell of separator q
+    unsigned separator( unsigned q ) const { return m_first[ q ] + m_size[ q ]; }
+
+    double* coupling( unsigned p, int p_coupling ) const {
+        return &m_couplings[ block4x4::SIZE*( total_couplings*p + p_coupling ) ];
+    }
+
+    // Block at stencil offset p_offset of cell l of separator q
+    double* separator_block( unsigned q, unsigned l, int p_offset ) const {
+        return &m_separator_rows[ block4x4::SIZE*( 8*q + 4*l + p_offset - BlockSparseMatrix::W ) ];
+    }
+
+    // Spike block: A_II^-1 A_IS of partition p at cell r ( 0, 1, last ) and separator cell c ( b_{p-1}, a_p, b_p )
+    double* spike( unsigned p, unsigned r, unsigned c ){
+        return &m_spikes[ block4x4::SIZE*( 9*p + 3*r + c ) ];
+    }
+
+    void partition( unsigned p_nblocks ){
+        m_nblocks = p_nblocks;
+        m_npartitions = std::max( 1u, std::min( m_nthreads, ( p_nblocks + 2 )/( m_min_partition + 2 ) ) );
+        if( m_npartitions < m_min_partitions ) m_npartitions = 1;
+
+        // Interior cells shared as evenly as possible, separators in between
+        unsigned ninterior = p_nblocks - 2*( m_npartitions - 1 );
+        m_first.resize( m_npartitions );
+        m_size.resize( m_npartitions );
+        m_interior.resize( m_npartitions );
+        m_rhs.resize( m_npartitions );
+        m_spike_work.resize( m_npartitions );
+        for( unsigned p = 0, first = 0; p < m_npartitions; ++p ){
+            m_first[ p ] = first;
+            m_size[ p ] = ninterior/m_npartitions + ( p < ninterior % m_npartitions ? 1 : 0 );
+            m_rhs[ p ].assign( block4x4::N*m_size[ p ], 0.0 );
+            m_spike_work[ p ].assign( block4x4::SIZE*m_size[ p ], 0.0 );
+            first += m_size[ p ] + 2;
+        }
+
+        unsigned nseparators = m_npartitions - 1;
+        m_couplings.assign( block4x4::SIZE*total_couplings*m_npartitions, 0.0 );
+        m_spikes.assign( 9*block4x4::SIZE*m_npartitions, 0.0 );
+        m_separator_rows.assign( 8*block4x4::SIZE*nseparators, 0.0 );
+        m_S_D.assign( SIZE_S*nseparators, 0.0 );
+        m_S_L.assign( SIZE_S*nseparators, 0.0 );
+        m_S_U.assign( SIZE_S*nseparators, 0.0 );
+        m_S_pivot.assign( NS*nseparators, 0 );
+        m_separator_x.assign( NS*nseparators, 0.0 );
+    }
+
+    // Spikes of partition p, on the thread that factored it
+    void compute_spikes( int p ){
+        const unsigned m = m_size[ p ];
+        const unsigned SIZE = block4x4::SIZE;
+        const unsigned rows[ 3 ] = { 0, 1, m - 1 };
+        double* Y = &m_spike_work[ p ][ 0 ];
+
+        for( unsigned c = 0; c < 3; ++c ){
+            bool exists = ( c == 0 ) ? p > 0 : p + 1 < int( m_npartitions );
+            if( !exists ) continue;
+
+            std::fill( Y, Y + SIZE*m, 0.0 );
+            unsigned first = 0;
+            if( c == 0 ){
+                block4x4::copy( coupling( p, LEFT_W ), Y );
+            }
+            else if( c == 1 ){
+                block4x4::copy( coupling( p, LAST2_EE ), Y + SIZE*( m - 2 ) );
+                block4x4::copy( coupling( p, LAST_E ), Y + SIZE*( m - 1 ) );
+                first = m - 2;
+            }
+            else{
+                block4x4::copy( coupling( p, LAST_EE ), Y + SIZE*( m - 1 ) );
+                first = m - 1;
+            }
+            m_interior[ p ].solve_block( Y, first );
+            for( unsigned r = 0; r < 3; ++r ) block4x4::copy( Y + SIZE*rows[ r ], spike( p, r, c ) );
+        }
+    }
+
+    // Assembles and factors S = A_SS - A_SI A_II^-1 A_IS
+    bool factorize_separators(){
+        const unsigned nseparators = m_npartitions - 1;
+        std::fill( m_S_L.begin(), m_S_L.end(), 0.0 );
+        std::fill( m_S_U.begin(), m_S_U.end(), 0.0 );
+        for( unsigned q = 0; q < nseparators; ++q ){
+            double* D = &m_S_D[ SIZE_S*q ];
+            std::fill( D, D + SIZE_S, 0.0 );
+            add_to_S( separator_block( q, 0, BlockSparseMatrix::C ), 1.0, D, 0, 0 );
+            add_to_S( separator_block( q, 0, BlockSparseMatrix::E ), 1.0, D, 0, 1 );
+            add_to_S( separator_block( q, 1, BlockSparseMatrix::W ), 1.0, D, 1, 0 );
+            add_to_S( separator_block( q, 1, BlockSparseMatrix::C ), 1.0, D, 1, 1 );
+        }
+
+        // Partition p connects separators p-1 ( rows a, b through its cells 0 and 1 ) and p ( row a through its last cell )
+        double product[ block4x4::SIZE ];
+        for( unsigned p = 0; p < m_npartitions; ++p ){
+            for( unsigned c = 0; c < 3; ++c ){
+                if( c == 0 ? p == 0 : p + 1 == m_npartitions ) continue;
+                unsigned q_col = ( c == 0 ) ? p - 1 : p;
+                unsigned l_col = ( c == 1 ) ? 0 : 1;
+
+                if( p > 0 ){
+                    unsigned q = p - 1;
+                    double* S = this->S_block( q, q_col );
+                    multiply( separator_block( q, 0, BlockSparseMatrix::EE ), spike( p, 0, c ), product );
+                    add_to_S( product, -1.0, S, 0, l_col );
+                    multiply( separator_block( q, 1, BlockSparseMatrix::E ), spike( p, 0, c ), product );
+                    add_to_S( product, -1.0, S, 1, l_col );
+                    multiply( separator_block( q, 1, BlockSparseMatrix::EE ), spike( p, 1, c ), product );
+                    add_to_S( product, -1.0, S, 1, l_col );
+                }
+                if( p + 1 < m_npartitions ){
+                    double* S = this->S_block( p, q_col );
+                    multiply( separator_block( p, 0, BlockSparseMatrix::W ), spike( p, 2, c ), product );
+                    add_to_S( product, -1.0, S, 0, l_col );
+                }
+            }
+        }
+
+        // Block Thomas on the 8x8 blocks, U_q <- D_q^-1 U_q
+        double work[ SIZE_S ];
+        for( unsigned q = 0; q < nseparators; ++q ){
+            double* D = &m_S_D[ SIZE_S*q ];
+            if( q > 0 ){
+                dense_gemm( &m_S_L[ SIZE_S*q ], &m_S_U[ SIZE_S*( q - 1 ) ], work );
+                for( unsigned k = 0; k < SIZE_S; ++k ) D[ k ] -= work[ k ];
+            }
+            if( !dense_lu_factor( D, &m_S_pivot[ NS*q ] ) ) return false;
+            double* U = &m_S_U[ SIZE_S*q ];
+            for( unsigned j = 0; j < NS; ++j ){
+                double column[ NS ];
+                for( unsigned i = 0; i < NS; ++i ) column[ i ] = U[ NS*i + j ];
+                dense_lu_solve( D, &m_S_pivot[ NS*q ], column );
+                for( unsigned i = 0; i < NS; ++i ) U[ NS*i + j ] = column[ i ];
+            }
+        }
+        return true;
+    }
+
+    // m_separator_x <- S^-1 m_separator_x
+    void solve_separators() const {
+        const unsigned nseparators = m_npartitions - 1;
+        for( unsigned q = 0; q < nseparators; ++q ){
+            double* x = &m_separator_x[ NS*q ];
+            if( q > 0 ) dense_gemv_sub( &m_S_L[ SIZE_S*q ], x - NS, x );
+            dense_lu_solve( &m_S_D[ SIZE_S*q ], &m_S_pivot[ NS*q ], x );
+        }
+        for( unsigned q = nseparators; q-- > 1; ){
+            dense_gemv_sub( &m_S_U[ SIZE_S*( q - 1 ) ], &m_separator_x[ NS*q ], &m_separator_x[ NS*( q - 1 ) ] );
+        }
+    }
+
+    // 8x8 block of S at block row q, block column q_col ( q-1, q or q+1 )
+    double* S_block( unsigned q, unsigned q_col ){
+        if( q_col < q ) return &m_S_L[ SIZE_S*q ];
+        if( q_col > q ) return &m_S_U[ SIZE_S*q ];
+        return &m_S_D[ SIZE_S*q ];
+    }
+
+    // c = a*b for 4x4 blocks
+    static void multiply( const double* a, const double* b, double* c ){
+        block4x4::zero( c );
+        for( unsigned i = 0; i < block4x4::N; ++i )
+            for( unsigned k = 0; k < block4x4::N; ++k )
+                for( unsigned j = 0; j < block4x4::N; ++j )
+                    c[ block4x4::N*i + j ] += a[ block4x4::N*i + k ]*b[ block4x4::N*k + j ];
+    }
+
+    // Adds p_factor*a to the 4x4 sub-block ( l_row, l_col ) of the row-major 8x8 block S
+    static void add_to_S( const double* a, double p_factor, double* S, unsigned l_row, unsigned l_col ){
+        for( unsigned i = 0; i < block4x4::N; ++i )
+            for( unsigned j = 0; j < block4x4::N; ++j )
+                S[ NS*( block4x4::N*l_row + i ) + block4x4::N*l_col + j ] += p_factor*a[ block4x4::N*i + j ];
+    }
+
+    // Dense 8x8 kernels for the separator system, row-major like the 4x4 blocks
+    static void dense_gemm( const double* a, const double* b, double* c ){
+        for( unsigned i = 0; i < NS; ++i ){
+            for( unsigned j = 0; j < NS; ++j ){
+                double sum = 0.0;
+                for( unsigned k = 0; k < NS; ++k ) sum += a[ NS*i + k ]*b[ NS*k + j ];
+                c[ NS*i + j ] = sum;
+            }
+        }
+    }
+
+    static void dense_gemv_sub( const double* a, const double* x, double* y ){
+        for( unsigned i = 0; i < NS; ++i )
+            for( unsigned k = 0; k < NS; ++k ) y[ i ] -= a[ NS*i + k ]*x[ k ];
+    }
+
+    static bool dense_lu_factor( double* a, int* piv ){
+        for( unsigned k = 0; k < NS; ++k ){
+            unsigned p = k;
+            for( unsigned i = k + 1; i < NS; ++i ) if( std::fabs( a[ NS*i + k ] ) > std::fabs( a[ NS*p + k ] ) ) p = i;
+            piv[ k ] = int( p );
+            if( a[ NS*p + k ] == 0.0 ) return false;
+            if( p != k ) for( unsigned j = 0; j < NS; ++j ) std::swap( a[ NS*k + j ], a[ NS*p + j ] );
+            for( unsigned i = k + 1; i < NS; ++i ){
+                double l = a[ NS*i + k ] /= a[ NS*k + k ];
+                for( unsigned j = k + 1; j < NS; ++j ) a[ NS*i + j ] -= l*a[ NS*k + j ];
+            }
+        }
+        return true;
+    }
+
+    static void dense_lu_solve( const double* lu, const int* piv, double* x ){
+        for( unsigned k = 0; k < NS; ++k ){
+            std::swap( x[ k ], x[ piv[ k ] ] );
+            for( unsigned j = 0; j < k; ++j ) x[ k ] -= lu[ NS*k + j ]*x[ j ];
+        }
+        for( unsigned k = NS; k-- > 0; ){
+            for( unsigned j = k + 1; j < NS; ++j ) x[ k ] -= lu[ NS*k + j ]*x[ j ];
+            x[ k ] /= lu[ NS*k + k ];
+        }
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    unsigned                            m_nblocks;
+    unsigned                            m_nthreads;
+    unsigned                            m_npartitions;
+    unsigned                            m_min_partitions;
+    unsigned                            m_min_partition;    // cells
+    std::vector<unsigned>               m_first;        // first cell of each partition
+    std::vector<unsigned>               m_size;         // cells of each partition
+    std::vector<BlockBandedSolver>      m_interior;
+    std::vector< std::vector<double> >  m_spike_work;
+    mutable std::vector< std::vector<double> > m_rhs;
+
+    mutable std::vector<double>         m_couplings;
+    mutable std::vector<double>         m_separator_rows;
+    std::vector<double>                 m_spikes;
+
+    // Separator system, block tridiagonal: L_q, D_q ( LU ), U_q ( D_q^-1 U_q once factored )
+    std::vector<double>                 m_S_L, m_S_D, m_S_U;
+    std::vector<int>                    m_S_pivot;
+    mutable std::vector<double>         m_separator_x;
+
+}; // class PartitionedBlockBandedSolver
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_PARTITIONEDBLOCKBANDEDSOLVER
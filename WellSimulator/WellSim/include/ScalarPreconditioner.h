@@ -0,0 +1,127 @@
+#ifndef H_WellSimulator_SCALARPRECONDITIONER
+#define H_WellSimulator_SCALARPRECONDITIONER
+
+#include <BlockSparseMatrix.h>
+#include <SharedPointer.h>
+#include <mtl/matrix.h>
+#include <mtl/mtl.h>
+#include <itl/itl.h>
+#include <itl/preconditioner/ilu.h>
+#include <itl/preconditioner/ilut.h>
+#include <itl/preconditioner/ssor.h>
+#include <itl/preconditioner/diagonal.h>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// ScalarPreconditioner ============================================================================
+//
+//  The scalar ITL preconditioners on the well Jacobian. factorize() puts the blocks in an MTL
+//  compressed row matrix (BlockSparseMatrix::copy_to()) and builds one of
+//
+//      ILU0        itl::ILU, with the zeros of the blocks in its pattern: the exact LU, unpivoted
+//      ILUT        itl::ILUT, by default 4 fill-ins per row and entries below 1E-4 dropped
+//      SSOR        itl::SSOR
+//      DIAGONAL    itl::diagonal_precond, scalar Jacobi
+//
+//  on the copy. The copy keeps its storage from one factorize() to the next, but the ITL
+//  preconditioners allocate their factors each time. solve() and trans_solve() have the ITL
+//  preconditioner signatures, trans_solve() for QMR; the vectors are MTL vectors.
+//
+class ScalarPreconditioner
+{
+//--------------------------------------------------------------------------------- Type Definitions
+public:
+    typedef mtl::matrix< double, mtl::rectangle<>, mtl::array< mtl::compressed<> >, mtl::row_major >::type matrix_type;
+    enum kind_type{ ILU0, ILUT, SSOR, DIAGONAL };
+
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+    ScalarPreconditioner() : m_kind( ILU0 ), m_nblocks( 0 ), m_ilut_fill( 4 ), m_ilut_drop( 1E-4 ) {}
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+    unsigned number_of_blocks() const { return m_nblocks; }
+    kind_type kind() const { return m_kind; }
+    const matrix_type& matrix() const { return m_A; }
+
+    // ILUT: fill-ins kept per row, and the threshold below which entries are dropped
+    void set_ilut( int p_fill, double p_drop ){
+        m_ilut_fill = p_fill;
+        m_ilut_drop = p_drop;
+    }
+
+    // Returns false on a zero diagonal entry of A, which all of them divide by
+    bool factorize( const BlockSparseMatrix& A, kind_type p_kind ){
+        m_nblocks = 0;
+        A.copy_to( m_A );
+        const matrix_type& A_copy = m_A;
+        for( unsigned r = 0; r < A_copy.nrows(); ++r ){
+            if( A_copy( r, r ) == 0.0 ) return false;
+        }
+
+        m_kind = p_kind;
+        switch( p_kind ){
+        case ILU0:
+            m_ilu = MakeShared< itl::ILU<matrix_type> >( m_A );
+            m_ilu_precond = (*m_ilu)();
+            break;
+        case ILUT:
+            m_ilut = MakeShared< itl::ILUT<matrix_type> >( m_A, m_ilut_fill, m_ilut_drop );
+            m_ilut_precond = (*m_ilut)();
+            break;
+        case SSOR:
+            m_ssor = MakeShared< itl::SSOR<matrix_type> >( m_A );
+            m_ssor_precond = (*m_ssor)();
+            break;
+        default:
+            m_diagonal = MakeShared< itl::diagonal_precond<matrix_type> >( m_A );
+        }
+        m_nblocks = A.number_of_blocks();
+        return true;
+    }
+
+    // z = M^-1 x; x and z may be the same vector
+    template <class VecX, class VecZ>
+    void solve( const VecX& x, const VecZ& z ) const {
+        switch( m_kind ){
+        case ILU0:  m_ilu_precond.solve( x, z ); break;
+        case ILUT:  m_ilut_precond.solve( x, z ); break;
+        case SSOR:  m_ssor_precond.solve( x, z ); break;
+        default:    itl::solve( (*m_diagonal)(), x, z );
+        }
+    }
+
+    // z = M^-T x
+    template <class VecX, class VecZ>
+    void trans_solve( const VecX& x, const VecZ& z ) const {
+        switch( m_kind ){
+        case ILU0:  m_ilu_precond.trans_solve( x, z ); break;
+        case ILUT:  m_ilut_precond.trans_solve( x, z ); break;
+        case SSOR:  m_ssor_precond.trans_solve( x, z ); break;
+        default:    itl::trans_solve( (*m_diagonal)(), x, z );
+        }
+    }
+
+//--------------------------------------------------------------------------------------------- Data
+protected:
+    kind_type       m_kind;
+    unsigned        m_nblocks;
+    matrix_type     m_A;
+    int             m_ilut_fill;
+    double          m_ilut_drop;
+    // The preconditioners point into the factors of their ITL objects, which aren't copyable
+    SharedPointer< itl::ILU<matrix_type> >              m_ilu;
+    SharedPointer< itl::ILUT<matrix_type> >             m_ilut;
+    SharedPointer< itl::SSOR<matrix_type> >             m_ssor;
+    SharedPointer< itl::diagonal_precond<matrix_type> > m_diagonal;
+    itl::ILU<matrix_type>::Precond                      m_ilu_precond;
+    itl::ILUT<matrix_type>::Precond                     m_ilut_precond;
+    itl::SSOR<matrix_type>::Precond                     m_ssor_precond;
+
+}; // class ScalarPreconditioner
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_SCALARPRECONDITIONER
@@ -0,0 +1,115 @@
+#ifndef H_WellSimulator_WELLSTATE
+#define H_WellSimulator_WELLSTATE
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// Namespace =======================================================================================
+namespace WellSimulator {
+
+// WellState =======================================================================================
+//
+//  State of the drift-flux well in one aligned buffer of doubles:
+//
+//      [ P a_g a_o v | P a_g a_o v | ... ][ a_w ... ]     current record
+//      [ P a_g a_o v | P a_g a_o v | ... ][ a_w ... ]     old record (last snapshot())
+//      [ v_o ... ][ v_w ... ][ v_g ... ]                  phase velocities
+//
+//  The unknowns of a node are contiguous and in the order of the Newton vector (unknown k of node
+//  i at 4*i + k), so the state and a Newton vector convert with one block copy. Each record is
+//  a single block too: snapshot() and restore() are one copy of 5*n doubles.
+//  field is a strided view of one quantity with the indexing of the old per-quantity vectors.
+//
+class WellState
+{
+//--------------------------------------------------------------------------------- Type Definitions
+public:
+	typedef double			real_type;
+	typedef unsigned int	uint_type;
+
+	enum{ unknowns_per_node = 4, record_size = unknowns_per_node + 1, alignment = 64 };
+
+	class field
+	{
+	public:
+		field() : m_data( 0 ), m_stride( 0 ) {}
+		field( real_type* p_data, uint_type p_stride ) : m_data( p_data ), m_stride( p_stride ) {}
+
+		real_type& operator []( uint_type p_node ) const { return m_data[ m_stride*p_node ]; }
+
+	private:
+		real_type*	m_data;
+		uint_type	m_stride;
+	};
+
+//------------------------------------------------------------------------- Constructor & Destructor
+public:
+	WellState() : m_nnodes( 0 ), m_offset( 0 ) { this->resize( 0 ); }
+
+//------------------------------------------------------------------------------------ Main functions
+public:
+	// Zeroes the state. Views taken before are invalidated.
+	void resize( uint_type p_nnodes ){
+		m_nnodes = p_nnodes;
+		m_buffer.assign( ( 2*record_size + 3 )*p_nnodes + alignment/sizeof( real_type ), 0.0 );
+		std::size_t address = reinterpret_cast<std::size_t>( &m_buffer[ 0 ] );
+		m_offset = ( ( alignment - address % alignment ) % alignment )/sizeof( real_type );
+	}
+
+	uint_type number_of_nodes() const { return m_nnodes; }
+	uint_type number_of_unknowns() const { return unknowns_per_node*m_nnodes; }
+
+	real_type* unknowns() { return this->current(); }
+	const real_type* unknowns() const { return const_cast<WellState*>( this )->current(); }
+
+	field unknown( uint_type p_variable )		{ return field( this->current() + p_variable, unknowns_per_node ); }
+	field old_unknown( uint_type p_variable )	{ return field( this->old() + p_variable, unknowns_per_node ); }
+	field water_vol_frac()						{ return field( this->current() + number_of_unknowns(), 1 ); }
+	field old_water_vol_frac()					{ return field( this->old() + number_of_unknowns(), 1 ); }
+	// p_phase: 0 oil, 1 water, 2 gas
+	field phase_velocity( uint_type p_phase )	{ return field( this->old() + ( record_size + p_phase )*m_nnodes, 1 ); }
+
+	// old record <- current record
+	void snapshot(){
+		std::copy( this->current(), this->current() + record_size*m_nnodes, this->old() );
+	}
+
+	// current record <- old record
+	void restore(){
+		std::copy( this->old(), this->old() + record_size*m_nnodes, this->current() );
+	}
+
+	// Newton-vector layout, p_unknowns must hold number_of_unknowns() values
+	template<class Vector>
+	void get_unknowns( Vector& p_unknowns ) const {
+		const real_type* x = this->unknowns();
+		for( uint_type k = 0; k < number_of_unknowns(); ++k ) p_unknowns[ k ] = x[ k ];
+	}
+
+	template<class Vector>
+	void set_unknowns( const Vector& p_unknowns ){
+		real_type* x = this->unknowns();
+		for( uint_type k = 0; k < number_of_unknowns(); ++k ) x[ k ] = p_unknowns[ k ];
+	}
+
+//------------------------------------------------------------------------------------------ Helpers
+private:
+	real_type* current()	{ return &m_buffer[ 0 ] + m_offset; }
+	real_type* old()		{ return this->current() + record_size*m_nnodes; }
+
+	// Copies would lose the alignment and leave the fields of the owner on the original
+	WellState( const WellState& );
+	WellState& operator =( const WellState& );
+
+//--------------------------------------------------------------------------------------------- Data
+private:
+	uint_type				m_nnodes;
+	std::size_t				m_offset; // first aligned double of m_buffer
+	std::vector<real_type>	m_buffer;
+};
+
+// Namespace =======================================================================================
+} // namespace WellSimulator
+
+#endif // H_WellSimulator_WELLSTATE
@@ -107,6 +107,9 @@ int main( int argc, char **argv ) {
     InFile.ignore(50,':');	InFile >> well_initial_data->m_gas_ref_pressure;
     InFile.ignore(50,':');	InFile >> well_initial_data->m_gas_sound_speed;
     InFile.ignore(50,':');	InFile >> well_initial_data->m_gas_viscosity;
+    // gmres, bicgstab, tfqmr, cgs, gcr, gcrodr, qmr or auto; ilu, jacobi, cpr, schwarz, scalar_ilu, ilut, ssor, diagonal or none
+    InFile.ignore(50,':');	InFile >> well_initial_data->m_krylov_solver;
+    InFile.ignore(50,':');	InFile >> well_initial_data->m_preconditioner;
     
     
     // ------------------------------------------------------------------------------
@@ -47,6 +47,10 @@ struct WellInitialData{
     float64 m_gas_sound_speed;
     float64 m_gas_viscosity;
 
+    // Linear solver, by the names of the setup file
+    std::string m_krylov_solver;
+    std::string m_preconditioner;
+
     // Drift flux correlation parameters
 
 };
@@ -133,6 +137,9 @@ SharedPointer<DriftFluxWell> simulate(SharedPointer<WellInitialData> p_initial_d
     wells->set_with_gas( true );
     wells->set_mass_flux( false );
     wells->set_newton_criteria( p_initial_data->m_tolerance );
+    if( !p_initial_data->m_krylov_solver.empty() && !wells->set_krylov_solver( p_initial_data->m_krylov_solver, p_initial_data->m_preconditioner ) ){
+        std::cout << "\nUnknown or unsupported Krylov solver and preconditioner: " << p_initial_data->m_krylov_solver << " + " << p_initial_data->m_preconditioner;
+    }
 
     inflow_vector_type inflow_gas(p_initial_data->m_number_of_nodes, MakeShared<ConstantInflow>(0.0));
     inflow_vector_type inflow_oil(p_initial_data->m_number_of_nodes, MakeShared<ConstantInflow>(0.0));
@@ -249,6 +256,9 @@ SharedPointer<DriftFluxWell> simulate_provenzano(SharedPointer<WellInitialData>
     wells->set_with_gas( true );
     wells->set_mass_flux( true ); // mass inflow flux
     wells->set_newton_criteria( p_initial_data->m_tolerance );
+    if( !p_initial_data->m_krylov_solver.empty() && !wells->set_krylov_solver( p_initial_data->m_krylov_solver, p_initial_data->m_preconditioner ) ){
+        std::cout << "\nUnknown or unsupported Krylov solver and preconditioner: " << p_initial_data->m_krylov_solver << " + " << p_initial_data->m_preconditioner;
+    }
 
     real_type n_nodes = p_initial_data->m_number_of_nodes;
     real_type length = p_initial_data->m_well_length;
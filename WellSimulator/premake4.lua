@@ -35,3 +35,14 @@ files {
 	"**.h",
 	"**.hpp"
 }
+excludes {
+	"Tests/**"
+}
+
+-- Parallel Jacobian assembly (DriftFluxWell::set_number_of_threads)
+configuration "vs*"
+	buildoptions { "/openmp" }
+configuration "gmake"
+	buildoptions { "-fopenmp" }
+	linkoptions { "-fopenmp" }
+configuration {}
@@ -48,6 +48,7 @@ libdirs {
 }
 
 include "./WellSimulator"
+include "./WellSimulator/Tests"
 include "./libgtkgraph"
 
 